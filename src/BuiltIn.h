@@ -35,3 +35,8 @@ extern const size_t midi_length;
 
 extern const char pin_mapper[];
 extern const size_t pin_mapper_length;
+
+extern const char checked[];
+extern const size_t checked_length;
+extern const char profile[];
+extern const size_t profile_length;
@@ -0,0 +1,54 @@
+#include "CompileOptions.h"
+
+#include "Common.h"
+
+const char* GetOptimizationPassString(OptimizationPass pass)
+{
+	switch (pass)
+	{
+	case OptimizationPass_StructReference: return "struct-reference";
+	case OptimizationPass_BlockMode: return "block-mode";
+	case OptimizationPass_ClosureConversion: return "closures";
+	case OptimizationPass_Specialization: return "specialize";
+	case OptimizationPass_Inlining: return "inline";
+	case OptimizationPass_Unrolling: return "unroll";
+	case OptimizationPass_LoopIdioms: return "loop-idioms";
+	case OptimizationPass_GlobalConstants: return "global-constants";
+	case OptimizationPass_CopyPropagation: return "copy-propagation";
+	case OptimizationPass_CommonSubexpression: return "cse";
+	case OptimizationPass_Simplification: return "simplify";
+	case OptimizationPass_DeadStores: return "dead-stores";
+	case OptimizationPass_Coalescing: return "coalesce";
+	default: INVALID_VALUE(pass);
+	}
+}
+
+bool IsOptimizationPassEnabled(const CompileOptions* options, OptimizationPass pass)
+{
+	if (options->passes[pass] != PassSetting_Default)
+		return options->passes[pass] == PassSetting_Enabled;
+
+	switch (options->optimizationLevel)
+	{
+	case OptimizationLevel_None:
+		// block mode is asked for in the code with [block: true]
+		return pass == OptimizationPass_BlockMode;
+	case OptimizationLevel_Basic:
+		// only the passes that never make the code bigger
+		return pass == OptimizationPass_StructReference ||
+			   pass == OptimizationPass_BlockMode ||
+			   pass == OptimizationPass_GlobalConstants ||
+			   pass == OptimizationPass_CopyPropagation ||
+			   pass == OptimizationPass_Simplification ||
+			   pass == OptimizationPass_DeadStores ||
+			   pass == OptimizationPass_Coalescing;
+	case OptimizationLevel_Full:
+		return true;
+	case OptimizationLevel_Size:
+		// specialization copies functions, passing variables adds arguments to every call,
+		// and unrolling only happens for loops marked with [unroll: true]
+		return pass != OptimizationPass_Specialization &&
+			   pass != OptimizationPass_ClosureConversion;
+	default: INVALID_VALUE(options->optimizationLevel);
+	}
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stdbool.h>
+
+// functions with a body this big (in syntax tree nodes) or smaller get inlined
+#define DEFAULT_INLINE_THRESHOLD 24
+// struct parameters with this many members or more are passed by address when they can be
+#define DEFAULT_STRUCT_REFERENCE_THRESHOLD 4
+
+typedef enum
+{
+	OptimizationLevel_None,
+	OptimizationLevel_Basic,
+	OptimizationLevel_Full,
+	OptimizationLevel_Size,
+} OptimizationLevel;
+
+typedef enum
+{
+	OptimizationPass_StructReference,
+	OptimizationPass_BlockMode,
+	OptimizationPass_ClosureConversion,
+	OptimizationPass_Specialization,
+	OptimizationPass_Inlining,
+	OptimizationPass_Unrolling,
+	OptimizationPass_LoopIdioms,
+	OptimizationPass_GlobalConstants,
+	OptimizationPass_CopyPropagation,
+	OptimizationPass_CommonSubexpression,
+	OptimizationPass_Simplification,
+	OptimizationPass_DeadStores,
+	OptimizationPass_Coalescing,
+	OptimizationPass_Count,
+} OptimizationPass;
+
+typedef enum
+{
+	PassSetting_Default,
+	PassSetting_Enabled,
+	PassSetting_Disabled,
+} PassSetting;
+
+typedef enum
+{
+	CostReport_None,
+	CostReport_Text,
+	CostReport_Json,
+} CostReportFormat;
+
+typedef struct
+{
+	int inlineThreshold;
+	int structReferenceThreshold;
+	OptimizationLevel optimizationLevel;
+	PassSetting passes[OptimizationPass_Count];
+	bool passReport;
+	bool memoryMap;
+	bool footprint;
+	bool checked;
+	bool profile;
+	CostReportFormat costReport;
+	bool minify;
+	bool hash;
+} CompileOptions;
+
+#define DEFAULT_COMPILE_OPTIONS \
+	(CompileOptions) { .inlineThreshold = DEFAULT_INLINE_THRESHOLD, .structReferenceThreshold = DEFAULT_STRUCT_REFERENCE_THRESHOLD, .optimizationLevel = OptimizationLevel_Full }
+
+const char* GetOptimizationPassString(OptimizationPass pass);
+bool IsOptimizationPassEnabled(const CompileOptions* options, OptimizationPass pass);
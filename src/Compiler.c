@@ -1,6 +1,7 @@
 #include "Compiler.h"
 
 #include <errno.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -32,6 +33,11 @@ typedef struct
 	bool publicImport;
 } ProgramDependency;
 
+// the checked module is only imported in builds with bounds checks
+static bool checkedBuild;
+// and the profile module only in builds with profiling
+static bool profileBuild;
+
 static void FreeProgramTree(const Array* programNodes)
 {
 	for (size_t i = 0; i < programNodes->length; ++i)
@@ -94,10 +100,37 @@ error:
 		errorPath);
 }
 
+// reaper reloads an effect whenever the file changes, so a build that didn't change anything shouldn't touch it
+static bool HasFileContent(const char* path, const char* bytes, size_t bytesLength)
+{
+	FILE* file = fopen(path, "rb");
+	if (file == NULL)
+		return false;
+
+	bool same = true;
+	size_t offset = 0;
+	char buffer[4096];
+	while (same)
+	{
+		size_t read = fread(buffer, sizeof(char), sizeof(buffer), file);
+		if (read == 0)
+			break;
+
+		same = offset + read <= bytesLength && memcmp(buffer, bytes + offset, read) == 0;
+		offset += read;
+	}
+
+	fclose(file);
+	return same && offset == bytesLength;
+}
+
 static Result WriteFile(const char* path, const char* bytes, size_t bytesLength)
 {
 	ASSERT(path);
 
+	if (HasFileContent(path, bytes, bytesLength))
+		return SUCCESS_RESULT;
+
 	errno = 0;
 	FILE* file = fopen(path, "wb");
 	if (file == NULL)
@@ -123,6 +156,18 @@ error:
 		NULL);
 }
 
+// fnv-1a, it only depends on the bytes so it is the same on every machine
+static uint64_t HashBytes(const char* bytes, size_t length)
+{
+	uint64_t hash = 0xcbf29ce484222325;
+	for (size_t i = 0; i < length; ++i)
+	{
+		hash ^= (uint8_t)bytes[i];
+		hash *= 0x100000001b3;
+	}
+	return hash;
+}
+
 static Result CheckFileReadable(const char* path, int lineNumber, const char* errorPath)
 {
 	char* errorMessage = NULL;
@@ -173,8 +218,9 @@ static Result CheckFileWriteable(const char* path, int lineNumber, const char* e
 	char* errorMessage = NULL;
 	ASSERT(path);
 
+	// append mode creates the file without truncating it
 	errno = 0;
-	FILE* file = fopen(path, "wb");
+	FILE* file = fopen(path, "ab");
 	if (file == NULL)
 		goto error;
 
@@ -318,6 +364,10 @@ static void AddBuiltInDependencies(AST* ast, Array* dependencies, Array* program
 	AddBuiltInDependency(ast, dependencies, programNodes, STRINGIFY(slider), slider, slider_length);
 	AddBuiltInDependency(ast, dependencies, programNodes, STRINGIFY(midi), midi, midi_length);
 	AddBuiltInDependency(ast, dependencies, programNodes, STRINGIFY(pin_mapper), pin_mapper, pin_mapper_length);
+	if (checkedBuild)
+		AddBuiltInDependency(ast, dependencies, programNodes, STRINGIFY(checked), checked, checked_length);
+	if (profileBuild)
+		AddBuiltInDependency(ast, dependencies, programNodes, STRINGIFY(profile), profile, profile_length);
 }
 
 static Result GenerateProgramNode(
@@ -452,30 +502,60 @@ static void AddNodeToMergedAST(const ProgramNode* node, void* mergedAST)
 	ArrayAdd(&ast->nodes, &module);
 }
 
-static Result CompileProgramTree(const Array* programNodes, char** outCode, size_t* outLength)
+static Result CompileProgramTree(const Array* programNodes, const CompileOptions* options, char** outCode, size_t* outLength, char** outProfileMap, char** outCostReport)
 {
 	AST merged = {.nodes = AllocateArray(sizeof(NodePtr))};
 	TopologicalVisitProgramTree(programNodes, AddNodeToMergedAST, &merged);
-	PROPAGATE_ERROR(GenerateCode(&merged, outCode, outLength));
+	PROPAGATE_ERROR(GenerateCode(&merged, options, outCode, outLength, outProfileMap, outCostReport));
 	FreeAST(merged);
 	return SUCCESS_RESULT;
 }
 
-Result Compile(const char* inputPath, const char* outputPath)
+Result Compile(const char* inputPath, const char* outputPath, const CompileOptions* options)
 {
 	PROPAGATE_ERROR(CheckFileWriteable(outputPath, -1, NULL));
 	char* outPath = AllocAbsolutePath(outputPath);
 
+	checkedBuild = options->checked;
+	profileBuild = options->profile;
 	Array programNodes = AllocateArray(sizeof(ProgramNode*));
 	PROPAGATE_ERROR(GenerateProgramNode(&programNodes, inputPath, -1, NULL, NULL));
 
 	char* code = NULL;
 	size_t codeLength = 0;
-	PROPAGATE_ERROR(CompileProgramTree(&programNodes, &code, &codeLength));
+	char* profileMap = NULL;
+	char* costReport = NULL;
+	PROPAGATE_ERROR(CompileProgramTree(&programNodes, options, &code, &codeLength, &profileMap, &costReport));
 	FreeProgramTree(&programNodes);
 
 	PROPAGATE_ERROR(WriteFile(outPath, code, codeLength));
 
+	if (options->hash)
+	{
+		char* hashPath = AllocateString1Str("%s.hash", outPath);
+		char hash[32];
+		snprintf(hash, sizeof(hash), "%016llx\n", (unsigned long long)HashBytes(code, codeLength));
+		PROPAGATE_ERROR(WriteFile(hashPath, hash, strlen(hash)));
+		free(hashPath);
+	}
+
+	// the profile map says which counter belongs to which function, see profile-report
+	if (profileMap)
+	{
+		char* mapPath = AllocateString1Str("%s.profile", outPath);
+		PROPAGATE_ERROR(WriteFile(mapPath, profileMap, strlen(profileMap)));
+		free(mapPath);
+		free(profileMap);
+	}
+
+	if (costReport)
+	{
+		char* reportPath = AllocateString1Str("%s.cost.json", outPath);
+		PROPAGATE_ERROR(WriteFile(reportPath, costReport, strlen(costReport)));
+		free(reportPath);
+		free(costReport);
+	}
+
 	free(outPath);
 	free(code);
 	return SUCCESS_RESULT;
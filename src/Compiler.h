@@ -1,5 +1,6 @@
 #pragma once
 
+#include "CompileOptions.h"
 #include "Result.h"
 
-Result Compile(const char* inputPath, const char* outputPath);
+Result Compile(const char* inputPath, const char* outputPath, const CompileOptions* options);
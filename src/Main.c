@@ -1,22 +1,159 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "Compiler.h"
 #include "PlatformUtils.h"
 
+static void PrintUsage(const char* executable)
+{
+	fprintf(stderr, "Usage: %s <input_file> [output_file] [options]\n", AllocFileName(executable));
+	fprintf(stderr, "Options:\n");
+	fprintf(stderr, "  -O0, -O1, -O2, -Os       optimization level: none, basic, full or optimize for size (default: -O2)\n");
+	fprintf(stderr, "  --inline-threshold <n>   inline functions with a body of up to n nodes, 0 disables inlining (default: %d)\n", DEFAULT_INLINE_THRESHOLD);
+	fprintf(stderr, "  --struct-reference-threshold <n>\n");
+	fprintf(stderr, "                           pass struct arguments with n or more members by address when every call passes them from memory, 0 disables it (default: %d)\n", DEFAULT_STRUCT_REFERENCE_THRESHOLD);
+	fprintf(stderr, "  --enable-pass <pass>     run an optimization pass even if the optimization level doesn't include it\n");
+	fprintf(stderr, "  --disable-pass <pass>    don't run an optimization pass\n");
+	fprintf(stderr, "  --pass-report            print how many changes each optimization pass made\n");
+	fprintf(stderr, "  --memory-map             print where each static buffer is in memory\n");
+	fprintf(stderr, "  --footprint              print how many variables each instance of the effect has, and where they come from\n");
+	fprintf(stderr, "  --checked                check that array indexes are in bounds and log the ones that aren't\n");
+	fprintf(stderr, "  --profile                count how often each function and section runs and show it in @gfx\n");
+	fprintf(stderr, "  --minify                 use the shortest names and leave out whitespace, comments and brackets that aren't needed\n");
+	fprintf(stderr, "  --hash                   write a hash of the output to <output_file>.hash\n");
+	fprintf(stderr, "  --cost-report <format>   estimate the cost of each section and function, text prints it and json writes it to <output_file>.cost.json\n");
+	fprintf(stderr, "Optimization passes:\n ");
+	for (int i = 0; i < OptimizationPass_Count; ++i)
+		fprintf(stderr, " %s", GetOptimizationPassString((OptimizationPass)i));
+	fprintf(stderr, "\n");
+}
+
+static bool ParsePassArgument(const char* string, OptimizationPass* out)
+{
+	for (int i = 0; i < OptimizationPass_Count; ++i)
+	{
+		if (strcmp(string, GetOptimizationPassString((OptimizationPass)i)) == 0)
+		{
+			*out = (OptimizationPass)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool ParseIntArgument(const char* string, int* out)
+{
+	char* end = NULL;
+	long value = strtol(string, &end, 10);
+	if (end == string || *end != '\0' || value < 0 || value > 1000000)
+		return false;
+
+	*out = (int)value;
+	return true;
+}
+
 int main(int argc, char** argv)
 {
-	if (argc < 2 || argc > 3)
+	const char* inputPath = NULL;
+	const char* outputPath = NULL;
+	CompileOptions options = DEFAULT_COMPILE_OPTIONS;
+
+	for (int i = 1; i < argc; ++i)
 	{
-		fprintf(stderr, "Usage: %s <input_file> [output_file]\n", AllocFileName(argv[0]));
-		return EXIT_FAILURE;
+		const char* arg = argv[i];
+		if (strcmp(arg, "--inline-threshold") == 0)
+		{
+			if (i + 1 >= argc || !ParseIntArgument(argv[i + 1], &options.inlineThreshold))
+			{
+				fprintf(stderr, "Expected a non-negative number after \"%s\"\n", arg);
+				return EXIT_FAILURE;
+			}
+			++i;
+		}
+		else if (strcmp(arg, "--struct-reference-threshold") == 0)
+		{
+			if (i + 1 >= argc || !ParseIntArgument(argv[i + 1], &options.structReferenceThreshold))
+			{
+				fprintf(stderr, "Expected a non-negative number after \"%s\"\n", arg);
+				return EXIT_FAILURE;
+			}
+			++i;
+		}
+		else if (strcmp(arg, "--enable-pass") == 0 || strcmp(arg, "--disable-pass") == 0)
+		{
+			OptimizationPass pass;
+			if (i + 1 >= argc || !ParsePassArgument(argv[i + 1], &pass))
+			{
+				fprintf(stderr, "Expected the name of an optimization pass after \"%s\"\n", arg);
+				PrintUsage(argv[0]);
+				return EXIT_FAILURE;
+			}
+			options.passes[pass] = strcmp(arg, "--enable-pass") == 0 ? PassSetting_Enabled : PassSetting_Disabled;
+			++i;
+		}
+		else if (strcmp(arg, "--pass-report") == 0)
+			options.passReport = true;
+		else if (strcmp(arg, "--memory-map") == 0)
+			options.memoryMap = true;
+		else if (strcmp(arg, "--footprint") == 0)
+			options.footprint = true;
+		else if (strcmp(arg, "--checked") == 0)
+			options.checked = true;
+		else if (strcmp(arg, "--profile") == 0)
+			options.profile = true;
+		else if (strcmp(arg, "--minify") == 0)
+			options.minify = true;
+		else if (strcmp(arg, "--hash") == 0)
+			options.hash = true;
+		else if (strcmp(arg, "--cost-report") == 0)
+		{
+			const char* format = i + 1 < argc ? argv[i + 1] : "";
+			if (strcmp(format, "text") == 0)
+				options.costReport = CostReport_Text;
+			else if (strcmp(format, "json") == 0)
+				options.costReport = CostReport_Json;
+			else
+			{
+				fprintf(stderr, "Expected text or json after \"%s\"\n", arg);
+				return EXIT_FAILURE;
+			}
+			++i;
+		}
+		else if (strcmp(arg, "-O0") == 0)
+			options.optimizationLevel = OptimizationLevel_None;
+		else if (strcmp(arg, "-O1") == 0)
+			options.optimizationLevel = OptimizationLevel_Basic;
+		else if (strcmp(arg, "-O2") == 0)
+			options.optimizationLevel = OptimizationLevel_Full;
+		else if (strcmp(arg, "-Os") == 0)
+			options.optimizationLevel = OptimizationLevel_Size;
+		else if (strncmp(arg, "--", 2) == 0 || strncmp(arg, "-O", 2) == 0)
+		{
+			fprintf(stderr, "Unknown option \"%s\"\n", arg);
+			PrintUsage(argv[0]);
+			return EXIT_FAILURE;
+		}
+		else if (!inputPath)
+			inputPath = arg;
+		else if (!outputPath)
+			outputPath = arg;
+		else
+		{
+			PrintUsage(argv[0]);
+			return EXIT_FAILURE;
+		}
 	}
 
-	const char* inputPath = argv[1];
+	if (!inputPath)
+	{
+		PrintUsage(argv[0]);
+		return EXIT_FAILURE;
+	}
 
-	const char* outputPath = "out.jsfx";
-	if (argc == 3) outputPath = argv[2];
+	if (!outputPath) outputPath = "out.jsfx";
 
-	Result result = Compile(inputPath, outputPath);
+	Result result = Compile(inputPath, outputPath, &options);
 	if (result.type == Result_Success)
 	{
 		printf("Successfully compiled to output file: %s\n", outputPath);
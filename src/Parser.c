@@ -1311,6 +1311,36 @@ static Result ParseExternalIdentifier(char** externalIdentifier)
 	return SUCCESS_RESULT;
 }
 
+static Result ParseInitializerList(NodePtr* out);
+
+static Result ParseInitializerListValue(NodePtr* out, void* data)
+{
+	(void)data;
+
+	PROPAGATE_ERROR(ParseInitializerList(out));
+	if (!out->ptr)
+		PROPAGATE_ERROR(ParseExpression(out));
+	return SUCCESS_RESULT;
+}
+
+static Result ParseInitializerList(NodePtr* out)
+{
+	const Token* openingBrace = MatchOne(Token_LeftCurlyBracket);
+	if (!openingBrace)
+		return NOT_FOUND_RESULT;
+
+	Array values;
+	PROPAGATE_ERROR(ParseCommaSeparatedList(&values, ParseInitializerListValue, NULL, Token_RightCurlyBracket, NULL));
+
+	*out = AllocASTNode(
+		&(InitializerListNode){
+			.lineNumber = openingBrace->lineNumber,
+			.values = values,
+		},
+		sizeof(InitializerListNode), Node_InitializerList);
+	return SUCCESS_RESULT;
+}
+
 static Result ParseVariableDeclaration(
 	NodePtr* out,
 	ModifierState modifiers,
@@ -1322,16 +1352,24 @@ static Result ParseVariableDeclaration(
 	char* externalIdentifier = NULL;
 	PROPAGATE_ERROR(ParseExternalIdentifier(&externalIdentifier));
 
+	NodePtr propertyList = NULL_NODE;
+	PROPAGATE_ERROR(ParsePropertyList(&propertyList));
+
 	NodePtr initializer = NULL_NODE;
+	NodePtr initializerList = NULL_NODE;
 	const Token* equals = MatchOne(Token_Equals);
 	if (equals != NULL)
 	{
 		if (!allowInitializer)
 			return ERROR_RESULT_LINE("Variable initializers are not allowed here");
 
-		PROPAGATE_ERROR(ParseExpression(&initializer));
-		if (initializer.ptr == NULL)
-			return ERROR_RESULT_LINE("Expected expression");
+		PROPAGATE_ERROR(ParseInitializerList(&initializerList));
+		if (initializerList.ptr == NULL)
+		{
+			PROPAGATE_ERROR(ParseExpression(&initializer));
+			if (initializer.ptr == NULL)
+				return ERROR_RESULT_LINE("Expected expression");
+		}
 	}
 
 	if (expectSemicolon)
@@ -1349,6 +1387,9 @@ static Result ParseVariableDeclaration(
 			.name = AllocateStringLength(identifier->text, identifier->textSize),
 			.externalName = externalIdentifier,
 			.initializer = initializer,
+			.propertyList = propertyList,
+			.initializerList = initializerList,
+			.staticAlign = PropertyBoolean_NotSet,
 			.instantiatedVariables = AllocateArray(sizeof(VarDeclStmt*)),
 			.modifiers = modifiers,
 			.uniqueName = -1,
@@ -1385,6 +1426,9 @@ static Result ParseFunctionDeclaration(NodePtr* out, ModifierState modifiers, co
 	char* externalIdentifier = NULL;
 	PROPAGATE_ERROR(ParseExternalIdentifier(&externalIdentifier));
 
+	NodePtr propertyList = NULL_NODE;
+	PROPAGATE_ERROR(ParsePropertyList(&propertyList));
+
 	if (!block.ptr)
 		if (!MatchOne(Token_Semicolon))
 			return ERROR_RESULT_LINE("Expected \";\"");
@@ -1399,6 +1443,9 @@ static Result ParseFunctionDeclaration(NodePtr* out, ModifierState modifiers, co
 			.parameters = params,
 			.oldParameters = AllocateArray(sizeof(NodePtr)),
 			.block = block,
+			.propertyList = propertyList,
+			.pure = PropertyBoolean_NotSet,
+			.constEval = PropertyBoolean_NotSet,
 			.globalReturn = NULL,
 			.modifiers = modifiers,
 			.variadic = variadic,
@@ -1417,6 +1464,9 @@ static Result ParseStructDeclaration(NodePtr* out, ModifierState modifiers)
 	if (identifier == NULL)
 		return ERROR_RESULT_LINE("Expected struct name");
 
+	NodePtr propertyList = NULL_NODE;
+	PROPAGATE_ERROR(ParsePropertyList(&propertyList));
+
 	if (MatchOne(Token_LeftCurlyBracket) == NULL)
 		return ERROR_RESULT_LINE("Expected \"{\" after struct name");
 
@@ -1443,6 +1493,9 @@ static Result ParseStructDeclaration(NodePtr* out, ModifierState modifiers)
 			.lineNumber = identifier->lineNumber,
 			.name = AllocateStringLength(identifier->text, identifier->textSize),
 			.members = members,
+			.propertyList = propertyList,
+			.layout = StructLayout_NotSet,
+			.capacity = 0,
 			.modifiers = modifiers,
 			.isArrayType = false,
 		},
@@ -1623,6 +1676,22 @@ static Result StringToPropertyType(const char* string, size_t stringSize, Proper
 		*out = PropertyType_IdleMode;
 	else if (strncmp(string, "hz", stringSize) == 0)
 		*out = PropertyType_HZ;
+	else if (strncmp(string, "unroll", stringSize) == 0)
+		*out = PropertyType_Unroll;
+	else if (strncmp(string, "pure", stringSize) == 0)
+		*out = PropertyType_Pure;
+	else if (strncmp(string, "const_eval", stringSize) == 0)
+		*out = PropertyType_ConstEval;
+	else if (strncmp(string, "layout", stringSize) == 0)
+		*out = PropertyType_Layout;
+	else if (strncmp(string, "capacity", stringSize) == 0)
+		*out = PropertyType_Capacity;
+	else if (strncmp(string, "length", stringSize) == 0)
+		*out = PropertyType_Length;
+	else if (strncmp(string, "align", stringSize) == 0)
+		*out = PropertyType_Align;
+	else if (strncmp(string, "block", stringSize) == 0)
+		*out = PropertyType_Block;
 	else
 		return ERROR_RESULT_LINE("Invalid property type");
 
@@ -1748,6 +1817,7 @@ static Result ParseWhileStatement(NodePtr* out)
 			.lineNumber = whileToken->lineNumber,
 			.expr = expr,
 			.stmt = stmt,
+			.unroll = PropertyBoolean_NotSet,
 		},
 		sizeof(WhileStmt), Node_While);
 	return SUCCESS_RESULT;
@@ -1759,6 +1829,9 @@ static Result ParseForStatement(NodePtr* out)
 	if (forToken == NULL)
 		return NOT_FOUND_RESULT;
 
+	NodePtr propertyList = NULL_NODE;
+	PROPAGATE_ERROR(ParsePropertyList(&propertyList));
+
 	if (MatchOne(Token_LeftBracket) == NULL)
 		return ERROR_RESULT_LINE("Expected \"(\"");
 
@@ -1804,6 +1877,8 @@ static Result ParseForStatement(NodePtr* out)
 			.condition = condition,
 			.increment = increment,
 			.stmt = stmt,
+			.propertyList = propertyList,
+			.unroll = PropertyBoolean_NotSet,
 		},
 		sizeof(ForStmt), Node_For);
 	return SUCCESS_RESULT;
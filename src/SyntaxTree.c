@@ -135,6 +135,7 @@ NodePtr CopyASTNode(const NodePtr node)
 {
 	switch (node.type)
 	{
+	case Node_Null: return NULL_NODE;
 	case Node_Binary:
 	{
 		BinaryExpr* ptr = node.ptr;
@@ -297,6 +298,8 @@ NodePtr CopyASTNode(const NodePtr node)
 		ptr = copy.ptr;
 
 		if (ptr->initializer.ptr) ptr->initializer = CopyASTNode(ptr->initializer);
+		ptr->propertyList = CopyASTNode(ptr->propertyList);
+		ptr->initializerList = CopyASTNode(ptr->initializerList);
 		ptr->type.expr = CopyASTNode(ptr->type.expr);
 
 		ptr->name = AllocateString(ptr->name);
@@ -344,6 +347,7 @@ NodePtr CopyASTNode(const NodePtr node)
 		ptr->oldParameters = oldParameters;
 
 		ptr->block = CopyASTNode(ptr->block);
+		ptr->propertyList = CopyASTNode(ptr->propertyList);
 
 		return copy;
 	}
@@ -364,6 +368,7 @@ NodePtr CopyASTNode(const NodePtr node)
 			ArrayAdd(&members, &copy);
 		}
 		ptr->members = members;
+		ptr->propertyList = CopyASTNode(ptr->propertyList);
 
 		return copy;
 	}
@@ -431,6 +436,7 @@ NodePtr CopyASTNode(const NodePtr node)
 		ptr->condition = CopyASTNode(ptr->condition);
 		ptr->increment = CopyASTNode(ptr->increment);
 		ptr->stmt = CopyASTNode(ptr->stmt);
+		ptr->propertyList = CopyASTNode(ptr->propertyList);
 
 		return copy;
 	}
@@ -494,6 +500,24 @@ NodePtr CopyASTNode(const NodePtr node)
 
 		return copy;
 	}
+	case Node_InitializerList:
+	{
+		InitializerListNode* ptr = node.ptr;
+		const NodePtr copy = AllocASTNode(ptr, sizeof(*ptr), node.type);
+		ASSERT(copy.type == node.type);
+		ptr = copy.ptr;
+
+		Array values = AllocateArray(sizeof(NodePtr));
+		for (size_t i = 0; i < ptr->values.length; ++i)
+		{
+			NodePtr* node = ptr->values.array[i];
+			NodePtr copy = CopyASTNode(*node);
+			ArrayAdd(&values, &copy);
+		}
+		ptr->values = values;
+
+		return copy;
+	}
 	case Node_Property:
 	{
 		PropertyNode* ptr = node.ptr;
@@ -604,6 +628,8 @@ void FreeASTNode(const NodePtr node)
 		free(ptr->externalName);
 		FreeASTNode(ptr->type.expr);
 		FreeASTNode(ptr->initializer);
+		FreeASTNode(ptr->propertyList);
+		FreeASTNode(ptr->initializerList);
 		FreeArray(&ptr->instantiatedVariables);
 		break;
 	}
@@ -616,6 +642,7 @@ void FreeASTNode(const NodePtr node)
 		for (size_t i = 0; i < ptr->parameters.length; ++i)
 			FreeASTNode(*(NodePtr*)ptr->parameters.array[i]);
 		FreeArray(&ptr->parameters);
+		FreeASTNode(ptr->propertyList);
 		break;
 	}
 	case Node_StructDeclaration:
@@ -625,6 +652,7 @@ void FreeASTNode(const NodePtr node)
 		for (size_t i = 0; i < ptr->members.length; ++i)
 			FreeASTNode(*(NodePtr*)ptr->members.array[i]);
 		FreeArray(&ptr->members);
+		FreeASTNode(ptr->propertyList);
 		break;
 	}
 	case Node_Modifier:
@@ -661,6 +689,7 @@ void FreeASTNode(const NodePtr node)
 		FreeASTNode(ptr->initialization);
 		FreeASTNode(ptr->increment);
 		FreeASTNode(ptr->stmt);
+		FreeASTNode(ptr->propertyList);
 		break;
 	}
 	case Node_LoopControl:
@@ -715,6 +744,14 @@ void FreeASTNode(const NodePtr node)
 		FreeArray(&ptr->list);
 		break;
 	}
+	case Node_InitializerList:
+	{
+		InitializerListNode* ptr = node.ptr;
+		for (size_t i = 0; i < ptr->values.length; ++i)
+			FreeASTNode(*(NodePtr*)ptr->values.array[i]);
+		FreeArray(&ptr->values);
+		break;
+	}
 	case Node_Property:
 	{
 		PropertyNode* ptr = node.ptr;
@@ -43,6 +43,7 @@ typedef enum
 	Node_Desc,
 	Node_Property,
 	Node_PropertyList,
+	Node_InitializerList,
 
 	Node_Module,
 } NodeType;
@@ -179,8 +180,17 @@ typedef struct
 {
 	Type type;
 	NodePtr block;
+	// the body of a function that was inlined, the block has the line of the call
+	bool inlined;
 } BlockExpr;
 
+typedef enum
+{
+	PropertyBoolean_NotSet = -1,
+	PropertyBoolean_True = true,
+	PropertyBoolean_False = false,
+} PropertyBoolean;
+
 typedef enum
 {
 	Section_Init,
@@ -199,6 +209,8 @@ typedef struct
 	NodePtr propertyList;
 	char* width;
 	char* height;
+	// @sample [block: true], the code that is the same for every sample of a block runs in @block
+	PropertyBoolean blockMode;
 } SectionStmt;
 
 typedef struct
@@ -236,13 +248,6 @@ typedef enum
 	SliderShape_Polynomial,
 } SliderShape;
 
-typedef enum
-{
-	PropertyBoolean_NotSet = -1,
-	PropertyBoolean_True = true,
-	PropertyBoolean_False = false,
-} PropertyBoolean;
-
 typedef enum
 {
 	IdleMode_NotSet,
@@ -250,6 +255,13 @@ typedef enum
 	IdleMode_Always,
 } GFXIdleMode;
 
+typedef enum
+{
+	StructLayout_NotSet,
+	StructLayout_ArrayOfStructs,
+	StructLayout_StructOfArrays,
+} StructLayout;
+
 typedef struct
 {
 	int lineNumber;
@@ -298,6 +310,11 @@ struct VarDeclStmt
 	char* externalName;
 	InputStmt* inputStmt;
 	NodePtr initializer;
+	NodePtr propertyList;
+	NodePtr initializerList;
+	uint64_t staticLength;
+	PropertyBoolean staticAlign;
+	uint64_t staticAddress;
 	Array instantiatedVariables;
 	ModifierState modifiers;
 	SectionStmt* section;
@@ -321,6 +338,9 @@ struct FuncDeclStmt
 	Array parameters;
 	Array oldParameters;
 	NodePtr block;
+	NodePtr propertyList;
+	PropertyBoolean pure;
+	PropertyBoolean constEval;
 	VarDeclStmt* globalReturn;
 	bool variadic;
 	ModifierState modifiers;
@@ -337,6 +357,9 @@ typedef struct
 	int lineNumber;
 	char* name;
 	Array members;
+	NodePtr propertyList;
+	StructLayout layout;
+	uint64_t capacity;
 	ModifierState modifiers;
 	bool isArrayType;
 } StructDeclStmt;
@@ -360,6 +383,7 @@ typedef struct
 	NodePtr baseExpr;
 	NodePtr indexExpr;
 	Type typeBeforeCollapse;
+	StructDeclStmt* arrayType;
 } SubscriptExpr;
 
 typedef struct
@@ -381,6 +405,7 @@ typedef struct
 	int lineNumber;
 	NodePtr expr;
 	NodePtr stmt;
+	PropertyBoolean unroll;
 } WhileStmt;
 
 typedef struct
@@ -390,6 +415,8 @@ typedef struct
 	NodePtr condition;
 	NodePtr increment;
 	NodePtr stmt;
+	NodePtr propertyList;
+	PropertyBoolean unroll;
 } ForStmt;
 
 typedef enum
@@ -444,6 +471,14 @@ typedef enum
 	PropertyType_GFX,
 	PropertyType_IdleMode,
 	PropertyType_HZ,
+	PropertyType_Unroll,
+	PropertyType_Pure,
+	PropertyType_ConstEval,
+	PropertyType_Layout,
+	PropertyType_Capacity,
+	PropertyType_Length,
+	PropertyType_Align,
+	PropertyType_Block,
 } PropertyType;
 
 typedef struct
@@ -458,6 +493,12 @@ typedef struct
 	Array list;
 } PropertyListNode;
 
+typedef struct
+{
+	int lineNumber;
+	Array values;
+} InitializerListNode;
+
 typedef struct
 {
 	char* path;
@@ -17,38 +17,240 @@
 #include "passes/MarkUnusedPass.h"
 #include "passes/RemoveUnusedPass.h"
 #include "passes/FunctionInliningPass.h"
+#include "passes/FunctionSpecializationPass.h"
+#include "passes/ClosureConversionPass.h"
+#include "passes/LoopUnrollingPass.h"
+#include "passes/LoopIdiomPass.h"
 #include "passes/FunctionDepsPass.h"
 #include "passes/VariableDepsPass.h"
 #include "passes/CopyPropagationPass.h"
+#include "passes/GlobalConstantPass.h"
+#include "passes/CommonSubexpressionPass.h"
 #include "passes/ExpressionSimplificationPass.h"
+#include "passes/LivenessPass.h"
+#include "passes/StaticMemoryPass.h"
+#include "passes/StructReferencePass.h"
+#include "passes/BoundsCheckPass.h"
+#include "passes/ProfilePass.h"
+#include "passes/CostReportPass.h"
+#include "passes/FootprintPass.h"
+#include "passes/BlockModePass.h"
 
-Result GenerateCode(const AST* syntaxTree, char** outputCode, size_t* outputLength)
+// the optimization passes are repeated until they stop making changes, or until this many iterations
+#define MAX_OPTIMIZATION_ITERATIONS 8
+
+typedef struct
+{
+	int changes[MAX_OPTIMIZATION_ITERATIONS][OptimizationPass_Count];
+	bool ran[MAX_OPTIMIZATION_ITERATIONS][OptimizationPass_Count];
+	int deadCodeChanges[MAX_OPTIMIZATION_ITERATIONS];
+	// passes that only run once, before or after the others
+	int finalChanges[OptimizationPass_Count];
+	bool finalRan[OptimizationPass_Count];
+	int iterations;
+} PassReport;
+
+static int RemoveDeadCode(const AST* syntaxTree)
+{
+	VariableDepsPass(syntaxTree);
+	int changes = MarkUnusedPass(syntaxTree);
+	changes += RemoveUnusedPass(syntaxTree);
+	return changes;
+}
+
+static int RunPass(const AST* syntaxTree, const CompileOptions* options, OptimizationPass pass, int iteration)
+{
+	switch (pass)
+	{
+	// these run once, before the structs are expanded and before the others
+	case OptimizationPass_StructReference:
+	case OptimizationPass_BlockMode:
+		return -1;
+	case OptimizationPass_ClosureConversion: return ClosureConversionPass(syntaxTree);
+	// functions only get specialized in the first iteration, otherwise the copies would get specialized again
+	case OptimizationPass_Specialization: return iteration == 0 ? FunctionSpecializationPass(syntaxTree) : -1;
+	case OptimizationPass_Inlining: return FunctionInliningPass(syntaxTree, options->inlineThreshold, options->optimizationLevel == OptimizationLevel_Size);
+	case OptimizationPass_Unrolling: return LoopUnrollingPass(syntaxTree, options->optimizationLevel == OptimizationLevel_Size);
+	case OptimizationPass_LoopIdioms: return LoopIdiomPass(syntaxTree, iteration == 0, options->optimizationLevel == OptimizationLevel_Size);
+	case OptimizationPass_GlobalConstants: return GlobalConstantPass(syntaxTree);
+	case OptimizationPass_CopyPropagation: return CopyPropagationPass(syntaxTree);
+	case OptimizationPass_CommonSubexpression: return CommonSubexpressionPass(syntaxTree);
+	case OptimizationPass_Simplification: return ExpressionSimplificationPass(syntaxTree);
+	case OptimizationPass_DeadStores: return DeadStorePass(syntaxTree);
+	// variables can only share names once they all have one, so this runs after the unique names are assigned
+	case OptimizationPass_Coalescing: return -1;
+	default: INVALID_VALUE(pass);
+	}
+}
+
+static void Optimize(const AST* syntaxTree, const CompileOptions* options, PassReport* report)
+{
+	FunctionDepsPass(syntaxTree);
+
+	// the inlining pass also puts block expressions that are only used once back where they were.
+	// that still has to happen when inlining is turned off
+	if (!IsOptimizationPassEnabled(options, OptimizationPass_Inlining))
+		FunctionInliningPass(syntaxTree, 0, false);
+
+	while (report->iterations < MAX_OPTIMIZATION_ITERATIONS)
+	{
+		int iteration = report->iterations++;
+		int totalChanges = 0;
+		for (int i = 0; i < OptimizationPass_Count; ++i)
+		{
+			if (!IsOptimizationPassEnabled(options, (OptimizationPass)i))
+				continue;
+
+			int changes = RunPass(syntaxTree, options, (OptimizationPass)i, iteration);
+			if (changes < 0)
+				continue;
+
+			report->ran[iteration][i] = true;
+			report->changes[iteration][i] = changes;
+			totalChanges += changes;
+		}
+
+		// unused code is always removed, because the unused functions from the
+		// builtin modules can have the same names as the functions in jsfx
+		report->deadCodeChanges[iteration] = RemoveDeadCode(syntaxTree);
+		totalChanges += report->deadCodeChanges[iteration];
+
+		if (totalChanges == 0)
+			break;
+	}
+}
+
+static void PrintPassReport(const PassReport* report)
+{
+	printf("Optimization passes ran for %d iteration%s\n", report->iterations, report->iterations == 1 ? "" : "s");
+	printf("  %-18s", "pass");
+	for (int i = 0; i < report->iterations; ++i)
+		printf("%7d", i + 1);
+	printf("%9s\n", "total");
+
+	for (int pass = 0; pass < OptimizationPass_Count; ++pass)
+	{
+		int total = 0;
+		bool ran = false;
+		printf("  %-18s", GetOptimizationPassString((OptimizationPass)pass));
+		for (int i = 0; i < report->iterations; ++i)
+		{
+			if (report->ran[i][pass])
+			{
+				printf("%7d", report->changes[i][pass]);
+				total += report->changes[i][pass];
+				ran = true;
+			}
+			else
+				printf("%7s", "-");
+		}
+
+		if (report->finalRan[pass])
+		{
+			total += report->finalChanges[pass];
+			ran = true;
+		}
+
+		if (ran)
+			printf("%9d\n", total);
+		else
+			printf("%9s\n", "off");
+	}
+
+	int total = 0;
+	printf("  %-18s", "dead-code");
+	for (int i = 0; i < report->iterations; ++i)
+	{
+		printf("%7d", report->deadCodeChanges[i]);
+		total += report->deadCodeChanges[i];
+	}
+	printf("%9d\n", total);
+}
+
+// the jsfx names of every external function and variable, before the unused ones are removed
+static void CollectExternalNames(const AST* syntaxTree, Map* names)
+{
+	for (size_t i = 0; i < syntaxTree->nodes.length; ++i)
+	{
+		const ModuleNode* module = ((NodePtr*)syntaxTree->nodes.array[i])->ptr;
+		for (size_t j = 0; j < module->statements.length; ++j)
+		{
+			const NodePtr* statement = module->statements.array[j];
+			if (statement->type == Node_VariableDeclaration)
+			{
+				const VarDeclStmt* varDecl = statement->ptr;
+				if (varDecl->modifiers.externalValue)
+					MapAdd(names, varDecl->externalName ? varDecl->externalName : varDecl->name, NULL);
+			}
+			else if (statement->type == Node_FunctionDeclaration)
+			{
+				const FuncDeclStmt* funcDecl = statement->ptr;
+				if (funcDecl->modifiers.externalValue)
+					MapAdd(names, funcDecl->externalName ? funcDecl->externalName : funcDecl->name, NULL);
+			}
+		}
+	}
+}
+
+Result GenerateCode(const AST* syntaxTree, const CompileOptions* options, char** outputCode, size_t* outputLength, char** outputProfileMap, char** outputCostReport)
 {
 	printf("Generating code...\n");
 	PROPAGATE_ERROR(ResolverPass(syntaxTree));
+	Map externalNames = AllocateMap(0);
+	CollectExternalNames(syntaxTree, &externalNames);
+	if (options->profile)
+		ProfilePass(syntaxTree);
+	PROPAGATE_ERROR(StaticMemoryPass(syntaxTree, options->memoryMap));
+	if (options->profile)
+		*outputProfileMap = AllocProfileMap();
+	if (options->checked)
+		BoundsCheckPass(syntaxTree);
 	PROPAGATE_ERROR(ChainedAssignmentPass(syntaxTree));
 	FunctionCallAccessPass(syntaxTree);
 	BlockExpressionPass(syntaxTree);
 	ForLoopPass(syntaxTree);
 	ReturnTaggingPass(syntaxTree);
+	PassReport report = {0};
+	// -O0 keeps the plain calling convention, the fuzzer compares the other levels against it
+	if (IsOptimizationPassEnabled(options, OptimizationPass_StructReference))
+	{
+		report.finalRan[OptimizationPass_StructReference] = true;
+		report.finalChanges[OptimizationPass_StructReference] = StructReferencePass(syntaxTree, options->structReferenceThreshold);
+	}
+	if (options->footprint)
+		CollectFootprint(syntaxTree);
 	PROPAGATE_ERROR(MemberExpansionPass(syntaxTree));
 	PROPAGATE_ERROR(ControlFlowPass(syntaxTree));
 	PROPAGATE_ERROR(TypeConversionPass(syntaxTree));
 	GlobalSectionPass(syntaxTree);
+	if (IsOptimizationPassEnabled(options, OptimizationPass_BlockMode))
+	{
+		report.finalRan[OptimizationPass_BlockMode] = true;
+		report.finalChanges[OptimizationPass_BlockMode] = BlockModePass(syntaxTree);
+	}
 
 	printf("Optimizing... [    ]\n");
-	FunctionDepsPass(syntaxTree);
-	FunctionInliningPass(syntaxTree);
-	CopyPropagationPass(syntaxTree);
-	printf("Optimizing... [##  ]\n");
-	ExpressionSimplificationPass(syntaxTree);
-	VariableDepsPass(syntaxTree);
-	MarkUnusedPass(syntaxTree);
-	RemoveUnusedPass(syntaxTree);
+	Optimize(syntaxTree, options, &report);
 	printf("Optimizing... [####]\n");
 
 	UniqueNamePass(syntaxTree);
+	if (IsOptimizationPassEnabled(options, OptimizationPass_Coalescing))
+	{
+		report.finalRan[OptimizationPass_Coalescing] = true;
+		report.finalChanges[OptimizationPass_Coalescing] = VariableCoalescingPass(syntaxTree);
+	}
+
+	if (options->passReport)
+		PrintPassReport(&report);
+	if (options->footprint)
+		PrintFootprint(syntaxTree);
+	// the report runs before the blocks are removed, it needs to know which blocks are inlined functions
+	if (options->costReport == CostReport_Text)
+		PrintCostReport(syntaxTree);
+	else if (options->costReport == CostReport_Json)
+		*outputCostReport = AllocCostReportJson(syntaxTree);
 	BlockRemoverPass(syntaxTree);
-	WriteOutput(syntaxTree, outputCode, outputLength);
+	WriteOutput(syntaxTree, options->minify, &externalNames, outputCode, outputLength);
+	FreeMap(&externalNames);
 	return SUCCESS_RESULT;
 }
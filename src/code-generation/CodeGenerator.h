@@ -1,6 +1,7 @@
 #pragma once
 
+#include "CompileOptions.h"
 #include "Result.h"
 #include "SyntaxTree.h"
 
-Result GenerateCode(const AST* syntaxTree, char** outputCode, size_t* outputLength);
+Result GenerateCode(const AST* syntaxTree, const CompileOptions* options, char** outputCode, size_t* outputLength, char** outputProfileMap, char** outputCostReport);
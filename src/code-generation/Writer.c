@@ -1,10 +1,12 @@
 #include "Writer.h"
 
+#include <ctype.h>
 #include <inttypes.h>
 #include <stdio.h>
 #include <string.h>
 
 #include "StringUtils.h"
+#include "data-structures/Map.h"
 #include "data-structures/MemoryStream.h"
 
 #define INDENT_WIDTH 4
@@ -32,31 +34,45 @@ static MemoryStream* descriptionLines;
 
 static int indentationLevel;
 
+// with --minify every name gets the shortest one that is still free, and there is no whitespace or comments
+static bool minify;
+static Map shortNames;
+static Map reservedNames;
+static size_t shortNameCount;
+
+// jsfx names are case insensitive. the names of the external functions and variables are reserved
+// along with these keywords of eel2, which aren't declared anywhere
+static const char* const reservedKeywords[] = {
+	"loop", "while", "function", "local", "static", "instance", "global", "globals", "this", "_global",
+};
+
+// the levels of eel2's grammar, from loosest to tightest. unlike c, "-" binds tighter than "+",
+// "/" binds tighter than "*", and the bitwise operators share one level
 static const int binaryPrecedence[] = {
-	[Binary_Exponentiation] = 18,
-	[Binary_Modulo] = 17,
-	[Binary_LeftShift] = 16,
-	[Binary_RightShift] = 16,
-	[Binary_Multiply] = 15,
-	[Binary_Divide] = 15,
-	[Binary_Add] = 14,
-	[Binary_Subtract] = 14,
-
-	[Binary_BitOr] = 13,
-	[Binary_BitAnd] = 12,
-	[Binary_XOR] = 11,
-
-	[Binary_IsEqual] = 10,
-	[Binary_NotEqual] = 10,
-	[Binary_LessThan] = 10,
-	[Binary_GreaterThan] = 10,
-	[Binary_LessOrEqual] = 10,
-	[Binary_GreaterOrEqual] = 10,
-
-	[Binary_BoolOr] = 9,
-	[Binary_BoolAnd] = 8,
-
-	[Binary_Assignment] = 7,
+	[Binary_Exponentiation] = 10,
+	[Binary_Modulo] = 9,
+	[Binary_LeftShift] = 9,
+	[Binary_RightShift] = 9,
+	[Binary_Divide] = 8,
+	[Binary_Multiply] = 7,
+	[Binary_Subtract] = 6,
+	[Binary_Add] = 5,
+
+	[Binary_BitOr] = 4,
+	[Binary_BitAnd] = 4,
+	[Binary_XOR] = 4,
+
+	[Binary_IsEqual] = 3,
+	[Binary_NotEqual] = 3,
+	[Binary_LessThan] = 3,
+	[Binary_GreaterThan] = 3,
+	[Binary_LessOrEqual] = 3,
+	[Binary_GreaterOrEqual] = 3,
+
+	[Binary_BoolOr] = 2,
+	[Binary_BoolAnd] = 2,
+
+	[Binary_Assignment] = 1,
 };
 
 static void VisitBlock(const BlockStmt* block, const bool semicolon);
@@ -80,6 +96,86 @@ static void WriteUniqueName(int uniqueName, MemoryStream* stream)
 	StreamWrite(stream, string, (size_t)numChars);
 }
 
+static char* AllocLowercase(const char* string)
+{
+	char* lowercase = AllocateString(string);
+	for (char* c = lowercase; *c; ++c)
+		*c = (char)tolower((unsigned char)*c);
+	return lowercase;
+}
+
+static void ReserveName(const char* name)
+{
+	char* lowercase = AllocLowercase(name);
+	MapAdd(&reservedNames, lowercase, NULL);
+	free(lowercase);
+}
+
+// names are a letter and then letters or digits: a, b, ..., z, a0, a1, ..., zz, a00, ...
+static char* AllocShortName(size_t index)
+{
+	static const char letters[] = "abcdefghijklmnopqrstuvwxyz";
+	static const char characters[] = "abcdefghijklmnopqrstuvwxyz0123456789";
+	const size_t letterCount = sizeof(letters) - 1;
+	const size_t characterCount = sizeof(characters) - 1;
+
+	size_t length = 1;
+	size_t namesOfLength = letterCount;
+	while (index >= namesOfLength)
+	{
+		index -= namesOfLength;
+		namesOfLength *= characterCount;
+		++length;
+	}
+
+	char* name = malloc(length + 1);
+	name[length] = '\0';
+	for (size_t i = length - 1; i > 0; --i)
+	{
+		name[i] = characters[index % characterCount];
+		index /= characterCount;
+	}
+	name[0] = letters[index];
+	return name;
+}
+
+static const char* GetShortName(const char* name)
+{
+	char** shortName = MapGet(&shortNames, name);
+	if (shortName)
+		return *shortName;
+
+	char* new = AllocShortName(shortNameCount++);
+	while (MapGet(&reservedNames, new))
+	{
+		free(new);
+		new = AllocShortName(shortNameCount++);
+	}
+	MapAdd(&shortNames, name, &new);
+	return new;
+}
+
+static void WriteString(const char* str, MemoryStream* stream);
+
+static void WriteName(const char* name, int uniqueName, MemoryStream* stream)
+{
+	if (!minify)
+	{
+		WriteString(name, stream);
+		if (uniqueName != -1)
+		{
+			StreamWriteByte(stream, '_');
+			WriteUniqueName(uniqueName, stream);
+		}
+		return;
+	}
+
+	// the unique names are already unique across the whole program, they only get shorter
+	char* fullName = uniqueName != -1 ? AllocateString1Str1Int("%s_%" PRId64, name, uniqueName) : AllocateString(name);
+	WriteString(GetShortName(fullName), stream);
+	free(fullName);
+}
+
 static void WriteString(const char* str, MemoryStream* stream)
 {
 	const size_t length = strlen(str);
@@ -106,14 +202,38 @@ static void WriteChar(char chr, MemoryStream* stream)
 	}
 }
 
+static void WriteSpace(MemoryStream* stream)
+{
+	if (!minify)
+		WriteChar(' ', stream);
+}
+
+static void WriteNewline(MemoryStream* stream)
+{
+	if (!minify)
+		WriteChar('\n', stream);
+}
+
+static void WriteStatementEnd(void)
+{
+	WriteChar(';', sections);
+	WriteNewline(sections);
+}
+
 static void PushIndent(MemoryStream* stream)
 {
+	if (minify)
+		return;
+
 	StreamWrite(stream, INDENT_STRING, INDENT_WIDTH);
 	indentationLevel++;
 }
 
 static void PopIndent(MemoryStream* stream)
 {
+	if (minify)
+		return;
+
 	const Buffer lastChars = StreamRewindRead(stream, INDENT_WIDTH);
 	if (memcmp(INDENT_STRING, lastChars.buffer, INDENT_WIDTH) == 0)
 		StreamRewind(stream, INDENT_WIDTH);
@@ -135,7 +255,10 @@ static void VisitFunctionCall(FuncCallExpr* funcCall)
 		VisitExpression(*(NodePtr*)funcCall->arguments.array[i], &funcCallNode);
 
 		if (i < funcCall->arguments.length - 1)
-			WriteString(", ", sections);
+		{
+			WriteChar(',', sections);
+			WriteSpace(sections);
+		}
 	}
 	WriteChar(')', sections);
 }
@@ -159,6 +282,29 @@ static void VisitLiteralExpression(LiteralExpr* literal)
 	}
 }
 
+static bool IsLeftAssociative(BinaryOperator operator)
+{
+	return operator == Binary_Add || operator == Binary_Subtract ||
+		   operator == Binary_Multiply || operator == Binary_Divide ||
+		   operator == Binary_BoolAnd || operator == Binary_BoolOr;
+}
+
+static bool StartsWithSign(NodePtr node)
+{
+	switch (node.type)
+	{
+	case Node_Unary: return true;
+	case Node_Literal:
+	{
+		const LiteralExpr* literal = node.ptr;
+		return literal->type == Literal_Number && (literal->number[0] == '-' || literal->number[0] == '+');
+	}
+	case Node_Binary: return StartsWithSign(((BinaryExpr*)node.ptr)->left);
+	case Node_Subscript: return StartsWithSign(((SubscriptExpr*)node.ptr)->baseExpr);
+	default: return false;
+	}
+}
+
 static void VisitBinaryExpression(BinaryExpr* binary, const NodePtr* parentExpr)
 {
 	char* operator;
@@ -201,6 +347,11 @@ static void VisitBinaryExpression(BinaryExpr* binary, const NodePtr* parentExpr)
 		BinaryExpr* parent = parentExpr->ptr;
 		if (binaryPrecedence[binary->operatorType] > binaryPrecedence[parent->operatorType])
 			writeBrackets = false;
+		// "a - b - c" is "(a - b) - c", so the brackets aren't needed on the left of the same operator
+		else if (minify && binary == parent->left.ptr &&
+				 binary->operatorType == parent->operatorType &&
+				 IsLeftAssociative(binary->operatorType))
+			writeBrackets = false;
 	}
 	else if (parentExpr->type == Node_Subscript)
 	{
@@ -213,9 +364,12 @@ static void VisitBinaryExpression(BinaryExpr* binary, const NodePtr* parentExpr)
 
 	if (writeBrackets) WriteChar('(', sections);
 	VisitExpression(binary->left, &binaryNode);
-	WriteChar(' ', sections);
+	WriteSpace(sections);
 	WriteString(operator, sections);
-	WriteChar(' ', sections);
+	WriteSpace(sections);
+	// so that "a - -b" doesn't become "a--b"
+	if (minify && (operator[0] == '+' || operator[0] == '-') && StartsWithSign(binary->right))
+		WriteChar(' ', sections);
 	VisitExpression(binary->right, &binaryNode);
 	if (writeBrackets) WriteChar(')', sections);
 }
@@ -280,12 +434,10 @@ static char* GetName(const MemberAccessExpr* identifier, bool external)
 
 static void VisitMemberAccessExpression(const MemberAccessExpr* identifier)
 {
-	WriteString(GetName(identifier, IsExternal(identifier)), sections);
-	if (!IsExternal(identifier) && GetUniqueName(identifier) != -1)
-	{
-		WriteChar('_', sections);
-		WriteUniqueName(GetUniqueName(identifier), sections);
-	}
+	if (IsExternal(identifier))
+		WriteString(GetName(identifier, true), sections);
+	else
+		WriteName(GetName(identifier, false), GetUniqueName(identifier), sections);
 }
 
 static void VisitBlockExpression(const BlockExpr* blockExpr)
@@ -333,12 +485,13 @@ static void VisitVariableDeclaration(VarDeclStmt* varDecl)
 				Node_MemberAccess},
 		},
 		NULL);
-	WriteString(";\n", sections);
+	WriteStatementEnd();
 }
 
 static void VisitBlock(const BlockStmt* block, const bool semicolon)
 {
-	WriteString("(\n", sections);
+	WriteChar('(', sections);
+	WriteNewline(sections);
 	PushIndent(sections);
 	bool hasStatements = false;
 	for (size_t i = 0; i < block->statements.length; ++i)
@@ -349,10 +502,13 @@ static void VisitBlock(const BlockStmt* block, const bool semicolon)
 			hasStatements = true;
 	}
 	if (!hasStatements)
-		WriteString("0;\n", sections);
+	{
+		WriteChar('0', sections);
+		WriteStatementEnd();
+	}
 	PopIndent(sections);
 	WriteChar(')', sections);
-	if (semicolon) WriteString(";\n", sections);
+	if (semicolon) WriteStatementEnd();
 }
 
 static void VisitFunctionDeclaration(const FuncDeclStmt* funcDecl)
@@ -361,12 +517,7 @@ static void VisitFunctionDeclaration(const FuncDeclStmt* funcDecl)
 		return;
 
 	WriteString("function ", sections);
-	WriteString(funcDecl->name, sections);
-	if (funcDecl->uniqueName != -1)
-	{
-		WriteChar('_', sections);
-		WriteUniqueName(funcDecl->uniqueName, sections);
-	}
+	WriteName(funcDecl->name, funcDecl->uniqueName, sections);
 
 	WriteChar('(', sections);
 	for (size_t i = 0; i < funcDecl->parameters.length; ++i)
@@ -375,17 +526,16 @@ static void VisitFunctionDeclaration(const FuncDeclStmt* funcDecl)
 
 		ASSERT(node->type == Node_VariableDeclaration);
 		const VarDeclStmt* varDecl = node->ptr;
-		WriteString(varDecl->name, sections);
-		if (varDecl->uniqueName != -1)
-		{
-			WriteChar('_', sections);
-			WriteUniqueName(varDecl->uniqueName, sections);
-		}
+		WriteName(varDecl->name, varDecl->uniqueName, sections);
 
 		if (i < funcDecl->parameters.length - 1)
-			WriteString(", ", sections);
+		{
+			WriteChar(',', sections);
+			WriteSpace(sections);
+		}
 	}
-	WriteString(")\n", sections);
+	WriteChar(')', sections);
+	WriteNewline(sections);
 
 	ASSERT(funcDecl->block.type == Node_BlockStatement);
 	VisitBlock(funcDecl->block.ptr, true);
@@ -394,17 +544,21 @@ static void VisitFunctionDeclaration(const FuncDeclStmt* funcDecl)
 static void VisitIfStatement(const IfStmt* ifStmt, bool semicolon)
 {
 	VisitExpression(ifStmt->expr, NULL);
-	WriteString(" ? ", sections);
+	WriteSpace(sections);
+	WriteChar('?', sections);
+	WriteSpace(sections);
 
 	if (!ifStmt->falseStmt.ptr)
-		WriteChar('\n', sections);
+		WriteNewline(sections);
 
 	ASSERT(ifStmt->trueStmt.type == Node_BlockStatement);
 	VisitBlock(ifStmt->trueStmt.ptr, false);
 
 	if (ifStmt->falseStmt.ptr)
 	{
-		WriteString(" : ", sections);
+		WriteSpace(sections);
+		WriteChar(':', sections);
+		WriteSpace(sections);
 
 		ASSERT(ifStmt->falseStmt.type == Node_BlockStatement);
 		BlockStmt* block = ifStmt->falseStmt.ptr;
@@ -419,14 +573,17 @@ static void VisitIfStatement(const IfStmt* ifStmt, bool semicolon)
 	}
 
 	if (semicolon)
-		WriteString(";\n", sections);
+		WriteStatementEnd();
 }
 
 static void VisitWhileStatement(const WhileStmt* whileStmt)
 {
-	WriteString("while (", sections);
+	WriteString("while", sections);
+	WriteSpace(sections);
+	WriteChar('(', sections);
 	VisitExpression(whileStmt->expr, NULL);
-	WriteString(")\n", sections);
+	WriteChar(')', sections);
+	WriteNewline(sections);
 
 	ASSERT(whileStmt->stmt.type == Node_BlockStatement);
 	VisitBlock(whileStmt->stmt.ptr, true);
@@ -450,7 +607,7 @@ static void VisitStatement(const NodePtr* node)
 	{
 		const ExpressionStmt* expressionStmt = node->ptr;
 		VisitExpression(expressionStmt->expr, NULL);
-		WriteString(";\n", sections);
+		WriteStatementEnd();
 		break;
 	}
 	case Node_BlockStatement:
@@ -532,12 +689,7 @@ static void WriteSlider(const InputStmt* slider)
 	WriteChar(':', sliders);
 
 	ASSERT(slider->varDecl.type == Node_VariableDeclaration);
-	WriteString(slider->name, sliders);
-	if (((VarDeclStmt*)slider->varDecl.ptr)->uniqueName != -1)
-	{
-		WriteChar('_', sliders);
-		WriteUniqueName(((VarDeclStmt*)slider->varDecl.ptr)->uniqueName, sliders);
-	}
+	WriteName(slider->name, ((VarDeclStmt*)slider->varDecl.ptr)->uniqueName, sliders);
 	WriteChar('=', sliders);
 	WriteString(slider->defaultValue, sliders);
 
@@ -645,7 +797,7 @@ static void WriteModule(const ModuleNode* module)
 {
 	const size_t start = StreamGetPosition(sections);
 
-	if (module->statements.length != 0)
+	if (module->statements.length != 0 && !minify)
 	{
 		WriteString("// Module: ", sections);
 		WriteString(module->moduleName, sections);
@@ -688,19 +840,139 @@ static void WriteDefaultDescriptionLines(MemoryStream* stream)
 		WriteChar('\n', stream);
 	}
 
+	if (minify)
+		return;
+
 	WriteString("tabsize:", stream);
 	WriteUInt64(INDENT_WIDTH, stream);
 	WriteChar('\n', stream);
 }
 
-void WriteOutput(const AST* ast, char** outBuffer, size_t* outLength)
+static void ReserveExternalNames(const NodePtr* node);
+
+static void ReserveExternalNamesInExpression(const NodePtr node)
+{
+	switch (node.type)
+	{
+	case Node_MemberAccess:
+	{
+		const MemberAccessExpr* identifier = node.ptr;
+		if (IsExternal(identifier))
+			ReserveName(GetName(identifier, true));
+		break;
+	}
+	case Node_Binary:
+		ReserveExternalNamesInExpression(((BinaryExpr*)node.ptr)->left);
+		ReserveExternalNamesInExpression(((BinaryExpr*)node.ptr)->right);
+		break;
+	case Node_Unary:
+		ReserveExternalNamesInExpression(((UnaryExpr*)node.ptr)->expression);
+		break;
+	case Node_Subscript:
+		ReserveExternalNamesInExpression(((SubscriptExpr*)node.ptr)->baseExpr);
+		ReserveExternalNamesInExpression(((SubscriptExpr*)node.ptr)->indexExpr);
+		break;
+	case Node_FunctionCall:
+	{
+		const FuncCallExpr* funcCall = node.ptr;
+		ReserveExternalNamesInExpression(funcCall->baseExpr);
+		for (size_t i = 0; i < funcCall->arguments.length; ++i)
+			ReserveExternalNamesInExpression(*(NodePtr*)funcCall->arguments.array[i]);
+		break;
+	}
+	case Node_BlockExpression:
+		ReserveExternalNames(&((BlockExpr*)node.ptr)->block);
+		break;
+	case Node_Literal:
+		break;
+	default: INVALID_VALUE(node.type);
+	}
+}
+
+// the names that jsfx already uses can't be given to anything else
+static void ReserveExternalNames(const NodePtr* node)
+{
+	switch (node->type)
+	{
+	case Node_Section:
+		ReserveExternalNames(&((SectionStmt*)node->ptr)->block);
+		break;
+	case Node_FunctionDeclaration:
+		ReserveExternalNames(&((FuncDeclStmt*)node->ptr)->block);
+		break;
+	case Node_VariableDeclaration:
+	{
+		const VarDeclStmt* varDecl = node->ptr;
+		if (!varDecl->modifiers.externalValue)
+			ReserveExternalNamesInExpression(varDecl->initializer);
+		break;
+	}
+	case Node_ExpressionStatement:
+		ReserveExternalNamesInExpression(((ExpressionStmt*)node->ptr)->expr);
+		break;
+	case Node_BlockStatement:
+	{
+		const BlockStmt* block = node->ptr;
+		for (size_t i = 0; i < block->statements.length; ++i)
+			ReserveExternalNames(block->statements.array[i]);
+		break;
+	}
+	case Node_If:
+	{
+		const IfStmt* ifStmt = node->ptr;
+		ReserveExternalNamesInExpression(ifStmt->expr);
+		ReserveExternalNames(&ifStmt->trueStmt);
+		ReserveExternalNames(&ifStmt->falseStmt);
+		break;
+	}
+	case Node_While:
+		ReserveExternalNamesInExpression(((WhileStmt*)node->ptr)->expr);
+		ReserveExternalNames(&((WhileStmt*)node->ptr)->stmt);
+		break;
+	case Node_Input:
+	case Node_Desc:
+	case Node_Import:
+	case Node_Null:
+		break;
+	default: INVALID_VALUE(node->type);
+	}
+}
+
+static void FreeShortNames(void)
+{
+	for (MAP_ITERATE(node, &shortNames))
+		free(*(char**)node->value);
+	FreeMap(&shortNames);
+	FreeMap(&reservedNames);
+}
+
+void WriteOutput(const AST* ast, bool minifyOutput, const Map* externalNames, char** outBuffer, size_t* outLength)
 {
 	indentationLevel = 0;
+	minify = minifyOutput;
 
 	sections = AllocateMemoryStream();
 	sliders = AllocateMemoryStream();
 	descriptionLines = AllocateMemoryStream();
 
+	if (minify)
+	{
+		shortNames = AllocateMap(sizeof(char*));
+		reservedNames = AllocateMap(0);
+		shortNameCount = 0;
+		for (size_t i = 0; i < sizeof(reservedKeywords) / sizeof(reservedKeywords[0]); ++i)
+			ReserveName(reservedKeywords[i]);
+		for (MAP_ITERATE(node, externalNames))
+			ReserveName(node->key);
+
+		for (size_t i = 0; i < ast->nodes.length; ++i)
+		{
+			const ModuleNode* module = ((NodePtr*)ast->nodes.array[i])->ptr;
+			for (size_t j = 0; j < module->statements.length; ++j)
+				ReserveExternalNames(module->statements.array[j]);
+		}
+	}
+
 	for (size_t i = 0; i < ast->nodes.length; ++i)
 	{
 		const NodePtr* node = ast->nodes.array[i];
@@ -712,12 +984,21 @@ void WriteOutput(const AST* ast, char** outBuffer, size_t* outLength)
 
 	MemoryStream* main = AllocateMemoryStream();
 	StreamWriteStream(main, descriptionLines);
-	StreamWriteByte(main, '\n');
-	StreamWriteStream(main, sliders);
-	StreamWriteByte(main, '\n');
-	WriteString(watermark, main);
-	StreamWriteByte(main, '\n');
-	StreamWriteStream(main, sections);
+	if (minify)
+	{
+		StreamWriteStream(main, sliders);
+		StreamWriteStream(main, sections);
+		FreeShortNames();
+	}
+	else
+	{
+		StreamWriteByte(main, '\n');
+		StreamWriteStream(main, sliders);
+		StreamWriteByte(main, '\n');
+		WriteString(watermark, main);
+		StreamWriteByte(main, '\n');
+		StreamWriteStream(main, sections);
+	}
 
 	FreeMemoryStream(sliders, true);
 	FreeMemoryStream(descriptionLines, true);
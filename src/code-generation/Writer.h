@@ -1,5 +1,6 @@
 #pragma once
 
 #include "SyntaxTree.h"
+#include "data-structures/Map.h"
 
-void WriteOutput(const AST* ast, char** outBuffer, size_t* outLength);
+void WriteOutput(const AST* ast, bool minify, const Map* externalNames, char** outBuffer, size_t* outLength);
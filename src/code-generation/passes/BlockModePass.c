@@ -0,0 +1,474 @@
+#include "BlockModePass.h"
+
+#include "Common.h"
+#include "data-structures/Map.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// the externals that the host only changes between blocks
+static const char* const blockVariables[] = {
+	"trigger",
+	"srate",
+	"num_ch",
+	"samplesblock",
+	"tempo",
+	"play_state",
+	"play_position",
+	"beat_position",
+	"ts_num",
+	"ts_denom",
+};
+
+typedef enum
+{
+	Function_Visiting,
+	Function_Invariant,
+	Function_Variant,
+} FunctionState;
+
+// the variables that can change while the samples of a block are processed
+static Map assigned;
+static Map reachedFunctions;
+// the top level variables of the block mode @sample sections, and which of them were moved to @block
+static Map sampleVariables;
+static Map movedVariables;
+static Map functionStates;
+static int changeCount;
+
+static bool IsInvariant(NodePtr node, const Map* locals);
+
+static bool Contains(const Map* map, const void* ptr)
+{
+	char key[64];
+	snprintf(key, sizeof(key), "%p", ptr);
+	return MapGet(map, key) != NULL;
+}
+
+static void Add(Map* map, const void* ptr)
+{
+	char key[64];
+	snprintf(key, sizeof(key), "%p", ptr);
+	MapAdd(map, key, &ptr);
+}
+
+static bool IsBlockVariable(const VarDeclStmt* varDecl)
+{
+	const char* name = varDecl->externalName ? varDecl->externalName : varDecl->name;
+	for (size_t i = 0; i < sizeof(blockVariables) / sizeof(blockVariables[0]); ++i)
+		if (strcmp(name, blockVariables[i]) == 0)
+			return true;
+	return false;
+}
+
+static FuncDeclStmt* GetFuncDecl(FuncCallExpr* funcCall)
+{
+	ASSERT(funcCall->baseExpr.type == Node_MemberAccess);
+	MemberAccessExpr* memberAccess = funcCall->baseExpr.ptr;
+	ASSERT(memberAccess->funcReference);
+	return memberAccess->funcReference;
+}
+
+// adds the writes of every function that can be called from the node
+static void CollectCalledWrites(NodePtr node)
+{
+	switch (node.type)
+	{
+	case Node_MemberAccess:
+	{
+		MemberAccessExpr* memberAccess = node.ptr;
+		CollectCalledWrites(memberAccess->start);
+
+		FuncDeclStmt* funcDecl = memberAccess->funcReference;
+		if (funcDecl && !funcDecl->modifiers.externalValue && !Contains(&reachedFunctions, funcDecl))
+		{
+			Add(&reachedFunctions, funcDecl);
+			bool hasCalls = false;
+			CollectWrittenVariables(funcDecl->block, &assigned, &hasCalls);
+			CollectCalledWrites(funcDecl->block);
+		}
+		break;
+	}
+	case Node_Binary:
+	{
+		BinaryExpr* binary = node.ptr;
+		CollectCalledWrites(binary->left);
+		CollectCalledWrites(binary->right);
+		break;
+	}
+	case Node_Unary:
+	{
+		UnaryExpr* unary = node.ptr;
+		CollectCalledWrites(unary->expression);
+		break;
+	}
+	case Node_FunctionCall:
+	{
+		FuncCallExpr* funcCall = node.ptr;
+		CollectCalledWrites(funcCall->baseExpr);
+		for (size_t i = 0; i < funcCall->arguments.length; ++i)
+			CollectCalledWrites(*(NodePtr*)funcCall->arguments.array[i]);
+		break;
+	}
+	case Node_Subscript:
+	{
+		SubscriptExpr* subscript = node.ptr;
+		CollectCalledWrites(subscript->baseExpr);
+		CollectCalledWrites(subscript->indexExpr);
+		break;
+	}
+	case Node_BlockExpression:
+	{
+		BlockExpr* blockExpr = node.ptr;
+		CollectCalledWrites(blockExpr->block);
+		break;
+	}
+	case Node_ExpressionStatement:
+	{
+		ExpressionStmt* exprStmt = node.ptr;
+		CollectCalledWrites(exprStmt->expr);
+		break;
+	}
+	case Node_VariableDeclaration:
+	{
+		VarDeclStmt* varDecl = node.ptr;
+		CollectCalledWrites(varDecl->initializer);
+		break;
+	}
+	case Node_Return:
+	{
+		ReturnStmt* returnStmt = node.ptr;
+		CollectCalledWrites(returnStmt->expr);
+		break;
+	}
+	case Node_BlockStatement:
+	{
+		BlockStmt* block = node.ptr;
+		for (size_t i = 0; i < block->statements.length; ++i)
+			CollectCalledWrites(*(NodePtr*)block->statements.array[i]);
+		break;
+	}
+	case Node_If:
+	{
+		IfStmt* ifStmt = node.ptr;
+		CollectCalledWrites(ifStmt->expr);
+		CollectCalledWrites(ifStmt->trueStmt);
+		CollectCalledWrites(ifStmt->falseStmt);
+		break;
+	}
+	case Node_While:
+	{
+		WhileStmt* whileStmt = node.ptr;
+		CollectCalledWrites(whileStmt->expr);
+		CollectCalledWrites(whileStmt->stmt);
+		break;
+	}
+	default: break;
+	}
+}
+
+static void CollectWrites(NodePtr node)
+{
+	bool hasCalls = false;
+	CollectWrittenVariables(node, &assigned, &hasCalls);
+	CollectCalledWrites(node);
+}
+
+// the top level declarations of a block mode section are not writes,
+// they are either moved to @block or they stay and can't be hoisted anyway
+static void CollectSampleWrites(const BlockStmt* block)
+{
+	for (size_t i = 0; i < block->statements.length; ++i)
+	{
+		const NodePtr* stmt = block->statements.array[i];
+		switch (stmt->type)
+		{
+		case Node_VariableDeclaration:
+		{
+			VarDeclStmt* varDecl = stmt->ptr;
+			Add(&sampleVariables, varDecl);
+			CollectWrites(varDecl->initializer);
+			break;
+		}
+		case Node_BlockStatement:
+			CollectSampleWrites(stmt->ptr);
+			break;
+		default:
+			CollectWrites(*stmt);
+			break;
+		}
+	}
+}
+
+static bool IsInvariantFunction(FuncDeclStmt* funcDecl);
+
+static bool IsInvariantStatement(NodePtr node, const Map* locals)
+{
+	switch (node.type)
+	{
+	case Node_Null:
+	case Node_LoopControl:
+		return true;
+	case Node_ExpressionStatement:
+		return IsInvariant(((ExpressionStmt*)node.ptr)->expr, locals);
+	case Node_VariableDeclaration:
+	{
+		VarDeclStmt* varDecl = node.ptr;
+		return !varDecl->initializerList.ptr && IsInvariant(varDecl->initializer, locals);
+	}
+	case Node_Return:
+		return IsInvariant(((ReturnStmt*)node.ptr)->expr, locals);
+	case Node_BlockStatement:
+	{
+		BlockStmt* block = node.ptr;
+		for (size_t i = 0; i < block->statements.length; ++i)
+			if (!IsInvariantStatement(*(NodePtr*)block->statements.array[i], locals))
+				return false;
+		return true;
+	}
+	case Node_If:
+	{
+		IfStmt* ifStmt = node.ptr;
+		return IsInvariant(ifStmt->expr, locals) &&
+			   IsInvariantStatement(ifStmt->trueStmt, locals) &&
+			   IsInvariantStatement(ifStmt->falseStmt, locals);
+	}
+	case Node_While:
+	{
+		WhileStmt* whileStmt = node.ptr;
+		return IsInvariant(whileStmt->expr, locals) && IsInvariantStatement(whileStmt->stmt, locals);
+	}
+	default: return false;
+	}
+}
+
+// the function only reads invariant values and only writes its own variables
+static bool IsInvariantFunction(FuncDeclStmt* funcDecl)
+{
+	char key[64];
+	snprintf(key, sizeof(key), "%p", (void*)funcDecl);
+	FunctionState* state = MapGet(&functionStates, key);
+	if (state)
+		return *state == Function_Invariant;
+
+	MapAdd(&functionStates, key, &(FunctionState){Function_Visiting});
+
+	Map locals = AllocateMap(sizeof(VarDeclStmt*));
+	Array variables = AllocateArray(sizeof(VarDeclStmt*));
+	for (size_t i = 0; i < funcDecl->parameters.length; ++i)
+		ArrayAdd(&variables, &((NodePtr*)funcDecl->parameters.array[i])->ptr);
+	CollectVariableDeclarations(funcDecl->block, &variables);
+	for (size_t i = 0; i < variables.length; ++i)
+		Add(&locals, *(VarDeclStmt**)variables.array[i]);
+	FreeArray(&variables);
+
+	bool invariant = IsInvariantStatement(funcDecl->block, &locals);
+	FreeMap(&locals);
+
+	state = MapGet(&functionStates, key);
+	*state = invariant ? Function_Invariant : Function_Variant;
+	return invariant;
+}
+
+static bool IsLocal(NodePtr node, const Map* locals)
+{
+	if (!locals || node.type != Node_MemberAccess)
+		return false;
+
+	MemberAccessExpr* memberAccess = node.ptr;
+	return !memberAccess->start.ptr && memberAccess->varReference && Contains(locals, memberAccess->varReference);
+}
+
+static bool IsInvariant(NodePtr node, const Map* locals)
+{
+	switch (node.type)
+	{
+	case Node_Null:
+	case Node_Literal:
+		return true;
+	case Node_MemberAccess:
+	{
+		MemberAccessExpr* memberAccess = node.ptr;
+		VarDeclStmt* varDecl = memberAccess->varReference;
+		if (memberAccess->start.ptr || !varDecl)
+			return false;
+
+		if (locals && Contains(locals, varDecl))
+			return true;
+
+		if (varDecl->modifiers.externalValue && !IsBlockVariable(varDecl))
+			return false;
+		if (Contains(&sampleVariables, varDecl) && !Contains(&movedVariables, varDecl))
+			return false;
+		return !IsVariableWritten(&assigned, varDecl);
+	}
+	case Node_Binary:
+	{
+		BinaryExpr* binary = node.ptr;
+		if (binary->operatorType >= Binary_Assignment)
+			return IsLocal(binary->left, locals) && IsInvariant(binary->right, locals);
+		return IsInvariant(binary->left, locals) && IsInvariant(binary->right, locals);
+	}
+	case Node_Unary:
+	{
+		UnaryExpr* unary = node.ptr;
+		switch (unary->operatorType)
+		{
+		case Unary_Increment:
+		case Unary_Decrement:
+			return IsLocal(unary->expression, locals);
+		case Unary_Dereference:
+			return false;
+		default:
+			return IsInvariant(unary->expression, locals);
+		}
+	}
+	case Node_FunctionCall:
+	{
+		FuncCallExpr* funcCall = node.ptr;
+		FuncDeclStmt* funcDecl = GetFuncDecl(funcCall);
+		if (funcDecl->modifiers.externalValue && funcDecl->pure != PropertyBoolean_True)
+			return false;
+
+		for (size_t i = 0; i < funcCall->arguments.length; ++i)
+			if (!IsInvariant(*(NodePtr*)funcCall->arguments.array[i], locals))
+				return false;
+
+		return funcDecl->modifiers.externalValue || IsInvariantFunction(funcDecl);
+	}
+	default: return false;
+	}
+}
+
+static void MoveStatements(BlockStmt* block, BlockStmt* blockSection)
+{
+	for (size_t i = 0; i < block->statements.length; ++i)
+	{
+		const NodePtr* stmt = block->statements.array[i];
+		if (stmt->type == Node_BlockStatement)
+		{
+			MoveStatements(stmt->ptr, blockSection);
+			continue;
+		}
+		if (stmt->type != Node_VariableDeclaration)
+			continue;
+
+		VarDeclStmt* varDecl = stmt->ptr;
+		if (varDecl->modifiers.externalValue ||
+			IsVariableWritten(&assigned, varDecl) ||
+			!varDecl->initializer.ptr ||
+			varDecl->initializerList.ptr ||
+			!IsInvariant(varDecl->initializer, NULL))
+			continue;
+
+		Add(&movedVariables, varDecl);
+		++changeCount;
+		ArrayAdd(&blockSection->statements, stmt);
+		ArrayRemove(&block->statements, i);
+		i--;
+	}
+}
+
+// the setup of a section runs in an @block that is put right before it,
+// so the @block sections that come after the first one run after the setup
+static void CollectSectionWrites(const ModuleNode* module, bool* afterSetup)
+{
+	for (size_t i = 0; i < module->statements.length; ++i)
+	{
+		const NodePtr* stmt = module->statements.array[i];
+		if (stmt->type != Node_Section)
+			continue;
+
+		const SectionStmt* section = stmt->ptr;
+		switch (section->sectionType)
+		{
+		case Section_Sample:
+			if (section->blockMode == PropertyBoolean_True)
+			{
+				CollectSampleWrites(section->block.ptr);
+				*afterSetup = true;
+			}
+			else
+				CollectWrites(section->block);
+			break;
+		case Section_Block:
+			if (*afterSetup)
+				CollectWrites(section->block);
+			break;
+		// @gfx runs on another thread, and @serialize can run at any time
+		case Section_Serialize:
+		case Section_GFX:
+			CollectWrites(section->block);
+			break;
+		default: break;
+		}
+	}
+}
+
+static void VisitModule(ModuleNode* module)
+{
+	for (size_t i = 0; i < module->statements.length; ++i)
+	{
+		const NodePtr* stmt = module->statements.array[i];
+		if (stmt->type != Node_Section)
+			continue;
+
+		SectionStmt* section = stmt->ptr;
+		if (section->sectionType != Section_Sample || section->blockMode != PropertyBoolean_True)
+			continue;
+
+		NodePtr blockSection = AllocASTNode(
+			&(SectionStmt){
+				.lineNumber = -1,
+				.sectionType = Section_Block,
+				.blockMode = PropertyBoolean_NotSet,
+				.block = AllocASTNode(
+					&(BlockStmt){
+						.statements = AllocateArray(sizeof(NodePtr)),
+					},
+					sizeof(BlockStmt), Node_BlockStatement),
+			},
+			sizeof(SectionStmt), Node_Section);
+
+		MoveStatements(section->block.ptr, ((SectionStmt*)blockSection.ptr)->block.ptr);
+
+		if (((BlockStmt*)((SectionStmt*)blockSection.ptr)->block.ptr)->statements.length != 0)
+		{
+			ArrayInsert(&module->statements, &blockSection, i);
+			i++;
+		}
+		else
+			FreeASTNode(blockSection);
+	}
+}
+
+int BlockModePass(const AST* ast)
+{
+	changeCount = 0;
+	assigned = AllocateMap(sizeof(VarDeclStmt*));
+	reachedFunctions = AllocateMap(sizeof(FuncDeclStmt*));
+	sampleVariables = AllocateMap(sizeof(VarDeclStmt*));
+	movedVariables = AllocateMap(sizeof(VarDeclStmt*));
+	functionStates = AllocateMap(sizeof(FunctionState));
+
+	bool afterSetup = false;
+	for (size_t i = 0; i < ast->nodes.length; ++i)
+	{
+		const NodePtr* node = ast->nodes.array[i];
+		ASSERT(node->type == Node_Module);
+		CollectSectionWrites(node->ptr, &afterSetup);
+	}
+
+	if (afterSetup)
+	{
+		for (size_t i = 0; i < ast->nodes.length; ++i)
+			VisitModule(((NodePtr*)ast->nodes.array[i])->ptr);
+	}
+
+	FreeMap(&assigned);
+	FreeMap(&reachedFunctions);
+	FreeMap(&sampleVariables);
+	FreeMap(&movedVariables);
+	FreeMap(&functionStates);
+	return changeCount;
+}
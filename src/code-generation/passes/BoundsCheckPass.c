@@ -0,0 +1,261 @@
+#include "BoundsCheckPass.h"
+
+#include "Common.h"
+#include "StringUtils.h"
+
+#include <string.h>
+
+static FuncDeclStmt* checkIndex;
+static const char* currentModuleName;
+
+static void VisitStatement(NodePtr* node);
+static void VisitExpression(NodePtr* node);
+
+// whether evaluating the expression twice gives the same result and doesn't change anything
+static bool CanEvaluateTwice(NodePtr node)
+{
+	switch (node.type)
+	{
+	case Node_Literal:
+		return true;
+	case Node_MemberAccess:
+	{
+		const MemberAccessExpr* memberAccess = node.ptr;
+		return memberAccess->varReference && (!memberAccess->start.ptr || CanEvaluateTwice(memberAccess->start));
+	}
+	case Node_Subscript:
+	{
+		const SubscriptExpr* subscript = node.ptr;
+		return CanEvaluateTwice(subscript->baseExpr) && CanEvaluateTwice(subscript->indexExpr);
+	}
+	case Node_Binary:
+	{
+		const BinaryExpr* binary = node.ptr;
+		return binary->operatorType < Binary_Assignment &&
+			   CanEvaluateTwice(binary->left) &&
+			   CanEvaluateTwice(binary->right);
+	}
+	case Node_Unary:
+	{
+		const UnaryExpr* unary = node.ptr;
+		return unary->operatorType != Unary_Increment &&
+			   unary->operatorType != Unary_Decrement &&
+			   CanEvaluateTwice(unary->expression);
+	}
+	default:
+		return false;
+	}
+}
+
+// the length is copied from the array expression before any checks are added inside of it
+static NodePtr AllocLengthAccess(const SubscriptExpr* subscript)
+{
+	if (!subscript->arrayType ||
+		subscript->baseExpr.type != Node_MemberAccess ||
+		!CanEvaluateTwice(subscript->baseExpr))
+		return NULL_NODE;
+
+	NodePtr length = CopyASTNode(subscript->baseExpr);
+	((MemberAccessExpr*)length.ptr)->varReference =
+		((NodePtr*)subscript->arrayType->members.array[ARRAY_STRUCT_LENGTH_MEMBER_INDEX])->ptr;
+	return length;
+}
+
+// array[index] becomes array.ptr[checked.check_index(index, array.length, line, file)]
+static void AddCheck(SubscriptExpr* subscript, NodePtr length)
+{
+	Array arguments = AllocateArray(sizeof(NodePtr));
+	ArrayAdd(&arguments, &subscript->indexExpr);
+	ArrayAdd(&arguments, &length);
+	NodePtr line = AllocUInt64Integer((uint64_t)subscript->lineNumber, subscript->lineNumber);
+	ArrayAdd(&arguments, &line);
+	NodePtr file = AllocStringLiteral(AllocateString(currentModuleName), subscript->lineNumber);
+	ArrayAdd(&arguments, &file);
+
+	subscript->indexExpr = AllocASTNode(
+		&(FuncCallExpr){
+			.lineNumber = subscript->lineNumber,
+			.arguments = arguments,
+			.baseExpr = AllocASTNode(
+				&(MemberAccessExpr){
+					.lineNumber = subscript->lineNumber,
+					.identifiers.array = NULL,
+					.start = NULL_NODE,
+					.funcReference = checkIndex,
+					.typeReference = NULL,
+					.varReference = NULL,
+				},
+				sizeof(MemberAccessExpr), Node_MemberAccess),
+		},
+		sizeof(FuncCallExpr), Node_FunctionCall);
+}
+
+static void VisitExpression(NodePtr* node)
+{
+	switch (node->type)
+	{
+	case Node_Literal:
+	case Node_Null:
+		break;
+	case Node_MemberAccess:
+	{
+		MemberAccessExpr* memberAccess = node->ptr;
+		VisitExpression(&memberAccess->start);
+		break;
+	}
+	case Node_Binary:
+	{
+		BinaryExpr* binary = node->ptr;
+		VisitExpression(&binary->left);
+		VisitExpression(&binary->right);
+		break;
+	}
+	case Node_Unary:
+	{
+		UnaryExpr* unary = node->ptr;
+		VisitExpression(&unary->expression);
+		break;
+	}
+	case Node_FunctionCall:
+	{
+		FuncCallExpr* funcCall = node->ptr;
+		VisitExpression(&funcCall->baseExpr);
+		for (size_t i = 0; i < funcCall->arguments.length; i++)
+			VisitExpression(funcCall->arguments.array[i]);
+		break;
+	}
+	case Node_Subscript:
+	{
+		SubscriptExpr* subscript = node->ptr;
+		NodePtr length = AllocLengthAccess(subscript);
+		VisitExpression(&subscript->baseExpr);
+		VisitExpression(&subscript->indexExpr);
+		if (length.ptr)
+			AddCheck(subscript, length);
+		break;
+	}
+	case Node_SizeOf:
+		break;
+	case Node_BlockExpression:
+	{
+		BlockExpr* block = node->ptr;
+		VisitStatement(&block->block);
+		break;
+	}
+	default: INVALID_VALUE(node->type);
+	}
+}
+
+static void VisitStatement(NodePtr* node)
+{
+	switch (node->type)
+	{
+	case Node_StructDeclaration:
+	case Node_LoopControl:
+	case Node_Import:
+	case Node_Input:
+	case Node_Desc:
+	case Node_Null:
+		break;
+	case Node_VariableDeclaration:
+	{
+		VarDeclStmt* varDecl = node->ptr;
+		VisitExpression(&varDecl->initializer);
+		break;
+	}
+	case Node_ExpressionStatement:
+	{
+		ExpressionStmt* exprStmt = node->ptr;
+		VisitExpression(&exprStmt->expr);
+		break;
+	}
+	case Node_FunctionDeclaration:
+	{
+		FuncDeclStmt* funcDecl = node->ptr;
+		VisitStatement(&funcDecl->block);
+		break;
+	}
+	case Node_BlockStatement:
+	{
+		const BlockStmt* block = node->ptr;
+		for (size_t i = 0; i < block->statements.length; ++i)
+			VisitStatement(block->statements.array[i]);
+		break;
+	}
+	case Node_If:
+	{
+		IfStmt* ifStmt = node->ptr;
+		VisitExpression(&ifStmt->expr);
+		VisitStatement(&ifStmt->trueStmt);
+		VisitStatement(&ifStmt->falseStmt);
+		break;
+	}
+	case Node_Return:
+	{
+		ReturnStmt* returnStmt = node->ptr;
+		VisitExpression(&returnStmt->expr);
+		break;
+	}
+	case Node_Section:
+	{
+		SectionStmt* section = node->ptr;
+		VisitStatement(&section->block);
+		break;
+	}
+	case Node_While:
+	{
+		WhileStmt* whileStmt = node->ptr;
+		VisitExpression(&whileStmt->expr);
+		VisitStatement(&whileStmt->stmt);
+		break;
+	}
+	case Node_For:
+	{
+		ForStmt* forStmt = node->ptr;
+		VisitStatement(&forStmt->initialization);
+		VisitExpression(&forStmt->condition);
+		VisitExpression(&forStmt->increment);
+		VisitStatement(&forStmt->stmt);
+		break;
+	}
+	default: INVALID_VALUE(node->type);
+	}
+}
+
+static FuncDeclStmt* FindCheckFunction(const AST* ast)
+{
+	for (size_t i = 0; i < ast->nodes.length; ++i)
+	{
+		const ModuleNode* module = ((NodePtr*)ast->nodes.array[i])->ptr;
+		if (strcmp(module->moduleName, "checked") != 0)
+			continue;
+
+		for (size_t j = 0; j < module->statements.length; ++j)
+		{
+			const NodePtr* node = module->statements.array[j];
+			if (node->type == Node_FunctionDeclaration && strcmp(((FuncDeclStmt*)node->ptr)->name, "check_index") == 0)
+				return node->ptr;
+		}
+	}
+	UNREACHABLE();
+}
+
+// checks the index of every subscript on an array type against its length.
+// indexes that are out of bounds are logged in the checked module
+void BoundsCheckPass(const AST* ast)
+{
+	checkIndex = FindCheckFunction(ast);
+	for (size_t i = 0; i < ast->nodes.length; ++i)
+	{
+		const NodePtr* node = ast->nodes.array[i];
+
+		ASSERT(node->type == Node_Module);
+		const ModuleNode* module = node->ptr;
+		if (strcmp(module->moduleName, "checked") == 0)
+			continue;
+
+		currentModuleName = module->moduleName;
+		for (size_t i = 0; i < module->statements.length; ++i)
+			VisitStatement(module->statements.array[i]);
+	}
+}
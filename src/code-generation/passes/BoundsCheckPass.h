@@ -0,0 +1,5 @@
+#pragma once
+
+#include "SyntaxTree.h"
+
+void BoundsCheckPass(const AST* ast);
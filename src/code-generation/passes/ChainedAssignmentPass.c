@@ -50,6 +50,15 @@ static Result ConvertCompoundAssignment(NodePtr* node)
 	if (binary->left.type == Node_BlockExpression)
 		return ERROR_RESULT("Left operand of assignment must be a variable", binary->lineNumber, currentFilePath);
 
+	BlockStmt* blockStmt = AllocASTNode(
+		&(BlockStmt){
+			.lineNumber = binary->lineNumber,
+			.statements = AllocateArray(sizeof(NodePtr)),
+		},
+		sizeof(BlockStmt), Node_BlockStatement)
+							   .ptr;
+	HoistAssignmentTarget(&binary->left, blockStmt, binary->lineNumber);
+
 	binary->right = AllocASTNode(
 		&(BinaryExpr){
 			.lineNumber = binary->lineNumber,
@@ -60,6 +69,36 @@ static Result ConvertCompoundAssignment(NodePtr* node)
 		sizeof(BinaryExpr), Node_Binary);
 	binary->operatorType = Binary_Assignment;
 
+	if (blockStmt->statements.length == 0)
+	{
+		FreeASTNode((NodePtr){.ptr = blockStmt, .type = Node_BlockStatement});
+		return SUCCESS_RESULT;
+	}
+
+	// a[f()] += x becomes { temp = f(); a[temp] = a[temp] + x; return a[temp]; }
+	NodePtr exprStmt = AllocASTNode(
+		&(ExpressionStmt){
+			.lineNumber = binary->lineNumber,
+			.expr = *node,
+		},
+		sizeof(ExpressionStmt), Node_ExpressionStatement);
+	ArrayAdd(&blockStmt->statements, &exprStmt);
+
+	NodePtr returnStmt = AllocASTNode(
+		&(ReturnStmt){
+			.lineNumber = binary->lineNumber,
+			.expr = CopyASTNode(binary->left),
+		},
+		sizeof(ReturnStmt), Node_Return);
+	ArrayAdd(&blockStmt->statements, &returnStmt);
+
+	*node = AllocASTNode(
+		&(BlockExpr){
+			.type = AllocTypeFromExpr(binary->left, binary->lineNumber),
+			.block = (NodePtr){.ptr = blockStmt, .type = Node_BlockStatement},
+		},
+		sizeof(BlockExpr), Node_BlockExpression);
+
 	return SUCCESS_RESULT;
 }
 
@@ -139,7 +178,10 @@ static Result VisitExpression(NodePtr* node, bool parentIsExprStmt)
 	case Node_Binary:
 	{
 		PROPAGATE_ERROR(ConvertCompoundAssignment(node));
-		PROPAGATE_ERROR(VisitBinaryExpression(node, parentIsExprStmt));
+		if (node->type == Node_BlockExpression)
+			PROPAGATE_ERROR(VisitExpression(node, parentIsExprStmt));
+		else
+			PROPAGATE_ERROR(VisitBinaryExpression(node, parentIsExprStmt));
 		break;
 	}
 	case Node_Unary:
@@ -151,7 +193,7 @@ static Result VisitExpression(NodePtr* node, bool parentIsExprStmt)
 			PROPAGATE_ERROR(VisitExpression(&unary->expression, false));
 		}
 		else
-			PROPAGATE_ERROR(VisitExpression(node, false));
+			PROPAGATE_ERROR(VisitExpression(node, parentIsExprStmt));
 		break;
 	}
 	case Node_FunctionCall:
@@ -262,7 +304,8 @@ static Result VisitStatement(NodePtr* node)
 		ForStmt* forStmt = node->ptr;
 		PROPAGATE_ERROR(VisitStatement(&forStmt->initialization));
 		PROPAGATE_ERROR(VisitExpression(&forStmt->condition, false));
-		PROPAGATE_ERROR(VisitExpression(&forStmt->increment, false));
+		// the value of the increment is never used, so it is treated like an expression statement
+		PROPAGATE_ERROR(VisitExpression(&forStmt->increment, true));
 		PROPAGATE_ERROR(VisitStatement(&forStmt->stmt));
 		break;
 	}
@@ -0,0 +1,465 @@
+#include "ClosureConversionPass.h"
+
+#include "Common.h"
+
+// functions declared inside other functions are moved out before the optimizations run, but they
+// still use the variables of the function they were in. that function can't be inlined or
+// specialized because its variables are used somewhere else, and the variables are invalidated at
+// every call to the nested function. if the nested function only reads them and is only called
+// from the function they belong to, they are passed to it as arguments instead.
+// functions that assign to them are left alone, the inlining pass has to deal with those
+
+// every variable that is passed adds an argument to each call
+#define MAX_CAPTURED_VARIABLES 4
+
+typedef enum
+{
+	Visit_Declarations,
+	Visit_Uses,
+} VisitMode;
+
+typedef struct
+{
+	FuncDeclStmt* function;
+	// the function that the variables it uses belong to
+	FuncDeclStmt* owner;
+	// the variables of the owner that the function uses
+	Array captured;
+	// the calls to the function
+	Array calls;
+	bool rejected;
+} FunctionInfo;
+
+typedef struct
+{
+	FuncCallExpr* funcCall;
+	FuncDeclStmt* caller;
+} Call;
+
+// in the order they are declared, so the output doesn't depend on where things are in memory
+static Array functions;
+static Map functionIndices;
+static Map variableOwners;
+static Map capturedWrites;
+static VisitMode mode;
+
+static FuncDeclStmt* currentFunction;
+
+static void Visit(NodePtr* node);
+
+static FuncDeclStmt* GetFuncDecl(FuncCallExpr* funcCall)
+{
+	ASSERT(funcCall->baseExpr.type == Node_MemberAccess);
+	MemberAccessExpr* memberAccess = funcCall->baseExpr.ptr;
+	ASSERT(memberAccess->funcReference);
+	return memberAccess->funcReference;
+}
+
+static FunctionInfo* GetFunctionInfo(const FuncDeclStmt* funcDecl)
+{
+	char key[64];
+	snprintf(key, sizeof(key), "%p", (const void*)funcDecl);
+	size_t* index = MapGet(&functionIndices, key);
+	return index ? functions.array[*index] : NULL;
+}
+
+static FuncDeclStmt* GetVariableOwner(const VarDeclStmt* varDecl)
+{
+	char key[64];
+	snprintf(key, sizeof(key), "%p", (const void*)varDecl);
+	FuncDeclStmt** owner = MapGet(&variableOwners, key);
+	return owner ? *owner : NULL;
+}
+
+static bool IsCapturedWrite(const VarDeclStmt* varDecl)
+{
+	char key[64];
+	snprintf(key, sizeof(key), "%p", (const void*)varDecl);
+	return MapGet(&capturedWrites, key) != NULL;
+}
+
+static void AddWrite(NodePtr node)
+{
+	if (mode != Visit_Uses || node.type != Node_MemberAccess)
+		return;
+
+	VarDeclStmt* varDecl = ((MemberAccessExpr*)node.ptr)->varReference;
+	if (!varDecl)
+		return;
+
+	FuncDeclStmt* owner = GetVariableOwner(varDecl);
+	if (!owner || owner == currentFunction)
+		return;
+
+	char key[64];
+	snprintf(key, sizeof(key), "%p", (void*)varDecl);
+	MapAdd(&capturedWrites, key, &varDecl);
+}
+
+static void AddUse(VarDeclStmt* varDecl)
+{
+	FuncDeclStmt* owner = GetVariableOwner(varDecl);
+	if (!owner || owner == currentFunction)
+		return;
+
+	FunctionInfo* info = GetFunctionInfo(currentFunction);
+	if (!info)
+		return;
+
+	// the variables would have to be passed through the other functions too
+	if (info->owner && info->owner != owner)
+	{
+		info->rejected = true;
+		return;
+	}
+	info->owner = owner;
+
+	for (size_t i = 0; i < info->captured.length; ++i)
+		if (*(VarDeclStmt**)info->captured.array[i] == varDecl)
+			return;
+	ArrayAdd(&info->captured, &varDecl);
+}
+
+static void VisitFunctionCall(FuncCallExpr* funcCall)
+{
+	FuncDeclStmt* funcDecl = GetFuncDecl(funcCall);
+	for (size_t i = 0; i < funcCall->arguments.length; ++i)
+	{
+		NodePtr* arg = funcCall->arguments.array[i];
+		if (funcDecl->modifiers.externalValue)
+			AddWrite(*arg);
+		Visit(arg);
+	}
+
+	if (mode != Visit_Uses)
+		return;
+
+	// the block can use the variables too, wait until it has been put back
+	FunctionInfo* callerInfo = GetFunctionInfo(currentFunction);
+	if (funcDecl->isBlockExpression && callerInfo)
+		callerInfo->rejected = true;
+
+	FunctionInfo* info = GetFunctionInfo(funcDecl);
+	if (info)
+		ArrayAdd(&info->calls, &(Call){.funcCall = funcCall, .caller = currentFunction});
+}
+
+static void VisitFunctionDeclaration(FuncDeclStmt* funcDecl)
+{
+	if (funcDecl->modifiers.externalValue || funcDecl->block.type != Node_BlockStatement)
+		return;
+
+	// block expressions get put back where they were by the inlining pass
+	if (mode == Visit_Declarations && !funcDecl->isBlockExpression)
+	{
+		char key[64];
+		snprintf(key, sizeof(key), "%p", (void*)funcDecl);
+		MapAdd(&functionIndices, key, &functions.length);
+		ArrayAdd(&functions, &(FunctionInfo){
+								 .function = funcDecl,
+								 .captured = AllocateArray(sizeof(VarDeclStmt*)),
+								 .calls = AllocateArray(sizeof(Call)),
+							 });
+	}
+
+	FuncDeclStmt* previousFunction = currentFunction;
+	currentFunction = funcDecl;
+	for (size_t i = 0; i < funcDecl->parameters.length; ++i)
+		Visit(funcDecl->parameters.array[i]);
+	Visit(&funcDecl->block);
+	currentFunction = previousFunction;
+}
+
+static void Visit(NodePtr* node)
+{
+	switch (node->type)
+	{
+	case Node_Import:
+	case Node_StructDeclaration:
+	case Node_Desc:
+	case Node_Literal:
+	case Node_Null:
+		break;
+	case Node_MemberAccess:
+	{
+		MemberAccessExpr* memberAccess = node->ptr;
+		Visit(&memberAccess->start);
+		if (mode == Visit_Uses && memberAccess->varReference)
+			AddUse(memberAccess->varReference);
+		break;
+	}
+	case Node_Binary:
+	{
+		BinaryExpr* binary = node->ptr;
+		if (binary->operatorType >= Binary_Assignment)
+			AddWrite(binary->left);
+		Visit(&binary->left);
+		Visit(&binary->right);
+		break;
+	}
+	case Node_Unary:
+	{
+		UnaryExpr* unary = node->ptr;
+		if (unary->operatorType == Unary_Increment || unary->operatorType == Unary_Decrement)
+			AddWrite(unary->expression);
+		Visit(&unary->expression);
+		break;
+	}
+	case Node_FunctionCall:
+	{
+		VisitFunctionCall(node->ptr);
+		break;
+	}
+	case Node_Subscript:
+	{
+		SubscriptExpr* subscript = node->ptr;
+		Visit(&subscript->baseExpr);
+		Visit(&subscript->indexExpr);
+		break;
+	}
+	case Node_BlockExpression:
+	{
+		BlockExpr* blockExpr = node->ptr;
+		Visit(&blockExpr->block);
+		break;
+	}
+	case Node_ExpressionStatement:
+	{
+		ExpressionStmt* exprStmt = node->ptr;
+		Visit(&exprStmt->expr);
+		break;
+	}
+	case Node_VariableDeclaration:
+	{
+		VarDeclStmt* varDecl = node->ptr;
+		if (mode == Visit_Declarations && currentFunction)
+		{
+			char key[64];
+			snprintf(key, sizeof(key), "%p", (void*)varDecl);
+			MapAdd(&variableOwners, key, &currentFunction);
+		}
+		Visit(&varDecl->initializer);
+		break;
+	}
+	case Node_FunctionDeclaration:
+	{
+		VisitFunctionDeclaration(node->ptr);
+		break;
+	}
+	case Node_Input:
+	{
+		InputStmt* input = node->ptr;
+		Visit(&input->varDecl);
+		break;
+	}
+	case Node_BlockStatement:
+	{
+		BlockStmt* block = node->ptr;
+		for (size_t i = 0; i < block->statements.length; ++i)
+			Visit(block->statements.array[i]);
+		break;
+	}
+	case Node_If:
+	{
+		IfStmt* ifStmt = node->ptr;
+		Visit(&ifStmt->expr);
+		Visit(&ifStmt->trueStmt);
+		Visit(&ifStmt->falseStmt);
+		break;
+	}
+	case Node_Section:
+	{
+		SectionStmt* section = node->ptr;
+		Visit(&section->block);
+		break;
+	}
+	case Node_While:
+	{
+		WhileStmt* whileStmt = node->ptr;
+		Visit(&whileStmt->expr);
+		Visit(&whileStmt->stmt);
+		break;
+	}
+	default: INVALID_VALUE(node->type);
+	}
+}
+
+static void VisitModules(const AST* ast, VisitMode visitMode)
+{
+	mode = visitMode;
+	for (size_t i = 0; i < ast->nodes.length; ++i)
+	{
+		const NodePtr* node = ast->nodes.array[i];
+
+		ASSERT(node->type == Node_Module);
+		const ModuleNode* module = node->ptr;
+
+		for (size_t i = 0; i < module->statements.length; ++i)
+			Visit(module->statements.array[i]);
+	}
+}
+
+// the variables have to exist where the function is called, and they can't change
+// while it runs, so it can't assign to them or call anything that does
+static bool CanPassVariables(const FunctionInfo* info)
+{
+	if (!info->owner ||
+		info->rejected ||
+		info->captured.length > MAX_CAPTURED_VARIABLES ||
+		info->function->variadic ||
+		CanCallFunction(info->function, info->owner))
+		return false;
+
+	for (size_t i = 0; i < info->calls.length; ++i)
+	{
+		const Call* call = info->calls.array[i];
+		if (call->caller != info->owner)
+			return false;
+	}
+
+	for (size_t i = 0; i < info->captured.length; ++i)
+		if (IsCapturedWrite(*(VarDeclStmt**)info->captured.array[i]))
+			return false;
+	return true;
+}
+
+static void ReplaceVariable(NodePtr node, const VarDeclStmt* from, VarDeclStmt* to)
+{
+	switch (node.type)
+	{
+	case Node_Literal:
+	case Node_Null:
+		break;
+	case Node_MemberAccess:
+	{
+		MemberAccessExpr* memberAccess = node.ptr;
+		ReplaceVariable(memberAccess->start, from, to);
+		if (memberAccess->varReference == from)
+			memberAccess->varReference = to;
+		break;
+	}
+	case Node_Binary:
+	{
+		BinaryExpr* binary = node.ptr;
+		ReplaceVariable(binary->left, from, to);
+		ReplaceVariable(binary->right, from, to);
+		break;
+	}
+	case Node_Unary:
+	{
+		UnaryExpr* unary = node.ptr;
+		ReplaceVariable(unary->expression, from, to);
+		break;
+	}
+	case Node_FunctionCall:
+	{
+		FuncCallExpr* funcCall = node.ptr;
+		for (size_t i = 0; i < funcCall->arguments.length; ++i)
+			ReplaceVariable(*(NodePtr*)funcCall->arguments.array[i], from, to);
+		break;
+	}
+	case Node_Subscript:
+	{
+		SubscriptExpr* subscript = node.ptr;
+		ReplaceVariable(subscript->baseExpr, from, to);
+		ReplaceVariable(subscript->indexExpr, from, to);
+		break;
+	}
+	case Node_BlockExpression:
+	{
+		BlockExpr* blockExpr = node.ptr;
+		ReplaceVariable(blockExpr->block, from, to);
+		break;
+	}
+	case Node_ExpressionStatement:
+	{
+		ExpressionStmt* exprStmt = node.ptr;
+		ReplaceVariable(exprStmt->expr, from, to);
+		break;
+	}
+	case Node_VariableDeclaration:
+	{
+		VarDeclStmt* varDecl = node.ptr;
+		ReplaceVariable(varDecl->initializer, from, to);
+		break;
+	}
+	case Node_BlockStatement:
+	{
+		BlockStmt* block = node.ptr;
+		for (size_t i = 0; i < block->statements.length; ++i)
+			ReplaceVariable(*(NodePtr*)block->statements.array[i], from, to);
+		break;
+	}
+	case Node_If:
+	{
+		IfStmt* ifStmt = node.ptr;
+		ReplaceVariable(ifStmt->expr, from, to);
+		ReplaceVariable(ifStmt->trueStmt, from, to);
+		ReplaceVariable(ifStmt->falseStmt, from, to);
+		break;
+	}
+	case Node_While:
+	{
+		WhileStmt* whileStmt = node.ptr;
+		ReplaceVariable(whileStmt->expr, from, to);
+		ReplaceVariable(whileStmt->stmt, from, to);
+		break;
+	}
+	default: INVALID_VALUE(node.type);
+	}
+}
+
+static void PassVariable(FunctionInfo* info, VarDeclStmt* captured)
+{
+	NodePtr parameter = CopyASTNode((NodePtr){.ptr = captured, .type = Node_VariableDeclaration});
+	VarDeclStmt* varDecl = parameter.ptr;
+	FreeASTNode(varDecl->initializer);
+	varDecl->initializer = NULL_NODE;
+	varDecl->functionParamOf = info->function;
+	ArrayAdd(&info->function->parameters, &parameter);
+
+	ReplaceVariable(info->function->block, captured, varDecl);
+
+	for (size_t i = 0; i < info->calls.length; ++i)
+	{
+		FuncCallExpr* funcCall = ((Call*)info->calls.array[i])->funcCall;
+		NodePtr arg = AllocIdentifier(captured, funcCall->lineNumber);
+		ArrayAdd(&funcCall->arguments, &arg);
+	}
+}
+
+int ClosureConversionPass(const AST* ast)
+{
+	functions = AllocateArray(sizeof(FunctionInfo));
+	functionIndices = AllocateMap(sizeof(size_t));
+	variableOwners = AllocateMap(sizeof(FuncDeclStmt*));
+	capturedWrites = AllocateMap(sizeof(VarDeclStmt*));
+
+	// the variables are found first, so the uses know which function they belong to
+	VisitModules(ast, Visit_Declarations);
+	VisitModules(ast, Visit_Uses);
+
+	int changeCount = 0;
+	for (size_t i = 0; i < functions.length; ++i)
+	{
+		FunctionInfo* info = functions.array[i];
+		if (!CanPassVariables(info))
+			continue;
+
+		for (size_t j = 0; j < info->captured.length; ++j)
+			PassVariable(info, *(VarDeclStmt**)info->captured.array[j]);
+		++changeCount;
+	}
+
+	for (size_t i = 0; i < functions.length; ++i)
+	{
+		FunctionInfo* info = functions.array[i];
+		FreeArray(&info->captured);
+		FreeArray(&info->calls);
+	}
+	FreeArray(&functions);
+	FreeMap(&functionIndices);
+	FreeMap(&variableOwners);
+	FreeMap(&capturedWrites);
+	return changeCount;
+}
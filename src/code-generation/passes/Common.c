@@ -2,6 +2,12 @@
 
 #include "StringUtils.h"
 
+#include <ctype.h>
+#include <math.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
 StructTypeInfo GetStructTypeInfoFromType(Type type)
 {
 	ASSERT(type.expr.ptr != NULL);
@@ -387,6 +393,90 @@ NodePtr AllocSetVariable(VarDeclStmt* varDecl, NodePtr value, int lineNumber)
 	return AllocAssignmentStatement(AllocIdentifier(varDecl, lineNumber), value, lineNumber);
 }
 
+// expressions that can be evaluated twice without a different result or side effects
+static bool IsSimpleExpression(NodePtr node)
+{
+	switch (node.type)
+	{
+	case Node_Literal:
+	case Node_Null:
+	case Node_SizeOf:
+		return true;
+	case Node_MemberAccess:
+		return IsSimpleExpression(((MemberAccessExpr*)node.ptr)->start);
+	case Node_Subscript:
+	{
+		SubscriptExpr* subscript = node.ptr;
+		return IsSimpleExpression(subscript->baseExpr) && IsSimpleExpression(subscript->indexExpr);
+	}
+	case Node_Unary:
+	{
+		UnaryExpr* unary = node.ptr;
+		return unary->operatorType != Unary_Increment &&
+			   unary->operatorType != Unary_Decrement &&
+			   IsSimpleExpression(unary->expression);
+	}
+	case Node_Binary:
+	{
+		BinaryExpr* binary = node.ptr;
+		return binary->operatorType < Binary_Assignment &&
+			   IsSimpleExpression(binary->left) &&
+			   IsSimpleExpression(binary->right);
+	}
+	default:
+		return false;
+	}
+}
+
+static void HoistExpression(NodePtr* node, BlockStmt* block, int lineNumber)
+{
+	if (IsSimpleExpression(*node))
+		return;
+
+	NodePtr varDecl = AllocASTNode(
+		&(VarDeclStmt){
+			.lineNumber = lineNumber,
+			.initializer = *node,
+			.type = AllocTypeFromExpr(*node, lineNumber),
+			.name = AllocateString("temp"),
+			.instantiatedVariables = AllocateArray(sizeof(VarDeclStmt*)),
+			.uniqueName = -1,
+		},
+		sizeof(VarDeclStmt), Node_VariableDeclaration);
+	ArrayAdd(&block->statements, &varDecl);
+	*node = AllocIdentifier(varDecl.ptr, lineNumber);
+}
+
+// the left operand is copied to the right side, so anything in it that has side effects is put in a variable first
+void HoistAssignmentTarget(NodePtr* node, BlockStmt* block, int lineNumber)
+{
+	switch (node->type)
+	{
+	case Node_MemberAccess:
+	{
+		MemberAccessExpr* memberAccess = node->ptr;
+		HoistAssignmentTarget(&memberAccess->start, block, lineNumber);
+		break;
+	}
+	case Node_Subscript:
+	{
+		SubscriptExpr* subscript = node->ptr;
+		HoistAssignmentTarget(&subscript->baseExpr, block, lineNumber);
+		HoistExpression(&subscript->indexExpr, block, lineNumber);
+		break;
+	}
+	case Node_Unary:
+	{
+		UnaryExpr* unary = node->ptr;
+		if (unary->operatorType == Unary_Dereference)
+			HoistExpression(&unary->expression, block, lineNumber);
+		break;
+	}
+	default:
+		break;
+	}
+}
+
 NodePtr AllocIntConversion(NodePtr expr, int lineNumber)
 {
 	return AllocASTNode(
@@ -443,6 +533,47 @@ NodePtr AllocNumber(char* value, int lineNumber)
 		sizeof(LiteralExpr), Node_Literal);
 }
 
+// the number is written with as many digits as needed to get the exact same value back.
+// jsfx doesn't have exponent notation so it is always written out in full
+NodePtr AllocDouble(double value, int lineNumber)
+{
+	ASSERT(isfinite(value));
+
+	if (signbit(value))
+		return AllocASTNode(
+			&(UnaryExpr){
+				.lineNumber = lineNumber,
+				.operatorType = Unary_Minus,
+				.expression = AllocDouble(-value, lineNumber),
+			},
+			sizeof(UnaryExpr), Node_Unary);
+
+	if (value < 1e15 && value == (double)(uint64_t)value)
+		return AllocUInt64Integer((uint64_t)value, lineNumber);
+
+	char buffer[512];
+	for (int precision = 15; precision <= 17; ++precision)
+	{
+		snprintf(buffer, sizeof(buffer), "%.*g", precision, value);
+		if (strtod(buffer, NULL) == value)
+			break;
+	}
+
+	char* exponent = strchr(buffer, 'e');
+	if (exponent)
+	{
+		int digits = 0;
+		for (char* c = buffer; c < exponent; ++c)
+			if (isdigit(*c))
+				++digits;
+
+		int decimals = digits - 1 - atoi(exponent + 1);
+		snprintf(buffer, sizeof(buffer), "%.*f", decimals > 0 ? decimals : 0, value);
+	}
+
+	return AllocNumber(AllocateString(buffer), lineNumber);
+}
+
 NodePtr AllocStringLiteral(char* value, int lineNumber)
 {
 	return AllocASTNode(
@@ -453,3 +584,977 @@ NodePtr AllocStringLiteral(char* value, int lineNumber)
 		},
 		sizeof(LiteralExpr), Node_Literal);
 }
+
+static FuncDeclStmt* GetFuncDecl(FuncCallExpr* funcCall)
+{
+	ASSERT(funcCall->baseExpr.type == Node_MemberAccess);
+	MemberAccessExpr* memberAccess = funcCall->baseExpr.ptr;
+	ASSERT(memberAccess->funcReference);
+	return memberAccess->funcReference;
+}
+
+static bool CallsFunction(FuncDeclStmt* funcDecl, FuncDeclStmt* target, Map* visited)
+{
+	char key[64];
+	snprintf(key, sizeof(key), "%p", (void*)funcDecl);
+	if (!MapAdd(visited, key, &(bool){true}))
+		return false;
+
+	for (size_t i = 0; i < funcDecl->dependencies.length; ++i)
+	{
+		NodePtr* node = funcDecl->dependencies.array[i];
+		ASSERT(node->type == Node_FunctionDeclaration);
+		if (node->ptr == target || CallsFunction(node->ptr, target, visited))
+			return true;
+	}
+	return false;
+}
+
+bool IsRecursiveFunction(FuncDeclStmt* funcDecl)
+{
+	Map visited = AllocateMap(sizeof(bool));
+	bool recursive = CallsFunction(funcDecl, funcDecl, &visited);
+	FreeMap(&visited);
+	return recursive;
+}
+
+// checks if calling the function can end up calling the target
+bool CanCallFunction(FuncDeclStmt* funcDecl, FuncDeclStmt* target)
+{
+	Map visited = AllocateMap(sizeof(bool));
+	bool calls = CallsFunction(funcDecl, target, &visited);
+	FreeMap(&visited);
+	return calls;
+}
+
+// how many variables a struct is expanded into, which is also how many memory slots it takes up
+uint64_t CountStructSlots(StructDeclStmt* type)
+{
+	uint64_t count = 0;
+	for (size_t i = 0; i < type->members.length; ++i)
+	{
+		const NodePtr* node = type->members.array[i];
+		ASSERT(node->type == Node_VariableDeclaration);
+		StructDeclStmt* memberType = GetStructTypeInfoFromType(((VarDeclStmt*)node->ptr)->type).effectiveType;
+		count += memberType ? CountStructSlots(memberType) : 1;
+	}
+	return count;
+}
+
+int CountNodes(NodePtr node)
+{
+	switch (node.type)
+	{
+	case Node_Null:
+		return 0;
+	case Node_Literal:
+	case Node_MemberAccess:
+		return 1;
+	case Node_Binary:
+	{
+		BinaryExpr* binary = node.ptr;
+		return 1 + CountNodes(binary->left) + CountNodes(binary->right);
+	}
+	case Node_Unary:
+	{
+		UnaryExpr* unary = node.ptr;
+		return 1 + CountNodes(unary->expression);
+	}
+	case Node_FunctionCall:
+	{
+		FuncCallExpr* funcCall = node.ptr;
+		int count = 1;
+		for (size_t i = 0; i < funcCall->arguments.length; ++i)
+			count += CountNodes(*(NodePtr*)funcCall->arguments.array[i]);
+		return count;
+	}
+	case Node_Subscript:
+	{
+		SubscriptExpr* subscript = node.ptr;
+		return 1 + CountNodes(subscript->baseExpr) + CountNodes(subscript->indexExpr);
+	}
+	case Node_BlockExpression:
+	{
+		BlockExpr* blockExpr = node.ptr;
+		return CountNodes(blockExpr->block);
+	}
+	case Node_ExpressionStatement:
+	{
+		ExpressionStmt* exprStmt = node.ptr;
+		return CountNodes(exprStmt->expr);
+	}
+	case Node_VariableDeclaration:
+	{
+		VarDeclStmt* varDecl = node.ptr;
+		return 1 + CountNodes(varDecl->initializer);
+	}
+	case Node_BlockStatement:
+	{
+		BlockStmt* block = node.ptr;
+		int count = 0;
+		for (size_t i = 0; i < block->statements.length; ++i)
+			count += CountNodes(*(NodePtr*)block->statements.array[i]);
+		return count;
+	}
+	case Node_If:
+	{
+		IfStmt* ifStmt = node.ptr;
+		return 1 + CountNodes(ifStmt->expr) + CountNodes(ifStmt->trueStmt) + CountNodes(ifStmt->falseStmt);
+	}
+	case Node_While:
+	{
+		WhileStmt* whileStmt = node.ptr;
+		return 1 + CountNodes(whileStmt->expr) + CountNodes(whileStmt->stmt);
+	}
+	case Node_FunctionDeclaration:
+	{
+		FuncDeclStmt* funcDecl = node.ptr;
+		return CountNodes(funcDecl->block);
+	}
+	case Node_Section:
+	{
+		SectionStmt* section = node.ptr;
+		return CountNodes(section->block);
+	}
+	case Node_Import:
+	case Node_StructDeclaration:
+	case Node_Input:
+	case Node_Desc:
+		return 0;
+	default: INVALID_VALUE(node.type);
+	}
+}
+
+bool ContainsFunctionDeclaration(NodePtr node)
+{
+	switch (node.type)
+	{
+	case Node_FunctionDeclaration:
+		return true;
+	case Node_BlockStatement:
+	{
+		BlockStmt* block = node.ptr;
+		for (size_t i = 0; i < block->statements.length; ++i)
+			if (ContainsFunctionDeclaration(*(NodePtr*)block->statements.array[i]))
+				return true;
+		return false;
+	}
+	case Node_If:
+	{
+		IfStmt* ifStmt = node.ptr;
+		return ContainsFunctionDeclaration(ifStmt->trueStmt) || ContainsFunctionDeclaration(ifStmt->falseStmt);
+	}
+	case Node_While:
+	{
+		WhileStmt* whileStmt = node.ptr;
+		return ContainsFunctionDeclaration(whileStmt->stmt);
+	}
+	default:
+		return false;
+	}
+}
+
+// checks if a function called from the node uses one of the variables.
+// nested functions can use the variables of the function they are in,
+// those functions would still use the original variables after the function is copied
+static bool CalleesUseVariables(NodePtr node, const Map* variables, Map* visited, bool inCallee)
+{
+	switch (node.type)
+	{
+	case Node_MemberAccess:
+	{
+		MemberAccessExpr* memberAccess = node.ptr;
+		if (!inCallee || !memberAccess->varReference)
+			return false;
+
+		char key[64];
+		snprintf(key, sizeof(key), "%p", (void*)memberAccess->varReference);
+		return MapGet(variables, key) != NULL;
+	}
+	case Node_Binary:
+	{
+		BinaryExpr* binary = node.ptr;
+		return CalleesUseVariables(binary->left, variables, visited, inCallee) ||
+			   CalleesUseVariables(binary->right, variables, visited, inCallee);
+	}
+	case Node_Unary:
+	{
+		UnaryExpr* unary = node.ptr;
+		return CalleesUseVariables(unary->expression, variables, visited, inCallee);
+	}
+	case Node_FunctionCall:
+	{
+		FuncCallExpr* funcCall = node.ptr;
+		for (size_t i = 0; i < funcCall->arguments.length; ++i)
+			if (CalleesUseVariables(*(NodePtr*)funcCall->arguments.array[i], variables, visited, inCallee))
+				return true;
+
+		FuncDeclStmt* funcDecl = GetFuncDecl(funcCall);
+		if (funcDecl->modifiers.externalValue)
+			return false;
+
+		char key[64];
+		snprintf(key, sizeof(key), "%p", (void*)funcDecl);
+		if (!MapAdd(visited, key, &(bool){true}))
+			return false;
+
+		for (size_t i = 0; i < funcDecl->parameters.length; ++i)
+			if (CalleesUseVariables(*(NodePtr*)funcDecl->parameters.array[i], variables, visited, true))
+				return true;
+		return CalleesUseVariables(funcDecl->block, variables, visited, true);
+	}
+	case Node_Subscript:
+	{
+		SubscriptExpr* subscript = node.ptr;
+		return CalleesUseVariables(subscript->baseExpr, variables, visited, inCallee) ||
+			   CalleesUseVariables(subscript->indexExpr, variables, visited, inCallee);
+	}
+	case Node_BlockExpression:
+	{
+		BlockExpr* blockExpr = node.ptr;
+		return CalleesUseVariables(blockExpr->block, variables, visited, inCallee);
+	}
+	case Node_ExpressionStatement:
+	{
+		ExpressionStmt* exprStmt = node.ptr;
+		return CalleesUseVariables(exprStmt->expr, variables, visited, inCallee);
+	}
+	case Node_VariableDeclaration:
+	{
+		VarDeclStmt* varDecl = node.ptr;
+		return CalleesUseVariables(varDecl->initializer, variables, visited, inCallee);
+	}
+	case Node_BlockStatement:
+	{
+		BlockStmt* block = node.ptr;
+		for (size_t i = 0; i < block->statements.length; ++i)
+			if (CalleesUseVariables(*(NodePtr*)block->statements.array[i], variables, visited, inCallee))
+				return true;
+		return false;
+	}
+	case Node_If:
+	{
+		IfStmt* ifStmt = node.ptr;
+		return CalleesUseVariables(ifStmt->expr, variables, visited, inCallee) ||
+			   CalleesUseVariables(ifStmt->trueStmt, variables, visited, inCallee) ||
+			   CalleesUseVariables(ifStmt->falseStmt, variables, visited, inCallee);
+	}
+	case Node_While:
+	{
+		WhileStmt* whileStmt = node.ptr;
+		return CalleesUseVariables(whileStmt->expr, variables, visited, inCallee) ||
+			   CalleesUseVariables(whileStmt->stmt, variables, visited, inCallee);
+	}
+	default:
+		return false;
+	}
+}
+
+void CollectVariableDeclarations(NodePtr node, Array* variables)
+{
+	switch (node.type)
+	{
+	case Node_Binary:
+	{
+		BinaryExpr* binary = node.ptr;
+		CollectVariableDeclarations(binary->left, variables);
+		CollectVariableDeclarations(binary->right, variables);
+		break;
+	}
+	case Node_Unary:
+	{
+		UnaryExpr* unary = node.ptr;
+		CollectVariableDeclarations(unary->expression, variables);
+		break;
+	}
+	case Node_FunctionCall:
+	{
+		FuncCallExpr* funcCall = node.ptr;
+		for (size_t i = 0; i < funcCall->arguments.length; ++i)
+			CollectVariableDeclarations(*(NodePtr*)funcCall->arguments.array[i], variables);
+		break;
+	}
+	case Node_Subscript:
+	{
+		SubscriptExpr* subscript = node.ptr;
+		CollectVariableDeclarations(subscript->baseExpr, variables);
+		CollectVariableDeclarations(subscript->indexExpr, variables);
+		break;
+	}
+	case Node_BlockExpression:
+	{
+		BlockExpr* blockExpr = node.ptr;
+		CollectVariableDeclarations(blockExpr->block, variables);
+		break;
+	}
+	case Node_ExpressionStatement:
+	{
+		ExpressionStmt* exprStmt = node.ptr;
+		CollectVariableDeclarations(exprStmt->expr, variables);
+		break;
+	}
+	case Node_VariableDeclaration:
+	{
+		ArrayAdd(variables, &node.ptr);
+		VarDeclStmt* varDecl = node.ptr;
+		CollectVariableDeclarations(varDecl->initializer, variables);
+		break;
+	}
+	case Node_BlockStatement:
+	{
+		BlockStmt* block = node.ptr;
+		for (size_t i = 0; i < block->statements.length; ++i)
+			CollectVariableDeclarations(*(NodePtr*)block->statements.array[i], variables);
+		break;
+	}
+	case Node_If:
+	{
+		IfStmt* ifStmt = node.ptr;
+		CollectVariableDeclarations(ifStmt->expr, variables);
+		CollectVariableDeclarations(ifStmt->trueStmt, variables);
+		CollectVariableDeclarations(ifStmt->falseStmt, variables);
+		break;
+	}
+	case Node_While:
+	{
+		WhileStmt* whileStmt = node.ptr;
+		CollectVariableDeclarations(whileStmt->expr, variables);
+		CollectVariableDeclarations(whileStmt->stmt, variables);
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+bool CalleesUseAnyVariable(NodePtr node, const Array* declared)
+{
+	Map variables = AllocateMap(sizeof(bool));
+	for (size_t i = 0; i < declared->length; ++i)
+	{
+		char key[64];
+		snprintf(key, sizeof(key), "%p", *(void**)declared->array[i]);
+		MapAdd(&variables, key, &(bool){true});
+	}
+
+	Map visited = AllocateMap(sizeof(bool));
+	bool used = CalleesUseVariables(node, &variables, &visited, false);
+	FreeMap(&visited);
+	FreeMap(&variables);
+	return used;
+}
+
+bool FunctionVariablesUsedOutside(FuncDeclStmt* funcDecl)
+{
+	Array declared = AllocateArray(sizeof(VarDeclStmt*));
+	for (size_t i = 0; i < funcDecl->parameters.length; ++i)
+		ArrayAdd(&declared, &((NodePtr*)funcDecl->parameters.array[i])->ptr);
+	CollectVariableDeclarations(funcDecl->block, &declared);
+
+	bool used = CalleesUseAnyVariable(funcDecl->block, &declared);
+	FreeArray(&declared);
+	return used;
+}
+
+// checks if the function uses the variables of the other one,
+// like a nested function that uses the variables of the function it was declared in
+bool FunctionUsesVariablesOf(FuncDeclStmt* funcDecl, FuncDeclStmt* owner)
+{
+	Array declared = AllocateArray(sizeof(VarDeclStmt*));
+	for (size_t i = 0; i < owner->parameters.length; ++i)
+		ArrayAdd(&declared, &((NodePtr*)owner->parameters.array[i])->ptr);
+	CollectVariableDeclarations(owner->block, &declared);
+
+	Map variables = AllocateMap(sizeof(bool));
+	for (size_t i = 0; i < declared.length; ++i)
+	{
+		char key[64];
+		snprintf(key, sizeof(key), "%p", *(void**)declared.array[i]);
+		MapAdd(&variables, key, &(bool){true});
+	}
+	FreeArray(&declared);
+
+	Map visited = AllocateMap(sizeof(bool));
+	bool used = CalleesUseVariables(funcDecl->block, &variables, &visited, true);
+	FreeMap(&visited);
+	FreeMap(&variables);
+	return used;
+}
+
+void AddVariableMapping(Map* map, const VarDeclStmt* from, NodePtr to)
+{
+	char key[64];
+	snprintf(key, sizeof(key), "%p", (const void*)from);
+	bool success = MapAdd(map, key, &to);
+	ASSERT(success);
+}
+
+static void AddWrite(Map* writes, VarDeclStmt* varDecl)
+{
+	char key[64];
+	snprintf(key, sizeof(key), "%p", (void*)varDecl);
+	MapAdd(writes, key, &varDecl);
+}
+
+bool IsVariableWritten(const Map* writes, const VarDeclStmt* varDecl)
+{
+	char key[64];
+	snprintf(key, sizeof(key), "%p", (const void*)varDecl);
+	return MapGet(writes, key) != NULL;
+}
+
+static void CollectWrites(NodePtr node, Map* writes, bool* hasCalls, bool declarations)
+{
+	switch (node.type)
+	{
+	case Node_Binary:
+	{
+		BinaryExpr* binary = node.ptr;
+		if (binary->operatorType >= Binary_Assignment && binary->left.type == Node_MemberAccess)
+			AddWrite(writes, ((MemberAccessExpr*)binary->left.ptr)->varReference);
+		CollectWrites(binary->left, writes, hasCalls, declarations);
+		CollectWrites(binary->right, writes, hasCalls, declarations);
+		break;
+	}
+	case Node_Unary:
+	{
+		UnaryExpr* unary = node.ptr;
+		if ((unary->operatorType == Unary_Increment || unary->operatorType == Unary_Decrement) &&
+			unary->expression.type == Node_MemberAccess)
+			AddWrite(writes, ((MemberAccessExpr*)unary->expression.ptr)->varReference);
+		CollectWrites(unary->expression, writes, hasCalls, declarations);
+		break;
+	}
+	case Node_FunctionCall:
+	{
+		FuncCallExpr* funcCall = node.ptr;
+		FuncDeclStmt* funcDecl = GetFuncDecl(funcCall);
+		if (!funcDecl->modifiers.externalValue)
+			*hasCalls = true;
+
+		for (size_t i = 0; i < funcCall->arguments.length; ++i)
+		{
+			NodePtr* arg = funcCall->arguments.array[i];
+			// external functions can write to the variables that are passed in
+			if (funcDecl->modifiers.externalValue && arg->type == Node_MemberAccess)
+				AddWrite(writes, ((MemberAccessExpr*)arg->ptr)->varReference);
+			CollectWrites(*arg, writes, hasCalls, declarations);
+		}
+		break;
+	}
+	case Node_MemberAccess:
+	{
+		MemberAccessExpr* memberAccess = node.ptr;
+		CollectWrites(memberAccess->start, writes, hasCalls, declarations);
+		break;
+	}
+	case Node_Subscript:
+	{
+		SubscriptExpr* subscript = node.ptr;
+		CollectWrites(subscript->baseExpr, writes, hasCalls, declarations);
+		CollectWrites(subscript->indexExpr, writes, hasCalls, declarations);
+		break;
+	}
+	case Node_BlockExpression:
+	{
+		BlockExpr* blockExpr = node.ptr;
+		CollectWrites(blockExpr->block, writes, hasCalls, declarations);
+		break;
+	}
+	case Node_ExpressionStatement:
+	{
+		ExpressionStmt* exprStmt = node.ptr;
+		CollectWrites(exprStmt->expr, writes, hasCalls, declarations);
+		break;
+	}
+	case Node_VariableDeclaration:
+	{
+		VarDeclStmt* varDecl = node.ptr;
+		if (declarations)
+			AddWrite(writes, varDecl);
+		CollectWrites(varDecl->initializer, writes, hasCalls, declarations);
+		break;
+	}
+	case Node_FunctionDeclaration:
+	{
+		FuncDeclStmt* funcDecl = node.ptr;
+		CollectWrites(funcDecl->block, writes, hasCalls, declarations);
+		break;
+	}
+	case Node_Return:
+	{
+		ReturnStmt* returnStmt = node.ptr;
+		CollectWrites(returnStmt->expr, writes, hasCalls, declarations);
+		break;
+	}
+	case Node_BlockStatement:
+	{
+		BlockStmt* block = node.ptr;
+		for (size_t i = 0; i < block->statements.length; ++i)
+			CollectWrites(*(NodePtr*)block->statements.array[i], writes, hasCalls, declarations);
+		break;
+	}
+	case Node_If:
+	{
+		IfStmt* ifStmt = node.ptr;
+		CollectWrites(ifStmt->expr, writes, hasCalls, declarations);
+		CollectWrites(ifStmt->trueStmt, writes, hasCalls, declarations);
+		CollectWrites(ifStmt->falseStmt, writes, hasCalls, declarations);
+		break;
+	}
+	case Node_While:
+	{
+		WhileStmt* whileStmt = node.ptr;
+		CollectWrites(whileStmt->expr, writes, hasCalls, declarations);
+		CollectWrites(whileStmt->stmt, writes, hasCalls, declarations);
+		break;
+	}
+	case Node_Section:
+	{
+		SectionStmt* section = node.ptr;
+		CollectWrites(section->block, writes, hasCalls, declarations);
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+// collects the variables that are declared or assigned in the node, including in the functions declared in it.
+// calls to other functions could write anything, so they are only reported
+void CollectWrittenVariables(NodePtr node, Map* writes, bool* hasCalls)
+{
+	CollectWrites(node, writes, hasCalls, true);
+}
+
+// the same as CollectWrittenVariables, but a declaration doesn't count as a write
+void CollectAssignedVariables(NodePtr node, Map* writes)
+{
+	bool hasCalls = false;
+	CollectWrites(node, writes, &hasCalls, false);
+}
+
+// the pointer of a subscript has to stay a variable, other bases can be replaced with their value
+bool CanReplaceSubscriptBase(const SubscriptExpr* subscript)
+{
+	return subscript->baseExpr.type != Node_MemberAccess;
+}
+
+void RemoveFunctionDependency(FuncDeclStmt* funcDecl, FuncDeclStmt* dependency)
+{
+	for (size_t i = 0; i < funcDecl->dependencies.length; ++i)
+	{
+		NodePtr* node = funcDecl->dependencies.array[i];
+		if (node->ptr == dependency)
+		{
+			ArrayRemove(&funcDecl->dependencies, i);
+			return;
+		}
+	}
+}
+
+void AddFunctionDependency(FuncDeclStmt* funcDecl, FuncDeclStmt* dependency)
+{
+	if (!funcDecl->dependencies.array)
+		funcDecl->dependencies = AllocateArray(sizeof(NodePtr));
+
+	ArrayAdd(&funcDecl->dependencies, &(NodePtr){.ptr = dependency, .type = Node_FunctionDeclaration});
+}
+
+// points the copied body at the copied variables or the substituted arguments,
+// and counts the new function references
+static void RemapReferences(NodePtr* node, const Map* variables, FuncDeclStmt* caller)
+{
+	switch (node->type)
+	{
+	case Node_MemberAccess:
+	{
+		MemberAccessExpr* memberAccess = node->ptr;
+		if (memberAccess->varReference)
+		{
+			char key[64];
+			snprintf(key, sizeof(key), "%p", (void*)memberAccess->varReference);
+			NodePtr* new = MapGet(variables, key);
+			if (new && new->type == Node_VariableDeclaration)
+				memberAccess->varReference = new->ptr;
+			else if (new)
+			{
+				FreeASTNode(*node);
+				*node = CopyASTNode(*new);
+				break;
+			}
+		}
+		if (memberAccess->funcReference)
+		{
+			++memberAccess->funcReference->useCount;
+			if (caller)
+				AddFunctionDependency(caller, memberAccess->funcReference);
+		}
+		break;
+	}
+	case Node_Binary:
+	{
+		BinaryExpr* binary = node->ptr;
+		RemapReferences(&binary->left, variables, caller);
+		RemapReferences(&binary->right, variables, caller);
+		break;
+	}
+	case Node_Unary:
+	{
+		UnaryExpr* unary = node->ptr;
+		RemapReferences(&unary->expression, variables, caller);
+		break;
+	}
+	case Node_FunctionCall:
+	{
+		FuncCallExpr* funcCall = node->ptr;
+		RemapReferences(&funcCall->baseExpr, variables, caller);
+		for (size_t i = 0; i < funcCall->arguments.length; ++i)
+			RemapReferences(funcCall->arguments.array[i], variables, caller);
+		break;
+	}
+	case Node_Subscript:
+	{
+		SubscriptExpr* subscript = node->ptr;
+		RemapReferences(&subscript->baseExpr, variables, caller);
+		RemapReferences(&subscript->indexExpr, variables, caller);
+		break;
+	}
+	case Node_BlockExpression:
+	{
+		BlockExpr* blockExpr = node->ptr;
+		RemapReferences(&blockExpr->block, variables, caller);
+		break;
+	}
+	case Node_ExpressionStatement:
+	{
+		ExpressionStmt* exprStmt = node->ptr;
+		RemapReferences(&exprStmt->expr, variables, caller);
+		break;
+	}
+	case Node_VariableDeclaration:
+	{
+		VarDeclStmt* varDecl = node->ptr;
+		RemapReferences(&varDecl->initializer, variables, caller);
+		break;
+	}
+	case Node_BlockStatement:
+	{
+		BlockStmt* block = node->ptr;
+		for (size_t i = 0; i < block->statements.length; ++i)
+			RemapReferences(block->statements.array[i], variables, caller);
+		break;
+	}
+	case Node_If:
+	{
+		IfStmt* ifStmt = node->ptr;
+		RemapReferences(&ifStmt->expr, variables, caller);
+		RemapReferences(&ifStmt->trueStmt, variables, caller);
+		RemapReferences(&ifStmt->falseStmt, variables, caller);
+		break;
+	}
+	case Node_While:
+	{
+		WhileStmt* whileStmt = node->ptr;
+		RemapReferences(&whileStmt->expr, variables, caller);
+		RemapReferences(&whileStmt->stmt, variables, caller);
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+// copies a statement with its own variables.
+// the variables map can already map other variables to whatever replaces them
+NodePtr AllocStatementCopy(NodePtr node, Map* variables, FuncDeclStmt* caller)
+{
+	NodePtr body = CopyASTNode(node);
+
+	Array original = AllocateArray(sizeof(VarDeclStmt*));
+	Array copied = AllocateArray(sizeof(VarDeclStmt*));
+	CollectVariableDeclarations(node, &original);
+	CollectVariableDeclarations(body, &copied);
+	ASSERT(original.length == copied.length);
+	for (size_t i = 0; i < original.length; ++i)
+		AddVariableMapping(variables, *(VarDeclStmt**)original.array[i],
+			(NodePtr){.ptr = *(VarDeclStmt**)copied.array[i], .type = Node_VariableDeclaration});
+	FreeArray(&original);
+	FreeArray(&copied);
+
+	RemapReferences(&body, variables, caller);
+	return body;
+}
+
+// copies the body of a function with its own variables.
+// the variables map should already map the parameters to whatever replaces them
+NodePtr AllocFunctionBodyCopy(FuncDeclStmt* funcDecl, Map* variables, FuncDeclStmt* caller)
+{
+	return AllocStatementCopy(funcDecl->block, variables, caller);
+}
+
+// undoes the function reference counting for code that is about to be removed
+void RemoveFunctionReferences(NodePtr node, FuncDeclStmt* caller)
+{
+	switch (node.type)
+	{
+	case Node_MemberAccess:
+	{
+		MemberAccessExpr* memberAccess = node.ptr;
+		if (memberAccess->funcReference)
+		{
+			--memberAccess->funcReference->useCount;
+			if (caller)
+				RemoveFunctionDependency(caller, memberAccess->funcReference);
+		}
+		break;
+	}
+	case Node_Binary:
+	{
+		BinaryExpr* binary = node.ptr;
+		RemoveFunctionReferences(binary->left, caller);
+		RemoveFunctionReferences(binary->right, caller);
+		break;
+	}
+	case Node_Unary:
+	{
+		UnaryExpr* unary = node.ptr;
+		RemoveFunctionReferences(unary->expression, caller);
+		break;
+	}
+	case Node_FunctionCall:
+	{
+		FuncCallExpr* funcCall = node.ptr;
+		RemoveFunctionReferences(funcCall->baseExpr, caller);
+		for (size_t i = 0; i < funcCall->arguments.length; ++i)
+			RemoveFunctionReferences(*(NodePtr*)funcCall->arguments.array[i], caller);
+		break;
+	}
+	case Node_Subscript:
+	{
+		SubscriptExpr* subscript = node.ptr;
+		RemoveFunctionReferences(subscript->baseExpr, caller);
+		RemoveFunctionReferences(subscript->indexExpr, caller);
+		break;
+	}
+	case Node_BlockExpression:
+	{
+		BlockExpr* blockExpr = node.ptr;
+		RemoveFunctionReferences(blockExpr->block, caller);
+		break;
+	}
+	case Node_ExpressionStatement:
+	{
+		ExpressionStmt* exprStmt = node.ptr;
+		RemoveFunctionReferences(exprStmt->expr, caller);
+		break;
+	}
+	case Node_VariableDeclaration:
+	{
+		VarDeclStmt* varDecl = node.ptr;
+		RemoveFunctionReferences(varDecl->initializer, caller);
+		break;
+	}
+	case Node_BlockStatement:
+	{
+		BlockStmt* block = node.ptr;
+		for (size_t i = 0; i < block->statements.length; ++i)
+			RemoveFunctionReferences(*(NodePtr*)block->statements.array[i], caller);
+		break;
+	}
+	case Node_If:
+	{
+		IfStmt* ifStmt = node.ptr;
+		RemoveFunctionReferences(ifStmt->expr, caller);
+		RemoveFunctionReferences(ifStmt->trueStmt, caller);
+		RemoveFunctionReferences(ifStmt->falseStmt, caller);
+		break;
+	}
+	case Node_While:
+	{
+		WhileStmt* whileStmt = node.ptr;
+		RemoveFunctionReferences(whileStmt->expr, caller);
+		RemoveFunctionReferences(whileStmt->stmt, caller);
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+// runs a builtin jsfx function the same way eel2 does, returns false for other functions
+static bool CallBuiltIn(const char* name, const double* args, size_t argCount, double* value)
+{
+	if (argCount == 1)
+	{
+		double x = args[0];
+		if (strcmp(name, "sin") == 0) *value = sin(x);
+		else if (strcmp(name, "cos") == 0) *value = cos(x);
+		else if (strcmp(name, "tan") == 0) *value = tan(x);
+		else if (strcmp(name, "asin") == 0) *value = asin(x);
+		else if (strcmp(name, "acos") == 0) *value = acos(x);
+		else if (strcmp(name, "atan") == 0) *value = atan(x);
+		else if (strcmp(name, "sqr") == 0) *value = x * x;
+		else if (strcmp(name, "sqrt") == 0) *value = sqrt(fabs(x)); // eel2 uses the absolute value
+		else if (strcmp(name, "exp") == 0) *value = exp(x);
+		else if (strcmp(name, "log") == 0) *value = log(x);
+		else if (strcmp(name, "log10") == 0) *value = log10(x);
+		else if (strcmp(name, "abs") == 0) *value = fabs(x);
+		else if (strcmp(name, "sign") == 0) *value = x > 0 ? 1 : x < 0 ? -1 : 0;
+		else if (strcmp(name, "floor") == 0) *value = floor(x);
+		else if (strcmp(name, "ceil") == 0) *value = ceil(x);
+		else return false;
+		return true;
+	}
+	else if (argCount == 2)
+	{
+		double x = args[0], y = args[1];
+		if (strcmp(name, "atan2") == 0) *value = atan2(x, y);
+		else if (strcmp(name, "pow") == 0) *value = pow(x, y);
+		else if (strcmp(name, "min") == 0) *value = x < y ? x : y;
+		else if (strcmp(name, "max") == 0) *value = x > y ? x : y;
+		else return false;
+		return true;
+	}
+	return false;
+}
+
+bool IsEvaluableBuiltIn(const char* name, size_t argCount)
+{
+	double args[2] = {1, 1};
+	double value;
+	return argCount <= 2 && CallBuiltIn(name, args, argCount, &value);
+}
+
+bool EvaluateBuiltIn(const char* name, const double* args, size_t argCount, double* value)
+{
+	for (size_t i = 0; i < argCount; ++i)
+	{
+		// min(0, -0) could give either zero
+		if (i > 0 && args[i] == args[0] && signbit(args[i]) != signbit(args[0]))
+			return false;
+	}
+
+	// infinity and nan can't be written as a number
+	return CallBuiltIn(name, args, argCount, value) && isfinite(*value);
+}
+
+// evaluates expressions made of number literals and the variables in the constants map,
+// the same way jsfx would
+bool EvaluateConstant(NodePtr node, const Map* constants, double* value)
+{
+	switch (node.type)
+	{
+	case Node_Literal:
+	{
+		LiteralExpr* literal = node.ptr;
+		if (literal->type != Literal_Number)
+			return false;
+
+		char* end = NULL;
+		*value = strtod(literal->number, &end);
+		return end != literal->number && *end == '\0';
+	}
+	case Node_MemberAccess:
+	{
+		MemberAccessExpr* memberAccess = node.ptr;
+		if (!constants || !memberAccess->varReference)
+			return false;
+
+		char key[64];
+		snprintf(key, sizeof(key), "%p", (void*)memberAccess->varReference);
+		NodePtr* constant = MapGet(constants, key);
+		return constant && EvaluateConstant(*constant, NULL, value);
+	}
+	case Node_Unary:
+	{
+		UnaryExpr* unary = node.ptr;
+		double operand;
+		if (!EvaluateConstant(unary->expression, constants, &operand))
+			return false;
+
+		switch (unary->operatorType)
+		{
+		case Unary_Minus: *value = -operand; return true;
+		case Unary_Plus: *value = operand; return true;
+		case Unary_Negate: *value = fabs(operand) < JSFX_EPSILON; return true;
+		default: return false;
+		}
+	}
+	case Node_Binary:
+	{
+		BinaryExpr* binary = node.ptr;
+		double left, right;
+		if (!EvaluateConstant(binary->left, constants, &left) ||
+			!EvaluateConstant(binary->right, constants, &right))
+			return false;
+
+		switch (binary->operatorType)
+		{
+		case Binary_IsEqual: *value = fabs(left - right) < JSFX_EPSILON; return true;
+		case Binary_NotEqual: *value = fabs(left - right) >= JSFX_EPSILON; return true;
+		case Binary_GreaterThan: *value = left > right; return true;
+		case Binary_GreaterOrEqual: *value = left >= right; return true;
+		case Binary_LessThan: *value = left < right; return true;
+		case Binary_LessOrEqual: *value = left <= right; return true;
+		case Binary_BoolAnd: *value = fabs(left) >= JSFX_EPSILON && fabs(right) >= JSFX_EPSILON; return true;
+		case Binary_BoolOr: *value = fabs(left) >= JSFX_EPSILON || fabs(right) >= JSFX_EPSILON; return true;
+		case Binary_Add: *value = left + right; return true;
+		case Binary_Subtract: *value = left - right; return true;
+		case Binary_Multiply: *value = left * right; return true;
+		case Binary_Divide:
+		{
+			if (right == 0)
+				return false;
+			*value = left / right;
+			return true;
+		}
+		case Binary_BitOr:
+		case Binary_BitAnd:
+		{
+			// only fold the int conversions on whole numbers
+			if (fabs(left) > 1e15 || fabs(right) > 1e15)
+				return false;
+
+			int64_t a = (int64_t)left, b = (int64_t)right;
+			if ((double)a != left || (double)b != right)
+				return false;
+
+			*value = (double)(binary->operatorType == Binary_BitOr ? a | b : a & b);
+			return true;
+		}
+		default: return false;
+		}
+	}
+	case Node_FunctionCall:
+	{
+		FuncCallExpr* funcCall = node.ptr;
+		ASSERT(funcCall->baseExpr.type == Node_MemberAccess);
+		FuncDeclStmt* funcDecl = ((MemberAccessExpr*)funcCall->baseExpr.ptr)->funcReference;
+		ASSERT(funcDecl);
+		if (funcDecl->constEval != PropertyBoolean_True || funcCall->arguments.length > 2)
+			return false;
+
+		double args[2];
+		for (size_t i = 0; i < funcCall->arguments.length; ++i)
+		{
+			if (!EvaluateConstant(*(NodePtr*)funcCall->arguments.array[i], constants, &args[i]))
+				return false;
+		}
+		const char* name = funcDecl->externalName ? funcDecl->externalName : funcDecl->name;
+		return EvaluateBuiltIn(name, args, funcCall->arguments.length, value);
+	}
+	default:
+		return false;
+	}
+}
+
+bool EvaluateCondition(NodePtr expr, const Map* constants, bool* result)
+{
+	double value;
+	if (!EvaluateConstant(expr, constants, &value))
+		return false;
+
+	*result = fabs(value) >= JSFX_EPSILON;
+	return true;
+}
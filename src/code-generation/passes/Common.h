@@ -1,11 +1,15 @@
 #pragma once
 
 #include "SyntaxTree.h"
+#include "data-structures/Map.h"
 
 #define ARRAY_STRUCT_MEMBER_COUNT 2
 #define ARRAY_STRUCT_PTR_MEMBER_INDEX 0
 #define ARRAY_STRUCT_LENGTH_MEMBER_INDEX 1
 
+// numbers closer than this are equal in jsfx
+#define JSFX_EPSILON 0.00001
+
 typedef struct
 {
 	StructDeclStmt* effectiveType;
@@ -32,10 +36,36 @@ VarDeclStmt* GetPtrMember(StructDeclStmt* type);
 NodePtr AllocIdentifier(VarDeclStmt* varDecl, int lineNumber);
 NodePtr AllocSetVariable(VarDeclStmt* varDecl, NodePtr value, int lineNumber);
 NodePtr AllocAssignmentStatement(NodePtr left, NodePtr right, int lineNumber);
+void HoistAssignmentTarget(NodePtr* node, BlockStmt* block, int lineNumber);
 NodePtr AllocIntConversion(NodePtr expr, int lineNumber);
 NodePtr AllocPrimitiveType(PrimitiveType primitiveType, int lineNumber);
 
 NodePtr AllocUInt64Integer(uint64_t value, int lineNumber);
 NodePtr AllocSizeInteger(size_t value, int lineNumber);
 NodePtr AllocNumber(char* value, int lineNumber);
+NodePtr AllocDouble(double value, int lineNumber);
 NodePtr AllocStringLiteral(char* value, int lineNumber);
+
+bool IsRecursiveFunction(FuncDeclStmt* funcDecl);
+bool CanCallFunction(FuncDeclStmt* funcDecl, FuncDeclStmt* target);
+uint64_t CountStructSlots(StructDeclStmt* type);
+int CountNodes(NodePtr node);
+bool ContainsFunctionDeclaration(NodePtr node);
+bool CalleesUseAnyVariable(NodePtr node, const Array* variables);
+bool FunctionVariablesUsedOutside(FuncDeclStmt* funcDecl);
+bool FunctionUsesVariablesOf(FuncDeclStmt* funcDecl, FuncDeclStmt* owner);
+void CollectVariableDeclarations(NodePtr node, Array* variables);
+void CollectWrittenVariables(NodePtr node, Map* writes, bool* hasCalls);
+void CollectAssignedVariables(NodePtr node, Map* writes);
+bool CanReplaceSubscriptBase(const SubscriptExpr* subscript);
+bool IsVariableWritten(const Map* writes, const VarDeclStmt* varDecl);
+void AddFunctionDependency(FuncDeclStmt* funcDecl, FuncDeclStmt* dependency);
+void RemoveFunctionDependency(FuncDeclStmt* funcDecl, FuncDeclStmt* dependency);
+void AddVariableMapping(Map* map, const VarDeclStmt* from, NodePtr to);
+NodePtr AllocStatementCopy(NodePtr node, Map* variables, FuncDeclStmt* caller);
+NodePtr AllocFunctionBodyCopy(FuncDeclStmt* funcDecl, Map* variables, FuncDeclStmt* caller);
+void RemoveFunctionReferences(NodePtr node, FuncDeclStmt* caller);
+bool IsEvaluableBuiltIn(const char* name, size_t argCount);
+bool EvaluateBuiltIn(const char* name, const double* args, size_t argCount, double* value);
+bool EvaluateConstant(NodePtr node, const Map* constants, double* value);
+bool EvaluateCondition(NodePtr expr, const Map* constants, bool* result);
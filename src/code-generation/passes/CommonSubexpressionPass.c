@@ -0,0 +1,967 @@
+#include "CommonSubexpressionPass.h"
+
+#include "Common.h"
+#include "StringUtils.h"
+#include "data-structures/Map.h"
+
+#include <string.h>
+
+// local value numbering.
+// every pure expression in a statement list gets a value number, two expressions
+// with the same value number always evaluate to the same thing.
+// if a value number shows up more than once, it is computed once into a temporary
+// before the statement of its first occurrence and every occurrence reads the temporary.
+// if and while statements are not entered, they only invalidate the values they might change.
+// their blocks are optimized separately as their own statement lists
+
+typedef struct
+{
+	NodePtr* node;
+	size_t statementIndex;
+	int valueNumber;
+	int size;
+	bool clean;
+} Occurrence;
+
+typedef struct
+{
+	VarDeclStmt* variable;
+	int version;
+} Holder;
+
+typedef struct
+{
+	Map writes;
+	bool writesMemory;
+	bool writesExternal;
+	bool writesEverything;
+	bool done;
+} FunctionEffects;
+
+static Map functionEffects;
+
+static Map valueNumbers;
+static Map versions;
+static Map holders;
+static int valueNumberCounter;
+static int memoryVersion;
+static int externalVersion;
+static int globalVersion;
+static int changeCount;
+
+static Array occurrences;
+static size_t currentStatementIndex;
+
+// what the current statement has written so far, used to tell if
+// an occurrence can be moved to before the statement
+static Map statementWrites;
+static bool statementWritesMemory;
+static bool statementWritesExternal;
+static bool statementWritesEverything;
+
+static void VisitStatement(NodePtr* node);
+static void NumberStatement(NodePtr* node, bool record);
+static void CollectEffectsStatement(NodePtr node, FunctionEffects* effects);
+
+static bool IsExternalVariable(const VarDeclStmt* varDecl)
+{
+	return varDecl->modifiers.externalValue || varDecl->inputStmt;
+}
+
+static void PointerKey(char* key, const size_t size, const void* ptr)
+{
+	snprintf(key, size, "%p", ptr);
+}
+
+static void AddEffectsWrite(FunctionEffects* effects, VarDeclStmt* varDecl)
+{
+	char key[64];
+	PointerKey(key, sizeof(key), varDecl);
+	MapAdd(&effects->writes, key, &varDecl);
+}
+
+static void MergeEffects(FunctionEffects* effects, const FunctionEffects* other)
+{
+	for (MAP_ITERATE(i, &other->writes))
+		MapAdd(&effects->writes, i->key, i->value);
+	effects->writesMemory |= other->writesMemory;
+	effects->writesExternal |= other->writesExternal;
+	effects->writesEverything |= other->writesEverything;
+}
+
+static FunctionEffects* GetFunctionEffects(FuncDeclStmt* funcDecl)
+{
+	char key[64];
+	PointerKey(key, sizeof(key), funcDecl);
+	FunctionEffects* effects = MapGet(&functionEffects, key);
+	if (effects)
+		return effects;
+
+	bool success = MapAdd(&functionEffects, key,
+		&(FunctionEffects){
+			.writes = AllocateMap(sizeof(VarDeclStmt*)),
+			.writesMemory = false,
+			.writesExternal = false,
+			.writesEverything = false,
+			.done = false,
+		});
+	ASSERT(success);
+	effects = MapGet(&functionEffects, key);
+
+	for (size_t i = 0; i < funcDecl->parameters.length; ++i)
+	{
+		const NodePtr* node = funcDecl->parameters.array[i];
+		ASSERT(node->type == Node_VariableDeclaration);
+		AddEffectsWrite(effects, node->ptr);
+	}
+	CollectEffectsStatement(funcDecl->block, effects);
+
+	effects->done = true;
+	return effects;
+}
+
+static void CollectEffectsExpression(const NodePtr node, FunctionEffects* effects)
+{
+	switch (node.type)
+	{
+	case Node_Literal:
+	case Node_MemberAccess:
+	case Node_Null:
+		break;
+	case Node_Binary:
+	{
+		BinaryExpr* binary = node.ptr;
+		if (binary->operatorType >= Binary_Assignment)
+		{
+			if (binary->left.type == Node_MemberAccess)
+			{
+				MemberAccessExpr* memberAccess = binary->left.ptr;
+				ASSERT(memberAccess->varReference);
+				AddEffectsWrite(effects, memberAccess->varReference);
+			}
+			else if (binary->left.type == Node_Subscript)
+				effects->writesMemory = true;
+			else
+				effects->writesExternal = true;
+		}
+		CollectEffectsExpression(binary->left, effects);
+		CollectEffectsExpression(binary->right, effects);
+		break;
+	}
+	case Node_Unary:
+	{
+		UnaryExpr* unary = node.ptr;
+		if (unary->operatorType == Unary_Increment || unary->operatorType == Unary_Decrement)
+		{
+			if (unary->expression.type == Node_MemberAccess)
+				AddEffectsWrite(effects, ((MemberAccessExpr*)unary->expression.ptr)->varReference);
+			else
+				effects->writesMemory = true;
+		}
+		CollectEffectsExpression(unary->expression, effects);
+		break;
+	}
+	case Node_FunctionCall:
+	{
+		FuncCallExpr* funcCall = node.ptr;
+		ASSERT(funcCall->baseExpr.type == Node_MemberAccess);
+		FuncDeclStmt* funcDecl = ((MemberAccessExpr*)funcCall->baseExpr.ptr)->funcReference;
+		ASSERT(funcDecl);
+
+		for (size_t i = 0; i < funcCall->arguments.length; ++i)
+		{
+			const NodePtr* arg = funcCall->arguments.array[i];
+			CollectEffectsExpression(*arg, effects);
+			if (funcDecl->modifiers.externalValue && funcDecl->pure != PropertyBoolean_True && arg->type == Node_MemberAccess)
+				AddEffectsWrite(effects, ((MemberAccessExpr*)arg->ptr)->varReference);
+		}
+
+		// pure external functions don't change anything
+		if (funcDecl->modifiers.externalValue && funcDecl->pure == PropertyBoolean_True)
+			break;
+		if (funcDecl->modifiers.externalValue)
+		{
+			effects->writesMemory = true;
+			effects->writesExternal = true;
+			break;
+		}
+
+		FunctionEffects* callee = GetFunctionEffects(funcDecl);
+		if (!callee->done)
+			effects->writesEverything = true;
+		else
+			MergeEffects(effects, callee);
+		break;
+	}
+	case Node_Subscript:
+	{
+		SubscriptExpr* subscript = node.ptr;
+		CollectEffectsExpression(subscript->baseExpr, effects);
+		CollectEffectsExpression(subscript->indexExpr, effects);
+		break;
+	}
+	case Node_BlockExpression:
+	{
+		BlockExpr* blockExpr = node.ptr;
+		CollectEffectsStatement(blockExpr->block, effects);
+		break;
+	}
+	default: INVALID_VALUE(node.type);
+	}
+}
+
+static void CollectEffectsStatement(const NodePtr node, FunctionEffects* effects)
+{
+	switch (node.type)
+	{
+	case Node_Import:
+	case Node_StructDeclaration:
+	case Node_FunctionDeclaration:
+	case Node_Null:
+		break;
+	case Node_ExpressionStatement:
+	{
+		ExpressionStmt* exprStmt = node.ptr;
+		CollectEffectsExpression(exprStmt->expr, effects);
+		break;
+	}
+	case Node_VariableDeclaration:
+	{
+		VarDeclStmt* varDecl = node.ptr;
+		CollectEffectsExpression(varDecl->initializer, effects);
+		AddEffectsWrite(effects, varDecl);
+		break;
+	}
+	case Node_Input:
+	{
+		InputStmt* input = node.ptr;
+		CollectEffectsStatement(input->varDecl, effects);
+		break;
+	}
+	case Node_BlockStatement:
+	{
+		BlockStmt* block = node.ptr;
+		for (size_t i = 0; i < block->statements.length; ++i)
+			CollectEffectsStatement(*(NodePtr*)block->statements.array[i], effects);
+		break;
+	}
+	case Node_If:
+	{
+		IfStmt* ifStmt = node.ptr;
+		CollectEffectsExpression(ifStmt->expr, effects);
+		CollectEffectsStatement(ifStmt->trueStmt, effects);
+		CollectEffectsStatement(ifStmt->falseStmt, effects);
+		break;
+	}
+	case Node_While:
+	{
+		WhileStmt* whileStmt = node.ptr;
+		CollectEffectsExpression(whileStmt->expr, effects);
+		CollectEffectsStatement(whileStmt->stmt, effects);
+		break;
+	}
+	default: INVALID_VALUE(node.type);
+	}
+}
+
+static int GetVersion(const VarDeclStmt* varDecl)
+{
+	char key[64];
+	PointerKey(key, sizeof(key), varDecl);
+	int* version = MapGet(&versions, key);
+	return version ? *version : 0;
+}
+
+static void WriteVariable(VarDeclStmt* varDecl)
+{
+	char key[64];
+	PointerKey(key, sizeof(key), varDecl);
+	int* version = MapGet(&versions, key);
+	if (version)
+		++*version;
+	else
+		MapAdd(&versions, key, &(int){1});
+
+	MapAdd(&statementWrites, key, &varDecl);
+}
+
+static void WriteMemory(void)
+{
+	++memoryVersion;
+	statementWritesMemory = true;
+}
+
+static void WriteExternal(void)
+{
+	++externalVersion;
+	statementWritesExternal = true;
+}
+
+static void WriteEverything(void)
+{
+	++globalVersion;
+	++memoryVersion;
+	++externalVersion;
+	statementWritesEverything = true;
+
+	FreeMap(&holders);
+	holders = AllocateMap(sizeof(Holder));
+}
+
+static void ApplyCallEffects(FuncDeclStmt* funcDecl)
+{
+	if (funcDecl->modifiers.externalValue && funcDecl->pure == PropertyBoolean_True)
+		return;
+	if (funcDecl->modifiers.externalValue)
+	{
+		WriteMemory();
+		WriteExternal();
+		return;
+	}
+
+	const FunctionEffects* effects = GetFunctionEffects(funcDecl);
+	if (!effects->done || effects->writesEverything)
+	{
+		WriteEverything();
+		return;
+	}
+
+	for (MAP_ITERATE(i, &effects->writes))
+		WriteVariable(*(VarDeclStmt**)i->value);
+	if (effects->writesMemory)
+		WriteMemory();
+	if (effects->writesExternal)
+		WriteExternal();
+}
+
+static int GetValueNumber(const char* key)
+{
+	int* valueNumber = MapGet(&valueNumbers, key);
+	if (valueNumber)
+		return *valueNumber;
+
+	int new = ++valueNumberCounter;
+	bool success = MapAdd(&valueNumbers, key, &new);
+	ASSERT(success);
+	return new;
+}
+
+static bool IsCommutative(const BinaryOperator operator)
+{
+	switch (operator)
+	{
+	case Binary_Add:
+	case Binary_Multiply:
+	case Binary_IsEqual:
+	case Binary_NotEqual:
+	case Binary_BitAnd:
+	case Binary_BitOr:
+	case Binary_XOR:
+		return true;
+	default:
+		return false;
+	}
+}
+
+// checks if the expression reads something that was already written in the current statement
+static bool ReadsStatementWrites(const NodePtr node)
+{
+	switch (node.type)
+	{
+	case Node_Literal:
+		return false;
+	case Node_MemberAccess:
+	{
+		const MemberAccessExpr* memberAccess = node.ptr;
+		if (statementWritesEverything)
+			return true;
+		if (statementWritesExternal && IsExternalVariable(memberAccess->varReference))
+			return true;
+
+		char key[64];
+		PointerKey(key, sizeof(key), memberAccess->varReference);
+		return MapGet(&statementWrites, key) != NULL;
+	}
+	case Node_Binary:
+	{
+		const BinaryExpr* binary = node.ptr;
+		return ReadsStatementWrites(binary->left) || ReadsStatementWrites(binary->right);
+	}
+	case Node_Unary:
+	{
+		const UnaryExpr* unary = node.ptr;
+		return ReadsStatementWrites(unary->expression);
+	}
+	case Node_Subscript:
+	{
+		const SubscriptExpr* subscript = node.ptr;
+		return statementWritesMemory || statementWritesEverything ||
+			   ReadsStatementWrites(subscript->baseExpr) ||
+			   ReadsStatementWrites(subscript->indexExpr);
+	}
+	default: INVALID_VALUE(node.type);
+	}
+}
+
+static void TruncateOccurrences(const size_t length)
+{
+	while (occurrences.length > length)
+		ArrayRemove(&occurrences, occurrences.length - 1);
+}
+
+static bool TryReplaceWithHolder(NodePtr* node, const int valueNumber)
+{
+	char key[64];
+	snprintf(key, sizeof(key), "%d", valueNumber);
+	const Holder* holder = MapGet(&holders, key);
+	if (!holder || GetVersion(holder->variable) != holder->version)
+		return false;
+
+	int lineNumber = node->type == Node_Binary ? ((BinaryExpr*)node->ptr)->lineNumber : -1;
+	FreeASTNode(*node);
+	*node = AllocIdentifier(holder->variable, lineNumber);
+	++changeCount;
+	return true;
+}
+
+typedef struct
+{
+	int valueNumber;
+	int size;
+	bool hasOperation;
+	bool hasVariable;
+} ValueInfo;
+
+static ValueInfo NumberExpression(NodePtr* node, bool record);
+
+static ValueInfo NumberExpressionInternal(NodePtr* node, const bool record)
+{
+	char key[128];
+	switch (node->type)
+	{
+	case Node_Null:
+		return (ValueInfo){.valueNumber = -1};
+	case Node_Literal:
+	{
+		const LiteralExpr* literal = node->ptr;
+		int length;
+		switch (literal->type)
+		{
+		case Literal_Number: length = snprintf(key, sizeof(key), "n%s", literal->number); break;
+		case Literal_Char: length = snprintf(key, sizeof(key), "c%s", literal->multiChar); break;
+		default: return (ValueInfo){.valueNumber = -1, .size = 1};
+		}
+		if (length >= (int)sizeof(key))
+			return (ValueInfo){.valueNumber = -1, .size = 1};
+		return (ValueInfo){.valueNumber = GetValueNumber(key), .size = 1};
+	}
+	case Node_MemberAccess:
+	{
+		const MemberAccessExpr* memberAccess = node->ptr;
+		VarDeclStmt* varDecl = memberAccess->varReference;
+		if (!varDecl)
+			return (ValueInfo){.valueNumber = -1, .size = 1};
+
+		snprintf(key, sizeof(key), "v%p.%d.%d.%d",
+			(void*)varDecl,
+			GetVersion(varDecl),
+			IsExternalVariable(varDecl) ? externalVersion : 0,
+			globalVersion);
+		return (ValueInfo){.valueNumber = GetValueNumber(key), .size = 1, .hasVariable = true};
+	}
+	case Node_Binary:
+	{
+		BinaryExpr* binary = node->ptr;
+		if (binary->operatorType >= Binary_Assignment)
+		{
+			if (binary->left.type == Node_MemberAccess)
+			{
+				NumberExpression(&binary->right, record);
+				ASSERT(((MemberAccessExpr*)binary->left.ptr)->varReference);
+				WriteVariable(((MemberAccessExpr*)binary->left.ptr)->varReference);
+			}
+			else if (binary->left.type == Node_Subscript)
+			{
+				SubscriptExpr* subscript = binary->left.ptr;
+				NumberExpression(&subscript->baseExpr, record);
+				NumberExpression(&subscript->indexExpr, record);
+				NumberExpression(&binary->right, record);
+				WriteMemory();
+			}
+			else
+			{
+				NumberExpression(&binary->left, record);
+				NumberExpression(&binary->right, record);
+				WriteExternal();
+			}
+			return (ValueInfo){.valueNumber = -1};
+		}
+
+		ValueInfo left = NumberExpression(&binary->left, record);
+		ValueInfo right = NumberExpression(&binary->right, record);
+		ValueInfo info = {
+			.valueNumber = -1,
+			.size = left.size + right.size + 1,
+			.hasOperation = true,
+			.hasVariable = left.hasVariable || right.hasVariable,
+		};
+		if (left.valueNumber == -1 || right.valueNumber == -1)
+			return info;
+
+		int first = left.valueNumber, second = right.valueNumber;
+		if (IsCommutative(binary->operatorType) && first > second)
+		{
+			first = right.valueNumber;
+			second = left.valueNumber;
+		}
+		snprintf(key, sizeof(key), "b%d.%d.%d", binary->operatorType, first, second);
+		info.valueNumber = GetValueNumber(key);
+		return info;
+	}
+	case Node_Unary:
+	{
+		UnaryExpr* unary = node->ptr;
+		ValueInfo operand = NumberExpression(&unary->expression, record);
+		if (unary->operatorType == Unary_Increment || unary->operatorType == Unary_Decrement)
+		{
+			if (unary->expression.type == Node_MemberAccess)
+				WriteVariable(((MemberAccessExpr*)unary->expression.ptr)->varReference);
+			else
+				WriteMemory();
+			return (ValueInfo){.valueNumber = -1};
+		}
+		if (unary->operatorType == Unary_Dereference)
+			return (ValueInfo){.valueNumber = -1};
+
+		ValueInfo info = operand;
+		info.size += 1;
+		if (operand.valueNumber == -1)
+			return info;
+
+		snprintf(key, sizeof(key), "u%d.%d", unary->operatorType, operand.valueNumber);
+		info.valueNumber = GetValueNumber(key);
+		return info;
+	}
+	case Node_Subscript:
+	{
+		SubscriptExpr* subscript = node->ptr;
+		ValueInfo base = NumberExpression(&subscript->baseExpr, record);
+		ValueInfo index = NumberExpression(&subscript->indexExpr, record);
+		ValueInfo info = {
+			.valueNumber = -1,
+			.size = base.size + index.size + 1,
+			.hasOperation = true,
+			.hasVariable = true,
+		};
+		if (base.valueNumber == -1 || index.valueNumber == -1)
+			return info;
+
+		snprintf(key, sizeof(key), "s%d.%d.%d.%d", base.valueNumber, index.valueNumber, memoryVersion, globalVersion);
+		info.valueNumber = GetValueNumber(key);
+		return info;
+	}
+	case Node_FunctionCall:
+	{
+		FuncCallExpr* funcCall = node->ptr;
+		ASSERT(funcCall->baseExpr.type == Node_MemberAccess);
+		FuncDeclStmt* funcDecl = ((MemberAccessExpr*)funcCall->baseExpr.ptr)->funcReference;
+		ASSERT(funcDecl);
+
+		for (size_t i = 0; i < funcCall->arguments.length; ++i)
+			NumberExpression(funcCall->arguments.array[i], record);
+
+		ApplyCallEffects(funcDecl);
+		if (funcDecl->modifiers.externalValue && funcDecl->pure != PropertyBoolean_True)
+		{
+			for (size_t i = 0; i < funcCall->arguments.length; ++i)
+			{
+				const NodePtr* arg = funcCall->arguments.array[i];
+				if (arg->type == Node_MemberAccess)
+					WriteVariable(((MemberAccessExpr*)arg->ptr)->varReference);
+			}
+		}
+		return (ValueInfo){.valueNumber = -1};
+	}
+	case Node_BlockExpression:
+	{
+		BlockExpr* blockExpr = node->ptr;
+		NumberStatement(&blockExpr->block, false);
+		return (ValueInfo){.valueNumber = -1};
+	}
+	default: INVALID_VALUE(node->type);
+	}
+}
+
+static ValueInfo NumberExpression(NodePtr* node, const bool record)
+{
+	size_t occurrencesStart = occurrences.length;
+	ValueInfo info = NumberExpressionInternal(node, record);
+
+	if (!record || info.valueNumber == -1 || !info.hasOperation || !info.hasVariable)
+		return info;
+
+	if (TryReplaceWithHolder(node, info.valueNumber))
+	{
+		TruncateOccurrences(occurrencesStart);
+		return info;
+	}
+
+	ArrayAdd(&occurrences,
+		&(Occurrence){
+			.node = node,
+			.statementIndex = currentStatementIndex,
+			.valueNumber = info.valueNumber,
+			.size = info.size,
+			.clean = !ReadsStatementWrites(*node),
+		});
+	return info;
+}
+
+static void BeginStatement(void)
+{
+	FreeMap(&statementWrites);
+	statementWrites = AllocateMap(sizeof(VarDeclStmt*));
+	statementWritesMemory = false;
+	statementWritesExternal = false;
+	statementWritesEverything = false;
+}
+
+static void AddHolder(VarDeclStmt* varDecl, const int valueNumber)
+{
+	if (valueNumber == -1 || IsExternalVariable(varDecl))
+		return;
+
+	char key[64];
+	snprintf(key, sizeof(key), "%d", valueNumber);
+	Holder holder = {.variable = varDecl, .version = GetVersion(varDecl)};
+	Holder* existing = MapGet(&holders, key);
+	if (existing)
+		*existing = holder;
+	else
+		MapAdd(&holders, key, &holder);
+}
+
+// numbers a statement of the list that is being optimized.
+// nested statements only invalidate values
+static void NumberStatement(NodePtr* node, const bool record)
+{
+	switch (node->type)
+	{
+	case Node_Import:
+	case Node_StructDeclaration:
+	case Node_FunctionDeclaration:
+	case Node_Null:
+		break;
+	case Node_ExpressionStatement:
+	{
+		ExpressionStmt* exprStmt = node->ptr;
+		if (exprStmt->expr.type == Node_Binary &&
+			((BinaryExpr*)exprStmt->expr.ptr)->operatorType == Binary_Assignment &&
+			((BinaryExpr*)exprStmt->expr.ptr)->left.type == Node_MemberAccess)
+		{
+			BinaryExpr* binary = exprStmt->expr.ptr;
+			ValueInfo right = NumberExpression(&binary->right, record);
+
+			MemberAccessExpr* left = binary->left.ptr;
+			ASSERT(left->varReference);
+			WriteVariable(left->varReference);
+			if (record && right.hasOperation && right.hasVariable)
+				AddHolder(left->varReference, right.valueNumber);
+		}
+		else
+			NumberExpression(&exprStmt->expr, record);
+		break;
+	}
+	case Node_VariableDeclaration:
+	{
+		VarDeclStmt* varDecl = node->ptr;
+		if (varDecl->modifiers.externalValue)
+			break;
+
+		ValueInfo right = NumberExpression(&varDecl->initializer, record);
+		WriteVariable(varDecl);
+		if (record && right.hasOperation && right.hasVariable)
+			AddHolder(varDecl, right.valueNumber);
+		break;
+	}
+	case Node_Input:
+	{
+		InputStmt* input = node->ptr;
+		NumberStatement(&input->varDecl, false);
+		break;
+	}
+	case Node_BlockStatement:
+	{
+		BlockStmt* block = node->ptr;
+		for (size_t i = 0; i < block->statements.length; ++i)
+			NumberStatement(block->statements.array[i], false);
+		break;
+	}
+	case Node_If:
+	{
+		IfStmt* ifStmt = node->ptr;
+		NumberExpression(&ifStmt->expr, record);
+		NumberStatement(&ifStmt->trueStmt, false);
+		NumberStatement(&ifStmt->falseStmt, false);
+		break;
+	}
+	case Node_While:
+	{
+		WhileStmt* whileStmt = node->ptr;
+		NumberExpression(&whileStmt->expr, false);
+		NumberStatement(&whileStmt->stmt, false);
+		break;
+	}
+	default: INVALID_VALUE(node->type);
+	}
+}
+
+static void NumberStatementList(BlockStmt* block)
+{
+	valueNumbers = AllocateMap(sizeof(int));
+	versions = AllocateMap(sizeof(int));
+	holders = AllocateMap(sizeof(Holder));
+	statementWrites = AllocateMap(sizeof(VarDeclStmt*));
+	valueNumberCounter = 0;
+	memoryVersion = 0;
+	externalVersion = 0;
+	globalVersion = 0;
+
+	for (size_t i = 0; i < block->statements.length; ++i)
+	{
+		currentStatementIndex = i;
+		BeginStatement();
+		NumberStatement(block->statements.array[i], true);
+	}
+
+	FreeMap(&valueNumbers);
+	FreeMap(&versions);
+	FreeMap(&holders);
+	FreeMap(&statementWrites);
+}
+
+static NodePtr AllocTemporary(NodePtr initializer, const int lineNumber)
+{
+	return AllocASTNode(
+		&(VarDeclStmt){
+			.lineNumber = lineNumber,
+			.name = AllocateString("cse"),
+			.instantiatedVariables = AllocateArray(sizeof(VarDeclStmt*)),
+			.uniqueName = -1,
+			.type.modifier = TypeModifier_None,
+			.type.expr = AllocPrimitiveType(Primitive_Float, lineNumber),
+			.initializer = initializer,
+		},
+		sizeof(VarDeclStmt), Node_VariableDeclaration);
+}
+
+// finds the biggest expression that is computed more than once and moves it into a temporary
+static bool EliminateOne(BlockStmt* block, const int lineNumber)
+{
+	const Occurrence* best = NULL;
+	size_t bestIndex = 0;
+	for (size_t i = 0; i < occurrences.length; ++i)
+	{
+		const Occurrence* occurrence = occurrences.array[i];
+		if (!occurrence->clean)
+			continue;
+		if (best && occurrence->size <= best->size)
+			continue;
+
+		bool isFirst = true;
+		for (size_t j = 0; j < i; ++j)
+		{
+			const Occurrence* other = occurrences.array[j];
+			if (other->valueNumber == occurrence->valueNumber && other->clean)
+			{
+				isFirst = false;
+				break;
+			}
+		}
+		if (!isFirst)
+			continue;
+
+		for (size_t j = i + 1; j < occurrences.length; ++j)
+		{
+			const Occurrence* other = occurrences.array[j];
+			if (other->valueNumber == occurrence->valueNumber)
+			{
+				best = occurrence;
+				bestIndex = i;
+				break;
+			}
+		}
+	}
+
+	if (!best)
+		return false;
+
+	NodePtr temporary = AllocTemporary(*best->node, lineNumber);
+	VarDeclStmt* varDecl = temporary.ptr;
+	*best->node = AllocIdentifier(varDecl, lineNumber);
+	++changeCount;
+
+	for (size_t i = bestIndex + 1; i < occurrences.length; ++i)
+	{
+		const Occurrence* other = occurrences.array[i];
+		if (other->valueNumber != best->valueNumber)
+			continue;
+
+		FreeASTNode(*other->node);
+		*other->node = AllocIdentifier(varDecl, lineNumber);
+		++changeCount;
+	}
+
+	ArrayInsert(&block->statements, &temporary, best->statementIndex);
+	return true;
+}
+
+static void OptimizeStatementList(BlockStmt* block)
+{
+	while (true)
+	{
+		occurrences = AllocateArray(sizeof(Occurrence));
+		NumberStatementList(block);
+		bool changed = EliminateOne(block, block->lineNumber);
+		FreeArray(&occurrences);
+
+		if (!changed)
+			break;
+	}
+}
+
+static void VisitExpression(NodePtr* node)
+{
+	switch (node->type)
+	{
+	case Node_Literal:
+	case Node_MemberAccess:
+	case Node_Null:
+		break;
+	case Node_Binary:
+	{
+		BinaryExpr* binary = node->ptr;
+		VisitExpression(&binary->left);
+		VisitExpression(&binary->right);
+		break;
+	}
+	case Node_Unary:
+	{
+		UnaryExpr* unary = node->ptr;
+		VisitExpression(&unary->expression);
+		break;
+	}
+	case Node_FunctionCall:
+	{
+		FuncCallExpr* funcCall = node->ptr;
+		for (size_t i = 0; i < funcCall->arguments.length; ++i)
+			VisitExpression(funcCall->arguments.array[i]);
+		break;
+	}
+	case Node_Subscript:
+	{
+		SubscriptExpr* subscript = node->ptr;
+		VisitExpression(&subscript->baseExpr);
+		VisitExpression(&subscript->indexExpr);
+		break;
+	}
+	case Node_BlockExpression:
+	{
+		BlockExpr* blockExpr = node->ptr;
+		VisitStatement(&blockExpr->block);
+		break;
+	}
+	default: INVALID_VALUE(node->type);
+	}
+}
+
+static void VisitStatement(NodePtr* node)
+{
+	switch (node->type)
+	{
+	case Node_Import:
+	case Node_StructDeclaration:
+	case Node_Null:
+		break;
+	case Node_ExpressionStatement:
+	{
+		ExpressionStmt* exprStmt = node->ptr;
+		VisitExpression(&exprStmt->expr);
+		break;
+	}
+	case Node_VariableDeclaration:
+	{
+		VarDeclStmt* varDecl = node->ptr;
+		VisitExpression(&varDecl->initializer);
+		break;
+	}
+	case Node_FunctionDeclaration:
+	{
+		FuncDeclStmt* funcDecl = node->ptr;
+		if (!funcDecl->modifiers.externalValue)
+			VisitStatement(&funcDecl->block);
+		break;
+	}
+	case Node_Input:
+	{
+		InputStmt* input = node->ptr;
+		VisitStatement(&input->varDecl);
+		break;
+	}
+	case Node_BlockStatement:
+	{
+		BlockStmt* block = node->ptr;
+		OptimizeStatementList(block);
+		for (size_t i = 0; i < block->statements.length; ++i)
+			VisitStatement(block->statements.array[i]);
+		break;
+	}
+	case Node_If:
+	{
+		IfStmt* ifStmt = node->ptr;
+		VisitExpression(&ifStmt->expr);
+		VisitStatement(&ifStmt->trueStmt);
+		VisitStatement(&ifStmt->falseStmt);
+		break;
+	}
+	case Node_While:
+	{
+		WhileStmt* whileStmt = node->ptr;
+		VisitExpression(&whileStmt->expr);
+		VisitStatement(&whileStmt->stmt);
+		break;
+	}
+	default: INVALID_VALUE(node->type);
+	}
+}
+
+int CommonSubexpressionPass(const AST* ast)
+{
+	changeCount = 0;
+	functionEffects = AllocateMap(sizeof(FunctionEffects));
+
+	for (size_t i = 0; i < ast->nodes.length; ++i)
+	{
+		const NodePtr* node = ast->nodes.array[i];
+
+		ASSERT(node->type == Node_Module);
+		const ModuleNode* module = node->ptr;
+
+		for (size_t i = 0; i < module->statements.length; ++i)
+		{
+			NodePtr* node = module->statements.array[i];
+			if (node->type == Node_Null || node->type == Node_Import || node->type == Node_Input || node->type == Node_Desc)
+				continue;
+
+			ASSERT(node->type == Node_Section);
+			SectionStmt* section = node->ptr;
+			ASSERT(section->block.type == Node_BlockStatement);
+			VisitStatement(&section->block);
+		}
+	}
+
+	for (MAP_ITERATE(i, &functionEffects))
+		FreeMap(&((FunctionEffects*)i->value)->writes);
+	FreeMap(&functionEffects);
+	return changeCount;
+}
@@ -0,0 +1,5 @@
+#pragma once
+
+#include "SyntaxTree.h"
+
+int CommonSubexpressionPass(const AST* ast);
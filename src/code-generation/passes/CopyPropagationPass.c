@@ -7,6 +7,7 @@
 typedef Map CopyAssignments;
 
 static FuncDeclStmt* currentFunction;
+static int changeCount;
 
 static void VisitStatement(NodePtr* node, CopyAssignments* map, bool modifyAST, bool modifyMap);
 
@@ -36,17 +37,8 @@ static void MergeCopyAssignments(CopyAssignments* map1, const CopyAssignments* m
 	Array deleteKeys = AllocateArray(sizeof(char*));
 	for (MAP_ITERATE(i, map1))
 	{
-		bool exists = false;
-		for (MAP_ITERATE(j, map2))
-		{
-			if (((NodePtr*)i->value)->ptr == ((NodePtr*)j->value)->ptr && strcmp(i->key, j->key) == 0)
-			{
-				exists = true;
-				break;
-			}
-		}
-
-		if (!exists)
+		const NodePtr* other = MapGet(map2, i->key);
+		if (!other || ((NodePtr*)i->value)->ptr != other->ptr)
 			ArrayAdd(&deleteKeys, &i->key);
 	}
 	FreeCopyAssignments(map2);
@@ -155,13 +147,18 @@ static void VisitExpression(NodePtr* node, CopyAssignments* map, bool modifyAST,
 		if (valueNode.type == Node_VariableDeclaration)
 		{
 			VarDeclStmt* value = valueNode.ptr;
-			if (!value->functionParamOf || value->functionParamOf == currentFunction)
+			if ((!value->functionParamOf || value->functionParamOf == currentFunction) &&
+				memberAccess->varReference != value)
+			{
 				memberAccess->varReference = value;
+				++changeCount;
+			}
 		}
 		else if (valueNode.ptr)
 		{
 			FreeASTNode(*node);
 			*node = CopyASTNode(valueNode);
+			++changeCount;
 		}
 		break;
 	}
@@ -193,7 +190,7 @@ static void VisitExpression(NodePtr* node, CopyAssignments* map, bool modifyAST,
 		for (size_t i = 0; i < funcCall->arguments.length; ++i)
 		{
 			NodePtr* node = funcCall->arguments.array[i];
-			if (funcDecl->modifiers.externalValue && node->type == Node_MemberAccess)
+			if (funcDecl->modifiers.externalValue && funcDecl->pure != PropertyBoolean_True && node->type == Node_MemberAccess)
 			{
 				MemberAccessExpr* memberAccess = node->ptr;
 				ASSERT(memberAccess->varReference);
@@ -329,8 +326,9 @@ static void VisitStatement(NodePtr* node, CopyAssignments* map, bool modifyAST,
 	}
 }
 
-void CopyPropagationPass(const AST* ast)
+int CopyPropagationPass(const AST* ast)
 {
+	changeCount = 0;
 	for (size_t i = 0; i < ast->nodes.length; ++i)
 	{
 		const NodePtr* node = ast->nodes.array[i];
@@ -352,4 +350,5 @@ void CopyPropagationPass(const AST* ast)
 			FreeCopyAssignments(&map);
 		}
 	}
+	return changeCount;
 }
@@ -2,4 +2,4 @@
 
 #include "SyntaxTree.h"
 
-void CopyPropagationPass(const AST* ast);
+int CopyPropagationPass(const AST* ast);
@@ -0,0 +1,534 @@
+#include "CostReportPass.h"
+
+#include "Common.h"
+#include "StringUtils.h"
+#include "data-structures/Map.h"
+#include "data-structures/MemoryStream.h"
+
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// how many of the most expensive lines are listed
+#define REPORTED_LINES 20
+
+typedef struct
+{
+	uint64_t ops;
+	uint64_t calls;
+	uint64_t builtinCalls;
+	uint64_t memoryReads;
+	uint64_t memoryWrites;
+	uint64_t loops;
+	int loopDepth;
+} Cost;
+
+typedef struct
+{
+	const FuncDeclStmt* funcDecl;
+	const ModuleNode* module;
+	// includes the functions that it calls
+	Cost cost;
+	bool measuring;
+	bool measured;
+} FunctionCost;
+
+typedef struct
+{
+	const char* path;
+	int lineNumber;
+	uint64_t ops;
+	int loopDepth;
+} LineCost;
+
+static const char* const sectionNames[] = {
+	[Section_Init] = "init",
+	[Section_Slider] = "slider",
+	[Section_Block] = "block",
+	[Section_Sample] = "sample",
+	[Section_Serialize] = "serialize",
+	[Section_GFX] = "gfx",
+};
+
+#define SECTION_TYPE_COUNT (sizeof(sectionNames) / sizeof(sectionNames[0]))
+
+static Cost sections[SECTION_TYPE_COUNT];
+static bool hasSection[SECTION_TYPE_COUNT];
+static Array functions;
+static Map lines;
+
+static Cost* cost;
+static const ModuleNode* currentModule;
+static int currentLine;
+static int inlinedLine;
+static int loopDepth;
+
+static void VisitStatement(const NodePtr* node);
+static void VisitExpression(NodePtr node, bool assigned);
+
+static FunctionCost* FindFunction(const FuncDeclStmt* funcDecl)
+{
+	for (size_t i = 0; i < functions.length; ++i)
+	{
+		FunctionCost* function = functions.array[i];
+		if (function->funcDecl == funcDecl)
+			return function;
+	}
+	return NULL;
+}
+
+static void AddCost(Cost* to, const Cost* from, int depth)
+{
+	to->ops += from->ops;
+	to->calls += from->calls;
+	to->builtinCalls += from->builtinCalls;
+	to->memoryReads += from->memoryReads;
+	to->memoryWrites += from->memoryWrites;
+	to->loops += from->loops;
+	if (from->loopDepth + depth > to->loopDepth)
+		to->loopDepth = from->loopDepth + depth;
+}
+
+static void AddOp(int lineNumber)
+{
+	cost->ops++;
+
+	// nodes that the compiler made don't have a line, so they go to the line of the code around them.
+	// inlined functions go to the line of the call, their own lines could be from another module
+	if (inlinedLine > 0)
+		lineNumber = inlinedLine;
+	if (lineNumber <= 0)
+		lineNumber = currentLine;
+	if (lineNumber <= 0)
+		return;
+
+	char* key = AllocateString1Str1Int("%s:%" PRId64, currentModule->path, lineNumber);
+	LineCost* line = MapGet(&lines, key);
+	if (!line)
+	{
+		MapAdd(&lines, key, &(LineCost){.path = currentModule->path, .lineNumber = lineNumber});
+		line = MapGet(&lines, key);
+	}
+	free(key);
+
+	line->ops++;
+	if (loopDepth > line->loopDepth)
+		line->loopDepth = loopDepth;
+}
+
+static void VisitBody(const NodePtr* node, const ModuleNode* module, Cost* into)
+{
+	Cost* previousCost = cost;
+	const ModuleNode* previousModule = currentModule;
+	const int previousLine = currentLine;
+	const int previousInlinedLine = inlinedLine;
+	const int previousLoopDepth = loopDepth;
+
+	cost = into;
+	currentModule = module;
+	currentLine = -1;
+	inlinedLine = -1;
+	loopDepth = 0;
+	VisitStatement(node);
+
+	cost = previousCost;
+	currentModule = previousModule;
+	currentLine = previousLine;
+	inlinedLine = previousInlinedLine;
+	loopDepth = previousLoopDepth;
+}
+
+// functions are measured the first time they are called, so the cost of the functions they call is already known
+static const FunctionCost* MeasureFunction(FunctionCost* function)
+{
+	if (function->measured || function->measuring)
+		return function;
+
+	function->measuring = true;
+	VisitBody(&function->funcDecl->block, function->module, &function->cost);
+	function->measuring = false;
+	function->measured = true;
+	return function;
+}
+
+static void VisitFunctionCall(const FuncCallExpr* funcCall)
+{
+	AddOp(funcCall->lineNumber);
+	for (size_t i = 0; i < funcCall->arguments.length; ++i)
+		VisitExpression(*(NodePtr*)funcCall->arguments.array[i], false);
+
+	ASSERT(funcCall->baseExpr.type == Node_MemberAccess);
+	const FuncDeclStmt* funcDecl = ((MemberAccessExpr*)funcCall->baseExpr.ptr)->funcReference;
+	ASSERT(funcDecl);
+
+	FunctionCost* function = FindFunction(funcDecl);
+	if (!function)
+	{
+		cost->builtinCalls++;
+		return;
+	}
+
+	cost->calls++;
+	const FunctionCost* callee = MeasureFunction(function);
+	AddCost(cost, &callee->cost, loopDepth);
+}
+
+static void VisitExpression(const NodePtr node, bool assigned)
+{
+	switch (node.type)
+	{
+	case Node_Binary:
+	{
+		const BinaryExpr* binary = node.ptr;
+		AddOp(binary->lineNumber);
+		VisitExpression(binary->left, binary->operatorType == Binary_Assignment);
+		VisitExpression(binary->right, false);
+		break;
+	}
+	case Node_Unary:
+	{
+		const UnaryExpr* unary = node.ptr;
+		AddOp(unary->lineNumber);
+		VisitExpression(unary->expression, false);
+		break;
+	}
+	case Node_Subscript:
+	{
+		const SubscriptExpr* subscript = node.ptr;
+		AddOp(subscript->lineNumber);
+		if (assigned)
+			cost->memoryWrites++;
+		else
+			cost->memoryReads++;
+		VisitExpression(subscript->baseExpr, false);
+		VisitExpression(subscript->indexExpr, false);
+		break;
+	}
+	case Node_FunctionCall:
+		VisitFunctionCall(node.ptr);
+		break;
+	case Node_BlockExpression:
+	{
+		const BlockExpr* blockExpr = node.ptr;
+		const int previousInlinedLine = inlinedLine;
+		if (blockExpr->inlined && inlinedLine <= 0)
+		{
+			const int callLine = ((BlockStmt*)blockExpr->block.ptr)->lineNumber;
+			inlinedLine = callLine > 0 ? callLine : currentLine;
+		}
+		VisitStatement(&blockExpr->block);
+		inlinedLine = previousInlinedLine;
+		break;
+	}
+	case Node_MemberAccess:
+	case Node_Literal:
+		break;
+	default: INVALID_VALUE(node.type);
+	}
+}
+
+static void VisitStatement(const NodePtr* node)
+{
+	switch (node->type)
+	{
+	case Node_VariableDeclaration:
+	{
+		const VarDeclStmt* varDecl = node->ptr;
+		if (varDecl->modifiers.externalValue || !varDecl->initializer.ptr)
+			break;
+
+		currentLine = varDecl->lineNumber;
+		AddOp(varDecl->lineNumber);
+		VisitExpression(varDecl->initializer, false);
+		break;
+	}
+	case Node_ExpressionStatement:
+	{
+		const ExpressionStmt* expressionStmt = node->ptr;
+		currentLine = expressionStmt->lineNumber;
+		VisitExpression(expressionStmt->expr, false);
+		break;
+	}
+	case Node_BlockStatement:
+	{
+		const BlockStmt* block = node->ptr;
+		for (size_t i = 0; i < block->statements.length; ++i)
+			VisitStatement(block->statements.array[i]);
+		break;
+	}
+	case Node_If:
+	{
+		const IfStmt* ifStmt = node->ptr;
+		currentLine = ifStmt->lineNumber;
+		AddOp(ifStmt->lineNumber);
+		VisitExpression(ifStmt->expr, false);
+		VisitStatement(&ifStmt->trueStmt);
+		VisitStatement(&ifStmt->falseStmt);
+		break;
+	}
+	case Node_While:
+	{
+		// the body is counted once, the number of iterations isn't known
+		const WhileStmt* whileStmt = node->ptr;
+		cost->loops++;
+		++loopDepth;
+		if (loopDepth > cost->loopDepth)
+			cost->loopDepth = loopDepth;
+
+		currentLine = whileStmt->lineNumber;
+		AddOp(whileStmt->lineNumber);
+		VisitExpression(whileStmt->expr, false);
+		VisitStatement(&whileStmt->stmt);
+		--loopDepth;
+		break;
+	}
+	// functions are measured on their own
+	case Node_FunctionDeclaration:
+	case Node_Null:
+		break;
+	default: INVALID_VALUE(node->type);
+	}
+}
+
+static void FindFunctions(const NodePtr* node, const ModuleNode* module)
+{
+	if (node->type == Node_BlockStatement)
+	{
+		const BlockStmt* block = node->ptr;
+		for (size_t i = 0; i < block->statements.length; ++i)
+			FindFunctions(block->statements.array[i], module);
+	}
+	else if (node->type == Node_FunctionDeclaration)
+	{
+		const FuncDeclStmt* funcDecl = node->ptr;
+		if (!funcDecl->modifiers.externalValue)
+			ArrayAdd(&functions, &(FunctionCost){.funcDecl = funcDecl, .module = module});
+	}
+}
+
+static void Measure(const AST* ast)
+{
+	functions = AllocateArray(sizeof(FunctionCost));
+	lines = AllocateMap(sizeof(LineCost));
+	memset(sections, 0, sizeof(sections));
+	memset(hasSection, 0, sizeof(hasSection));
+
+	for (size_t i = 0; i < ast->nodes.length; ++i)
+	{
+		const ModuleNode* module = ((NodePtr*)ast->nodes.array[i])->ptr;
+		for (size_t j = 0; j < module->statements.length; ++j)
+		{
+			const NodePtr* node = module->statements.array[j];
+			if (node->type == Node_Section)
+				FindFunctions(&((SectionStmt*)node->ptr)->block, module);
+		}
+	}
+
+	for (size_t i = 0; i < functions.length; ++i)
+		MeasureFunction(functions.array[i]);
+
+	for (size_t i = 0; i < ast->nodes.length; ++i)
+	{
+		const ModuleNode* module = ((NodePtr*)ast->nodes.array[i])->ptr;
+		for (size_t j = 0; j < module->statements.length; ++j)
+		{
+			const NodePtr* node = module->statements.array[j];
+			if (node->type != Node_Section)
+				continue;
+
+			const SectionStmt* section = node->ptr;
+			hasSection[section->sectionType] = true;
+			VisitBody(&section->block, module, &sections[section->sectionType]);
+		}
+	}
+}
+
+static int CompareFunctions(const void* a, const void* b)
+{
+	const FunctionCost* functionA = *(const FunctionCost* const*)a;
+	const FunctionCost* functionB = *(const FunctionCost* const*)b;
+	if (functionA->cost.ops != functionB->cost.ops)
+		return functionA->cost.ops < functionB->cost.ops ? 1 : -1;
+	return strcmp(functionA->funcDecl->name, functionB->funcDecl->name);
+}
+
+// lines inside of deeper loops come first, because they most likely run the most
+static int CompareLines(const void* a, const void* b)
+{
+	const LineCost* lineA = *(const LineCost* const*)a;
+	const LineCost* lineB = *(const LineCost* const*)b;
+	if (lineA->loopDepth != lineB->loopDepth)
+		return lineA->loopDepth < lineB->loopDepth ? 1 : -1;
+	if (lineA->ops != lineB->ops)
+		return lineA->ops < lineB->ops ? 1 : -1;
+	const int pathOrder = strcmp(lineA->path, lineB->path);
+	return pathOrder != 0 ? pathOrder : lineA->lineNumber - lineB->lineNumber;
+}
+
+static Array AllocSortedLines(void)
+{
+	Array sorted = AllocateArray(sizeof(LineCost));
+	for (MAP_ITERATE(node, &lines))
+		ArrayAdd(&sorted, node->value);
+	qsort(sorted.array, sorted.length, sizeof(*sorted.array), CompareLines);
+	return sorted;
+}
+
+static void SortFunctions(void)
+{
+	// the array holds pointers to the items, so only those are moved
+	qsort(functions.array, functions.length, sizeof(*functions.array), CompareFunctions);
+}
+
+static void FreeMeasurements(void)
+{
+	FreeArray(&functions);
+	FreeMap(&lines);
+}
+
+static const char* GetFileName(const char* path)
+{
+	const char* fileName = strrchr(path, '/');
+	return fileName ? fileName + 1 : path;
+}
+
+static void PrintCostRow(const char* prefix, const char* name, const Cost* cost)
+{
+	printf("%s%-28s %10" PRIu64 " %8" PRIu64 " %8" PRIu64 " %10" PRIu64 " %10" PRIu64 " %6" PRIu64 " %6d\n",
+		prefix, name, cost->ops, cost->calls, cost->builtinCalls, cost->memoryReads, cost->memoryWrites, cost->loops, cost->loopDepth);
+}
+
+// an estimate from the generated code: loop bodies are counted once, and
+// every call counts the whole function it calls, including the functions that it calls
+void PrintCostReport(const AST* ast)
+{
+	Measure(ast);
+	SortFunctions();
+
+	printf("Cost report (loop bodies are counted once)\n");
+	printf("  per sample: %" PRIu64 " ops in @sample, plus %" PRIu64 " ops in @block for each block\n",
+		sections[Section_Sample].ops, sections[Section_Block].ops);
+
+	const char* header = "%s%-28s %10s %8s %8s %10s %10s %6s %6s\n";
+	printf(header, "  ", "section", "ops", "calls", "builtin", "mem reads", "mem writes", "loops", "depth");
+	for (size_t i = 0; i < SECTION_TYPE_COUNT; ++i)
+	{
+		if (!hasSection[i])
+			continue;
+
+		char* name = AllocateString1Str("@%s", sectionNames[i]);
+		PrintCostRow(i == Section_Sample || i == Section_Block ? "* " : "  ", name, &sections[i]);
+		free(name);
+	}
+
+	printf(header, "\n  ", "function", "ops", "calls", "builtin", "mem reads", "mem writes", "loops", "depth");
+	for (size_t i = 0; i < functions.length; ++i)
+	{
+		const FunctionCost* function = functions.array[i];
+		char* name = AllocateString2Str("%s.%s", function->module->moduleName, function->funcDecl->name);
+		PrintCostRow("  ", name, &function->cost);
+		free(name);
+	}
+
+	Array sorted = AllocSortedLines();
+	printf("\n  %10s %6s  %s\n", "ops", "depth", "line");
+	for (size_t i = 0; i < sorted.length && i < REPORTED_LINES; ++i)
+	{
+		const LineCost* line = sorted.array[i];
+		printf("  %10" PRIu64 " %6d  %s:%d\n", line->ops, line->loopDepth, GetFileName(line->path), line->lineNumber);
+	}
+	FreeArray(&sorted);
+
+	FreeMeasurements();
+}
+
+static void WriteFormat(MemoryStream* stream, const char* format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	const int length = vsnprintf(NULL, 0, format, args);
+	va_end(args);
+	ASSERT(length >= 0);
+
+	char* string = malloc((size_t)length + 1);
+	va_start(args, format);
+	vsnprintf(string, (size_t)length + 1, format, args);
+	va_end(args);
+
+	StreamWrite(stream, string, (size_t)length);
+	free(string);
+}
+
+static void WriteJsonString(MemoryStream* stream, const char* string)
+{
+	StreamWriteByte(stream, '"');
+	for (const char* c = string; *c; ++c)
+	{
+		if (*c == '"' || *c == '\\')
+			StreamWriteByte(stream, '\\');
+		StreamWriteByte(stream, *c);
+	}
+	StreamWriteByte(stream, '"');
+}
+
+static void WriteJsonCost(MemoryStream* stream, const Cost* cost)
+{
+	WriteFormat(stream,
+		"\"ops\": %" PRIu64 ", \"calls\": %" PRIu64 ", \"builtin_calls\": %" PRIu64 ", \"memory_reads\": %" PRIu64
+		", \"memory_writes\": %" PRIu64 ", \"loops\": %" PRIu64 ", \"loop_depth\": %d",
+		cost->ops, cost->calls, cost->builtinCalls, cost->memoryReads, cost->memoryWrites, cost->loops, cost->loopDepth);
+}
+
+char* AllocCostReportJson(const AST* ast)
+{
+	Measure(ast);
+	SortFunctions();
+	MemoryStream* stream = AllocateMemoryStream();
+
+	WriteFormat(stream, "{\n  \"ops_per_sample\": %" PRIu64 ",\n  \"ops_per_block\": %" PRIu64 ",\n  \"sections\": {",
+		sections[Section_Sample].ops, sections[Section_Block].ops);
+	bool first = true;
+	for (size_t i = 0; i < SECTION_TYPE_COUNT; ++i)
+	{
+		if (!hasSection[i])
+			continue;
+
+		WriteFormat(stream, "%s\n    \"%s\": {", first ? "" : ",", sectionNames[i]);
+		WriteJsonCost(stream, &sections[i]);
+		StreamWriteByte(stream, '}');
+		first = false;
+	}
+
+	WriteFormat(stream, "\n  },\n  \"functions\": [");
+	for (size_t i = 0; i < functions.length; ++i)
+	{
+		const FunctionCost* function = functions.array[i];
+		WriteFormat(stream, "%s\n    {\"module\": ", i == 0 ? "" : ",");
+		WriteJsonString(stream, function->module->moduleName);
+		WriteFormat(stream, ", \"name\": ");
+		WriteJsonString(stream, function->funcDecl->name);
+		WriteFormat(stream, ", \"line\": %d, ", function->funcDecl->lineNumber);
+		WriteJsonCost(stream, &function->cost);
+		StreamWriteByte(stream, '}');
+	}
+
+	WriteFormat(stream, "\n  ],\n  \"lines\": [");
+	Array sorted = AllocSortedLines();
+	for (size_t i = 0; i < sorted.length && i < REPORTED_LINES; ++i)
+	{
+		const LineCost* line = sorted.array[i];
+		WriteFormat(stream, "%s\n    {\"path\": ", i == 0 ? "" : ",");
+		WriteJsonString(stream, line->path);
+		WriteFormat(stream, ", \"line\": %d, \"ops\": %" PRIu64 ", \"loop_depth\": %d}", line->lineNumber, line->ops, line->loopDepth);
+	}
+	FreeArray(&sorted);
+	WriteFormat(stream, "\n  ]\n}\n");
+	StreamWriteByte(stream, '\0');
+
+	FreeMeasurements();
+	char* report = StreamGetBuffer(stream).buffer;
+	FreeMemoryStream(stream, false);
+	return report;
+}
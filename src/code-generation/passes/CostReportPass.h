@@ -0,0 +1,6 @@
+#pragma once
+
+#include "SyntaxTree.h"
+
+void PrintCostReport(const AST* ast);
+char* AllocCostReportJson(const AST* ast);
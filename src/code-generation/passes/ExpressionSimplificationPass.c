@@ -3,6 +3,7 @@
 #include "Common.h"
 
 #include <ctype.h>
+#include <stdlib.h>
 #include <string.h>
 
 typedef struct
@@ -16,6 +17,11 @@ typedef struct
 	bool isNegative;
 } ConstantInfo;
 
+// variables that are assigned anywhere other than their declaration
+static Map assignedVariables;
+static FuncDeclStmt* currentFunction;
+static int changeCount;
+
 static void VisitStatement(NodePtr* node);
 
 static uint64_t PowerOf10(int x)
@@ -65,6 +71,117 @@ static NodePtr AllocNumberExpr(ConstantInfo info, int lineNumber)
 		return AllocUInt64Integer(info.intValue, lineNumber);
 }
 
+// whole numbers up to this size can be represented exactly by jsfx
+#define MAX_EXACT_INTEGER (1LL << 53)
+
+static bool GetSignedInteger(ConstantInfo info, int64_t* value)
+{
+	if (!info.isInt || info.intValue > (uint64_t)MAX_EXACT_INTEGER)
+		return false;
+
+	*value = info.isNegative ? -(int64_t)info.intValue : (int64_t)info.intValue;
+	return true;
+}
+
+static bool FoldArithmetic(NodePtr* node, ConstantInfo left, ConstantInfo right, ConstantInfo* info)
+{
+	ASSERT(node->type == Node_Binary);
+	BinaryExpr* binary = node->ptr;
+
+	int64_t a, b;
+	if (!GetSignedInteger(left, &a) || !GetSignedInteger(right, &b))
+		return false;
+
+	int64_t result;
+	switch (binary->operatorType)
+	{
+	case Binary_Add: result = a + b; break;
+	case Binary_Subtract: result = a - b; break;
+	case Binary_Multiply:
+	{
+		if (a != 0 && llabs(b) > MAX_EXACT_INTEGER / llabs(a))
+			return false;
+		result = a * b;
+		break;
+	}
+	default: INVALID_VALUE(binary->operatorType);
+	}
+
+	if (result > MAX_EXACT_INTEGER || result < -MAX_EXACT_INTEGER)
+		return false;
+
+	*info = (ConstantInfo){
+		.isInt = true,
+		.intValue = (uint64_t)llabs(result),
+		.isNegative = result < 0,
+	};
+	int lineNumber = binary->lineNumber;
+	FreeASTNode(*node);
+	*node = AllocNumberExpr(*info, lineNumber);
+	++changeCount;
+	return true;
+}
+
+static bool FoldComparison(NodePtr* node, ConstantInfo left, ConstantInfo right, ConstantInfo* info)
+{
+	ASSERT(node->type == Node_Binary);
+	BinaryExpr* binary = node->ptr;
+
+	int64_t a, b;
+	if (!GetSignedInteger(left, &a) || !GetSignedInteger(right, &b))
+		return false;
+
+	bool result;
+	switch (binary->operatorType)
+	{
+	case Binary_GreaterThan: result = a > b; break;
+	case Binary_GreaterOrEqual: result = a >= b; break;
+	case Binary_LessThan: result = a < b; break;
+	case Binary_LessOrEqual: result = a <= b; break;
+	case Binary_BoolOr: result = a || b; break;
+	default: INVALID_VALUE(binary->operatorType);
+	}
+
+	*info = (ConstantInfo){.isInt = true, .intValue = result};
+	int lineNumber = binary->lineNumber;
+	FreeASTNode(*node);
+	*node = AllocNumberExpr(*info, lineNumber);
+	++changeCount;
+	return true;
+}
+
+// a variable that is never assigned after being declared with a constant always has that value.
+// this is usually a configuration global or a control flow flag that is never set
+static bool IsConstantVariable(VarDeclStmt* varDecl)
+{
+	if (varDecl->modifiers.externalValue ||
+		varDecl->inputStmt ||
+		varDecl->functionParamOf ||
+		!varDecl->initializer.ptr)
+		return false;
+
+	double value;
+	if (!EvaluateConstant(varDecl->initializer, NULL, &value))
+		return false;
+
+	return !IsVariableWritten(&assignedVariables, varDecl);
+}
+
+// blocks that are left empty after their statements were removed
+static bool IsEmptyStatement(NodePtr node)
+{
+	if (node.type == Node_Null)
+		return true;
+	if (node.type != Node_BlockStatement)
+		return false;
+
+	BlockStmt* block = node.ptr;
+	for (size_t i = 0; i < block->statements.length; ++i)
+		if (!IsEmptyStatement(*(NodePtr*)block->statements.array[i]))
+			return false;
+	return true;
+}
+
 static bool VisitExpression(NodePtr* node, ConstantInfo* info)
 {
 	ConstantInfo a;
@@ -116,18 +233,65 @@ static bool VisitExpression(NodePtr* node, ConstantInfo* info)
 		VisitExpression(&funcCall->baseExpr, NULL);
 		for (size_t i = 0; i < funcCall->arguments.length; ++i)
 			VisitExpression(funcCall->arguments.array[i], NULL);
+
+		// builtins like math.sqrt(2) are evaluated the same way jsfx would
+		double value;
+		if (((MemberAccessExpr*)funcCall->baseExpr.ptr)->funcReference->constEval == PropertyBoolean_True &&
+			EvaluateConstant(*node, NULL, &value))
+		{
+			int lineNumber = funcCall->lineNumber;
+			RemoveFunctionReferences(*node, currentFunction);
+			FreeASTNode(*node);
+			*node = AllocDouble(value, lineNumber);
+			++changeCount;
+			return VisitExpression(node, info);
+		}
 		return false;
 	}
 	case Node_BlockExpression:
 	{
 		BlockExpr* blockExpr = node->ptr;
 		VisitStatement(&blockExpr->block);
-		return false;
+
+		// an inlined function that only returns a value, like { 2; }, is replaced with the value so it can be folded
+		ASSERT(blockExpr->block.type == Node_BlockStatement);
+		BlockStmt* block = blockExpr->block.ptr;
+		NodePtr* statement = NULL;
+		for (size_t i = 0; i < block->statements.length; ++i)
+		{
+			NodePtr* node = block->statements.array[i];
+			if (IsEmptyStatement(*node))
+				continue;
+			if (statement)
+				return false;
+			statement = node;
+		}
+		if (!statement || statement->type != Node_ExpressionStatement)
+			return false;
+
+		ExpressionStmt* exprStmt = statement->ptr;
+		NodePtr expr = exprStmt->expr;
+		exprStmt->expr = NULL_NODE;
+		FreeASTNode(*node);
+		*node = expr;
+		++changeCount;
+		return VisitExpression(node, info);
 	}
 	case Node_MemberAccess:
 	{
 		MemberAccessExpr* memberAccess = node->ptr;
 		VisitExpression(&memberAccess->start, NULL);
+
+		if (!memberAccess->start.ptr &&
+			memberAccess->varReference &&
+			IsConstantVariable(memberAccess->varReference))
+		{
+			NodePtr value = CopyASTNode(memberAccess->varReference->initializer);
+			FreeASTNode(*node);
+			*node = value;
+			++changeCount;
+			return VisitExpression(node, info);
+		}
 		return false;
 	}
 	case Node_Binary:
@@ -145,16 +309,29 @@ static bool VisitExpression(NodePtr* node, ConstantInfo* info)
 			{
 				*info = (ConstantInfo){.isInt = true, .intValue = leftInfo.intValue && rightInfo.intValue};
 				*node = AllocNumberExpr(*info, binary->lineNumber);
+				++changeCount;
+				return true;
+			}
+			else if (left && leftInfo.isInt && !leftInfo.intValue)
+			{
+				// the right side is never evaluated
+				*info = (ConstantInfo){.isInt = true, .intValue = 0};
+				int lineNumber = binary->lineNumber;
+				FreeASTNode(*node);
+				*node = AllocNumberExpr(*info, lineNumber);
+				++changeCount;
 				return true;
 			}
 			else if (left && !right && leftInfo.isInt && leftInfo.intValue)
 			{
 				*node = binary->right;
+				++changeCount;
 				return false;
 			}
 			else if (!left && right && rightInfo.isInt && rightInfo.intValue)
 			{
 				*node = binary->left;
+				++changeCount;
 				return false;
 			}
 			else
@@ -162,7 +339,16 @@ static bool VisitExpression(NodePtr* node, ConstantInfo* info)
 		}
 		case Binary_BoolOr:
 		{
-			return false;
+			if (left && leftInfo.isInt && leftInfo.intValue)
+			{
+				*info = (ConstantInfo){.isInt = true, .intValue = 1};
+				int lineNumber = binary->lineNumber;
+				FreeASTNode(*node);
+				*node = AllocNumberExpr(*info, lineNumber);
+				++changeCount;
+				return true;
+			}
+			return left && right && FoldComparison(node, leftInfo, rightInfo, info);
 		}
 		case Binary_IsEqual:
 		{
@@ -170,6 +356,7 @@ static bool VisitExpression(NodePtr* node, ConstantInfo* info)
 			{
 				*info = (ConstantInfo){.isInt = true, .intValue = leftInfo.intValue == rightInfo.intValue && leftInfo.isNegative == rightInfo.isNegative};
 				*node = AllocNumberExpr(*info, binary->lineNumber);
+				++changeCount;
 				return true;
 			}
 			else
@@ -181,6 +368,7 @@ static bool VisitExpression(NodePtr* node, ConstantInfo* info)
 			{
 				*info = (ConstantInfo){.isInt = true, .intValue = leftInfo.intValue != rightInfo.intValue || leftInfo.isNegative != rightInfo.isNegative};
 				*node = AllocNumberExpr(*info, binary->lineNumber);
+				++changeCount;
 				return true;
 			}
 			else
@@ -188,19 +376,19 @@ static bool VisitExpression(NodePtr* node, ConstantInfo* info)
 		}
 		case Binary_GreaterThan:
 		{
-			return false;
+			return left && right && FoldComparison(node, leftInfo, rightInfo, info);
 		}
 		case Binary_GreaterOrEqual:
 		{
-			return false;
+			return left && right && FoldComparison(node, leftInfo, rightInfo, info);
 		}
 		case Binary_LessThan:
 		{
-			return false;
+			return left && right && FoldComparison(node, leftInfo, rightInfo, info);
 		}
 		case Binary_LessOrEqual:
 		{
-			return false;
+			return left && right && FoldComparison(node, leftInfo, rightInfo, info);
 		}
 
 		case Binary_BitAnd:
@@ -213,6 +401,7 @@ static bool VisitExpression(NodePtr* node, ConstantInfo* info)
 			{
 				*info = (ConstantInfo){.isInt = true, .intValue = leftInfo.intValue | rightInfo.intValue, .isNegative = leftInfo.isNegative | rightInfo.isNegative};
 				*node = AllocNumberExpr(*info, binary->lineNumber);
+				++changeCount;
 				return true;
 			}
 			else
@@ -225,15 +414,15 @@ static bool VisitExpression(NodePtr* node, ConstantInfo* info)
 
 		case Binary_Add:
 		{
-			return false;
+			return left && right && FoldArithmetic(node, leftInfo, rightInfo, info);
 		}
 		case Binary_Subtract:
 		{
-			return false;
+			return left && right && FoldArithmetic(node, leftInfo, rightInfo, info);
 		}
 		case Binary_Multiply:
 		{
-			return false;
+			return left && right && FoldArithmetic(node, leftInfo, rightInfo, info);
 		}
 		case Binary_Divide:
 		{
@@ -270,6 +459,13 @@ static bool VisitExpression(NodePtr* node, ConstantInfo* info)
 		if (!VisitExpression(&unary->expression, &unaryInfo))
 			return false;
 
+		// negative numbers are already as simple as they can be
+		if (unary->operatorType == Unary_Minus && unary->expression.type == Node_Literal && unaryInfo.isInt && !unaryInfo.isNegative)
+		{
+			*info = (ConstantInfo){.isInt = true, .intValue = unaryInfo.intValue, .isNegative = true};
+			return true;
+		}
+
 		switch (unary->operatorType)
 		{
 		case Unary_Negate:
@@ -278,11 +474,13 @@ static bool VisitExpression(NodePtr* node, ConstantInfo* info)
 			{
 				*info = (ConstantInfo){.isInt = true, .intValue = !unaryInfo.intValue};
 				*node = AllocNumberExpr(*info, unary->lineNumber);
+				++changeCount;
 			}
 			else
 			{
 				*info = (ConstantInfo){.isInt = true, .intValue = !(bool)unaryInfo.floatValue};
 				*node = AllocNumberExpr(*info, unary->lineNumber);
+				++changeCount;
 			}
 			return true;
 		}
@@ -292,11 +490,13 @@ static bool VisitExpression(NodePtr* node, ConstantInfo* info)
 			{
 				*info = (ConstantInfo){.isInt = true, .intValue = unaryInfo.intValue, .isNegative = !unaryInfo.isNegative};
 				*node = AllocNumberExpr(*info, unary->lineNumber);
+				++changeCount;
 			}
 			else
 			{
 				*info = (ConstantInfo){.isInt = false, .floatValue = unaryInfo.floatValue, .isNegative = !unaryInfo.isNegative};
 				*node = AllocNumberExpr(*info, unary->lineNumber);
+				++changeCount;
 			}
 			return true;
 		}
@@ -306,11 +506,13 @@ static bool VisitExpression(NodePtr* node, ConstantInfo* info)
 			{
 				*info = (ConstantInfo){.isInt = true, .intValue = unaryInfo.intValue, .isNegative = unaryInfo.isNegative};
 				*node = AllocNumberExpr(*info, unary->lineNumber);
+				++changeCount;
 			}
 			else
 			{
 				*info = (ConstantInfo){.isInt = false, .floatValue = unaryInfo.floatValue, .isNegative = unaryInfo.isNegative};
 				*node = AllocNumberExpr(*info, unary->lineNumber);
+				++changeCount;
 			}
 			return true;
 		}
@@ -320,7 +522,8 @@ static bool VisitExpression(NodePtr* node, ConstantInfo* info)
 	case Node_Subscript:
 	{
 		SubscriptExpr* subscript = node->ptr;
-		VisitExpression(&subscript->baseExpr, NULL);
+		if (CanReplaceSubscriptBase(subscript))
+			VisitExpression(&subscript->baseExpr, NULL);
 		VisitExpression(&subscript->indexExpr, NULL);
 		return false;
 	}
@@ -328,6 +531,14 @@ static bool VisitExpression(NodePtr* node, ConstantInfo* info)
 	}
 }
 
+static void RemoveStatement(NodePtr* node, NodePtr replacement)
+{
+	RemoveFunctionReferences(*node, currentFunction);
+	FreeASTNode(*node);
+	*node = replacement;
+	++changeCount;
+}
+
 static void VisitStatement(NodePtr* node)
 {
 	switch (node->type)
@@ -352,9 +563,12 @@ static void VisitStatement(NodePtr* node)
 	case Node_FunctionDeclaration:
 	{
 		FuncDeclStmt* funcDecl = node->ptr;
+		FuncDeclStmt* previousFunction = currentFunction;
+		currentFunction = funcDecl;
 		for (size_t i = 0; i < funcDecl->parameters.length; ++i)
 			VisitStatement(funcDecl->parameters.array[i]);
 		VisitStatement(&funcDecl->block);
+		currentFunction = previousFunction;
 		break;
 	}
 	case Node_Input:
@@ -375,6 +589,17 @@ static void VisitStatement(NodePtr* node)
 	{
 		IfStmt* ifStmt = node->ptr;
 		VisitExpression(&ifStmt->expr, NULL);
+		bool condition;
+		if (EvaluateCondition(ifStmt->expr, NULL, &condition))
+		{
+			// only the branch that runs is kept
+			NodePtr* taken = condition ? &ifStmt->trueStmt : &ifStmt->falseStmt;
+			NodePtr branch = *taken;
+			*taken = NULL_NODE;
+			RemoveStatement(node, branch);
+			VisitStatement(node);
+			break;
+		}
 		VisitStatement(&ifStmt->falseStmt);
 		VisitStatement(&ifStmt->trueStmt);
 		break;
@@ -390,6 +615,12 @@ static void VisitStatement(NodePtr* node)
 	{
 		WhileStmt* whileStmt = node->ptr;
 		VisitExpression(&whileStmt->expr, NULL);
+		bool condition;
+		if (EvaluateCondition(whileStmt->expr, NULL, &condition) && !condition)
+		{
+			RemoveStatement(node, NULL_NODE);
+			break;
+		}
 		VisitStatement(&whileStmt->stmt);
 		break;
 	}
@@ -397,8 +628,21 @@ static void VisitStatement(NodePtr* node)
 	}
 }
 
-void ExpressionSimplificationPass(const AST* ast)
+int ExpressionSimplificationPass(const AST* ast)
 {
+	changeCount = 0;
+	assignedVariables = AllocateMap(sizeof(VarDeclStmt*));
+	for (size_t i = 0; i < ast->nodes.length; ++i)
+	{
+		const NodePtr* node = ast->nodes.array[i];
+
+		ASSERT(node->type == Node_Module);
+		const ModuleNode* module = node->ptr;
+
+		for (size_t i = 0; i < module->statements.length; ++i)
+			CollectAssignedVariables(*(NodePtr*)module->statements.array[i], &assignedVariables);
+	}
+
 	for (size_t i = 0; i < ast->nodes.length; ++i)
 	{
 		const NodePtr* node = ast->nodes.array[i];
@@ -406,7 +650,10 @@ void ExpressionSimplificationPass(const AST* ast)
 		ASSERT(node->type == Node_Module);
 		const ModuleNode* module = node->ptr;
 
+		currentFunction = NULL;
 		for (size_t i = 0; i < module->statements.length; ++i)
 			VisitStatement(module->statements.array[i]);
 	}
+	FreeMap(&assignedVariables);
+	return changeCount;
 }
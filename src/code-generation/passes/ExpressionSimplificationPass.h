@@ -2,4 +2,4 @@
 
 #include "SyntaxTree.h"
 
-void ExpressionSimplificationPass(const AST* ast);
+int ExpressionSimplificationPass(const AST* ast);
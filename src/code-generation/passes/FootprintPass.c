@@ -0,0 +1,452 @@
+#include "FootprintPass.h"
+
+#include "Common.h"
+#include "StaticMemoryPass.h"
+#include "StringUtils.h"
+#include "data-structures/Map.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// how many of the biggest struct variables and static buffers are listed
+#define REPORTED_ENTRIES 10
+
+// marks variables that are used in more than one function or section
+#define SHARED_REGION ((void*)1)
+
+typedef struct
+{
+	char* name;
+	char* typeName;
+	uint64_t size;
+} Entry;
+
+typedef struct
+{
+	void* region;
+	SectionType sectionType;
+	bool inFunction;
+	bool input;
+	bool declared;
+	size_t module;
+} Variable;
+
+static const char* const sectionNames[] = {
+	[Section_Init] = "init",
+	[Section_Slider] = "slider",
+	[Section_Block] = "block",
+	[Section_Sample] = "sample",
+	[Section_Serialize] = "serialize",
+	[Section_GFX] = "gfx",
+};
+
+#define SECTION_TYPE_COUNT (sizeof(sectionNames) / sizeof(sectionNames[0]))
+
+// these are collected before the structs are expanded, after that it isn't known which variables were structs
+static Array structVariables;
+static Array buffers;
+static const ModuleNode* currentModule;
+static const FuncDeclStmt* currentFunction;
+
+// the variables in the output, by name. variables that were given the same name are one variable
+static Map variables;
+static void* region;
+static SectionType sectionType;
+static size_t moduleIndex;
+
+static void AddEntry(Array* entries, const VarDeclStmt* varDecl, bool parameter, const char* typeName, uint64_t size)
+{
+	char* name;
+	// parameters are copied into a variable with the same name
+	if (parameter)
+		name = AllocateString3Str("%s.%s(%s)", currentModule->moduleName, currentFunction->name, varDecl->name);
+	else if (currentFunction)
+		name = AllocateString3Str("%s.%s.%s", currentModule->moduleName, currentFunction->name, varDecl->name);
+	else
+		name = AllocateString2Str("%s.%s", currentModule->moduleName, varDecl->name);
+	// the struct declarations are removed when the structs are expanded
+	ArrayAdd(entries, &(Entry){.name = name, .typeName = typeName ? AllocateString(typeName) : NULL, .size = size});
+}
+
+static void CollectVariable(const VarDeclStmt* varDecl, bool parameter)
+{
+	if (varDecl->modifiers.externalValue)
+		return;
+
+	if (varDecl->staticLength != 0)
+	{
+		AddEntry(&buffers, varDecl, false, NULL, GetStaticBufferSize(varDecl));
+		return;
+	}
+
+	// arrays are only a pointer and a length
+	StructDeclStmt* type = GetStructTypeInfoFromType(varDecl->type).effectiveType;
+	if (type && !type->isArrayType)
+		AddEntry(&structVariables, varDecl, parameter, type->name, CountStructSlots(type));
+}
+
+static void CollectStatement(const NodePtr* node)
+{
+	switch (node->type)
+	{
+	case Node_LoopControl:
+	case Node_Import:
+	case Node_Input:
+	case Node_Desc:
+	case Node_Null:
+	case Node_StructDeclaration:
+	case Node_ExpressionStatement:
+	case Node_Return:
+		break;
+	case Node_VariableDeclaration:
+	{
+		CollectVariable(node->ptr, false);
+		break;
+	}
+	case Node_FunctionDeclaration:
+	{
+		const FuncDeclStmt* funcDecl = node->ptr;
+		if (funcDecl->modifiers.externalValue)
+			break;
+
+		const FuncDeclStmt* previousFunction = currentFunction;
+		currentFunction = funcDecl;
+		for (size_t i = 0; i < funcDecl->parameters.length; ++i)
+			CollectVariable(((NodePtr*)funcDecl->parameters.array[i])->ptr, true);
+		CollectStatement(&funcDecl->block);
+		currentFunction = previousFunction;
+		break;
+	}
+	case Node_BlockStatement:
+	{
+		const BlockStmt* block = node->ptr;
+		for (size_t i = 0; i < block->statements.length; ++i)
+			CollectStatement(block->statements.array[i]);
+		break;
+	}
+	case Node_If:
+	{
+		const IfStmt* ifStmt = node->ptr;
+		CollectStatement(&ifStmt->trueStmt);
+		CollectStatement(&ifStmt->falseStmt);
+		break;
+	}
+	case Node_Section:
+	{
+		const SectionStmt* section = node->ptr;
+		CollectStatement(&section->block);
+		break;
+	}
+	case Node_While:
+	{
+		const WhileStmt* whileStmt = node->ptr;
+		CollectStatement(&whileStmt->stmt);
+		break;
+	}
+	default: INVALID_VALUE(node->type);
+	}
+}
+
+// has to run before the member expansion pass
+void CollectFootprint(const AST* ast)
+{
+	structVariables = AllocateArray(sizeof(Entry));
+	buffers = AllocateArray(sizeof(Entry));
+	currentFunction = NULL;
+
+	for (size_t i = 0; i < ast->nodes.length; ++i)
+	{
+		const NodePtr* node = ast->nodes.array[i];
+		ASSERT(node->type == Node_Module);
+		currentModule = node->ptr;
+
+		for (size_t j = 0; j < currentModule->statements.length; ++j)
+			CollectStatement(currentModule->statements.array[j]);
+	}
+}
+
+static void UseVariable(const VarDeclStmt* varDecl, bool declaration)
+{
+	if (varDecl->modifiers.externalValue)
+		return;
+
+	char* name = varDecl->uniqueName != -1
+					 ? AllocateString1Str1Int("%s_%" PRId64, varDecl->name, varDecl->uniqueName)
+					 : AllocateString(varDecl->name);
+	Variable* variable = MapGet(&variables, name);
+	if (!variable)
+	{
+		MapAdd(&variables, name,
+			&(Variable){
+				.region = region,
+				.sectionType = sectionType,
+				.inFunction = currentFunction != NULL,
+				.input = varDecl->inputStmt != NULL,
+				.declared = declaration,
+				.module = moduleIndex,
+			});
+		free(name);
+		return;
+	}
+	free(name);
+
+	if (variable->region != region)
+		variable->region = SHARED_REGION;
+	variable->input = variable->input || varDecl->inputStmt;
+	// the variable belongs to the module it is declared in
+	if (declaration && !variable->declared)
+	{
+		variable->declared = true;
+		variable->module = moduleIndex;
+	}
+}
+
+static void VisitStatement(const NodePtr node);
+
+static void VisitExpression(const NodePtr node)
+{
+	switch (node.type)
+	{
+	case Node_Literal:
+	case Node_Null:
+		break;
+	case Node_MemberAccess:
+	{
+		const MemberAccessExpr* memberAccess = node.ptr;
+		if (memberAccess->varReference)
+			UseVariable(memberAccess->varReference, false);
+		break;
+	}
+	case Node_Binary:
+	{
+		const BinaryExpr* binary = node.ptr;
+		VisitExpression(binary->left);
+		VisitExpression(binary->right);
+		break;
+	}
+	case Node_Unary:
+	{
+		const UnaryExpr* unary = node.ptr;
+		VisitExpression(unary->expression);
+		break;
+	}
+	case Node_FunctionCall:
+	{
+		const FuncCallExpr* funcCall = node.ptr;
+		for (size_t i = 0; i < funcCall->arguments.length; ++i)
+			VisitExpression(*(NodePtr*)funcCall->arguments.array[i]);
+		break;
+	}
+	case Node_Subscript:
+	{
+		const SubscriptExpr* subscript = node.ptr;
+		VisitExpression(subscript->baseExpr);
+		VisitExpression(subscript->indexExpr);
+		break;
+	}
+	case Node_BlockExpression:
+	{
+		const BlockExpr* block = node.ptr;
+		VisitStatement(block->block);
+		break;
+	}
+	default: INVALID_VALUE(node.type);
+	}
+}
+
+static void VisitStatement(const NodePtr node)
+{
+	switch (node.type)
+	{
+	case Node_Import:
+	case Node_StructDeclaration:
+	case Node_Desc:
+	case Node_Null:
+		break;
+	case Node_ExpressionStatement:
+	{
+		const ExpressionStmt* exprStmt = node.ptr;
+		VisitExpression(exprStmt->expr);
+		break;
+	}
+	case Node_VariableDeclaration:
+	{
+		const VarDeclStmt* varDecl = node.ptr;
+		UseVariable(varDecl, true);
+		VisitExpression(varDecl->initializer);
+		break;
+	}
+	case Node_FunctionDeclaration:
+	{
+		FuncDeclStmt* funcDecl = node.ptr;
+		if (funcDecl->modifiers.externalValue)
+			break;
+
+		void* previousRegion = region;
+		const FuncDeclStmt* previousFunction = currentFunction;
+		region = funcDecl;
+		currentFunction = funcDecl;
+		for (size_t i = 0; i < funcDecl->parameters.length; ++i)
+			VisitStatement(*(NodePtr*)funcDecl->parameters.array[i]);
+		VisitStatement(funcDecl->block);
+		region = previousRegion;
+		currentFunction = previousFunction;
+		break;
+	}
+	case Node_Input:
+	{
+		const InputStmt* input = node.ptr;
+		UseVariable(input->varDecl.ptr, true);
+		break;
+	}
+	case Node_BlockStatement:
+	{
+		const BlockStmt* block = node.ptr;
+		for (size_t i = 0; i < block->statements.length; ++i)
+			VisitStatement(*(NodePtr*)block->statements.array[i]);
+		break;
+	}
+	case Node_If:
+	{
+		const IfStmt* ifStmt = node.ptr;
+		VisitExpression(ifStmt->expr);
+		VisitStatement(ifStmt->trueStmt);
+		VisitStatement(ifStmt->falseStmt);
+		break;
+	}
+	case Node_Section:
+	{
+		const SectionStmt* section = node.ptr;
+		region = node.ptr;
+		sectionType = section->sectionType;
+		VisitStatement(section->block);
+		region = NULL;
+		break;
+	}
+	case Node_While:
+	{
+		const WhileStmt* whileStmt = node.ptr;
+		VisitExpression(whileStmt->expr);
+		VisitStatement(whileStmt->stmt);
+		break;
+	}
+	default: INVALID_VALUE(node.type);
+	}
+}
+
+static int CompareEntries(const void* a, const void* b)
+{
+	const Entry* entryA = *(const Entry* const*)a;
+	const Entry* entryB = *(const Entry* const*)b;
+	if (entryA->size != entryB->size)
+		return entryA->size < entryB->size ? 1 : -1;
+	return strcmp(entryA->name, entryB->name);
+}
+
+static uint64_t SortEntries(Array* entries)
+{
+	// the array holds pointers to the items, so only those are moved
+	qsort(entries->array, entries->length, sizeof(*entries->array), CompareEntries);
+
+	uint64_t total = 0;
+	for (size_t i = 0; i < entries->length; ++i)
+		total += ((Entry*)entries->array[i])->size;
+	return total;
+}
+
+static void FreeEntries(Array* entries)
+{
+	for (size_t i = 0; i < entries->length; ++i)
+	{
+		Entry* entry = entries->array[i];
+		free(entry->name);
+		free(entry->typeName);
+	}
+	FreeArray(entries);
+}
+
+// every variable in the output is there for as long as the effect is loaded, in every instance of it.
+// variables that are only used in one section or function are counted there, the rest are shared
+void PrintFootprint(const AST* ast)
+{
+	variables = AllocateMap(sizeof(Variable));
+	region = NULL;
+	currentFunction = NULL;
+	for (moduleIndex = 0; moduleIndex < ast->nodes.length; ++moduleIndex)
+	{
+		const ModuleNode* module = ((NodePtr*)ast->nodes.array[moduleIndex])->ptr;
+		for (size_t i = 0; i < module->statements.length; ++i)
+			VisitStatement(*(NodePtr*)module->statements.array[i]);
+	}
+
+	size_t sections[SECTION_TYPE_COUNT] = {0};
+	size_t functions = 0;
+	size_t shared = 0;
+	size_t inputs = 0;
+	size_t* modules = calloc(ast->nodes.length, sizeof(size_t));
+	ASSERT(modules);
+	for (MAP_ITERATE(node, &variables))
+	{
+		const Variable* variable = node->value;
+		++modules[variable->module];
+		if (variable->input)
+			++inputs;
+		else if (variable->region == SHARED_REGION || variable->region == NULL)
+			++shared;
+		else if (variable->inFunction)
+			++functions;
+		else
+			++sections[variable->sectionType];
+	}
+
+	uint64_t bufferSlots = SortEntries(&buffers);
+	uint64_t structSize = SortEntries(&structVariables);
+
+	printf("Memory footprint: %zu variables, %" PRIu64 " static memory slots\n", variables.elementCount, bufferSlots);
+	printf("  %-28s %10s\n", "used in", "variables");
+	for (size_t i = 0; i < SECTION_TYPE_COUNT; ++i)
+	{
+		if (sections[i] == 0)
+			continue;
+
+		char* name = AllocateString1Str("@%s", sectionNames[i]);
+		printf("  %-28s %10zu\n", name, sections[i]);
+		free(name);
+	}
+	printf("  %-28s %10zu\n", "one function", functions);
+	printf("  %-28s %10zu\n", "more than one", shared);
+	printf("  %-28s %10zu\n", "inputs", inputs);
+
+	printf("\n  %-28s %10s\n", "module", "variables");
+	for (size_t i = 0; i < ast->nodes.length; ++i)
+	{
+		const ModuleNode* module = ((NodePtr*)ast->nodes.array[i])->ptr;
+		if (modules[i] != 0)
+			printf("  %-28s %10zu\n", module->moduleName, modules[i]);
+	}
+	free(modules);
+
+	printf("\n  %zu struct variables, expanded into %" PRIu64 " variables before optimizing\n", structVariables.length, structSize);
+	if (structVariables.length != 0)
+		printf("  %-28s %10s  %s\n", "struct", "variables", "type");
+	for (size_t i = 0; i < structVariables.length && i < REPORTED_ENTRIES; ++i)
+	{
+		const Entry* entry = structVariables.array[i];
+		printf("  %-28s %10" PRIu64 "  %s\n", entry->name, entry->size, entry->typeName);
+	}
+
+	printf("\n  %zu static buffers\n", buffers.length);
+	if (buffers.length != 0)
+		printf("  %-28s %10s\n", "buffer", "slots");
+	for (size_t i = 0; i < buffers.length && i < REPORTED_ENTRIES; ++i)
+	{
+		const Entry* entry = buffers.array[i];
+		printf("  %-28s %10" PRIu64 "\n", entry->name, entry->size);
+	}
+
+	FreeEntries(&structVariables);
+	FreeEntries(&buffers);
+	FreeMap(&variables);
+}
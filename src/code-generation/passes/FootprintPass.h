@@ -0,0 +1,6 @@
+#pragma once
+
+#include "SyntaxTree.h"
+
+void CollectFootprint(const AST* ast);
+void PrintFootprint(const AST* ast);
@@ -29,6 +29,7 @@ static void VisitForStatement(NodePtr* node)
 			.lineNumber = forStmt->lineNumber,
 			.expr = forStmt->condition,
 			.stmt = (NodePtr){.ptr = whileBlock, .type = Node_BlockStatement},
+			.unroll = forStmt->unroll,
 		},
 		sizeof(WhileStmt), Node_While);
 	forStmt->condition = NULL_NODE;
@@ -94,11 +94,14 @@ static void VisitStatement(NodePtr* node)
 	case Node_FunctionDeclaration:
 	{
 		FuncDeclStmt* funcDecl = node->ptr;
+		// functions can be declared inside other functions,
+		// the calls after the nested function still belong to the outer one
+		FuncDeclStmt* previousFunc = currentFunc;
 		currentFunc = funcDecl;
 		for (size_t i = 0; i < funcDecl->parameters.length; ++i)
 			VisitStatement(funcDecl->parameters.array[i]);
 		VisitStatement(&funcDecl->block);
-		currentFunc = NULL;
+		currentFunc = previousFunc;
 		break;
 	}
 	case Node_Input:
@@ -1,10 +1,36 @@
 #include "FunctionInliningPass.h"
 
-#include "data-structures/Map.h"
+#include "Common.h"
 
 #include <string.h>
 
+// how much bigger the limit gets for calls that are run a lot
+#define HOT_CALL_MULTIPLIER 2
+// if a function is only called once, inlining it doesnt make the output bigger
+#define SINGLE_CALL_MULTIPLIER 4
+// struct parameters get expanded into many scalar parameters,
+// each of them makes the call more expensive
+#define PARAMETER_COST 4
+// inlining can make the program at most this many times bigger
+#define MAX_GROWTH 1
+// how many nodes can get copied into one function,
+// big functions make the other passes slow
+#define MAX_CALLER_GROWTH 2048
+
 static Map pointerToReference;
+static Map recursiveFunctions;
+static Map capturingFunctions;
+static int inlineThreshold;
+static bool onlySingleCalls;
+static int inlineBudget;
+
+static FuncDeclStmt* currentFunction;
+static SectionStmt* currentSection;
+static int loopDepth;
+static int callerGrowth;
+static int changeCount;
+
+static void VisitStatement(NodePtr* node);
 
 static void AddReference(void* pointer, NodePtr* reference)
 {
@@ -32,6 +58,186 @@ static FuncDeclStmt* GetFuncDecl(FuncCallExpr* funcCall)
 	return memberAccess->funcReference;
 }
 
+static bool IsRecursive(FuncDeclStmt* funcDecl)
+{
+	char key[64];
+	snprintf(key, sizeof(key), "%p", (void*)funcDecl);
+	bool* cached = MapGet(&recursiveFunctions, key);
+	if (cached)
+		return *cached;
+
+	bool recursive = IsRecursiveFunction(funcDecl);
+
+	MapAdd(&recursiveFunctions, key, &recursive);
+	return recursive;
+}
+
+// checks if the function uses the variables of the function that is calling it
+static bool UsesCallerVariables(FuncDeclStmt* funcDecl)
+{
+	if (!currentFunction)
+		return false;
+
+	char key[64];
+	snprintf(key, sizeof(key), "%p %p", (void*)funcDecl, (void*)currentFunction);
+	bool* cached = MapGet(&capturingFunctions, key);
+	if (cached)
+		return *cached;
+
+	bool uses = FunctionUsesVariablesOf(funcDecl, currentFunction);
+
+	MapAdd(&capturingFunctions, key, &uses);
+	return uses;
+}
+
+static bool ShouldInline(FuncCallExpr* funcCall)
+{
+	FuncDeclStmt* funcDecl = GetFuncDecl(funcCall);
+	if (inlineThreshold <= 0 ||
+		funcDecl->modifiers.externalValue ||
+		funcDecl->isBlockExpression ||
+		funcDecl->variadic ||
+		funcDecl->block.type != Node_BlockStatement ||
+		funcDecl->parameters.length != funcCall->arguments.length ||
+		ContainsFunctionDeclaration(funcDecl->block) ||
+		IsRecursive(funcDecl) ||
+		FunctionVariablesUsedOutside(funcDecl))
+		return false;
+
+	int limit = inlineThreshold + (int)funcDecl->parameters.length * PARAMETER_COST;
+
+	bool hot = loopDepth > 0 ||
+			   (!currentFunction && currentSection && currentSection->sectionType == Section_Sample);
+	if (hot)
+		limit *= HOT_CALL_MULTIPLIER;
+
+	if (funcDecl->useCount <= 1)
+		limit *= SINGLE_CALL_MULTIPLIER;
+	else if (onlySingleCalls)
+		return false;
+	// a nested function that assigns to the variables of the function it is in keeps that
+	// function from being inlined anywhere, so it gets inlined like it only had one call
+	else if (UsesCallerVariables(funcDecl))
+		limit *= SINGLE_CALL_MULTIPLIER;
+
+	int size = CountNodes(funcDecl->block);
+	if (size > limit)
+		return false;
+
+	// functions that are called once get removed after inlining so they dont count
+	if (funcDecl->useCount > 1)
+	{
+		if (size > inlineBudget || callerGrowth + size > MAX_CALLER_GROWTH)
+			return false;
+
+		inlineBudget -= size;
+		callerGrowth += size;
+	}
+	return true;
+}
+
+// an argument can be used in place of its parameter if it always has the same value as the parameter
+// while the body runs. writes and hasCalls cover the body and all of the arguments of the call
+static bool CanSubstituteArgument(NodePtr arg, const VarDeclStmt* parameter, const Map* writes, bool hasCalls)
+{
+	if (IsVariableWritten(writes, parameter))
+		return false;
+
+	if (arg.type == Node_Literal)
+	{
+		LiteralExpr* literal = arg.ptr;
+		return literal->type == Literal_Number || literal->type == Literal_Char;
+	}
+
+	if (arg.type == Node_MemberAccess)
+	{
+		MemberAccessExpr* memberAccess = arg.ptr;
+		return memberAccess->varReference &&
+			   !memberAccess->varReference->modifiers.externalValue &&
+			   !memberAccess->varReference->inputStmt &&
+			   !hasCalls &&
+			   !IsVariableWritten(writes, memberAccess->varReference);
+	}
+
+	return false;
+}
+
+// replaces the call with a block expression that runs a copy of the body.
+// parameters are replaced with their arguments where that is safe, the rest are set at the start of the block.
+// the variables declared in the body are copied too so the copies dont share state
+static NodePtr AllocInlinedCall(FuncCallExpr* funcCall)
+{
+	FuncDeclStmt* funcDecl = GetFuncDecl(funcCall);
+	Map variables = AllocateMap(sizeof(NodePtr));
+	Array substitutedArguments = AllocateArray(sizeof(NodePtr));
+
+	NodePtr block = AllocASTNode(
+		&(BlockStmt){
+			.lineNumber = funcCall->lineNumber,
+			.statements = AllocateArray(sizeof(NodePtr)),
+		},
+		sizeof(BlockStmt), Node_BlockStatement);
+	BlockStmt* blockStmt = block.ptr;
+
+	Map writes = AllocateMap(sizeof(VarDeclStmt*));
+	bool hasCalls = false;
+	CollectWrittenVariables(funcDecl->block, &writes, &hasCalls);
+	// the arguments run before the body, so in Add(x, x++) the first parameter isn't x anymore
+	for (size_t i = 0; i < funcCall->arguments.length; ++i)
+		CollectWrittenVariables(*(NodePtr*)funcCall->arguments.array[i], &writes, &hasCalls);
+
+	for (size_t i = 0; i < funcDecl->parameters.length; ++i)
+	{
+		NodePtr* node = funcDecl->parameters.array[i];
+		ASSERT(node->type == Node_VariableDeclaration);
+		NodePtr arg = *(NodePtr*)funcCall->arguments.array[i];
+
+		if (CanSubstituteArgument(arg, node->ptr, &writes, hasCalls))
+		{
+			AddVariableMapping(&variables, node->ptr, arg);
+			ArrayAdd(&substitutedArguments, &arg);
+			continue;
+		}
+
+		NodePtr copy = CopyASTNode(*node);
+		VarDeclStmt* parameter = copy.ptr;
+		parameter->functionParamOf = NULL;
+		parameter->initializer = arg;
+		AddVariableMapping(&variables, node->ptr, copy);
+		ArrayAdd(&blockStmt->statements, &copy);
+	}
+	FreeMap(&writes);
+
+	NodePtr body = AllocFunctionBodyCopy(funcDecl, &variables, currentFunction);
+	FreeMap(&variables);
+
+	for (size_t i = 0; i < substitutedArguments.length; ++i)
+		FreeASTNode(*(NodePtr*)substitutedArguments.array[i]);
+	FreeArray(&substitutedArguments);
+
+	ASSERT(body.type == Node_BlockStatement);
+	BlockStmt* bodyBlock = body.ptr;
+	for (size_t i = 0; i < bodyBlock->statements.length; ++i)
+		ArrayAdd(&blockStmt->statements, bodyBlock->statements.array[i]);
+	FreeArray(&bodyBlock->statements);
+	free(bodyBlock);
+
+	--funcDecl->useCount;
+	if (currentFunction)
+		RemoveFunctionDependency(currentFunction, funcDecl);
+
+	FreeASTNode(funcCall->baseExpr);
+	FreeArray(&funcCall->arguments);
+	free(funcCall);
+
+	return AllocASTNode(
+		&(BlockExpr){
+			.block = block,
+			.inlined = true,
+		},
+		sizeof(BlockExpr), Node_BlockExpression);
+}
+
 static void VisitExpression(NodePtr* node)
 {
 	switch (node->type)
@@ -46,10 +252,30 @@ static void VisitExpression(NodePtr* node)
 		for (size_t i = 0; i < funcCall->arguments.length; ++i)
 			VisitExpression(funcCall->arguments.array[i]);
 
+		if (ShouldInline(funcCall))
+		{
+			*node = AllocInlinedCall(funcCall);
+			++changeCount;
+
+			// the copied body can have calls that can be inlined too
+			VisitExpression(node);
+			break;
+		}
+
 		if (!GetFuncDecl(funcCall)->isBlockExpression || GetFuncDecl(funcCall)->useCount > 1)
 			break;
 		ASSERT(GetFuncDecl(funcCall)->parameters.length == 0);
 
+		// the calls in the block are now made by the function it is put back into
+		FuncDeclStmt* blockFunction = GetFuncDecl(funcCall);
+		--blockFunction->useCount;
+		if (currentFunction)
+		{
+			RemoveFunctionDependency(currentFunction, blockFunction);
+			for (size_t i = 0; i < blockFunction->dependencies.length; ++i)
+				AddFunctionDependency(currentFunction, ((NodePtr*)blockFunction->dependencies.array[i])->ptr);
+		}
+
 		*node = AllocASTNode(
 			&(BlockExpr){
 				.block = GetFuncDecl(funcCall)->block,
@@ -60,6 +286,7 @@ static void VisitExpression(NodePtr* node)
 		GetFuncDecl(funcCall)->block = NULL_NODE;
 		// FreeASTNode(*funcDeclNode); todo
 		*funcDeclNode = NULL_NODE;
+		++changeCount;
 		break;
 	}
 	case Node_MemberAccess:
@@ -88,6 +315,12 @@ static void VisitExpression(NodePtr* node)
 		VisitExpression(&subscript->indexExpr);
 		break;
 	}
+	case Node_BlockExpression:
+	{
+		BlockExpr* blockExpr = node->ptr;
+		VisitStatement(&blockExpr->block);
+		break;
+	}
 	default: INVALID_VALUE(node->type);
 	}
 }
@@ -117,9 +350,21 @@ static void VisitStatement(NodePtr* node)
 	{
 		FuncDeclStmt* funcDecl = node->ptr;
 		AddReference(funcDecl, node);
+
+		FuncDeclStmt* previousFunction = currentFunction;
+		int previousLoopDepth = loopDepth;
+		int previousCallerGrowth = callerGrowth;
+		currentFunction = funcDecl;
+		loopDepth = 0;
+		callerGrowth = 0;
+
 		for (size_t i = 0; i < funcDecl->parameters.length; ++i)
 			VisitStatement(funcDecl->parameters.array[i]);
 		VisitStatement(&funcDecl->block);
+
+		currentFunction = previousFunction;
+		loopDepth = previousLoopDepth;
+		callerGrowth = previousCallerGrowth;
 		break;
 	}
 	case Node_Input:
@@ -148,23 +393,45 @@ static void VisitStatement(NodePtr* node)
 	{
 		SectionStmt* section = node->ptr;
 		ASSERT(section->block.type == Node_BlockStatement);
+		currentSection = section;
+		callerGrowth = 0;
 		VisitStatement(&section->block);
+		currentSection = NULL;
 		break;
 	}
 	case Node_While:
 	{
 		WhileStmt* whileStmt = node->ptr;
+		++loopDepth;
 		VisitExpression(&whileStmt->expr);
 		VisitStatement(&whileStmt->stmt);
+		--loopDepth;
 		break;
 	}
 	default: INVALID_VALUE(node->type);
 	}
 }
 
-void FunctionInliningPass(const AST* ast)
+int FunctionInliningPass(const AST* ast, const int threshold, const bool optimizeForSize)
 {
+	changeCount = 0;
 	pointerToReference = AllocateMap(sizeof(NodePtr*));
+	recursiveFunctions = AllocateMap(sizeof(bool));
+	capturingFunctions = AllocateMap(sizeof(bool));
+	inlineThreshold = threshold;
+	// inlining a function that is called once removes the function, so the code doesnt get bigger
+	onlySingleCalls = optimizeForSize;
+
+	int programSize = 0;
+	for (size_t i = 0; i < ast->nodes.length; ++i)
+	{
+		const NodePtr* node = ast->nodes.array[i];
+		ASSERT(node->type == Node_Module);
+		const ModuleNode* module = node->ptr;
+		for (size_t i = 0; i < module->statements.length; ++i)
+			programSize += CountNodes(*(NodePtr*)module->statements.array[i]);
+	}
+	inlineBudget = programSize * MAX_GROWTH;
 
 	for (size_t i = 0; i < ast->nodes.length; ++i)
 	{
@@ -178,4 +445,7 @@ void FunctionInliningPass(const AST* ast)
 	}
 
 	FreeMap(&pointerToReference);
+	FreeMap(&recursiveFunctions);
+	FreeMap(&capturingFunctions);
+	return changeCount;
 }
@@ -2,4 +2,4 @@
 
 #include "SyntaxTree.h"
 
-void FunctionInliningPass(const AST* ast);
+int FunctionInliningPass(const AST* ast, int threshold, bool optimizeForSize);
@@ -0,0 +1,618 @@
+#include "FunctionSpecializationPass.h"
+
+#include "Common.h"
+#include "StringUtils.h"
+
+#include <math.h>
+
+// functions bigger than this (in syntax tree nodes) are not copied
+#define MAX_FUNCTION_SIZE 512
+// how many specialized copies one function can have
+#define MAX_SPECIALIZATIONS 8
+// the copies can add at most the size of the program divided by this
+#define GROWTH_DIVISOR 2
+
+typedef struct
+{
+	BlockStmt* parent;
+	FuncDeclStmt* original;
+	NodePtr clone;
+} PendingClone;
+
+static Map parentBlocks;
+static Map specializations;
+static Map specializationCounts;
+static Array pendingClones;
+static int growthBudget;
+static int changeCount;
+
+static FuncDeclStmt* currentFunction;
+
+static void VisitStatement(NodePtr* node);
+
+static FuncDeclStmt* GetFuncDecl(FuncCallExpr* funcCall)
+{
+	ASSERT(funcCall->baseExpr.type == Node_MemberAccess);
+	MemberAccessExpr* memberAccess = funcCall->baseExpr.ptr;
+	ASSERT(memberAccess->funcReference);
+	return memberAccess->funcReference;
+}
+
+static void CollectParentBlocks(NodePtr node, BlockStmt* parent)
+{
+	switch (node.type)
+	{
+	case Node_FunctionDeclaration:
+	{
+		FuncDeclStmt* funcDecl = node.ptr;
+		if (parent)
+		{
+			char key[64];
+			snprintf(key, sizeof(key), "%p", (void*)funcDecl);
+			MapAdd(&parentBlocks, key, &parent);
+		}
+		CollectParentBlocks(funcDecl->block, NULL);
+		break;
+	}
+	case Node_BlockStatement:
+	{
+		BlockStmt* block = node.ptr;
+		for (size_t i = 0; i < block->statements.length; ++i)
+			CollectParentBlocks(*(NodePtr*)block->statements.array[i], block);
+		break;
+	}
+	case Node_If:
+	{
+		IfStmt* ifStmt = node.ptr;
+		CollectParentBlocks(ifStmt->trueStmt, NULL);
+		CollectParentBlocks(ifStmt->falseStmt, NULL);
+		break;
+	}
+	case Node_While:
+	{
+		WhileStmt* whileStmt = node.ptr;
+		CollectParentBlocks(whileStmt->stmt, NULL);
+		break;
+	}
+	case Node_Section:
+	{
+		SectionStmt* section = node.ptr;
+		CollectParentBlocks(section->block, NULL);
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+static BlockStmt* GetParentBlock(FuncDeclStmt* funcDecl)
+{
+	char key[64];
+	snprintf(key, sizeof(key), "%p", (void*)funcDecl);
+	BlockStmt** parent = MapGet(&parentBlocks, key);
+	return parent ? *parent : NULL;
+}
+
+static bool IsConstantLiteral(NodePtr node)
+{
+	if (node.type != Node_Literal)
+		return false;
+
+	LiteralExpr* literal = node.ptr;
+	return literal->type == Literal_Number || literal->type == Literal_Char;
+}
+
+static bool CanSpecialize(FuncDeclStmt* funcDecl, FuncCallExpr* funcCall)
+{
+	return !funcDecl->modifiers.externalValue &&
+		   !funcDecl->isBlockExpression &&
+		   !funcDecl->variadic &&
+		   funcDecl->block.type == Node_BlockStatement &&
+		   funcDecl->parameters.length == funcCall->arguments.length &&
+		   GetParentBlock(funcDecl) &&
+		   CountNodes(funcDecl->block) <= MAX_FUNCTION_SIZE &&
+		   !ContainsFunctionDeclaration(funcDecl->block) &&
+		   !IsRecursiveFunction(funcDecl) &&
+		   !FunctionVariablesUsedOutside(funcDecl);
+}
+
+// makes a literal with the value of the argument if it is a constant
+static NodePtr AllocConstantArgument(NodePtr arg, int lineNumber)
+{
+	if (IsConstantLiteral(arg))
+		return CopyASTNode(arg);
+
+	double value;
+	if (!EvaluateConstant(arg, NULL, &value) || fabs(value) > 1e15 || (double)(int64_t)value != value)
+		return NULL_NODE;
+
+	char number[64];
+	snprintf(number, sizeof(number), "%" PRId64, (int64_t)value);
+	return AllocNumber(AllocateString(number), lineNumber);
+}
+
+// gets the constant value that a variable declaration is initialized with
+static NodePtr GetInitialValue(NodePtr node, const Map* parameterValues)
+{
+	if (node.type != Node_VariableDeclaration)
+		return NULL_NODE;
+
+	VarDeclStmt* varDecl = node.ptr;
+	if (IsConstantLiteral(varDecl->initializer))
+		return varDecl->initializer;
+
+	if (varDecl->initializer.type != Node_MemberAccess)
+		return NULL_NODE;
+
+	MemberAccessExpr* memberAccess = varDecl->initializer.ptr;
+	if (!memberAccess->varReference)
+		return NULL_NODE;
+
+	char key[64];
+	snprintf(key, sizeof(key), "%p", (void*)memberAccess->varReference);
+	NodePtr* value = MapGet(parameterValues, key);
+	return value ? *value : NULL_NODE;
+}
+
+static void CollectInitializedVariables(NodePtr node, const Map* parameterValues, Array* variables, Map* writes)
+{
+	bool hasCalls = false;
+	switch (node.type)
+	{
+	case Node_BlockStatement:
+	{
+		BlockStmt* block = node.ptr;
+		for (size_t i = 0; i < block->statements.length; ++i)
+			CollectInitializedVariables(*(NodePtr*)block->statements.array[i], parameterValues, variables, writes);
+		break;
+	}
+	case Node_If:
+	{
+		IfStmt* ifStmt = node.ptr;
+		CollectWrittenVariables(ifStmt->expr, writes, &hasCalls);
+		CollectInitializedVariables(ifStmt->trueStmt, parameterValues, variables, writes);
+		CollectInitializedVariables(ifStmt->falseStmt, parameterValues, variables, writes);
+		break;
+	}
+	case Node_While:
+	{
+		WhileStmt* whileStmt = node.ptr;
+		CollectWrittenVariables(whileStmt->expr, writes, &hasCalls);
+		CollectInitializedVariables(whileStmt->stmt, parameterValues, variables, writes);
+		break;
+	}
+	case Node_VariableDeclaration:
+	{
+		if (GetInitialValue(node, parameterValues).ptr)
+			ArrayAdd(variables, &node.ptr);
+		else
+			CollectWrittenVariables(node, writes, &hasCalls);
+		break;
+	}
+	default:
+		CollectWrittenVariables(node, writes, &hasCalls);
+		break;
+	}
+}
+
+// the resolver copies every parameter into a variable at the start of the function,
+// those variables are constant if they start with a constant and nothing else assigns them
+static void CollectConstants(NodePtr body, const Map* parameterValues, Map* constants)
+{
+	Array variables = AllocateArray(sizeof(VarDeclStmt*));
+	Map writes = AllocateMap(sizeof(VarDeclStmt*));
+	CollectInitializedVariables(body, parameterValues, &variables, &writes);
+
+	for (size_t i = 0; i < variables.length; ++i)
+	{
+		VarDeclStmt* varDecl = *(VarDeclStmt**)variables.array[i];
+		if (!IsVariableWritten(&writes, varDecl))
+			AddVariableMapping(constants, varDecl,
+				GetInitialValue((NodePtr){.ptr = varDecl, .type = Node_VariableDeclaration}, parameterValues));
+	}
+	FreeMap(&writes);
+	FreeArray(&variables);
+}
+
+// counts the nodes that would be removed from the body if the parameters were constant
+static int CountDeadNodes(NodePtr node, const Map* constants)
+{
+	switch (node.type)
+	{
+	case Node_BlockStatement:
+	{
+		BlockStmt* block = node.ptr;
+		int count = 0;
+		for (size_t i = 0; i < block->statements.length; ++i)
+			count += CountDeadNodes(*(NodePtr*)block->statements.array[i], constants);
+		return count;
+	}
+	case Node_If:
+	{
+		IfStmt* ifStmt = node.ptr;
+		bool condition;
+		if (!EvaluateCondition(ifStmt->expr, constants, &condition))
+			return CountDeadNodes(ifStmt->trueStmt, constants) + CountDeadNodes(ifStmt->falseStmt, constants);
+
+		NodePtr taken = condition ? ifStmt->trueStmt : ifStmt->falseStmt;
+		NodePtr dead = condition ? ifStmt->falseStmt : ifStmt->trueStmt;
+		return 1 + CountNodes(ifStmt->expr) + CountNodes(dead) + CountDeadNodes(taken, constants);
+	}
+	case Node_While:
+	{
+		WhileStmt* whileStmt = node.ptr;
+		bool condition;
+		if (EvaluateCondition(whileStmt->expr, constants, &condition) && !condition)
+			return CountNodes(node);
+		return CountDeadNodes(whileStmt->stmt, constants);
+	}
+	default:
+		return 0;
+	}
+}
+
+static NodePtr* GetParameterValue(const Map* parameterValues, const VarDeclStmt* parameter)
+{
+	char key[64];
+	snprintf(key, sizeof(key), "%p", (const void*)parameter);
+	return MapGet(parameterValues, key);
+}
+
+static void FreeParameterValues(const Map* parameterValues)
+{
+	for (MAP_ITERATE(i, parameterValues))
+		FreeASTNode(*(NodePtr*)i->value);
+	FreeMap(parameterValues);
+}
+
+// the key is the function and the value of each constant parameter
+static bool GetSpecializationKey(FuncDeclStmt* funcDecl, const Map* parameterValues, char* key, size_t size)
+{
+	size_t length = (size_t)snprintf(key, size, "%p", (void*)funcDecl);
+	for (size_t i = 0; i < funcDecl->parameters.length && length < size; ++i)
+	{
+		NodePtr* param = funcDecl->parameters.array[i];
+		NodePtr* value = GetParameterValue(parameterValues, param->ptr);
+		if (!value)
+		{
+			length += (size_t)snprintf(key + length, size - length, ",_");
+			continue;
+		}
+
+		LiteralExpr* literal = value->ptr;
+		length += (size_t)snprintf(key + length, size - length,
+			literal->type == Literal_Number ? ",%s" : ",'%s'",
+			literal->type == Literal_Number ? literal->number : literal->multiChar);
+	}
+	return length < size;
+}
+
+static NodePtr AllocSpecialization(FuncDeclStmt* funcDecl, const Map* parameterValues)
+{
+	Map variables = AllocateMap(sizeof(NodePtr));
+	Array parameters = AllocateArray(sizeof(NodePtr));
+
+	NodePtr clone = AllocASTNode(funcDecl, sizeof(FuncDeclStmt), Node_FunctionDeclaration);
+	FuncDeclStmt* cloneDecl = clone.ptr;
+	cloneDecl->type.expr = CopyASTNode(funcDecl->type.expr);
+	cloneDecl->oldType.expr = CopyASTNode(funcDecl->oldType.expr);
+	cloneDecl->name = AllocateString(funcDecl->name);
+	cloneDecl->externalName = AllocateString(funcDecl->externalName);
+	cloneDecl->oldParameters = AllocateArray(sizeof(NodePtr));
+	cloneDecl->dependencies = AllocateArray(sizeof(NodePtr));
+	cloneDecl->useCount = 0;
+	cloneDecl->inlineCount = 0;
+	cloneDecl->unused = false;
+	cloneDecl->uniqueName = -1;
+
+	for (size_t i = 0; i < funcDecl->parameters.length; ++i)
+	{
+		NodePtr* param = funcDecl->parameters.array[i];
+		NodePtr* value = GetParameterValue(parameterValues, param->ptr);
+		if (value)
+		{
+			AddVariableMapping(&variables, param->ptr, *value);
+			continue;
+		}
+
+		NodePtr copy = CopyASTNode(*param);
+		((VarDeclStmt*)copy.ptr)->functionParamOf = cloneDecl;
+		AddVariableMapping(&variables, param->ptr, copy);
+		ArrayAdd(&parameters, &copy);
+	}
+	cloneDecl->parameters = parameters;
+
+	// the parameter variables of the copy start with the constants,
+	// ExpressionSimplificationPass propagates them and removes the branches that can't run
+	cloneDecl->block = AllocFunctionBodyCopy(funcDecl, &variables, cloneDecl);
+	FreeMap(&variables);
+
+	return clone;
+}
+
+// finds or makes a copy of the function that has the constant arguments built in
+static FuncDeclStmt* GetSpecialization(FuncDeclStmt* funcDecl, const Map* parameterValues)
+{
+	char key[512];
+	if (!GetSpecializationKey(funcDecl, parameterValues, key, sizeof(key)))
+		return NULL;
+
+	FuncDeclStmt** existing = MapGet(&specializations, key);
+	if (existing)
+		return *existing;
+
+	char countKey[64];
+	snprintf(countKey, sizeof(countKey), "%p", (void*)funcDecl);
+	if (!MapGet(&specializationCounts, countKey))
+		MapAdd(&specializationCounts, countKey, &(int){0});
+	int* count = MapGet(&specializationCounts, countKey);
+
+	// it is only worth making a copy if the constants remove some of the code
+	Map constants = AllocateMap(sizeof(NodePtr));
+	CollectConstants(funcDecl->block, parameterValues, &constants);
+	int size = CountNodes(funcDecl->block);
+	int dead = CountDeadNodes(funcDecl->block, &constants);
+	FreeMap(&constants);
+
+	FuncDeclStmt* result = NULL;
+	if (dead > 0 && *count < MAX_SPECIALIZATIONS && size - dead <= growthBudget)
+	{
+		growthBudget -= size - dead;
+		++*count;
+
+		NodePtr clone = AllocSpecialization(funcDecl, parameterValues);
+		ArrayAdd(&pendingClones, &(PendingClone){
+										.parent = GetParentBlock(funcDecl),
+										.original = funcDecl,
+										.clone = clone,
+									});
+		result = clone.ptr;
+
+		// the constants can make more calls inside the copy specializable
+		FuncDeclStmt* previousFunction = currentFunction;
+		currentFunction = result;
+		VisitStatement(&result->block);
+		currentFunction = previousFunction;
+	}
+
+	MapAdd(&specializations, key, &result);
+	return result;
+}
+
+static void SpecializeCall(FuncCallExpr* funcCall)
+{
+	FuncDeclStmt* funcDecl = GetFuncDecl(funcCall);
+	if (!CanSpecialize(funcDecl, funcCall))
+		return;
+
+	Map writes = AllocateMap(sizeof(VarDeclStmt*));
+	bool hasCalls = false;
+	CollectWrittenVariables(funcDecl->block, &writes, &hasCalls);
+
+	Map parameterValues = AllocateMap(sizeof(NodePtr));
+	for (size_t i = 0; i < funcDecl->parameters.length; ++i)
+	{
+		NodePtr* param = funcDecl->parameters.array[i];
+		ASSERT(param->type == Node_VariableDeclaration);
+		if (IsVariableWritten(&writes, param->ptr))
+			continue;
+
+		NodePtr value = AllocConstantArgument(*(NodePtr*)funcCall->arguments.array[i], funcCall->lineNumber);
+		if (value.ptr)
+			AddVariableMapping(&parameterValues, param->ptr, value);
+	}
+	FreeMap(&writes);
+
+	FuncDeclStmt* specialization = parameterValues.elementCount > 0 ? GetSpecialization(funcDecl, &parameterValues) : NULL;
+	if (specialization)
+	{
+		for (size_t i = funcDecl->parameters.length; i-- > 0;)
+		{
+			NodePtr* param = funcDecl->parameters.array[i];
+			if (!GetParameterValue(&parameterValues, param->ptr))
+				continue;
+
+			FreeASTNode(*(NodePtr*)funcCall->arguments.array[i]);
+			ArrayRemove(&funcCall->arguments, i);
+		}
+
+		MemberAccessExpr* memberAccess = funcCall->baseExpr.ptr;
+		memberAccess->funcReference = specialization;
+		++changeCount;
+		--funcDecl->useCount;
+		++specialization->useCount;
+		if (currentFunction)
+		{
+			RemoveFunctionDependency(currentFunction, funcDecl);
+			AddFunctionDependency(currentFunction, specialization);
+		}
+	}
+
+	FreeParameterValues(&parameterValues);
+}
+
+static void VisitExpression(NodePtr* node)
+{
+	switch (node->type)
+	{
+	case Node_Literal:
+	case Node_Null:
+		break;
+	case Node_FunctionCall:
+	{
+		FuncCallExpr* funcCall = node->ptr;
+		VisitExpression(&funcCall->baseExpr);
+		for (size_t i = 0; i < funcCall->arguments.length; ++i)
+			VisitExpression(funcCall->arguments.array[i]);
+
+		SpecializeCall(funcCall);
+		break;
+	}
+	case Node_MemberAccess:
+	{
+		MemberAccessExpr* memberAccess = node->ptr;
+		VisitExpression(&memberAccess->start);
+		break;
+	}
+	case Node_Binary:
+	{
+		BinaryExpr* binary = node->ptr;
+		VisitExpression(&binary->left);
+		VisitExpression(&binary->right);
+		break;
+	}
+	case Node_Unary:
+	{
+		UnaryExpr* unary = node->ptr;
+		VisitExpression(&unary->expression);
+		break;
+	}
+	case Node_Subscript:
+	{
+		SubscriptExpr* subscript = node->ptr;
+		VisitExpression(&subscript->baseExpr);
+		VisitExpression(&subscript->indexExpr);
+		break;
+	}
+	case Node_BlockExpression:
+	{
+		BlockExpr* blockExpr = node->ptr;
+		VisitStatement(&blockExpr->block);
+		break;
+	}
+	default: INVALID_VALUE(node->type);
+	}
+}
+
+static void VisitStatement(NodePtr* node)
+{
+	switch (node->type)
+	{
+	case Node_Import:
+	case Node_StructDeclaration:
+	case Node_Desc:
+	case Node_Null:
+		break;
+	case Node_ExpressionStatement:
+	{
+		ExpressionStmt* exprStmt = node->ptr;
+		VisitExpression(&exprStmt->expr);
+		break;
+	}
+	case Node_VariableDeclaration:
+	{
+		VarDeclStmt* varDecl = node->ptr;
+		VisitExpression(&varDecl->initializer);
+		break;
+	}
+	case Node_FunctionDeclaration:
+	{
+		FuncDeclStmt* funcDecl = node->ptr;
+		FuncDeclStmt* previousFunction = currentFunction;
+		currentFunction = funcDecl;
+		for (size_t i = 0; i < funcDecl->parameters.length; ++i)
+			VisitStatement(funcDecl->parameters.array[i]);
+		VisitStatement(&funcDecl->block);
+		currentFunction = previousFunction;
+		break;
+	}
+	case Node_Input:
+	{
+		InputStmt* input = node->ptr;
+		ASSERT(input->varDecl.type == Node_VariableDeclaration);
+		VisitStatement(&input->varDecl);
+		break;
+	}
+	case Node_BlockStatement:
+	{
+		BlockStmt* block = node->ptr;
+		for (size_t i = 0; i < block->statements.length; ++i)
+			VisitStatement(block->statements.array[i]);
+		break;
+	}
+	case Node_If:
+	{
+		IfStmt* ifStmt = node->ptr;
+		VisitExpression(&ifStmt->expr);
+		VisitStatement(&ifStmt->falseStmt);
+		VisitStatement(&ifStmt->trueStmt);
+		break;
+	}
+	case Node_Section:
+	{
+		SectionStmt* section = node->ptr;
+		ASSERT(section->block.type == Node_BlockStatement);
+		VisitStatement(&section->block);
+		break;
+	}
+	case Node_While:
+	{
+		WhileStmt* whileStmt = node->ptr;
+		VisitExpression(&whileStmt->expr);
+		VisitStatement(&whileStmt->stmt);
+		break;
+	}
+	default: INVALID_VALUE(node->type);
+	}
+}
+
+// the copies go right after the original function so they are declared before any of the calls
+static void InsertClones(void)
+{
+	for (size_t i = 0; i < pendingClones.length; ++i)
+	{
+		PendingClone* pending = pendingClones.array[i];
+		BlockStmt* parent = pending->parent;
+
+		size_t index = 0;
+		while (index < parent->statements.length &&
+			   ((NodePtr*)parent->statements.array[index])->ptr != pending->original)
+			++index;
+		ASSERT(index < parent->statements.length);
+
+		ArrayInsert(&parent->statements, &pending->clone, index + 1);
+	}
+}
+
+int FunctionSpecializationPass(const AST* ast)
+{
+	changeCount = 0;
+	parentBlocks = AllocateMap(sizeof(BlockStmt*));
+	specializations = AllocateMap(sizeof(FuncDeclStmt*));
+	specializationCounts = AllocateMap(sizeof(int));
+	pendingClones = AllocateArray(sizeof(PendingClone));
+
+	int programSize = 0;
+	for (size_t i = 0; i < ast->nodes.length; ++i)
+	{
+		const NodePtr* node = ast->nodes.array[i];
+		ASSERT(node->type == Node_Module);
+		const ModuleNode* module = node->ptr;
+		for (size_t i = 0; i < module->statements.length; ++i)
+		{
+			NodePtr* statement = module->statements.array[i];
+			programSize += CountNodes(*statement);
+			CollectParentBlocks(*statement, NULL);
+		}
+	}
+	growthBudget = programSize / GROWTH_DIVISOR;
+
+	for (size_t i = 0; i < ast->nodes.length; ++i)
+	{
+		const NodePtr* node = ast->nodes.array[i];
+
+		ASSERT(node->type == Node_Module);
+		const ModuleNode* module = node->ptr;
+
+		for (size_t i = 0; i < module->statements.length; ++i)
+			VisitStatement(module->statements.array[i]);
+	}
+
+	InsertClones();
+
+	FreeMap(&parentBlocks);
+	FreeMap(&specializations);
+	FreeMap(&specializationCounts);
+	FreeArray(&pendingClones);
+	return changeCount;
+}
@@ -0,0 +1,5 @@
+#pragma once
+
+#include "SyntaxTree.h"
+
+int FunctionSpecializationPass(const AST* ast);
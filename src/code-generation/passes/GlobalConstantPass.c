@@ -0,0 +1,413 @@
+#include "GlobalConstantPass.h"
+
+#include "Common.h"
+
+#include <stdio.h>
+
+typedef struct
+{
+	VarDeclStmt* varDecl;
+	NodePtr value;
+} InitWrite;
+
+// the value each variable was last assigned at the top level of @init
+static Map initWrites;
+// variables that are written anywhere else, like in a branch, a loop, a function or another section
+static Map otherWrites;
+// functions that can be called while @init is running
+static Map initFunctions;
+static Map constants;
+static int changeCount;
+
+static void GetKey(const void* ptr, char* key, size_t size)
+{
+	snprintf(key, size, "%p", ptr);
+}
+
+static void SetInitWrite(VarDeclStmt* varDecl, NodePtr value)
+{
+	char key[64];
+	GetKey(varDecl, key, sizeof(key));
+	InitWrite* write = MapGet(&initWrites, key);
+	if (write)
+		write->value = value;
+	else
+		MapAdd(&initWrites, key, &(InitWrite){.varDecl = varDecl, .value = value});
+}
+
+static void CollectOtherWrites(NodePtr node)
+{
+	bool hasCalls = false;
+	CollectWrittenVariables(node, &otherWrites, &hasCalls);
+}
+
+// statements at the top level of @init always run, in order, before any other section.
+// returns false if the rest of @init might not run
+static bool CollectInitWrites(BlockStmt* block)
+{
+	bool runs = true;
+	for (size_t i = 0; i < block->statements.length; ++i)
+	{
+		NodePtr* node = block->statements.array[i];
+		if (!runs)
+		{
+			CollectOtherWrites(*node);
+			continue;
+		}
+
+		switch (node->type)
+		{
+		case Node_VariableDeclaration:
+		{
+			VarDeclStmt* varDecl = node->ptr;
+			SetInitWrite(varDecl, varDecl->initializer);
+			CollectOtherWrites(varDecl->initializer);
+			break;
+		}
+		case Node_ExpressionStatement:
+		{
+			ExpressionStmt* exprStmt = node->ptr;
+			BinaryExpr* binary = exprStmt->expr.ptr;
+			if (exprStmt->expr.type == Node_Binary &&
+				binary->operatorType == Binary_Assignment &&
+				binary->left.type == Node_MemberAccess &&
+				!((MemberAccessExpr*)binary->left.ptr)->start.ptr &&
+				((MemberAccessExpr*)binary->left.ptr)->varReference)
+			{
+				SetInitWrite(((MemberAccessExpr*)binary->left.ptr)->varReference, binary->right);
+				CollectOtherWrites(binary->right);
+			}
+			else
+				CollectOtherWrites(*node);
+			break;
+		}
+		case Node_BlockStatement:
+		{
+			runs = CollectInitWrites(node->ptr);
+			break;
+		}
+		case Node_Return:
+		case Node_LoopControl:
+		{
+			CollectOtherWrites(*node);
+			runs = false;
+			break;
+		}
+		default:
+			CollectOtherWrites(*node);
+			break;
+		}
+	}
+	return runs;
+}
+
+static bool IsGlobalConstant(const InitWrite* write, double* value)
+{
+	if (write->varDecl->modifiers.externalValue ||
+		write->varDecl->inputStmt ||
+		write->varDecl->functionParamOf ||
+		IsVariableWritten(&otherWrites, write->varDecl))
+		return false;
+
+	return EvaluateConstant(write->value, NULL, value);
+}
+
+static void CollectInitCalls(NodePtr node)
+{
+	switch (node.type)
+	{
+	case Node_FunctionCall:
+	{
+		FuncCallExpr* funcCall = node.ptr;
+		for (size_t i = 0; i < funcCall->arguments.length; ++i)
+			CollectInitCalls(*(NodePtr*)funcCall->arguments.array[i]);
+
+		ASSERT(funcCall->baseExpr.type == Node_MemberAccess);
+		FuncDeclStmt* funcDecl = ((MemberAccessExpr*)funcCall->baseExpr.ptr)->funcReference;
+		ASSERT(funcDecl);
+		char key[64];
+		GetKey(funcDecl, key, sizeof(key));
+		if (MapAdd(&initFunctions, key, &funcDecl))
+			CollectInitCalls(funcDecl->block);
+		break;
+	}
+	case Node_MemberAccess:
+	{
+		MemberAccessExpr* memberAccess = node.ptr;
+		CollectInitCalls(memberAccess->start);
+		break;
+	}
+	case Node_Binary:
+	{
+		BinaryExpr* binary = node.ptr;
+		CollectInitCalls(binary->left);
+		CollectInitCalls(binary->right);
+		break;
+	}
+	case Node_Unary:
+	{
+		UnaryExpr* unary = node.ptr;
+		CollectInitCalls(unary->expression);
+		break;
+	}
+	case Node_Subscript:
+	{
+		SubscriptExpr* subscript = node.ptr;
+		CollectInitCalls(subscript->baseExpr);
+		CollectInitCalls(subscript->indexExpr);
+		break;
+	}
+	case Node_BlockExpression:
+	{
+		BlockExpr* blockExpr = node.ptr;
+		CollectInitCalls(blockExpr->block);
+		break;
+	}
+	case Node_VariableDeclaration:
+	{
+		VarDeclStmt* varDecl = node.ptr;
+		CollectInitCalls(varDecl->initializer);
+		break;
+	}
+	case Node_ExpressionStatement:
+	{
+		ExpressionStmt* exprStmt = node.ptr;
+		CollectInitCalls(exprStmt->expr);
+		break;
+	}
+	case Node_Return:
+	{
+		ReturnStmt* returnStmt = node.ptr;
+		CollectInitCalls(returnStmt->expr);
+		break;
+	}
+	case Node_BlockStatement:
+	{
+		BlockStmt* block = node.ptr;
+		for (size_t i = 0; i < block->statements.length; ++i)
+			CollectInitCalls(*(NodePtr*)block->statements.array[i]);
+		break;
+	}
+	case Node_If:
+	{
+		IfStmt* ifStmt = node.ptr;
+		CollectInitCalls(ifStmt->expr);
+		CollectInitCalls(ifStmt->trueStmt);
+		CollectInitCalls(ifStmt->falseStmt);
+		break;
+	}
+	case Node_While:
+	{
+		WhileStmt* whileStmt = node.ptr;
+		CollectInitCalls(whileStmt->expr);
+		CollectInitCalls(whileStmt->stmt);
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+static void VisitStatement(NodePtr* node);
+
+static void VisitExpression(NodePtr* node)
+{
+	switch (node->type)
+	{
+	case Node_MemberAccess:
+	{
+		MemberAccessExpr* memberAccess = node->ptr;
+		VisitExpression(&memberAccess->start);
+		if (memberAccess->start.ptr || !memberAccess->varReference)
+			break;
+
+		char key[64];
+		GetKey(memberAccess->varReference, key, sizeof(key));
+		double* value = MapGet(&constants, key);
+		if (!value)
+			break;
+
+		int lineNumber = memberAccess->lineNumber;
+		FreeASTNode(*node);
+		*node = AllocDouble(*value, lineNumber);
+		++changeCount;
+		break;
+	}
+	case Node_Binary:
+	{
+		BinaryExpr* binary = node->ptr;
+		VisitExpression(&binary->left);
+		VisitExpression(&binary->right);
+		break;
+	}
+	case Node_Unary:
+	{
+		UnaryExpr* unary = node->ptr;
+		VisitExpression(&unary->expression);
+		break;
+	}
+	case Node_FunctionCall:
+	{
+		FuncCallExpr* funcCall = node->ptr;
+		for (size_t i = 0; i < funcCall->arguments.length; ++i)
+			VisitExpression(funcCall->arguments.array[i]);
+		break;
+	}
+	case Node_Subscript:
+	{
+		SubscriptExpr* subscript = node->ptr;
+		if (CanReplaceSubscriptBase(subscript))
+			VisitExpression(&subscript->baseExpr);
+		VisitExpression(&subscript->indexExpr);
+		break;
+	}
+	case Node_BlockExpression:
+	{
+		BlockExpr* blockExpr = node->ptr;
+		VisitStatement(&blockExpr->block);
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+static void VisitStatement(NodePtr* node)
+{
+	switch (node->type)
+	{
+	case Node_VariableDeclaration:
+	{
+		VarDeclStmt* varDecl = node->ptr;
+		VisitExpression(&varDecl->initializer);
+		break;
+	}
+	case Node_ExpressionStatement:
+	{
+		ExpressionStmt* exprStmt = node->ptr;
+		VisitExpression(&exprStmt->expr);
+		break;
+	}
+	case Node_Return:
+	{
+		ReturnStmt* returnStmt = node->ptr;
+		VisitExpression(&returnStmt->expr);
+		break;
+	}
+	case Node_BlockStatement:
+	{
+		BlockStmt* block = node->ptr;
+		for (size_t i = 0; i < block->statements.length; ++i)
+			VisitStatement(block->statements.array[i]);
+		break;
+	}
+	case Node_If:
+	{
+		IfStmt* ifStmt = node->ptr;
+		VisitExpression(&ifStmt->expr);
+		VisitStatement(&ifStmt->trueStmt);
+		VisitStatement(&ifStmt->falseStmt);
+		break;
+	}
+	case Node_While:
+	{
+		WhileStmt* whileStmt = node->ptr;
+		VisitExpression(&whileStmt->expr);
+		VisitStatement(&whileStmt->stmt);
+		break;
+	}
+	case Node_FunctionDeclaration:
+	{
+		// functions that run during @init could see the variable before it is assigned
+		FuncDeclStmt* funcDecl = node->ptr;
+		char key[64];
+		GetKey(funcDecl, key, sizeof(key));
+		if (!MapGet(&initFunctions, key))
+			VisitStatement(&funcDecl->block);
+		break;
+	}
+	case Node_Section:
+	{
+		SectionStmt* section = node->ptr;
+		if (section->sectionType != Section_Init)
+			VisitStatement(&section->block);
+		else
+		{
+			// only function declarations are visited in @init
+			BlockStmt* block = section->block.ptr;
+			for (size_t i = 0; i < block->statements.length; ++i)
+			{
+				NodePtr* statement = block->statements.array[i];
+				if (statement->type == Node_FunctionDeclaration)
+					VisitStatement(statement);
+			}
+		}
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+// globals that are only assigned a constant at the top level of @init (like channel counts, table sizes
+// and configuration flags) always have that value in the other sections.
+// jsfx runs @init before any other section, and when it runs it again it assigns the same value
+int GlobalConstantPass(const AST* ast)
+{
+	changeCount = 0;
+	initWrites = AllocateMap(sizeof(InitWrite));
+	otherWrites = AllocateMap(sizeof(VarDeclStmt*));
+	initFunctions = AllocateMap(sizeof(FuncDeclStmt*));
+	constants = AllocateMap(sizeof(double));
+
+	// sections from every module run in the order they are in the syntax tree
+	for (size_t i = 0; i < ast->nodes.length; ++i)
+	{
+		const NodePtr* node = ast->nodes.array[i];
+		ASSERT(node->type == Node_Module);
+		const ModuleNode* module = node->ptr;
+		for (size_t j = 0; j < module->statements.length; ++j)
+		{
+			NodePtr* statement = module->statements.array[j];
+			if (statement->type != Node_Section)
+				continue;
+
+			SectionStmt* section = statement->ptr;
+			ASSERT(section->block.type == Node_BlockStatement);
+			if (section->sectionType == Section_Init)
+			{
+				CollectInitWrites(section->block.ptr);
+
+				BlockStmt* block = section->block.ptr;
+				for (size_t k = 0; k < block->statements.length; ++k)
+				{
+					NodePtr* initStatement = block->statements.array[k];
+					if (initStatement->type != Node_FunctionDeclaration)
+						CollectInitCalls(*initStatement);
+				}
+			}
+			else
+				CollectOtherWrites(section->block);
+		}
+	}
+
+	for (MAP_ITERATE(i, &initWrites))
+	{
+		double value;
+		if (IsGlobalConstant(i->value, &value))
+			MapAdd(&constants, i->key, &value);
+	}
+
+	for (size_t i = 0; i < ast->nodes.length; ++i)
+	{
+		const ModuleNode* module = ((NodePtr*)ast->nodes.array[i])->ptr;
+		for (size_t j = 0; j < module->statements.length; ++j)
+			VisitStatement(module->statements.array[j]);
+	}
+
+	FreeMap(&initWrites);
+	FreeMap(&otherWrites);
+	FreeMap(&initFunctions);
+	FreeMap(&constants);
+	return changeCount;
+}
@@ -0,0 +1,830 @@
+#include "LivenessPass.h"
+
+#include "Common.h"
+#include "StringUtils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef uint64_t Word;
+#define WORD_BITS 64
+
+// marks variables that are used in more than one function or section
+#define SHARED_REGION ((void*)1)
+
+// the function or section each variable is used in
+static Map regions;
+// the variables that are only used in the function or section that is being looked at.
+// they are always assigned before they are read, so they are never live at the start of it
+static Array locals;
+static Map localIndices;
+static size_t wordCount;
+
+static FuncDeclStmt* currentFunction;
+static bool removeStores;
+// stores are only removed and interferences are only recorded once the loops have been analyzed
+static int analyzingLoops;
+// for each variable, the variables that are live while it is assigned
+static Word* interference;
+static bool hasControlFlow;
+static int changeCount;
+// the locals of each section that can share names with the locals of the other sections
+static Array sectionLocals;
+
+static void GetKey(const void* ptr, char* key, size_t size)
+{
+	snprintf(key, size, "%p", ptr);
+}
+
+static Word* AllocLiveSet(void)
+{
+	Word* live = calloc(wordCount ? wordCount : 1, sizeof(Word));
+	ASSERT(live);
+	return live;
+}
+
+static Word* CopyLiveSet(const Word* live)
+{
+	Word* copy = AllocLiveSet();
+	memcpy(copy, live, wordCount * sizeof(Word));
+	return copy;
+}
+
+static void AddLiveSet(Word* live, const Word* other)
+{
+	for (size_t i = 0; i < wordCount; ++i)
+		live[i] |= other[i];
+}
+
+static bool IsLive(const Word* live, size_t index)
+{
+	return live[index / WORD_BITS] & ((Word)1 << (index % WORD_BITS));
+}
+
+static void SetLive(Word* live, size_t index, bool value)
+{
+	if (value)
+		live[index / WORD_BITS] |= (Word)1 << (index % WORD_BITS);
+	else
+		live[index / WORD_BITS] &= ~((Word)1 << (index % WORD_BITS));
+}
+
+static void UseRegion(const VarDeclStmt* varDecl, void* region)
+{
+	char key[64];
+	GetKey(varDecl, key, sizeof(key));
+	void** existing = MapGet(&regions, key);
+	if (!existing)
+		MapAdd(&regions, key, &region);
+	else if (*existing != region)
+		*existing = SHARED_REGION;
+}
+
+static void CollectRegions(NodePtr node, void* region)
+{
+	switch (node.type)
+	{
+	case Node_MemberAccess:
+	{
+		MemberAccessExpr* memberAccess = node.ptr;
+		CollectRegions(memberAccess->start, region);
+		if (memberAccess->varReference)
+			UseRegion(memberAccess->varReference, region);
+		break;
+	}
+	case Node_Binary:
+	{
+		BinaryExpr* binary = node.ptr;
+		CollectRegions(binary->left, region);
+		CollectRegions(binary->right, region);
+		break;
+	}
+	case Node_Unary:
+	{
+		UnaryExpr* unary = node.ptr;
+		CollectRegions(unary->expression, region);
+		break;
+	}
+	case Node_FunctionCall:
+	{
+		FuncCallExpr* funcCall = node.ptr;
+		for (size_t i = 0; i < funcCall->arguments.length; ++i)
+			CollectRegions(*(NodePtr*)funcCall->arguments.array[i], region);
+		break;
+	}
+	case Node_Subscript:
+	{
+		SubscriptExpr* subscript = node.ptr;
+		CollectRegions(subscript->baseExpr, region);
+		CollectRegions(subscript->indexExpr, region);
+		break;
+	}
+	case Node_BlockExpression:
+	{
+		BlockExpr* blockExpr = node.ptr;
+		CollectRegions(blockExpr->block, region);
+		break;
+	}
+	case Node_VariableDeclaration:
+	{
+		VarDeclStmt* varDecl = node.ptr;
+		UseRegion(varDecl, region);
+		CollectRegions(varDecl->initializer, region);
+		break;
+	}
+	case Node_ExpressionStatement:
+	{
+		ExpressionStmt* exprStmt = node.ptr;
+		CollectRegions(exprStmt->expr, region);
+		break;
+	}
+	case Node_Return:
+	{
+		ReturnStmt* returnStmt = node.ptr;
+		CollectRegions(returnStmt->expr, region);
+		break;
+	}
+	case Node_BlockStatement:
+	{
+		BlockStmt* block = node.ptr;
+		for (size_t i = 0; i < block->statements.length; ++i)
+			CollectRegions(*(NodePtr*)block->statements.array[i], region);
+		break;
+	}
+	case Node_If:
+	{
+		IfStmt* ifStmt = node.ptr;
+		CollectRegions(ifStmt->expr, region);
+		CollectRegions(ifStmt->trueStmt, region);
+		CollectRegions(ifStmt->falseStmt, region);
+		break;
+	}
+	case Node_While:
+	{
+		WhileStmt* whileStmt = node.ptr;
+		CollectRegions(whileStmt->expr, region);
+		CollectRegions(whileStmt->stmt, region);
+		break;
+	}
+	case Node_FunctionDeclaration:
+	{
+		FuncDeclStmt* funcDecl = node.ptr;
+		for (size_t i = 0; i < funcDecl->parameters.length; ++i)
+			CollectRegions(*(NodePtr*)funcDecl->parameters.array[i], funcDecl);
+		CollectRegions(funcDecl->block, funcDecl);
+		break;
+	}
+	case Node_Section:
+	{
+		SectionStmt* section = node.ptr;
+		CollectRegions(section->block, section);
+		break;
+	}
+	case Node_Input:
+	{
+		InputStmt* input = node.ptr;
+		UseRegion(input->varDecl.ptr, SHARED_REGION);
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+static void CollectLocals(NodePtr node, void* region)
+{
+	switch (node.type)
+	{
+	case Node_Binary:
+	{
+		BinaryExpr* binary = node.ptr;
+		CollectLocals(binary->left, region);
+		CollectLocals(binary->right, region);
+		break;
+	}
+	case Node_Unary:
+	{
+		UnaryExpr* unary = node.ptr;
+		CollectLocals(unary->expression, region);
+		break;
+	}
+	case Node_FunctionCall:
+	{
+		FuncCallExpr* funcCall = node.ptr;
+		for (size_t i = 0; i < funcCall->arguments.length; ++i)
+			CollectLocals(*(NodePtr*)funcCall->arguments.array[i], region);
+		break;
+	}
+	case Node_Subscript:
+	{
+		SubscriptExpr* subscript = node.ptr;
+		CollectLocals(subscript->baseExpr, region);
+		CollectLocals(subscript->indexExpr, region);
+		break;
+	}
+	case Node_BlockExpression:
+	{
+		BlockExpr* blockExpr = node.ptr;
+		CollectLocals(blockExpr->block, region);
+		break;
+	}
+	case Node_VariableDeclaration:
+	{
+		VarDeclStmt* varDecl = node.ptr;
+		CollectLocals(varDecl->initializer, region);
+
+		char key[64];
+		GetKey(varDecl, key, sizeof(key));
+		void** varRegion = MapGet(&regions, key);
+		if (varDecl->modifiers.externalValue ||
+			varDecl->inputStmt ||
+			varDecl->functionParamOf ||
+			!varRegion || *varRegion != region)
+			break;
+
+		size_t index = locals.length;
+		if (MapAdd(&localIndices, key, &index))
+			ArrayAdd(&locals, &varDecl);
+		break;
+	}
+	case Node_ExpressionStatement:
+	{
+		ExpressionStmt* exprStmt = node.ptr;
+		CollectLocals(exprStmt->expr, region);
+		break;
+	}
+	case Node_BlockStatement:
+	{
+		BlockStmt* block = node.ptr;
+		for (size_t i = 0; i < block->statements.length; ++i)
+			CollectLocals(*(NodePtr*)block->statements.array[i], region);
+		break;
+	}
+	case Node_If:
+	{
+		IfStmt* ifStmt = node.ptr;
+		CollectLocals(ifStmt->expr, region);
+		CollectLocals(ifStmt->trueStmt, region);
+		CollectLocals(ifStmt->falseStmt, region);
+		break;
+	}
+	case Node_While:
+	{
+		WhileStmt* whileStmt = node.ptr;
+		CollectLocals(whileStmt->expr, region);
+		CollectLocals(whileStmt->stmt, region);
+		break;
+	}
+	case Node_Return:
+	case Node_LoopControl:
+		hasControlFlow = true;
+		break;
+	default:
+		break;
+	}
+}
+
+static bool GetLocalIndex(const VarDeclStmt* varDecl, size_t* index)
+{
+	char key[64];
+	GetKey(varDecl, key, sizeof(key));
+	size_t* value = MapGet(&localIndices, key);
+	if (!value)
+		return false;
+	*index = *value;
+	return true;
+}
+
+static bool GetAssignedLocal(NodePtr node, size_t* index)
+{
+	if (node.type != Node_MemberAccess)
+		return false;
+	MemberAccessExpr* memberAccess = node.ptr;
+	return !memberAccess->start.ptr &&
+		   memberAccess->varReference &&
+		   GetLocalIndex(memberAccess->varReference, index);
+}
+
+// the variable is assigned while the other live variables still have values that are needed
+static void Define(size_t index, const Word* live)
+{
+	if (!interference || analyzingLoops)
+		return;
+
+	Word* row = interference + index * wordCount;
+	for (size_t i = 0; i < locals.length; ++i)
+	{
+		if (i == index || !IsLive(live, i))
+			continue;
+		SetLive(row, i, true);
+		SetLive(interference + i * wordCount, index, true);
+	}
+}
+
+// expressions that can be removed without changing anything other than the variable they are assigned to
+static bool IsRemovable(NodePtr node)
+{
+	switch (node.type)
+	{
+	case Node_Literal:
+	case Node_Null:
+		return true;
+	case Node_MemberAccess:
+	{
+		MemberAccessExpr* memberAccess = node.ptr;
+		return IsRemovable(memberAccess->start);
+	}
+	case Node_Binary:
+	{
+		BinaryExpr* binary = node.ptr;
+		return binary->operatorType < Binary_Assignment &&
+			   IsRemovable(binary->left) &&
+			   IsRemovable(binary->right);
+	}
+	case Node_Unary:
+	{
+		UnaryExpr* unary = node.ptr;
+		return unary->operatorType != Unary_Increment &&
+			   unary->operatorType != Unary_Decrement &&
+			   IsRemovable(unary->expression);
+	}
+	case Node_FunctionCall:
+	{
+		FuncCallExpr* funcCall = node.ptr;
+		FuncDeclStmt* funcDecl = ((MemberAccessExpr*)funcCall->baseExpr.ptr)->funcReference;
+		if (!funcDecl->modifiers.externalValue || funcDecl->pure != PropertyBoolean_True)
+			return false;
+		for (size_t i = 0; i < funcCall->arguments.length; ++i)
+		{
+			if (!IsRemovable(*(NodePtr*)funcCall->arguments.array[i]))
+				return false;
+		}
+		return true;
+	}
+	case Node_Subscript:
+	{
+		SubscriptExpr* subscript = node.ptr;
+		return IsRemovable(subscript->baseExpr) &&
+			   IsRemovable(subscript->indexExpr);
+	}
+	default:
+		return false;
+	}
+}
+
+static void VisitStatement(NodePtr* node, Word* live, bool valueUsed);
+
+// goes backwards through the expression, adding the variables it reads.
+// assignments inside of expressions don't end the lifetime of the variable, which is always safe
+static void VisitExpression(NodePtr node, Word* live)
+{
+	switch (node.type)
+	{
+	case Node_MemberAccess:
+	{
+		MemberAccessExpr* memberAccess = node.ptr;
+		size_t index;
+		if (GetAssignedLocal(node, &index))
+			SetLive(live, index, true);
+		VisitExpression(memberAccess->start, live);
+		break;
+	}
+	case Node_Binary:
+	{
+		BinaryExpr* binary = node.ptr;
+		size_t index;
+		if (binary->operatorType >= Binary_Assignment && GetAssignedLocal(binary->left, &index))
+		{
+			Define(index, live);
+			SetLive(live, index, true);
+			VisitExpression(binary->right, live);
+		}
+		else if (binary->operatorType == Binary_BoolAnd || binary->operatorType == Binary_BoolOr)
+		{
+			// the right side might not run
+			Word* right = CopyLiveSet(live);
+			VisitExpression(binary->right, right);
+			AddLiveSet(live, right);
+			free(right);
+			VisitExpression(binary->left, live);
+		}
+		else if (binary->operatorType >= Binary_Assignment)
+		{
+			// the address that is stored to can be worked out after the value,
+			// so the variables in it have to stay live while the value is
+			VisitExpression(binary->left, live);
+			VisitExpression(binary->right, live);
+		}
+		else
+		{
+			VisitExpression(binary->right, live);
+			VisitExpression(binary->left, live);
+		}
+		break;
+	}
+	case Node_Unary:
+	{
+		UnaryExpr* unary = node.ptr;
+		size_t index;
+		if ((unary->operatorType == Unary_Increment || unary->operatorType == Unary_Decrement) &&
+			GetAssignedLocal(unary->expression, &index))
+			Define(index, live);
+		VisitExpression(unary->expression, live);
+		break;
+	}
+	case Node_FunctionCall:
+	{
+		FuncCallExpr* funcCall = node.ptr;
+		FuncDeclStmt* funcDecl = ((MemberAccessExpr*)funcCall->baseExpr.ptr)->funcReference;
+		for (size_t i = funcCall->arguments.length; i-- > 0;)
+		{
+			NodePtr arg = *(NodePtr*)funcCall->arguments.array[i];
+			size_t index;
+			if (funcDecl->modifiers.externalValue && funcDecl->pure != PropertyBoolean_True &&
+				GetAssignedLocal(arg, &index))
+				Define(index, live);
+			VisitExpression(arg, live);
+		}
+		break;
+	}
+	case Node_Subscript:
+	{
+		SubscriptExpr* subscript = node.ptr;
+		VisitExpression(subscript->indexExpr, live);
+		VisitExpression(subscript->baseExpr, live);
+		break;
+	}
+	case Node_BlockExpression:
+	{
+		BlockExpr* blockExpr = node.ptr;
+		VisitStatement(&blockExpr->block, live, true);
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+static void RemoveStore(NodePtr* node)
+{
+	RemoveFunctionReferences(*node, currentFunction);
+	FreeASTNode(*node);
+	*node = NULL_NODE;
+	++changeCount;
+}
+
+// the value of the last statement in a block expression or a function is its result, so it is never removed
+static void VisitStatement(NodePtr* node, Word* live, bool valueUsed)
+{
+	switch (node->type)
+	{
+	case Node_ExpressionStatement:
+	{
+		ExpressionStmt* exprStmt = node->ptr;
+		BinaryExpr* binary = exprStmt->expr.ptr;
+		size_t index;
+		if (exprStmt->expr.type != Node_Binary ||
+			binary->operatorType != Binary_Assignment ||
+			!GetAssignedLocal(binary->left, &index))
+		{
+			VisitExpression(exprStmt->expr, live);
+			break;
+		}
+
+		if (removeStores && !analyzingLoops &&
+			!valueUsed &&
+			!exprStmt->doNotOptimize &&
+			!IsLive(live, index) &&
+			IsRemovable(binary->right))
+		{
+			RemoveStore(node);
+			break;
+		}
+
+		Define(index, live);
+		SetLive(live, index, false);
+		VisitExpression(binary->right, live);
+		break;
+	}
+	case Node_VariableDeclaration:
+	{
+		VarDeclStmt* varDecl = node->ptr;
+		size_t index;
+		if (GetLocalIndex(varDecl, &index))
+		{
+			Define(index, live);
+			SetLive(live, index, false);
+		}
+		VisitExpression(varDecl->initializer, live);
+		break;
+	}
+	case Node_BlockStatement:
+	{
+		BlockStmt* block = node->ptr;
+		for (size_t i = block->statements.length; i-- > 0;)
+			VisitStatement(block->statements.array[i], live, valueUsed && i == block->statements.length - 1);
+		break;
+	}
+	case Node_If:
+	{
+		IfStmt* ifStmt = node->ptr;
+		Word* falseLive = CopyLiveSet(live);
+		VisitStatement(&ifStmt->trueStmt, live, valueUsed);
+		VisitStatement(&ifStmt->falseStmt, falseLive, valueUsed);
+		AddLiveSet(live, falseLive);
+		free(falseLive);
+		VisitExpression(ifStmt->expr, live);
+		break;
+	}
+	case Node_While:
+	{
+		WhileStmt* whileStmt = node->ptr;
+
+		// the variables that are live at the condition, when the loop starts and after every iteration
+		Word* exit = CopyLiveSet(live);
+		Word* head = CopyLiveSet(live);
+		VisitExpression(whileStmt->expr, head);
+		++analyzingLoops;
+		while (true)
+		{
+			Word* next = CopyLiveSet(head);
+			VisitStatement(&whileStmt->stmt, next, false);
+			AddLiveSet(next, exit);
+			VisitExpression(whileStmt->expr, next);
+			AddLiveSet(next, head);
+
+			bool same = memcmp(next, head, wordCount * sizeof(Word)) == 0;
+			free(head);
+			head = next;
+			if (same)
+				break;
+		}
+		--analyzingLoops;
+
+		Word* body = CopyLiveSet(head);
+		VisitStatement(&whileStmt->stmt, body, false);
+		free(body);
+
+		memcpy(live, head, wordCount * sizeof(Word));
+		VisitExpression(whileStmt->expr, live);
+		free(head);
+		free(exit);
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+static void VisitRegion(NodePtr* body, void* region, FuncDeclStmt* function, Array* regionLocals)
+{
+	locals = AllocateArray(sizeof(VarDeclStmt*));
+	localIndices = AllocateMap(sizeof(size_t));
+	hasControlFlow = false;
+	CollectLocals(*body, region);
+	wordCount = (locals.length + WORD_BITS - 1) / WORD_BITS;
+
+	if (locals.length != 0 && !hasControlFlow)
+	{
+		if (regionLocals)
+		{
+			interference = calloc(locals.length * wordCount, sizeof(Word));
+			ASSERT(interference);
+		}
+
+		currentFunction = function;
+		Word* live = AllocLiveSet();
+		VisitStatement(body, live, function != NULL);
+		free(live);
+	}
+
+	if (regionLocals)
+		*regionLocals = locals;
+	else
+		FreeArray(&locals);
+	FreeMap(&localIndices);
+}
+
+static void ForEachRegion(const AST* ast, void (*visit)(NodePtr* body, void* region, FuncDeclStmt* function))
+{
+	regions = AllocateMap(sizeof(void*));
+	for (size_t i = 0; i < ast->nodes.length; ++i)
+	{
+		const NodePtr* node = ast->nodes.array[i];
+		ASSERT(node->type == Node_Module);
+		const ModuleNode* module = node->ptr;
+		for (size_t j = 0; j < module->statements.length; ++j)
+			CollectRegions(*(NodePtr*)module->statements.array[j], NULL);
+	}
+
+	for (size_t i = 0; i < ast->nodes.length; ++i)
+	{
+		const ModuleNode* module = ((NodePtr*)ast->nodes.array[i])->ptr;
+		for (size_t j = 0; j < module->statements.length; ++j)
+		{
+			NodePtr* statement = module->statements.array[j];
+			if (statement->type != Node_Section)
+				continue;
+
+			SectionStmt* section = statement->ptr;
+			visit(&section->block, section, NULL);
+
+			BlockStmt* block = section->block.ptr;
+			for (size_t k = 0; k < block->statements.length; ++k)
+			{
+				NodePtr* node = block->statements.array[k];
+				if (node->type != Node_FunctionDeclaration)
+					continue;
+
+				FuncDeclStmt* funcDecl = node->ptr;
+				if (!funcDecl->modifiers.externalValue)
+					visit(&funcDecl->block, funcDecl, funcDecl);
+			}
+		}
+	}
+	FreeMap(&regions);
+}
+
+static void RemoveDeadStores(NodePtr* body, void* region, FuncDeclStmt* function)
+{
+	VisitRegion(body, region, function, NULL);
+}
+
+// removes assignments to variables that are assigned again before they are read,
+// or never read again. only variables that are used in just one function or section are looked at
+int DeadStorePass(const AST* ast)
+{
+	changeCount = 0;
+	removeStores = true;
+	ForEachRegion(ast, RemoveDeadStores);
+	return changeCount;
+}
+
+static size_t GetNameLength(const VarDeclStmt* varDecl)
+{
+	size_t length = strlen(varDecl->name);
+	if (varDecl->uniqueName != -1)
+		length += (size_t)snprintf(NULL, 0, "_%d", varDecl->uniqueName);
+	return length;
+}
+
+// @gfx and @serialize can run on another thread while the other sections are running
+static bool IsSerializedSection(SectionType type)
+{
+	return type == Section_Init ||
+		   type == Section_Slider ||
+		   type == Section_Block ||
+		   type == Section_Sample;
+}
+
+static bool HasSameName(const VarDeclStmt* a, const VarDeclStmt* b)
+{
+	return a->uniqueName == b->uniqueName && strcmp(a->name, b->name) == 0;
+}
+
+static void CoalesceVariables(NodePtr* body, void* region, FuncDeclStmt* function)
+{
+	Array regionLocals;
+	interference = NULL;
+	VisitRegion(body, region, function, &regionLocals);
+	if (!function && IsSerializedSection(((SectionStmt*)region)->sectionType) && regionLocals.length != 0)
+	{
+		Array copy = AllocateArray(sizeof(VarDeclStmt*));
+		for (size_t i = 0; i < regionLocals.length; ++i)
+			ArrayAdd(&copy, regionLocals.array[i]);
+		ArrayAdd(&sectionLocals, &copy);
+	}
+
+	if (!interference)
+	{
+		FreeArray(&regionLocals);
+		return;
+	}
+
+	// each variable goes in the first group of variables that it doesn't interfere with
+	size_t groupCount = 0;
+	size_t* groups = malloc(regionLocals.length * sizeof(size_t));
+	Word* members = calloc(regionLocals.length * wordCount, sizeof(Word));
+	ASSERT(groups && members);
+	for (size_t i = 0; i < regionLocals.length; ++i)
+	{
+		const Word* row = interference + i * wordCount;
+		size_t group = 0;
+		for (; group < groupCount; ++group)
+		{
+			const Word* groupMembers = members + group * wordCount;
+			bool interferes = false;
+			for (size_t j = 0; j < wordCount; ++j)
+				interferes = interferes || (row[j] & groupMembers[j]);
+			if (!interferes)
+				break;
+		}
+
+		if (group == groupCount)
+			++groupCount;
+		groups[i] = group;
+		SetLive(members + group * wordCount, i, true);
+	}
+
+	// the whole group uses the shortest name in it
+	for (size_t group = 0; group < groupCount; ++group)
+	{
+		VarDeclStmt* shortest = NULL;
+		for (size_t i = 0; i < regionLocals.length; ++i)
+		{
+			VarDeclStmt* varDecl = *(VarDeclStmt**)regionLocals.array[i];
+			if (groups[i] == group && (!shortest || GetNameLength(varDecl) < GetNameLength(shortest)))
+				shortest = varDecl;
+		}
+
+		for (size_t i = 0; i < regionLocals.length; ++i)
+		{
+			VarDeclStmt* varDecl = *(VarDeclStmt**)regionLocals.array[i];
+			if (groups[i] != group || varDecl == shortest)
+				continue;
+
+			free(varDecl->name);
+			varDecl->name = AllocateString(shortest->name);
+			varDecl->uniqueName = shortest->uniqueName;
+			++changeCount;
+		}
+	}
+
+	free(members);
+	free(groups);
+	free(interference);
+	interference = NULL;
+	FreeArray(&regionLocals);
+}
+
+// the locals of a section are assigned before they are read every time it runs, so they are never live
+// outside of it. the sections that don't run at the same time can use the same names for them
+static void ShareSectionLocals(void)
+{
+	// each slot is the names that are given to one variable, the first name of each section goes in the first slot
+	Array slots = AllocateArray(sizeof(Array));
+	for (size_t i = 0; i < sectionLocals.length; ++i)
+	{
+		Array* locals = sectionLocals.array[i];
+		Array names = AllocateArray(sizeof(VarDeclStmt*));
+		for (size_t j = 0; j < locals->length; ++j)
+		{
+			VarDeclStmt* varDecl = *(VarDeclStmt**)locals->array[j];
+			size_t slot = 0;
+			while (slot < names.length && !HasSameName(*(VarDeclStmt**)names.array[slot], varDecl))
+				++slot;
+			if (slot == names.length)
+				ArrayAdd(&names, &varDecl);
+
+			if (slot == slots.length)
+			{
+				Array slotLocals = AllocateArray(sizeof(VarDeclStmt*));
+				ArrayAdd(&slots, &slotLocals);
+			}
+			ArrayAdd(slots.array[slot], &varDecl);
+		}
+		FreeArray(&names);
+		FreeArray(locals);
+	}
+
+	// the whole slot uses the shortest name in it
+	for (size_t i = 0; i < slots.length; ++i)
+	{
+		Array* slotLocals = slots.array[i];
+		VarDeclStmt* shortest = NULL;
+		for (size_t j = 0; j < slotLocals->length; ++j)
+		{
+			VarDeclStmt* varDecl = *(VarDeclStmt**)slotLocals->array[j];
+			if (!shortest || GetNameLength(varDecl) < GetNameLength(shortest))
+				shortest = varDecl;
+		}
+
+		for (size_t j = 0; j < slotLocals->length; ++j)
+		{
+			VarDeclStmt* varDecl = *(VarDeclStmt**)slotLocals->array[j];
+			if (HasSameName(varDecl, shortest))
+				continue;
+
+			free(varDecl->name);
+			varDecl->name = AllocateString(shortest->name);
+			varDecl->uniqueName = shortest->uniqueName;
+			++changeCount;
+		}
+		FreeArray(slotLocals);
+	}
+	FreeArray(&slots);
+}
+
+// variables in the same function or section that are never live at the same time are given the same name,
+// so the output uses fewer variables. this has to run after the unique names are assigned
+int VariableCoalescingPass(const AST* ast)
+{
+	changeCount = 0;
+	removeStores = false;
+	sectionLocals = AllocateArray(sizeof(Array));
+	ForEachRegion(ast, CoalesceVariables);
+	ShareSectionLocals();
+	FreeArray(&sectionLocals);
+	return changeCount;
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+#include "SyntaxTree.h"
+
+int DeadStorePass(const AST* ast);
+int VariableCoalescingPass(const AST* ast);
@@ -0,0 +1,721 @@
+#include "LoopIdiomPass.h"
+
+#include "Common.h"
+
+#include <math.h>
+#include <string.h>
+
+typedef enum
+{
+	Idiom_None,
+	Idiom_Copy,
+	Idiom_Fill,
+	Idiom_MultiplySum,
+} Idiom;
+
+typedef struct Position
+{
+	BlockStmt* block;
+	size_t index;
+	const struct Position* parent;
+} Position;
+
+static FuncDeclStmt* copyFunction;
+static FuncDeclStmt* fillFunction;
+static FuncDeclStmt* multiplySumFunction;
+static FuncDeclStmt* currentFunction;
+// the statement that the block being visited is in, if it is directly in another block
+static const Position* parentPosition;
+static bool optimizeForSize;
+static int changeCount;
+
+static FuncDeclStmt* FindBuiltIn(const AST* ast, const char* externalName)
+{
+	for (size_t i = 0; i < ast->nodes.length; ++i)
+	{
+		const ModuleNode* module = ((NodePtr*)ast->nodes.array[i])->ptr;
+		for (size_t j = 0; j < module->statements.length; ++j)
+		{
+			NodePtr* statement = module->statements.array[j];
+			if (statement->type != Node_Section)
+				continue;
+
+			BlockStmt* block = ((SectionStmt*)statement->ptr)->block.ptr;
+			for (size_t k = 0; k < block->statements.length; ++k)
+			{
+				NodePtr* node = block->statements.array[k];
+				if (node->type != Node_FunctionDeclaration)
+					continue;
+
+				FuncDeclStmt* funcDecl = node->ptr;
+				if (funcDecl->modifiers.externalValue &&
+					funcDecl->externalName &&
+					strcmp(funcDecl->externalName, externalName) == 0)
+					return funcDecl;
+			}
+		}
+	}
+	return NULL;
+}
+
+static bool IsVariable(NodePtr node, const VarDeclStmt* varDecl)
+{
+	if (node.type != Node_MemberAccess)
+		return false;
+
+	MemberAccessExpr* memberAccess = node.ptr;
+	return !memberAccess->start.ptr && memberAccess->varReference == varDecl;
+}
+
+// gets the variable and the value of a "var = value" statement or a variable declaration
+static VarDeclStmt* GetAssignment(NodePtr node, NodePtr* value)
+{
+	if (node.type == Node_VariableDeclaration)
+	{
+		VarDeclStmt* varDecl = node.ptr;
+		*value = varDecl->initializer;
+		return varDecl;
+	}
+
+	if (node.type != Node_ExpressionStatement)
+		return NULL;
+
+	ExpressionStmt* exprStmt = node.ptr;
+	if (exprStmt->expr.type != Node_Binary)
+		return NULL;
+
+	BinaryExpr* binary = exprStmt->expr.ptr;
+	if (binary->operatorType != Binary_Assignment || binary->left.type != Node_MemberAccess)
+		return NULL;
+
+	MemberAccessExpr* memberAccess = binary->left.ptr;
+	if (memberAccess->start.ptr)
+		return NULL;
+
+	*value = binary->right;
+	return memberAccess->varReference;
+}
+
+// true if the expression has the same value in every iteration.
+// the counter and the written variable are the only variables that change in the loops this pass looks at
+static bool IsInvariant(NodePtr node, const VarDeclStmt* counter, const VarDeclStmt* written, bool readsMemory)
+{
+	switch (node.type)
+	{
+	case Node_Literal:
+		return true;
+	case Node_MemberAccess:
+	{
+		MemberAccessExpr* memberAccess = node.ptr;
+		return !memberAccess->start.ptr &&
+			   memberAccess->varReference &&
+			   memberAccess->varReference != counter &&
+			   memberAccess->varReference != written;
+	}
+	case Node_Binary:
+	{
+		BinaryExpr* binary = node.ptr;
+		return binary->operatorType < Binary_Assignment &&
+			   IsInvariant(binary->left, counter, written, readsMemory) &&
+			   IsInvariant(binary->right, counter, written, readsMemory);
+	}
+	case Node_Unary:
+	{
+		UnaryExpr* unary = node.ptr;
+		return unary->operatorType != Unary_Increment &&
+			   unary->operatorType != Unary_Decrement &&
+			   IsInvariant(unary->expression, counter, written, readsMemory);
+	}
+	case Node_Subscript:
+	{
+		// only if nothing in the loop writes to memory
+		SubscriptExpr* subscript = node.ptr;
+		return readsMemory &&
+			   IsInvariant(subscript->baseExpr, counter, written, readsMemory) &&
+			   IsInvariant(subscript->indexExpr, counter, written, readsMemory);
+	}
+	default:
+		return false;
+	}
+}
+
+static bool IsWholeNumber(NodePtr node)
+{
+	double value;
+	if (EvaluateConstant(node, NULL, &value))
+		return value == floor(value);
+
+	PrimitiveTypeInfo type = GetPrimitiveTypeInfoFromExpr(node);
+	return type.isPointer || type.effectiveType == Primitive_Int;
+}
+
+// gets the base of a "base[counter]" expression
+static bool GetElement(NodePtr node, const VarDeclStmt* counter, NodePtr* base)
+{
+	if (node.type != Node_Subscript)
+		return false;
+
+	SubscriptExpr* subscript = node.ptr;
+	if (!IsVariable(subscript->indexExpr, counter))
+		return false;
+
+	*base = subscript->baseExpr;
+	return true;
+}
+
+static bool IsIncrement(NodePtr node, const VarDeclStmt* counter)
+{
+	NodePtr value;
+	if (GetAssignment(node, &value) != counter || node.type != Node_ExpressionStatement)
+		return false;
+
+	if (value.type == Node_Binary && ((BinaryExpr*)value.ptr)->operatorType == Binary_BitOr)
+	{
+		// int conversion
+		BinaryExpr* conversion = value.ptr;
+		double zero;
+		if (!EvaluateConstant(conversion->left, NULL, &zero) || zero != 0)
+			return false;
+		value = conversion->right;
+	}
+
+	double one;
+	BinaryExpr* add = value.ptr;
+	return value.type == Node_Binary &&
+		   add->operatorType == Binary_Add &&
+		   IsVariable(add->left, counter) &&
+		   EvaluateConstant(add->right, NULL, &one) &&
+		   one == 1;
+}
+
+// block expressions that are statements are the same as blocks
+static bool IsBlockExpressionStatement(NodePtr node)
+{
+	return node.type == Node_ExpressionStatement && ((ExpressionStmt*)node.ptr)->expr.type == Node_BlockExpression;
+}
+
+static void CollectStatements(NodePtr node, Array* statements)
+{
+	if (node.type == Node_Null)
+		return;
+
+	if (IsBlockExpressionStatement(node))
+	{
+		CollectStatements(((BlockExpr*)((ExpressionStmt*)node.ptr)->expr.ptr)->block, statements);
+		return;
+	}
+
+	if (node.type != Node_BlockStatement)
+	{
+		ArrayAdd(statements, &node);
+		return;
+	}
+
+	BlockStmt* block = node.ptr;
+	for (size_t i = 0; i < block->statements.length; ++i)
+		CollectStatements(*(NodePtr*)block->statements.array[i], statements);
+}
+
+// mem_multiply_sum() adds the products up starting from zero, so the result is only exactly the same
+// if the sum is zero before the loop
+static bool IsZeroBefore(const Position* position, const VarDeclStmt* sum)
+{
+	// the statements before a block run right before it
+	for (; position; position = position->parent)
+	{
+		for (size_t i = position->index; i-- > 0;)
+		{
+			NodePtr node = *(NodePtr*)position->block->statements.array[i];
+			if (node.type == Node_Null)
+				continue;
+
+			NodePtr value;
+			VarDeclStmt* varDecl = GetAssignment(node, &value);
+			if (!varDecl)
+				return false;
+
+			if (varDecl == sum)
+			{
+				double zero;
+				return EvaluateConstant(value, NULL, &zero) && zero == 0;
+			}
+
+			// other variables being set to something without side effects can be skipped
+			if (!IsInvariant(value, NULL, NULL, true))
+				return false;
+		}
+	}
+	return false;
+}
+
+static Idiom GetIdiom(NodePtr statement, const VarDeclStmt* counter, NodePtr* destination, NodePtr* source, VarDeclStmt** sum)
+{
+	if (statement.type != Node_ExpressionStatement)
+		return Idiom_None;
+
+	ExpressionStmt* exprStmt = statement.ptr;
+	BinaryExpr* assignment = exprStmt->expr.ptr;
+	if (exprStmt->expr.type != Node_Binary || assignment->operatorType != Binary_Assignment)
+		return Idiom_None;
+
+	// dst[i] = src[i]; or dst[i] = value;
+	if (GetElement(assignment->left, counter, destination))
+	{
+		if (!IsInvariant(*destination, counter, NULL, false))
+			return Idiom_None;
+
+		if (GetElement(assignment->right, counter, source))
+			return IsInvariant(*source, counter, NULL, false) ? Idiom_Copy : Idiom_None;
+
+		*source = assignment->right;
+		return IsInvariant(*source, counter, NULL, false) ? Idiom_Fill : Idiom_None;
+	}
+
+	// sum = sum + a[i] * b[i]; or sum = sum + a[i];
+	if (assignment->left.type != Node_MemberAccess || assignment->right.type != Node_Binary)
+		return Idiom_None;
+
+	MemberAccessExpr* memberAccess = assignment->left.ptr;
+	BinaryExpr* add = assignment->right.ptr;
+	*sum = memberAccess->varReference;
+	if (memberAccess->start.ptr || !*sum || *sum == counter || add->operatorType != Binary_Add)
+		return Idiom_None;
+
+	NodePtr term = add->right;
+	if (!IsVariable(add->left, *sum))
+	{
+		if (!IsVariable(add->right, *sum))
+			return Idiom_None;
+		term = add->left;
+	}
+
+	BinaryExpr* multiply = term.ptr;
+	if (term.type == Node_Binary && multiply->operatorType == Binary_Multiply)
+	{
+		if (!GetElement(multiply->left, counter, destination) ||
+			!GetElement(multiply->right, counter, source))
+			return Idiom_None;
+	}
+	else if (GetElement(term, counter, destination))
+		*source = NULL_NODE;
+	else
+		return Idiom_None;
+
+	if (!IsInvariant(*destination, counter, *sum, true) ||
+		(source->ptr && !IsInvariant(*source, counter, *sum, true)))
+		return Idiom_None;
+	return Idiom_MultiplySum;
+}
+
+static NodePtr AllocBinary(BinaryOperator operatorType, NodePtr left, NodePtr right, int lineNumber)
+{
+	return AllocASTNode(
+		&(BinaryExpr){
+			.lineNumber = lineNumber,
+			.operatorType = operatorType,
+			.left = left,
+			.right = right,
+		},
+		sizeof(BinaryExpr), Node_Binary);
+}
+
+static NodePtr AllocOffset(NodePtr node, double offset, int lineNumber)
+{
+	if (offset == 0)
+		return node;
+	return AllocBinary(offset > 0 ? Binary_Add : Binary_Subtract, node, AllocDouble(fabs(offset), lineNumber), lineNumber);
+}
+
+static NodePtr AllocCall(FuncDeclStmt* funcDecl, NodePtr* arguments, size_t argumentCount, int lineNumber)
+{
+	++funcDecl->useCount;
+	if (currentFunction)
+		AddFunctionDependency(currentFunction, funcDecl);
+
+	FuncCallExpr* funcCall = AllocASTNode(
+		&(FuncCallExpr){
+			.lineNumber = lineNumber,
+			.arguments = AllocateArray(sizeof(NodePtr)),
+			.baseExpr = AllocASTNode(
+				&(MemberAccessExpr){
+					.lineNumber = lineNumber,
+					.identifiers.array = NULL,
+					.start = NULL_NODE,
+					.funcReference = funcDecl,
+					.typeReference = NULL,
+					.varReference = NULL,
+				},
+				sizeof(MemberAccessExpr), Node_MemberAccess),
+		},
+		sizeof(FuncCallExpr), Node_FunctionCall)
+							  .ptr;
+	for (size_t i = 0; i < argumentCount; ++i)
+		ArrayAdd(&funcCall->arguments, &arguments[i]);
+
+	return AllocASTNode(
+		&(ExpressionStmt){
+			.lineNumber = lineNumber,
+			.expr = (NodePtr){.ptr = funcCall, .type = Node_FunctionCall},
+		},
+		sizeof(ExpressionStmt), Node_ExpressionStatement);
+}
+
+// the loop copies one element at a time, so if the destination starts inside of the source
+// it reads the elements it already wrote. memcpy() copies as if the regions don't overlap
+static NodePtr AllocNoOverlapCondition(NodePtr destination, NodePtr source, NodePtr length, int lineNumber)
+{
+	return AllocBinary(Binary_BoolOr,
+		AllocBinary(Binary_LessOrEqual,
+			AllocBinary(Binary_Subtract, CopyASTNode(destination), CopyASTNode(source), lineNumber),
+			AllocUInt64Integer(0, lineNumber),
+			lineNumber),
+		AllocBinary(Binary_GreaterOrEqual,
+			AllocBinary(Binary_Subtract, CopyASTNode(destination), CopyASTNode(source), lineNumber),
+			CopyASTNode(length),
+			lineNumber),
+		lineNumber);
+}
+
+// loops are usually wrapped in a block that declares the break flag before them
+static NodePtr* GetLoop(NodePtr* node)
+{
+	if (node->type == Node_While)
+		return node;
+
+	if (node->type != Node_BlockStatement)
+		return NULL;
+
+	BlockStmt* block = node->ptr;
+	NodePtr* loop = NULL;
+	for (size_t i = 0; i < block->statements.length; ++i)
+	{
+		NodePtr* statement = block->statements.array[i];
+		double value;
+		if (statement->type == Node_Null)
+			continue;
+		if (loop)
+			return NULL;
+
+		if (statement->type == Node_While)
+			loop = statement;
+		else if (statement->type != Node_VariableDeclaration ||
+				 !EvaluateConstant(((VarDeclStmt*)statement->ptr)->initializer, NULL, &value))
+			return NULL;
+	}
+	return loop;
+}
+
+static NodePtr AllocBlock(NodePtr first, NodePtr second, int lineNumber)
+{
+	BlockStmt* block = AllocASTNode(
+		&(BlockStmt){
+			.lineNumber = lineNumber,
+			.statements = AllocateArray(sizeof(NodePtr)),
+		},
+		sizeof(BlockStmt), Node_BlockStatement)
+						   .ptr;
+	ArrayAdd(&block->statements, &first);
+	if (second.ptr)
+		ArrayAdd(&block->statements, &second);
+	return (NodePtr){.ptr = block, .type = Node_BlockStatement};
+}
+
+// the counter still has to have the right value after the loop
+static NodePtr AllocCounterEnd(VarDeclStmt* counter, double start, NodePtr end, bool inclusive, int lineNumber)
+{
+	return AllocASTNode(
+		&(IfStmt){
+			.lineNumber = lineNumber,
+			.expr = AllocBinary(inclusive ? Binary_LessOrEqual : Binary_LessThan, AllocDouble(start, lineNumber), CopyASTNode(end), lineNumber),
+			.trueStmt = AllocBlock(AllocSetVariable(counter, AllocOffset(CopyASTNode(end), inclusive ? 1 : 0, lineNumber), lineNumber), NULL_NODE, lineNumber),
+			.falseStmt = NULL_NODE,
+		},
+		sizeof(IfStmt), Node_If);
+}
+
+static void ReplaceLoop(const Position* position)
+{
+	BlockStmt* block = position->block;
+	size_t index = position->index;
+	if (index == 0)
+		return;
+
+	NodePtr* node = block->statements.array[index];
+	NodePtr* loopNode = GetLoop(node);
+	if (!loopNode)
+		return;
+
+	NodePtr initializer = NULL_NODE;
+	VarDeclStmt* counter = GetAssignment(*(NodePtr*)block->statements.array[index - 1], &initializer);
+	if (!counter)
+		return;
+
+	WhileStmt* whileStmt = loopNode->ptr;
+	BinaryExpr* condition = whileStmt->expr.ptr;
+	double start;
+	if (counter->modifiers.externalValue ||
+		!EvaluateConstant(initializer, NULL, &start) ||
+		start != floor(start) ||
+		fabs(start) > 1e15 ||
+		whileStmt->expr.type != Node_Binary ||
+		(condition->operatorType != Binary_LessThan && condition->operatorType != Binary_LessOrEqual) ||
+		!IsVariable(condition->left, counter) ||
+		!IsWholeNumber(condition->right))
+		return;
+
+	Array statements = AllocateArray(sizeof(NodePtr));
+	CollectStatements(whileStmt->stmt, &statements);
+	NodePtr destination = NULL_NODE;
+	NodePtr source = NULL_NODE;
+	VarDeclStmt* sum = NULL;
+	Idiom idiom = Idiom_None;
+	if (statements.length == 2 && IsIncrement(*(NodePtr*)statements.array[1], counter))
+		idiom = GetIdiom(*(NodePtr*)statements.array[0], counter, &destination, &source, &sum);
+	FreeArray(&statements);
+
+	NodePtr end = condition->right;
+	if (idiom == Idiom_None ||
+		!IsInvariant(end, counter, sum, idiom == Idiom_MultiplySum) ||
+		(idiom == Idiom_MultiplySum && !IsZeroBefore(position, sum)) ||
+		(idiom == Idiom_Copy && optimizeForSize))
+		return;
+
+	int lineNumber = whileStmt->lineNumber;
+	bool inclusive = condition->operatorType == Binary_LessOrEqual;
+	NodePtr length = AllocOffset(CopyASTNode(end), (inclusive ? 1 : 0) - start, lineNumber);
+	NodePtr replacement = NULL_NODE;
+	switch (idiom)
+	{
+	case Idiom_Copy:
+	{
+		NodePtr condition = AllocNoOverlapCondition(destination, source, length, lineNumber);
+		bool noOverlap;
+		bool known = EvaluateCondition(condition, NULL, &noOverlap);
+		if (known && !noOverlap)
+		{
+			FreeASTNode(condition);
+			FreeASTNode(length);
+			return;
+		}
+
+		NodePtr arguments[] = {
+			AllocOffset(CopyASTNode(destination), start, lineNumber),
+			AllocOffset(CopyASTNode(source), start, lineNumber),
+			length,
+		};
+		replacement = AllocBlock(
+			AllocCall(copyFunction, arguments, 3, lineNumber),
+			AllocCounterEnd(counter, start, end, inclusive, lineNumber),
+			lineNumber);
+		if (!known)
+		{
+			// the loop is still needed for when they do overlap
+			*loopNode = AllocASTNode(
+				&(IfStmt){
+					.lineNumber = lineNumber,
+					.expr = condition,
+					.trueStmt = replacement,
+					.falseStmt = AllocBlock(*loopNode, NULL_NODE, lineNumber),
+				},
+				sizeof(IfStmt), Node_If);
+			++changeCount;
+			return;
+		}
+		FreeASTNode(condition);
+		break;
+	}
+	case Idiom_Fill:
+	{
+		NodePtr arguments[] = {
+			AllocOffset(CopyASTNode(destination), start, lineNumber),
+			CopyASTNode(source),
+			length,
+		};
+		replacement = AllocCall(fillFunction, arguments, 3, lineNumber);
+		break;
+	}
+	case Idiom_MultiplySum:
+	{
+		// -2 makes it add up the elements of the first buffer
+		NodePtr arguments[] = {
+			AllocOffset(CopyASTNode(destination), start, lineNumber),
+			source.ptr ? AllocOffset(CopyASTNode(source), start, lineNumber) : AllocDouble(-2, lineNumber),
+			length,
+		};
+		replacement = AllocCall(multiplySumFunction, arguments, 3, lineNumber);
+		ExpressionStmt* exprStmt = replacement.ptr;
+		exprStmt->expr = AllocBinary(Binary_Assignment, AllocIdentifier(sum, lineNumber), exprStmt->expr, lineNumber);
+		break;
+	}
+	default: INVALID_VALUE(idiom);
+	}
+	if (idiom != Idiom_Copy)
+		replacement = AllocBlock(replacement, AllocCounterEnd(counter, start, end, inclusive, lineNumber), lineNumber);
+
+	RemoveFunctionReferences(*loopNode, currentFunction);
+	FreeASTNode(*loopNode);
+	*loopNode = replacement;
+	++changeCount;
+}
+
+static void VisitStatement(NodePtr* node);
+
+// inlined functions are block expressions
+static void VisitExpression(NodePtr* node)
+{
+	switch (node->type)
+	{
+	case Node_BlockExpression:
+	{
+		BlockExpr* blockExpr = node->ptr;
+		VisitStatement(&blockExpr->block);
+		break;
+	}
+	case Node_Binary:
+	{
+		BinaryExpr* binary = node->ptr;
+		VisitExpression(&binary->left);
+		VisitExpression(&binary->right);
+		break;
+	}
+	case Node_Unary:
+	{
+		UnaryExpr* unary = node->ptr;
+		VisitExpression(&unary->expression);
+		break;
+	}
+	case Node_FunctionCall:
+	{
+		FuncCallExpr* funcCall = node->ptr;
+		for (size_t i = 0; i < funcCall->arguments.length; ++i)
+			VisitExpression(funcCall->arguments.array[i]);
+		break;
+	}
+	case Node_Subscript:
+	{
+		SubscriptExpr* subscript = node->ptr;
+		VisitExpression(&subscript->baseExpr);
+		VisitExpression(&subscript->indexExpr);
+		break;
+	}
+	case Node_MemberAccess:
+	{
+		MemberAccessExpr* memberAccess = node->ptr;
+		VisitExpression(&memberAccess->start);
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+static void VisitStatement(NodePtr* node)
+{
+	switch (node->type)
+	{
+	case Node_BlockStatement:
+	{
+		Position position = {.block = node->ptr, .parent = parentPosition};
+		for (size_t i = 0; i < position.block->statements.length; ++i)
+		{
+			NodePtr* statement = position.block->statements.array[i];
+			position.index = i;
+			parentPosition = statement->type == Node_BlockStatement || IsBlockExpressionStatement(*statement) ? &position : NULL;
+			VisitStatement(statement);
+			parentPosition = position.parent;
+			ReplaceLoop(&position);
+		}
+		break;
+	}
+	case Node_ExpressionStatement:
+	{
+		ExpressionStmt* exprStmt = node->ptr;
+		VisitExpression(&exprStmt->expr);
+		break;
+	}
+	case Node_VariableDeclaration:
+	{
+		VarDeclStmt* varDecl = node->ptr;
+		VisitExpression(&varDecl->initializer);
+		break;
+	}
+	case Node_Return:
+	{
+		ReturnStmt* returnStmt = node->ptr;
+		VisitExpression(&returnStmt->expr);
+		break;
+	}
+	case Node_FunctionDeclaration:
+	{
+		FuncDeclStmt* funcDecl = node->ptr;
+		if (funcDecl->modifiers.externalValue)
+			break;
+
+		FuncDeclStmt* previousFunction = currentFunction;
+		currentFunction = funcDecl;
+		VisitStatement(&funcDecl->block);
+		currentFunction = previousFunction;
+		break;
+	}
+	case Node_If:
+	{
+		IfStmt* ifStmt = node->ptr;
+		VisitExpression(&ifStmt->expr);
+		VisitStatement(&ifStmt->trueStmt);
+		VisitStatement(&ifStmt->falseStmt);
+		break;
+	}
+	case Node_While:
+	{
+		WhileStmt* whileStmt = node->ptr;
+		VisitExpression(&whileStmt->expr);
+		VisitStatement(&whileStmt->stmt);
+		break;
+	}
+	case Node_Section:
+	{
+		SectionStmt* section = node->ptr;
+		VisitStatement(&section->block);
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+// replaces loops that copy, fill or add up memory one element at a time with a single call
+// to memcpy(), memset() or mem_multiply_sum(), which do the same thing natively
+int LoopIdiomPass(const AST* ast, bool firstRun, bool forSize)
+{
+	optimizeForSize = forSize;
+	changeCount = 0;
+
+	copyFunction = FindBuiltIn(ast, "memcpy");
+	fillFunction = FindBuiltIn(ast, "memset");
+	multiplySumFunction = FindBuiltIn(ast, "mem_multiply_sum");
+	if (!copyFunction || !fillFunction || !multiplySumFunction)
+		return changeCount;
+
+	// the loops usually only look like this after a few iterations,
+	// so the built-ins have to stay around even if nothing calls them yet
+	if (firstRun)
+	{
+		++copyFunction->useCount;
+		++fillFunction->useCount;
+		++multiplySumFunction->useCount;
+	}
+
+	for (size_t i = 0; i < ast->nodes.length; ++i)
+	{
+		const NodePtr* node = ast->nodes.array[i];
+
+		ASSERT(node->type == Node_Module);
+		const ModuleNode* module = node->ptr;
+
+		currentFunction = NULL;
+		parentPosition = NULL;
+		for (size_t i = 0; i < module->statements.length; ++i)
+			VisitStatement(module->statements.array[i]);
+	}
+	return changeCount;
+}
@@ -0,0 +1,5 @@
+#pragma once
+
+#include "SyntaxTree.h"
+
+int LoopIdiomPass(const AST* ast, bool firstRun, bool forSize);
@@ -0,0 +1,317 @@
+#include "LoopUnrollingPass.h"
+
+#include "Common.h"
+
+#include <math.h>
+
+// loops that run at most this many times are unrolled
+#define MAX_ITERATIONS 8
+// as long as the unrolled loop is at most this big (in syntax tree nodes)
+#define MAX_UNROLLED_SIZE 256
+// loops marked with [unroll: true] only have this limit
+#define MAX_FORCED_ITERATIONS 1024
+
+static FuncDeclStmt* currentFunction;
+static bool onlyForced;
+static int changeCount;
+
+static void VisitStatement(NodePtr* node);
+
+// gets the variable and the value of a "var = value" statement or a variable declaration
+static VarDeclStmt* GetAssignment(NodePtr node, NodePtr* value)
+{
+	if (node.type == Node_VariableDeclaration)
+	{
+		VarDeclStmt* varDecl = node.ptr;
+		*value = varDecl->initializer;
+		return varDecl;
+	}
+
+	if (node.type != Node_ExpressionStatement)
+		return NULL;
+
+	ExpressionStmt* exprStmt = node.ptr;
+	if (exprStmt->expr.type != Node_Binary)
+		return NULL;
+
+	BinaryExpr* binary = exprStmt->expr.ptr;
+	if (binary->operatorType != Binary_Assignment || binary->left.type != Node_MemberAccess)
+		return NULL;
+
+	MemberAccessExpr* memberAccess = binary->left.ptr;
+	if (memberAccess->start.ptr)
+		return NULL;
+
+	*value = binary->right;
+	return memberAccess->varReference;
+}
+
+static NodePtr AllocWholeNumber(double value, int lineNumber)
+{
+	if (value < 0)
+		return AllocASTNode(
+			&(UnaryExpr){
+				.lineNumber = lineNumber,
+				.operatorType = Unary_Minus,
+				.expression = AllocUInt64Integer((uint64_t)-value, lineNumber),
+			},
+			sizeof(UnaryExpr), Node_Unary);
+	else
+		return AllocUInt64Integer((uint64_t)value, lineNumber);
+}
+
+static void FreeValues(Array* values)
+{
+	for (size_t i = 0; i < values->length; ++i)
+		FreeASTNode(*(NodePtr*)values->array[i]);
+	FreeArray(values);
+}
+
+static void AddConstants(Map* map, const Array* flags)
+{
+	for (size_t i = 0; i < flags->length; ++i)
+	{
+		VarDeclStmt* flag = *(VarDeclStmt**)flags->array[i];
+		AddVariableMapping(map, flag, flag->initializer);
+	}
+}
+
+// runs the loop counter through the condition and the increment.
+// the values it has in each iteration are added to the array, and the last one is the value after the loop
+static bool CollectIterationValues(
+	VarDeclStmt* counter, double value, const Array* flags, WhileStmt* whileStmt, NodePtr increment, int maxIterations, Array* values)
+{
+	while (true)
+	{
+		if (fabs(value) > 1e15 || (double)(int64_t)value != value)
+			return false;
+
+		NodePtr literal = AllocWholeNumber(value, whileStmt->lineNumber);
+		ArrayAdd(values, &literal);
+
+		Map constants = AllocateMap(sizeof(NodePtr));
+		AddConstants(&constants, flags);
+		AddVariableMapping(&constants, counter, literal);
+
+		bool condition;
+		bool success = EvaluateCondition(whileStmt->expr, &constants, &condition);
+		if (success && condition)
+			success = values->length <= (size_t)maxIterations &&
+					  EvaluateConstant(increment, &constants, &value);
+		FreeMap(&constants);
+
+		if (!success)
+			return false;
+		if (!condition)
+			return true;
+	}
+}
+
+static bool CanUnroll(VarDeclStmt* counter, const Array* flags, WhileStmt* whileStmt)
+{
+	if (!counter || counter->modifiers.externalValue)
+		return false;
+
+	// the counter can only be changed by the increment at the end, and the flags can't be changed at all
+	BlockStmt* block = whileStmt->stmt.ptr;
+	Map writes = AllocateMap(sizeof(VarDeclStmt*));
+	bool hasCalls = false;
+	CollectWrittenVariables(whileStmt->expr, &writes, &hasCalls);
+	for (size_t i = 0; i + 1 < block->statements.length; ++i)
+		CollectWrittenVariables(*(NodePtr*)block->statements.array[i], &writes, &hasCalls);
+	bool written = IsVariableWritten(&writes, counter);
+	for (size_t i = 0; i < flags->length; ++i)
+		written = written || IsVariableWritten(&writes, *(VarDeclStmt**)flags->array[i]);
+	FreeMap(&writes);
+	if (written)
+		return false;
+
+	// functions called in the loop would still see the original variables
+	Array variables = AllocateArray(sizeof(VarDeclStmt*));
+	ArrayAdd(&variables, &counter);
+	for (size_t i = 0; i < flags->length; ++i)
+		ArrayAdd(&variables, flags->array[i]);
+	CollectVariableDeclarations(whileStmt->stmt, &variables);
+	bool used = CalleesUseAnyVariable(whileStmt->stmt, &variables);
+	FreeArray(&variables);
+	return !used;
+}
+
+// loops are usually wrapped in a block that declares the break flag before them
+static WhileStmt* GetLoop(NodePtr node, Array* flags)
+{
+	if (node.type == Node_While)
+		return node.ptr;
+
+	if (node.type != Node_BlockStatement)
+		return NULL;
+
+	BlockStmt* block = node.ptr;
+	if (block->statements.length == 0)
+		return NULL;
+
+	NodePtr* last = block->statements.array[block->statements.length - 1];
+	if (last->type != Node_While)
+		return NULL;
+
+	for (size_t i = 0; i + 1 < block->statements.length; ++i)
+	{
+		NodePtr* statement = block->statements.array[i];
+		double value;
+		if (statement->type != Node_VariableDeclaration ||
+			!EvaluateConstant(((VarDeclStmt*)statement->ptr)->initializer, NULL, &value))
+			return NULL;
+		ArrayAdd(flags, &statement->ptr);
+	}
+
+	return last->ptr;
+}
+
+// replaces a while loop that runs a constant number of times with a copy of its body for each iteration.
+// the counter is replaced with its value in each copy
+static void UnrollLoop(BlockStmt* block, size_t index)
+{
+	if (index == 0)
+		return;
+
+	NodePtr* node = block->statements.array[index];
+	Array flags = AllocateArray(sizeof(VarDeclStmt*));
+	WhileStmt* whileStmt = GetLoop(*node, &flags);
+	if (!whileStmt ||
+		whileStmt->unroll == PropertyBoolean_False ||
+		(onlyForced && whileStmt->unroll != PropertyBoolean_True) ||
+		whileStmt->stmt.type != Node_BlockStatement ||
+		((BlockStmt*)whileStmt->stmt.ptr)->statements.length == 0)
+	{
+		FreeArray(&flags);
+		return;
+	}
+
+	BlockStmt* body = whileStmt->stmt.ptr;
+	NodePtr initializer = NULL_NODE;
+	VarDeclStmt* counter = GetAssignment(*(NodePtr*)block->statements.array[index - 1], &initializer);
+	NodePtr increment = NULL_NODE;
+	NodePtr* last = body->statements.array[body->statements.length - 1];
+	double start;
+	if (last->type != Node_ExpressionStatement ||
+		GetAssignment(*last, &increment) != counter ||
+		!CanUnroll(counter, &flags, whileStmt) ||
+		!EvaluateConstant(initializer, NULL, &start))
+	{
+		FreeArray(&flags);
+		return;
+	}
+
+	int maxIterations = whileStmt->unroll == PropertyBoolean_True ? MAX_FORCED_ITERATIONS : MAX_ITERATIONS;
+	Array values = AllocateArray(sizeof(NodePtr));
+	bool success = CollectIterationValues(counter, start, &flags, whileStmt, increment, maxIterations, &values);
+	size_t iterations = values.length - 1;
+	if (success && whileStmt->unroll != PropertyBoolean_True)
+		success = iterations * (size_t)CountNodes(whileStmt->stmt) <= MAX_UNROLLED_SIZE;
+	if (!success)
+	{
+		FreeValues(&values);
+		FreeArray(&flags);
+		return;
+	}
+
+	BlockStmt* unrolled = AllocASTNode(
+		&(BlockStmt){
+			.lineNumber = whileStmt->lineNumber,
+			.statements = AllocateArray(sizeof(NodePtr)),
+		},
+		sizeof(BlockStmt), Node_BlockStatement)
+							  .ptr;
+	for (size_t i = 0; i < iterations; ++i)
+	{
+		Map variables = AllocateMap(sizeof(NodePtr));
+		AddConstants(&variables, &flags);
+		AddVariableMapping(&variables, counter, *(NodePtr*)values.array[i]);
+		NodePtr copy = AllocStatementCopy(whileStmt->stmt, &variables, currentFunction);
+		FreeMap(&variables);
+
+		// the increment is not needed anymore
+		BlockStmt* copyBlock = copy.ptr;
+		FreeASTNode(*(NodePtr*)copyBlock->statements.array[copyBlock->statements.length - 1]);
+		ArrayRemove(&copyBlock->statements, copyBlock->statements.length - 1);
+
+		ArrayAdd(&unrolled->statements, &copy);
+	}
+
+	// the counter still has the right value after the loop
+	NodePtr end = AllocSetVariable(counter, CopyASTNode(*(NodePtr*)values.array[iterations]), whileStmt->lineNumber);
+	ArrayAdd(&unrolled->statements, &end);
+	FreeValues(&values);
+	FreeArray(&flags);
+
+	RemoveFunctionReferences(*node, currentFunction);
+	FreeASTNode(*node);
+	*node = (NodePtr){.ptr = unrolled, .type = Node_BlockStatement};
+	++changeCount;
+}
+
+static void VisitStatement(NodePtr* node)
+{
+	switch (node->type)
+	{
+	case Node_BlockStatement:
+	{
+		BlockStmt* block = node->ptr;
+		for (size_t i = 0; i < block->statements.length; ++i)
+		{
+			NodePtr* statement = block->statements.array[i];
+			VisitStatement(statement);
+			UnrollLoop(block, i);
+		}
+		break;
+	}
+	case Node_FunctionDeclaration:
+	{
+		FuncDeclStmt* funcDecl = node->ptr;
+		FuncDeclStmt* previousFunction = currentFunction;
+		currentFunction = funcDecl;
+		VisitStatement(&funcDecl->block);
+		currentFunction = previousFunction;
+		break;
+	}
+	case Node_If:
+	{
+		IfStmt* ifStmt = node->ptr;
+		VisitStatement(&ifStmt->trueStmt);
+		VisitStatement(&ifStmt->falseStmt);
+		break;
+	}
+	case Node_While:
+	{
+		WhileStmt* whileStmt = node->ptr;
+		VisitStatement(&whileStmt->stmt);
+		break;
+	}
+	case Node_Section:
+	{
+		SectionStmt* section = node->ptr;
+		VisitStatement(&section->block);
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+int LoopUnrollingPass(const AST* ast, bool forcedOnly)
+{
+	onlyForced = forcedOnly;
+	changeCount = 0;
+	for (size_t i = 0; i < ast->nodes.length; ++i)
+	{
+		const NodePtr* node = ast->nodes.array[i];
+
+		ASSERT(node->type == Node_Module);
+		const ModuleNode* module = node->ptr;
+
+		currentFunction = NULL;
+		for (size_t i = 0; i < module->statements.length; ++i)
+			VisitStatement(module->statements.array[i]);
+	}
+	return changeCount;
+}
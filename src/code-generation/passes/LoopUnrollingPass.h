@@ -0,0 +1,5 @@
+#pragma once
+
+#include "SyntaxTree.h"
+
+int LoopUnrollingPass(const AST* ast, bool forcedOnly);
@@ -1,11 +1,17 @@
 #include "MarkUnusedPass.h"
 
+#include "Common.h"
+
+static FuncDeclStmt* currentFunction;
+static int changeCount;
+
 static void VisitStatement(NodePtr* node, bool endOfFunction);
 static void ProcessAssignment(NodePtr assignment);
 
 static void ProcessFuncDecl(FuncDeclStmt* funcDecl)
 {
-	if (funcDecl->useCount != 0)
+	// it can already have been marked by a function that called it
+	if (funcDecl->unused || funcDecl->useCount != 0)
 		return;
 
 	for (size_t i = 0; i < funcDecl->dependencies.length; ++i)
@@ -135,9 +141,13 @@ static bool NodeHasSideEffects(NodePtr node)
 	{
 	case Node_Literal:
 	case Node_MemberAccess:
-	case Node_Unary:
 	case Node_Null:
 		return false;
+	case Node_Unary:
+	{
+		UnaryExpr* unary = node.ptr;
+		return NodeHasSideEffects(unary->expression);
+	}
 	case Node_Binary:
 	{
 		BinaryExpr* binary = node.ptr;
@@ -157,7 +167,7 @@ static bool NodeHasSideEffects(NodePtr node)
 		MemberAccessExpr* memberAccess = funcCall->baseExpr.ptr;
 		ASSERT(memberAccess->funcReference);
 		if (memberAccess->funcReference->modifiers.externalValue)
-			return true;
+			return memberAccess->funcReference->pure != PropertyBoolean_True;
 		return NodeHasSideEffects(memberAccess->funcReference->block);
 	}
 	case Node_Subscript:
@@ -247,6 +257,16 @@ static NodePtr GetAssignmentRight(NodePtr assignment)
 		UNREACHABLE();
 }
 
+static bool GetAssignmentUnused(NodePtr assignment)
+{
+	if (assignment.type == Node_VariableDeclaration)
+		return ((VarDeclStmt*)assignment.ptr)->unused;
+	else if (assignment.type == Node_ExpressionStatement)
+		return ((ExpressionStmt*)assignment.ptr)->unused;
+	else
+		UNREACHABLE();
+}
+
 static void SetAssignmentUnused(NodePtr assignment)
 {
 	if (assignment.type == Node_VariableDeclaration)
@@ -283,7 +303,8 @@ static void UpdateDeps(NodePtr node)
 static void ProcessAssignment(NodePtr assignment)
 {
 	ASSERT(*GetUseCount(assignment) >= 0);
-	if (GetDoNotOptimize(assignment) || *GetUseCount(assignment) != 0)
+	// it can already have been marked by an assignment that it was a dep of
+	if (GetAssignmentUnused(assignment) || GetDoNotOptimize(assignment) || *GetUseCount(assignment) != 0)
 		return;
 
 	SetAssignmentUnused(assignment);
@@ -293,6 +314,38 @@ static void ProcessAssignment(NodePtr assignment)
 		UpdateDeps(GetAssignmentRight(assignment));
 }
 
+// a statement is empty when nothing will be left of it after the unused assignments are removed
+static bool IsEmptyStatement(NodePtr node)
+{
+	switch (node.type)
+	{
+	case Node_Null:
+		return true;
+	case Node_ExpressionStatement:
+	{
+		ExpressionStmt* exprStmt = node.ptr;
+		return exprStmt->unused && !exprStmt->keepRight;
+	}
+	case Node_VariableDeclaration:
+	{
+		VarDeclStmt* varDecl = node.ptr;
+		return varDecl->unused && !varDecl->keepRight;
+	}
+	case Node_BlockStatement:
+	{
+		BlockStmt* block = node.ptr;
+		for (size_t i = 0; i < block->statements.length; ++i)
+		{
+			if (!IsEmptyStatement(*(NodePtr*)block->statements.array[i]))
+				return false;
+		}
+		return true;
+	}
+	default:
+		return false;
+	}
+}
+
 static void VisitExpression(const NodePtr node, bool parentIsExprStmt)
 {
 	switch (node.type)
@@ -373,6 +426,7 @@ static void VisitStatement(NodePtr* node, bool endOfFunction)
 		{
 			UpdateDeps(*node);
 			*node = NULL_NODE;
+			++changeCount;
 			break;
 		}
 		VisitExpression(exprStmt->expr, true);
@@ -404,12 +458,17 @@ static void VisitStatement(NodePtr* node, bool endOfFunction)
 			varDecl->doNotOptimize = true;
 		}
 
-		if (!funcDecl->modifiers.externalValue)
+		// a function that isn't called anymore is removed anyway,
+		// and its body can still use variables from code that was removed along with the call
+		if (!funcDecl->modifiers.externalValue && funcDecl->useCount != 0)
 		{
+			FuncDeclStmt* previousFunction = currentFunction;
+			currentFunction = funcDecl;
 			ASSERT(funcDecl->block.type == Node_BlockStatement);
 			BlockStmt* block = funcDecl->block.ptr;
 			for (size_t i = 0; i < block->statements.length; ++i)
 				VisitStatement(block->statements.array[i], i == block->statements.length - 1);
+			currentFunction = previousFunction;
 		}
 
 		ProcessFuncDecl(funcDecl);
@@ -428,6 +487,18 @@ static void VisitStatement(NodePtr* node, bool endOfFunction)
 		VisitExpression(ifStmt->expr, false);
 		VisitStatement(&ifStmt->falseStmt, false);
 		VisitStatement(&ifStmt->trueStmt, false);
+
+		// an if statement that doesn't do anything in either branch is removed along with its condition.
+		// this happens a lot with the flags from control flow statements
+		if (IsEmptyStatement(ifStmt->trueStmt) &&
+			IsEmptyStatement(ifStmt->falseStmt) &&
+			!NodeHasSideEffects(ifStmt->expr))
+		{
+			UpdateDeps(ifStmt->expr);
+			RemoveFunctionReferences(ifStmt->expr, currentFunction);
+			*node = NULL_NODE;
+			++changeCount;
+		}
 		break;
 	}
 	case Node_Section:
@@ -448,8 +519,9 @@ static void VisitStatement(NodePtr* node, bool endOfFunction)
 	}
 }
 
-void MarkUnusedPass(const AST* ast)
+int MarkUnusedPass(const AST* ast)
 {
+	changeCount = 0;
 	for (size_t i = 0; i < ast->nodes.length; ++i)
 	{
 		const NodePtr* node = ast->nodes.array[i];
@@ -457,7 +529,9 @@ void MarkUnusedPass(const AST* ast)
 		ASSERT(node->type == Node_Module);
 		const ModuleNode* module = node->ptr;
 
+		currentFunction = NULL;
 		for (size_t i = 0; i < module->statements.length; ++i)
 			VisitStatement(module->statements.array[i], false);
 	}
+	return changeCount;
 }
@@ -2,4 +2,4 @@
 
 #include "SyntaxTree.h"
 
-void MarkUnusedPass(const AST* ast);
+int MarkUnusedPass(const AST* ast);
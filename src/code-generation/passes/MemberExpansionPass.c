@@ -163,17 +163,6 @@ static NodePtr AllocMultiply(NodePtr left, NodePtr right, int lineNumber)
 		sizeof(BinaryExpr), Node_Binary);
 }
 
-static NodePtr AllocStructOffsetCalculation(NodePtr offset, size_t memberIndex, size_t memberCount, int lineNumber)
-{
-	return AllocASTNode(
-		&(BinaryExpr){
-			.lineNumber = lineNumber,
-			.operatorType = Binary_Add,
-			.left = AllocMultiply(offset, AllocSizeInteger(memberCount, lineNumber), lineNumber),
-			.right = AllocSizeInteger(memberIndex, lineNumber),
-		},
-		sizeof(BinaryExpr), Node_Binary);
-}
 
 typedef struct
 {
@@ -215,12 +204,43 @@ static size_t CountStructMembers(StructDeclStmt* type)
 	return ForEachStructMember(type, NULL, NULL, NULL, NULL);
 }
 
+// how far apart two elements are in memory.
+// with the soa layout each member has its own array, so the elements are next to each other
+static size_t GetElementStride(StructDeclStmt* type)
+{
+	if (type->layout == StructLayout_StructOfArrays)
+		return 1;
+	return CountStructMembers(type);
+}
+
+static NodePtr AllocStructOffsetCalculation(NodePtr offset, size_t memberIndex, StructDeclStmt* type, int lineNumber)
+{
+	if (type->layout == StructLayout_StructOfArrays)
+		return AllocASTNode(
+			&(BinaryExpr){
+				.lineNumber = lineNumber,
+				.operatorType = Binary_Add,
+				.left = offset,
+				.right = AllocUInt64Integer(memberIndex * type->capacity, lineNumber),
+			},
+			sizeof(BinaryExpr), Node_Binary);
+
+	return AllocASTNode(
+		&(BinaryExpr){
+			.lineNumber = lineNumber,
+			.operatorType = Binary_Add,
+			.left = AllocMultiply(offset, AllocSizeInteger(CountStructMembers(type), lineNumber), lineNumber),
+			.right = AllocSizeInteger(memberIndex, lineNumber),
+		},
+		sizeof(BinaryExpr), Node_Binary);
+}
+
 typedef struct
 {
 	NodePtr argumentNode;
 	FuncCallExpr* funcCall;
 	size_t argumentIndex;
-	size_t memberCount;
+	StructDeclStmt* type;
 } ExpandArgumentData;
 
 static void CollapseSubscriptMemberAccess(NodePtr* node, Array* parentRefs)
@@ -256,7 +276,7 @@ static void CollapseSubscriptMemberAccess(NodePtr* node, Array* parentRefs)
 	subscript->indexExpr = AllocStructOffsetCalculation(
 		AllocIntConversion(subscript->indexExpr, subscript->lineNumber),
 		GetIndexOfMember(type, memberAccess->varReference, &memberAccess->parentRefs),
-		CountStructMembers(type),
+		type,
 		subscript->lineNumber);
 
 	// undo merging
@@ -275,7 +295,7 @@ static NodePtr AllocStructMemberAssignmentExpr(
 	NodePtr node,
 	VarDeclStmt* member,
 	size_t index,
-	size_t memberCount,
+	StructDeclStmt* type,
 	Array* parentRefs)
 {
 	switch (node.type)
@@ -373,7 +393,7 @@ static NodePtr AllocStructMemberAssignmentExpr(
 		new->indexExpr = AllocStructOffsetCalculation(
 			AllocIntConversion(new->indexExpr, subscript->lineNumber),
 			index,
-			memberCount,
+			type,
 			subscript->lineNumber);
 		return copy;
 	}
@@ -385,7 +405,7 @@ static void ExpandArgument(VarDeclStmt* member, size_t index, Array* parentRefs,
 {
 	const ExpandArgumentData* d = data;
 
-	NodePtr expr = AllocStructMemberAssignmentExpr(d->argumentNode, member, index, d->memberCount, parentRefs);
+	NodePtr expr = AllocStructMemberAssignmentExpr(d->argumentNode, member, index, d->type, parentRefs);
 	ArrayInsert(&d->funcCall->arguments, &expr, d->argumentIndex + index);
 }
 
@@ -443,7 +463,7 @@ static Result VisitFunctionCallArguments(FuncCallExpr* funcCall, NodePtr* contai
 				.argumentNode = argument,
 				.funcCall = funcCall,
 				.argumentIndex = argIndex,
-				.memberCount = ForEachStructMember(argType.effectiveType, NULL, NULL, NULL, NULL),
+				.type = argType.effectiveType,
 			},
 			NULL,
 			&parentRefs);
@@ -461,15 +481,15 @@ typedef struct
 	NodePtr leftExpr;
 	NodePtr rightExpr;
 	Array* statements;
-	size_t memberCount;
+	StructDeclStmt* type;
 } GenerateStructMemberAssignmentData;
 
 static void GenerateStructMemberAssignment(VarDeclStmt* member, size_t index, Array* parentRefs, void* data)
 {
 	const GenerateStructMemberAssignmentData* d = data;
 	NodePtr statement = AllocAssignmentStatement(
-		AllocStructMemberAssignmentExpr(d->leftExpr, member, index, d->memberCount, parentRefs),
-		AllocStructMemberAssignmentExpr(d->rightExpr, member, index, d->memberCount, parentRefs),
+		AllocStructMemberAssignmentExpr(d->leftExpr, member, index, d->type, parentRefs),
+		AllocStructMemberAssignmentExpr(d->rightExpr, member, index, d->type, parentRefs),
 		-1);
 	ArrayAdd(d->statements, &statement);
 }
@@ -510,13 +530,13 @@ static Result VisitBinaryExpression(NodePtr* node, NodePtr* containingStatement)
 		if (leftType.isPointer && leftType.pointerType && !rightType.isPointer)
 			binary->right = AllocMultiply(
 				binary->right,
-				AllocSizeInteger(CountStructMembers(leftType.pointerType), binary->lineNumber),
+				AllocSizeInteger(GetElementStride(leftType.pointerType), binary->lineNumber),
 				binary->lineNumber);
 
 		if (rightType.isPointer && rightType.pointerType && !leftType.isPointer)
 			binary->left = AllocMultiply(
 				binary->left,
-				AllocSizeInteger(CountStructMembers(rightType.pointerType), binary->lineNumber),
+				AllocSizeInteger(GetElementStride(rightType.pointerType), binary->lineNumber),
 				binary->lineNumber);
 	}
 
@@ -541,7 +561,7 @@ static Result VisitBinaryExpression(NodePtr* node, NodePtr* containingStatement)
 			.statements = &block->statements,
 			.leftExpr = binary->left,
 			.rightExpr = binary->right,
-			.memberCount = CountStructMembers(type),
+			.type = type,
 		},
 		NULL,
 		&parentRefs);
@@ -629,6 +649,9 @@ static Result VisitSizeOfExpression(NodePtr* node, NodePtr* containingStatement)
 		typeInfo = GetStructTypeInfoFromType(sizeOf->type);
 
 	uint64_t value = typeInfo.effectiveType ? CountStructMembers(typeInfo.effectiveType) : 1;
+	// the members of a soa struct each have their own array, so a buffer of them takes up all of those arrays
+	if (typeInfo.effectiveType && typeInfo.effectiveType->layout == StructLayout_StructOfArrays)
+		value *= typeInfo.effectiveType->capacity;
 	int lineNumber = sizeOf->lineNumber;
 	FreeASTNode(*node);
 	*node = AllocUInt64Integer(value, lineNumber);
@@ -746,7 +769,7 @@ typedef struct
 {
 	NodePtr expr;
 	NodePtr block;
-	size_t memberCount;
+	StructDeclStmt* type;
 } GenerateStructMemberExprData;
 
 static void GenerateStructMemberExpr(VarDeclStmt* member, size_t index, Array* parentRefs, void* data)
@@ -754,7 +777,7 @@ static void GenerateStructMemberExpr(VarDeclStmt* member, size_t index, Array* p
 	const GenerateStructMemberExprData* d = data;
 	NodePtr stmt = AllocASTNode(
 		&(ExpressionStmt){
-			.expr = AllocStructMemberAssignmentExpr(d->expr, member, index, d->memberCount, parentRefs),
+			.expr = AllocStructMemberAssignmentExpr(d->expr, member, index, d->type, parentRefs),
 		},
 		sizeof(ExpressionStmt), Node_ExpressionStatement);
 
@@ -781,7 +804,7 @@ static Result VisitExpressionStatement(NodePtr* node)
 				&(GenerateStructMemberExprData){
 					.block = block,
 					.expr = exprStmt->expr,
-					.memberCount = CountStructMembers(typeInfo.effectiveType),
+					.type = typeInfo.effectiveType,
 				},
 				NULL,
 				&parentRefs);
@@ -960,6 +983,15 @@ static Result VisitVariableDeclaration(NodePtr* node)
 	BlockStmt* block = AllocBlockStmt(varDecl->lineNumber).ptr;
 	InstantiateMembers(type, &varDecl->instantiatedVariables, &block->statements, block->statements.length);
 
+	// static buffers already have a place in memory
+	if (varDecl->staticLength != 0)
+	{
+		VarDeclStmt* ptr = *(VarDeclStmt**)varDecl->instantiatedVariables.array[ARRAY_STRUCT_PTR_MEMBER_INDEX];
+		VarDeclStmt* length = *(VarDeclStmt**)varDecl->instantiatedVariables.array[ARRAY_STRUCT_LENGTH_MEMBER_INDEX];
+		ptr->initializer = AllocUInt64Integer(varDecl->staticAddress, varDecl->lineNumber);
+		length->initializer = AllocUInt64Integer(varDecl->staticLength, varDecl->lineNumber);
+	}
+
 	if (varDecl->initializer.ptr != NULL)
 	{
 		NodePtr setVariable = AllocSetVariable(varDecl, varDecl->initializer, varDecl->lineNumber);
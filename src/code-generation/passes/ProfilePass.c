@@ -0,0 +1,346 @@
+#include "ProfilePass.h"
+
+#include "Common.h"
+#include "StringUtils.h"
+#include "data-structures/MemoryStream.h"
+
+#include <stdio.h>
+#include <string.h>
+
+typedef struct
+{
+	char* name;
+	const char* path;
+	int lineNumber;
+} Counter;
+
+static const char* const sectionNames[] = {
+	[Section_Init] = "@init",
+	[Section_Slider] = "@slider",
+	[Section_Block] = "@block",
+	[Section_Sample] = "@sample",
+	[Section_Serialize] = "@serialize",
+	[Section_GFX] = "@gfx",
+};
+
+#define SECTION_TYPE_COUNT (sizeof(sectionNames) / sizeof(sectionNames[0]))
+
+static Array counters;
+static VarDeclStmt* countersDecl;
+static FuncDeclStmt* countFunction;
+static FuncDeclStmt* beginSectionFunction;
+static FuncDeclStmt* endSectionFunction;
+static FuncDeclStmt* beginOverlayFunction;
+static FuncDeclStmt* drawRowFunction;
+static const ModuleNode* currentModule;
+
+static void VisitStatement(NodePtr* node);
+
+static NodePtr AllocCallStatement(FuncDeclStmt* funcDecl, Array arguments)
+{
+	return AllocASTNode(
+		&(ExpressionStmt){
+			.lineNumber = -1,
+			.expr = AllocASTNode(
+				&(FuncCallExpr){
+					.lineNumber = -1,
+					.arguments = arguments,
+					.baseExpr = AllocASTNode(
+						&(MemberAccessExpr){
+							.lineNumber = -1,
+							.identifiers.array = NULL,
+							.start = NULL_NODE,
+							.funcReference = funcDecl,
+							.typeReference = NULL,
+							.varReference = NULL,
+						},
+						sizeof(MemberAccessExpr), Node_MemberAccess),
+				},
+				sizeof(FuncCallExpr), Node_FunctionCall),
+		},
+		sizeof(ExpressionStmt), Node_ExpressionStatement);
+}
+
+static Array AllocIndexArgument(size_t index)
+{
+	Array arguments = AllocateArray(sizeof(NodePtr));
+	NodePtr node = AllocSizeInteger(index, -1);
+	ArrayAdd(&arguments, &node);
+	return arguments;
+}
+
+static size_t AddCounter(char* name, const char* path, int lineNumber)
+{
+	ArrayAdd(&counters, &(Counter){
+							.name = name,
+							.path = path,
+							.lineNumber = lineNumber,
+						});
+	return counters.length - 1;
+}
+
+static void AddFunctionCounter(const FuncDeclStmt* funcDecl)
+{
+	// external functions don't have a body
+	if (!funcDecl->block.ptr)
+		return;
+
+	const size_t index = AddCounter(
+		AllocateString2Str("%s.%s", currentModule->moduleName, funcDecl->name),
+		currentModule->path, funcDecl->lineNumber);
+
+	ASSERT(funcDecl->block.type == Node_BlockStatement);
+	BlockStmt* block = funcDecl->block.ptr;
+	const NodePtr call = AllocCallStatement(countFunction, AllocIndexArgument(index));
+	ArrayInsert(&block->statements, &call, 0);
+}
+
+static void VisitStatement(NodePtr* node)
+{
+	switch (node->type)
+	{
+	case Node_StructDeclaration:
+	case Node_VariableDeclaration:
+	case Node_ExpressionStatement:
+	case Node_Return:
+	case Node_LoopControl:
+	case Node_Import:
+	case Node_Input:
+	case Node_Desc:
+	case Node_Null:
+		break;
+	case Node_FunctionDeclaration:
+	{
+		FuncDeclStmt* funcDecl = node->ptr;
+		AddFunctionCounter(funcDecl);
+		VisitStatement(&funcDecl->block);
+		break;
+	}
+	case Node_BlockStatement:
+	{
+		const BlockStmt* block = node->ptr;
+		for (size_t i = 0; i < block->statements.length; ++i)
+			VisitStatement(block->statements.array[i]);
+		break;
+	}
+	case Node_If:
+	{
+		IfStmt* ifStmt = node->ptr;
+		VisitStatement(&ifStmt->trueStmt);
+		VisitStatement(&ifStmt->falseStmt);
+		break;
+	}
+	case Node_Section:
+	{
+		SectionStmt* section = node->ptr;
+		VisitStatement(&section->block);
+		break;
+	}
+	case Node_While:
+	{
+		WhileStmt* whileStmt = node->ptr;
+		VisitStatement(&whileStmt->stmt);
+		break;
+	}
+	case Node_For:
+	{
+		ForStmt* forStmt = node->ptr;
+		VisitStatement(&forStmt->stmt);
+		break;
+	}
+	default: INVALID_VALUE(node->type);
+	}
+}
+
+static NodePtr AllocSection(SectionType type, const SectionStmt* sizeFrom)
+{
+	return AllocASTNode(
+		&(SectionStmt){
+			.lineNumber = -1,
+			.sectionType = type,
+			.block = AllocASTNode(
+				&(BlockStmt){
+					.statements = AllocateArray(sizeof(NodePtr)),
+				},
+				sizeof(BlockStmt), Node_BlockStatement),
+			.width = sizeFrom && sizeFrom->width ? AllocateString(sizeFrom->width) : NULL,
+			.height = sizeFrom && sizeFrom->height ? AllocateString(sizeFrom->height) : NULL,
+		},
+		sizeof(SectionStmt), Node_Section);
+}
+
+static void AddToSection(NodePtr section, NodePtr statement)
+{
+	BlockStmt* block = ((SectionStmt*)section.ptr)->block.ptr;
+	ArrayAdd(&block->statements, &statement);
+}
+
+static char* AllocCounterLabel(const Counter* counter)
+{
+	// sections are counted as a whole, so they only get their name
+	if (counter->lineNumber < 0)
+		return AllocateString(counter->name);
+
+	const char* fileName = strrchr(counter->path, '/');
+	fileName = fileName ? fileName + 1 : counter->path;
+
+	const int length = snprintf(NULL, 0, "%s (%s:%d)", counter->name, fileName, counter->lineNumber);
+	ASSERT(length > 0);
+	char* label = malloc((size_t)length + 1);
+	snprintf(label, (size_t)length + 1, "%s (%s:%d)", counter->name, fileName, counter->lineNumber);
+	return label;
+}
+
+// draws every counter that isn't zero on top of the plugin's own @gfx
+static void AddOverlay(NodePtr gfxSection)
+{
+	AddToSection(gfxSection, AllocCallStatement(beginOverlayFunction, AllocateArray(sizeof(NodePtr))));
+	for (size_t i = 0; i < counters.length; ++i)
+	{
+		Array arguments = AllocIndexArgument(i);
+		NodePtr label = AllocStringLiteral(AllocCounterLabel(counters.array[i]), -1);
+		ArrayAdd(&arguments, &label);
+		AddToSection(gfxSection, AllocCallStatement(drawRowFunction, arguments));
+	}
+}
+
+static ModuleNode* FindProfileModule(const AST* ast)
+{
+	for (size_t i = 0; i < ast->nodes.length; ++i)
+	{
+		ModuleNode* module = ((NodePtr*)ast->nodes.array[i])->ptr;
+		if (strcmp(module->moduleName, "profile") == 0)
+			return module;
+	}
+	UNREACHABLE();
+}
+
+static void FindProfileDeclarations(const ModuleNode* module)
+{
+	for (size_t i = 0; i < module->statements.length; ++i)
+	{
+		const NodePtr* node = module->statements.array[i];
+		if (node->type == Node_VariableDeclaration && strcmp(((VarDeclStmt*)node->ptr)->name, "counters") == 0)
+			countersDecl = node->ptr;
+		if (node->type != Node_FunctionDeclaration)
+			continue;
+
+		FuncDeclStmt* funcDecl = node->ptr;
+		if (strcmp(funcDecl->name, "count") == 0) countFunction = funcDecl;
+		else if (strcmp(funcDecl->name, "begin_section") == 0) beginSectionFunction = funcDecl;
+		else if (strcmp(funcDecl->name, "end_section") == 0) endSectionFunction = funcDecl;
+		else if (strcmp(funcDecl->name, "begin_overlay") == 0) beginOverlayFunction = funcDecl;
+		else if (strcmp(funcDecl->name, "draw_row") == 0) drawRowFunction = funcDecl;
+	}
+	ASSERT(countersDecl && countFunction && beginSectionFunction && endSectionFunction && beginOverlayFunction && drawRowFunction);
+}
+
+// counts how many times each section and function runs, and times the sections with time_precise().
+// every section type gets a section before all of the others (at the end of the profile module)
+// and one at the very end of the program, so the timing doesn't depend on how the code in between returns
+void ProfilePass(const AST* ast)
+{
+	counters = AllocateArray(sizeof(Counter));
+	ModuleNode* profileModule = FindProfileModule(ast);
+	FindProfileDeclarations(profileModule);
+
+	const SectionStmt* firstSections[SECTION_TYPE_COUNT] = {0};
+	size_t sectionCounters[SECTION_TYPE_COUNT] = {0};
+	for (size_t i = 0; i < ast->nodes.length; ++i)
+	{
+		const ModuleNode* module = ((NodePtr*)ast->nodes.array[i])->ptr;
+		for (size_t j = 0; j < module->statements.length; ++j)
+		{
+			const NodePtr* node = module->statements.array[j];
+			if (node->type != Node_Section)
+				continue;
+
+			const SectionStmt* section = node->ptr;
+			if (firstSections[section->sectionType])
+				continue;
+
+			firstSections[section->sectionType] = section;
+			sectionCounters[section->sectionType] = AddCounter(AllocateString(sectionNames[section->sectionType]), module->path, -1);
+		}
+	}
+
+	// calls have to come after the function they call, so only the modules after the
+	// profile module get counters. those are all of the modules that aren't built in
+	bool afterProfileModule = false;
+	for (size_t i = 0; i < ast->nodes.length; ++i)
+	{
+		currentModule = ((NodePtr*)ast->nodes.array[i])->ptr;
+		if (afterProfileModule)
+		{
+			for (size_t j = 0; j < currentModule->statements.length; ++j)
+				VisitStatement(currentModule->statements.array[j]);
+		}
+		if (currentModule == profileModule)
+			afterProfileModule = true;
+	}
+
+	ModuleNode* lastModule = ((NodePtr*)ast->nodes.array[ast->nodes.length - 1])->ptr;
+	for (size_t type = 0; type < SECTION_TYPE_COUNT; ++type)
+	{
+		if (!firstSections[type])
+			continue;
+
+		NodePtr begin = AllocSection((SectionType)type, firstSections[type]);
+		AddToSection(begin, AllocCallStatement(beginSectionFunction, AllocIndexArgument(sectionCounters[type])));
+		ArrayAdd(&profileModule->statements, &begin);
+
+		if (type == Section_GFX)
+			continue;
+
+		NodePtr end = AllocSection((SectionType)type, NULL);
+		AddToSection(end, AllocCallStatement(endSectionFunction, AllocIndexArgument(sectionCounters[type])));
+		ArrayAdd(&lastModule->statements, &end);
+	}
+
+	// the overlay is drawn after the rest of @gfx, but isn't part of its time
+	NodePtr gfx = AllocSection(Section_GFX, firstSections[Section_GFX]);
+	if (firstSections[Section_GFX])
+		AddToSection(gfx, AllocCallStatement(endSectionFunction, AllocIndexArgument(sectionCounters[Section_GFX])));
+	AddOverlay(gfx);
+	ArrayAdd(&lastModule->statements, &gfx);
+
+	countersDecl->staticLength = counters.length;
+}
+
+static void WriteString(MemoryStream* stream, const char* string)
+{
+	StreamWrite(stream, string, strlen(string));
+}
+
+// the map has the address and the number of counters on the first line,
+// then the index, name, file and line of each counter
+char* AllocProfileMap(void)
+{
+	MemoryStream* stream = AllocateMemoryStream();
+
+	char number[UINT64_MAX_CHARS + 4];
+	snprintf(number, sizeof(number), "%" PRIu64, countersDecl->staticAddress);
+	WriteString(stream, "counters ");
+	WriteString(stream, number);
+	snprintf(number, sizeof(number), " %zu\n", counters.length);
+	WriteString(stream, number);
+
+	for (size_t i = 0; i < counters.length; ++i)
+	{
+		Counter* counter = counters.array[i];
+		snprintf(number, sizeof(number), "%zu\t", i);
+		WriteString(stream, number);
+		WriteString(stream, counter->name);
+		StreamWriteByte(stream, '\t');
+		WriteString(stream, counter->path);
+		snprintf(number, sizeof(number), "\t%d\n", counter->lineNumber);
+		WriteString(stream, number);
+		free(counter->name);
+	}
+	StreamWriteByte(stream, '\0');
+	FreeArray(&counters);
+
+	char* map = StreamGetBuffer(stream).buffer;
+	FreeMemoryStream(stream, false);
+	return map;
+}
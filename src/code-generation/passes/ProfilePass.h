@@ -0,0 +1,6 @@
+#pragma once
+
+#include "SyntaxTree.h"
+
+void ProfilePass(const AST* ast);
+char* AllocProfileMap(void);
@@ -1,5 +1,7 @@
 #include "RemoveUnusedPass.h"
 
+static int changeCount;
+
 static void VisitStatement(NodePtr* node);
 
 static void VisitExpression(const NodePtr node)
@@ -74,6 +76,7 @@ static void VisitStatement(NodePtr* node)
 					exprStmt->expr = binary->right;
 				else
 					*node = NULL_NODE;
+				++changeCount;
 			}
 		}
 
@@ -97,6 +100,7 @@ static void VisitStatement(NodePtr* node)
 			}
 			else
 				*node = NULL_NODE;
+			++changeCount;
 
 			return;
 		}
@@ -111,6 +115,7 @@ static void VisitStatement(NodePtr* node)
 		if (funcDecl->unused)
 		{
 			*node = NULL_NODE;
+			++changeCount;
 			break;
 		}
 
@@ -156,8 +161,9 @@ static void VisitStatement(NodePtr* node)
 	}
 }
 
-void RemoveUnusedPass(const AST* ast)
+int RemoveUnusedPass(const AST* ast)
 {
+	changeCount = 0;
 	for (size_t i = 0; i < ast->nodes.length; ++i)
 	{
 		const NodePtr* node = ast->nodes.array[i];
@@ -168,4 +174,5 @@ void RemoveUnusedPass(const AST* ast)
 		for (size_t i = 0; i < module->statements.length; ++i)
 			VisitStatement(module->statements.array[i]);
 	}
+	return changeCount;
 }
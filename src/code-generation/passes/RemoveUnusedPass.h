@@ -2,4 +2,4 @@
 
 #include "SyntaxTree.h"
 
-void RemoveUnusedPass(const AST* ast);
+int RemoveUnusedPass(const AST* ast);
@@ -58,6 +58,7 @@ static Result ResolveExpression(NodePtr* node, bool checkForValue, FuncCallExpr*
 static Result ResolveType(Type* type, bool voidAllowed, bool isPublicAPI, bool* outIsType);
 static Result VisitBlock(const BlockStmt* block);
 static Result FindFunctionOverloadScoped(const char* text, NodePtr* outNode, size_t argCount, bool* isAmbiguous, int lineNumber);
+static Result SetVariableProperties(VarDeclStmt* varDecl);
 
 static NodePtr AllocMemberVarDecl(const char* name, Type type)
 {
@@ -825,6 +826,7 @@ static Result ResolveExpression(NodePtr* node, bool checkForValue, FuncCallExpr*
 				},
 				sizeof(BlockStmt), Node_BlockStatement)
 									   .ptr;
+			HoistAssignmentTarget(&unary->expression, blockStmt, unary->lineNumber);
 
 			VarDeclStmt* varDecl = AllocASTNode(
 				&(VarDeclStmt){
@@ -954,6 +956,7 @@ static Result ResolveExpression(NodePtr* node, bool checkForValue, FuncCallExpr*
 				return ERROR_RESULT("Cannot index into non-array type",
 					subscript->lineNumber,
 					currentFilePath);
+			subscript->arrayType = type.effectiveType;
 
 			// make the member access point to the ptr member inside the array type
 			switch (subscript->baseExpr.type)
@@ -1080,6 +1083,7 @@ static Result VisitVariableDeclaration(NodePtr* node, bool isPublicAPI)
 			return ERROR_RESULT("External variables must be of type \"any\"", varDecl->lineNumber, currentFilePath);
 	}
 
+	PROPAGATE_ERROR(SetVariableProperties(varDecl));
 	return SUCCESS_RESULT;
 }
 
@@ -1197,6 +1201,66 @@ invalidValue:
 	return ERROR_RESULT("Expected slider shape type", lineNumber, currentFilePath);
 }
 
+static Result SetLayoutProperty(NodePtr value, void* destination, int lineNumber)
+{
+	ASSERT(destination);
+
+	StructLayout* layout = destination;
+	if (*layout != StructLayout_NotSet)
+		return ERROR_RESULT("Cannot set property twice", lineNumber, currentFilePath);
+
+	if (value.type != Node_MemberAccess)
+		goto invalidValue;
+	MemberAccessExpr* memberAccess = value.ptr;
+
+	if (memberAccess->identifiers.length != 1 ||
+		memberAccess->start.ptr)
+		goto invalidValue;
+
+	char* string = *(char**)memberAccess->identifiers.array[0];
+	ASSERT(string);
+	if (strcmp(string, "aos") == 0)
+		*layout = StructLayout_ArrayOfStructs;
+	else if (strcmp(string, "soa") == 0)
+		*layout = StructLayout_StructOfArrays;
+	else
+		return ERROR_RESULT(
+			AllocateString1Str("Unknown struct layout \"%s\"", string),
+			lineNumber, currentFilePath);
+
+	return SUCCESS_RESULT;
+
+invalidValue:
+	return ERROR_RESULT("Expected struct layout", lineNumber, currentFilePath);
+}
+
+static Result SetPositiveIntegerProperty(NodePtr value, void* destination, int lineNumber)
+{
+	ASSERT(destination);
+
+	uint64_t* integer = destination;
+	if (*integer != 0)
+		return ERROR_RESULT("Cannot set property twice", lineNumber, currentFilePath);
+
+	if (value.type != Node_Literal)
+		goto invalidValue;
+	LiteralExpr* literal = value.ptr;
+
+	if (literal->type != Literal_Number)
+		goto invalidValue;
+
+	char* end;
+	double number = strtod(literal->number, &end);
+	if (*end != '\0' || number < 1 || number > 1e15 || number != (double)(uint64_t)number)
+		goto invalidValue;
+
+	*integer = (uint64_t)number;
+	return SUCCESS_RESULT;
+
+invalidValue:
+	return ERROR_RESULT("Expected a positive whole number", lineNumber, currentFilePath);
+}
+
 static Result SetShapeProperties(InputStmt* slider, PropertyListNode* properties)
 {
 	for (size_t i = 0; i < properties->list.length; ++i)
@@ -1226,6 +1290,179 @@ static Result SetShapeProperties(InputStmt* slider, PropertyListNode* properties
 	return SUCCESS_RESULT;
 }
 
+static Result SetLoopProperties(ForStmt* forStmt)
+{
+	if (!forStmt->propertyList.ptr)
+		return SUCCESS_RESULT;
+
+	ASSERT(forStmt->propertyList.type == Node_PropertyList);
+	PropertyListNode* properties = forStmt->propertyList.ptr;
+	for (size_t i = 0; i < properties->list.length; ++i)
+	{
+		NodePtr* node = properties->list.array[i];
+		ASSERT(node->type == Node_Property);
+
+		PropertyNode* property = node->ptr;
+		switch (property->type)
+		{
+		case PropertyType_Unroll:
+			PROPAGATE_ERROR(SetBooleanProperty(property->value, &forStmt->unroll, property->lineNumber));
+			break;
+		default: return ERROR_RESULT("Invalid property type", property->lineNumber, currentFilePath);
+		}
+	}
+
+	return SUCCESS_RESULT;
+}
+
+static Result SetFunctionProperties(FuncDeclStmt* funcDecl)
+{
+	funcDecl->pure = PropertyBoolean_NotSet;
+	funcDecl->constEval = PropertyBoolean_NotSet;
+	if (!funcDecl->propertyList.ptr)
+		return SUCCESS_RESULT;
+
+	if (!funcDecl->modifiers.externalValue)
+		return ERROR_RESULT("Only external functions can have properties", funcDecl->lineNumber, currentFilePath);
+
+	ASSERT(funcDecl->propertyList.type == Node_PropertyList);
+	PropertyListNode* properties = funcDecl->propertyList.ptr;
+	for (size_t i = 0; i < properties->list.length; ++i)
+	{
+		NodePtr* node = properties->list.array[i];
+		ASSERT(node->type == Node_Property);
+
+		PropertyNode* property = node->ptr;
+		switch (property->type)
+		{
+		case PropertyType_Pure:
+			PROPAGATE_ERROR(SetBooleanProperty(property->value, &funcDecl->pure, property->lineNumber));
+			break;
+		case PropertyType_ConstEval:
+			PROPAGATE_ERROR(SetBooleanProperty(property->value, &funcDecl->constEval, property->lineNumber));
+			break;
+		default: return ERROR_RESULT("Invalid property type", property->lineNumber, currentFilePath);
+		}
+	}
+
+	// the compiler has to know how to run the function itself
+	const char* name = funcDecl->externalName ? funcDecl->externalName : funcDecl->name;
+	if (funcDecl->constEval == PropertyBoolean_True)
+	{
+		if (funcDecl->variadic || !IsEvaluableBuiltIn(name, funcDecl->parameters.length))
+			return ERROR_RESULT(
+				AllocateString1Str("Function \"%s\" cannot be evaluated at compile time", name),
+				funcDecl->lineNumber, currentFilePath);
+
+		if (funcDecl->pure == PropertyBoolean_False)
+			return ERROR_RESULT("Functions that are evaluated at compile time must be pure", funcDecl->lineNumber, currentFilePath);
+		funcDecl->pure = PropertyBoolean_True;
+	}
+
+	return SUCCESS_RESULT;
+}
+
+static Result SetStructProperties(StructDeclStmt* structDecl)
+{
+	structDecl->layout = StructLayout_NotSet;
+	structDecl->capacity = 0;
+	if (!structDecl->propertyList.ptr)
+		return SUCCESS_RESULT;
+
+	ASSERT(structDecl->propertyList.type == Node_PropertyList);
+	PropertyListNode* properties = structDecl->propertyList.ptr;
+	for (size_t i = 0; i < properties->list.length; ++i)
+	{
+		NodePtr* node = properties->list.array[i];
+		ASSERT(node->type == Node_Property);
+
+		PropertyNode* property = node->ptr;
+		switch (property->type)
+		{
+		case PropertyType_Layout:
+			PROPAGATE_ERROR(SetLayoutProperty(property->value, &structDecl->layout, property->lineNumber));
+			break;
+		case PropertyType_Capacity:
+			PROPAGATE_ERROR(SetPositiveIntegerProperty(property->value, &structDecl->capacity, property->lineNumber));
+			break;
+		default: return ERROR_RESULT("Invalid property type", property->lineNumber, currentFilePath);
+		}
+	}
+
+	// each member gets its own array, so the compiler has to know how long they are
+	if (structDecl->layout == StructLayout_StructOfArrays && structDecl->capacity == 0)
+		return ERROR_RESULT("Structs with the \"soa\" layout need a capacity", structDecl->lineNumber, currentFilePath);
+	if (structDecl->layout != StructLayout_StructOfArrays && structDecl->capacity != 0)
+		return ERROR_RESULT("Only structs with the \"soa\" layout can have a capacity", structDecl->lineNumber, currentFilePath);
+
+	return SUCCESS_RESULT;
+}
+
+static Result ResolveInitializerList(NodePtr* node)
+{
+	if (node->type != Node_InitializerList)
+		return ResolveExpression(node, true, NULL);
+
+	const InitializerListNode* list = node->ptr;
+	for (size_t i = 0; i < list->values.length; ++i)
+		PROPAGATE_ERROR(ResolveInitializerList(list->values.array[i]));
+	return SUCCESS_RESULT;
+}
+
+static Result SetVariableProperties(VarDeclStmt* varDecl)
+{
+	varDecl->staticLength = 0;
+	varDecl->staticAlign = PropertyBoolean_NotSet;
+	if (!varDecl->propertyList.ptr && !varDecl->initializerList.ptr)
+		return SUCCESS_RESULT;
+
+	PropertyListNode* properties = varDecl->propertyList.ptr;
+	ASSERT(!properties || varDecl->propertyList.type == Node_PropertyList);
+	for (size_t i = 0; properties && i < properties->list.length; ++i)
+	{
+		NodePtr* node = properties->list.array[i];
+		ASSERT(node->type == Node_Property);
+
+		PropertyNode* property = node->ptr;
+		switch (property->type)
+		{
+		case PropertyType_Length:
+			PROPAGATE_ERROR(SetPositiveIntegerProperty(property->value, &varDecl->staticLength, property->lineNumber));
+			break;
+		case PropertyType_Align:
+			PROPAGATE_ERROR(SetBooleanProperty(property->value, &varDecl->staticAlign, property->lineNumber));
+			break;
+		default: return ERROR_RESULT("Invalid property type", property->lineNumber, currentFilePath);
+		}
+	}
+
+	// the compiler gives these a place in memory, so it has to know how big they are before the program runs
+	StructTypeInfo type = GetStructTypeInfoFromType(varDecl->type);
+	if (currentScope->parent || varDecl->modifiers.externalValue)
+		return ERROR_RESULT("Only variables in file scope can be static buffers", varDecl->lineNumber, currentFilePath);
+	if (!type.effectiveType || !type.effectiveType->isArrayType)
+		return ERROR_RESULT("Static buffers must be arrays", varDecl->lineNumber, currentFilePath);
+	if (varDecl->initializer.ptr)
+		return ERROR_RESULT("Static buffers cannot have initializers", varDecl->lineNumber, currentFilePath);
+
+	if (varDecl->initializerList.ptr)
+	{
+		ASSERT(varDecl->initializerList.type == Node_InitializerList);
+		const InitializerListNode* list = varDecl->initializerList.ptr;
+		if (varDecl->staticLength == 0)
+			varDecl->staticLength = list->values.length;
+		else if (varDecl->staticLength < list->values.length)
+			return ERROR_RESULT("Initializer list is longer than the buffer", list->lineNumber, currentFilePath);
+
+		PROPAGATE_ERROR(ResolveInitializerList(&varDecl->initializerList));
+	}
+
+	if (varDecl->staticLength == 0)
+		return ERROR_RESULT("Static buffers need a length", varDecl->lineNumber, currentFilePath);
+
+	return SUCCESS_RESULT;
+}
+
 static Result SetInputProperties(InputStmt* slider)
 {
 	// initialize all to not set
@@ -1330,11 +1567,12 @@ static Result SetSectionProperties(SectionStmt* section)
 {
 	section->width = NULL;
 	section->height = NULL;
+	section->blockMode = PropertyBoolean_NotSet;
 
 	if (section->propertyList.ptr)
 	{
-		if (section->sectionType != Section_GFX)
-			return ERROR_RESULT("Properties are only allowed in an \"@gfx\" section", section->lineNumber, currentFilePath);
+		if (section->sectionType != Section_GFX && section->sectionType != Section_Sample)
+			return ERROR_RESULT("Properties are only allowed in \"@gfx\" and \"@sample\" sections", section->lineNumber, currentFilePath);
 
 		ASSERT(section->propertyList.type == Node_PropertyList);
 		PropertyListNode* properties = section->propertyList.ptr;
@@ -1347,11 +1585,20 @@ static Result SetSectionProperties(SectionStmt* section)
 			switch (property->type)
 			{
 			case PropertyType_Width:
+				if (section->sectionType != Section_GFX)
+					return ERROR_RESULT("Invalid property type", property->lineNumber, currentFilePath);
 				PROPAGATE_ERROR(SetNumberProperty(property->value, &section->width, property->lineNumber));
 				break;
 			case PropertyType_Height:
+				if (section->sectionType != Section_GFX)
+					return ERROR_RESULT("Invalid property type", property->lineNumber, currentFilePath);
 				PROPAGATE_ERROR(SetNumberProperty(property->value, &section->height, property->lineNumber));
 				break;
+			case PropertyType_Block:
+				if (section->sectionType != Section_Sample)
+					return ERROR_RESULT("Invalid property type", property->lineNumber, currentFilePath);
+				PROPAGATE_ERROR(SetBooleanProperty(property->value, &section->blockMode, property->lineNumber));
+				break;
 			default: return ERROR_RESULT("Invalid property type", property->lineNumber, currentFilePath);
 			}
 		}
@@ -1586,6 +1833,8 @@ static Result VisitStatement(NodePtr* node)
 				return ERROR_RESULT("Only external functions can be variadic functions", funcDecl->lineNumber, currentFilePath);
 		}
 
+		PROPAGATE_ERROR(SetFunctionProperties(funcDecl));
+
 		bool isPublicAPI = funcDecl->modifiers.publicValue;
 		PROPAGATE_ERROR(ResolveType(&funcDecl->type, true, isPublicAPI, NULL));
 
@@ -1665,6 +1914,8 @@ static Result VisitStatement(NodePtr* node)
 		if (structDecl->members.length == 0)
 			return ERROR_RESULT("Cannot define an empty struct", structDecl->lineNumber, currentFilePath);
 
+		PROPAGATE_ERROR(SetStructProperties(structDecl));
+
 		PROPAGATE_ERROR(RegisterDeclaration(structDecl->name, node, structDecl->lineNumber));
 
 		PushScope();
@@ -1721,6 +1972,7 @@ static Result VisitStatement(NodePtr* node)
 	case Node_For:
 	{
 		ForStmt* forStmt = node->ptr;
+		PROPAGATE_ERROR(SetLoopProperties(forStmt));
 		PushScope();
 		PROPAGATE_ERROR(VisitStatement(&forStmt->initialization));
 		PROPAGATE_ERROR(ResolveExpression(&forStmt->condition, true, NULL));
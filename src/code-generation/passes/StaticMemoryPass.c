@@ -0,0 +1,511 @@
+#include "StaticMemoryPass.h"
+
+#include "Common.h"
+#include "StringUtils.h"
+
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// jsfx memory is allocated in blocks of this many slots.
+// functions that work on a range of memory (like memcpy() or fft()) are slower when the range goes into the next block
+#define BLOCK_SIZE 65536
+// how many memory slots effects get if max_memory isn't set
+#define DEFAULT_MAX_MEMORY 8000000
+// the most that max_memory can be
+#define MAX_MEMORY_LIMIT 33554432
+// how many values are written by each mem_set_values() call
+#define VALUES_PER_CALL 64
+
+typedef struct
+{
+	const char* name;
+	const char* moduleName;
+	uint64_t address;
+	uint64_t size;
+} MapEntry;
+
+typedef struct
+{
+	uint64_t start;
+	uint64_t end;
+} Gap;
+
+static Array entries;
+static Array gaps;
+static uint64_t top;
+// the buffers of the modules that are only imported in debug builds go at the end of memory, below this.
+// that way they don't get overwritten by effects that use memory from 0 without static buffers
+static uint64_t reservedStart;
+static const char* const reservedModules[] = {"checked", "profile"};
+
+// how many memory slots a static buffer takes up
+uint64_t GetStaticBufferSize(const VarDeclStmt* varDecl)
+{
+	StructDeclStmt* arrayType = GetStructTypeInfoFromType(varDecl->type).effectiveType;
+	ASSERT(arrayType && arrayType->isArrayType);
+	StructDeclStmt* elementType = GetStructTypeInfoFromType(GetPtrMember(arrayType)->type).pointerType;
+	if (!elementType)
+		return varDecl->staticLength;
+
+	// each member has its own array that is as long as the capacity
+	if (elementType->layout == StructLayout_StructOfArrays)
+		return CountStructSlots(elementType) * elementType->capacity;
+	return CountStructSlots(elementType) * varDecl->staticLength;
+}
+
+static Result GetBufferSize(const VarDeclStmt* varDecl, const char* path, uint64_t* size)
+{
+	StructDeclStmt* arrayType = GetStructTypeInfoFromType(varDecl->type).effectiveType;
+	ASSERT(arrayType && arrayType->isArrayType);
+	StructDeclStmt* elementType = GetStructTypeInfoFromType(GetPtrMember(arrayType)->type).pointerType;
+	if (elementType &&
+		elementType->layout == StructLayout_StructOfArrays &&
+		varDecl->staticLength > elementType->capacity)
+		return ERROR_RESULT("Static buffers of structs with the \"soa\" layout cannot be longer than their capacity", varDecl->lineNumber, path);
+
+	*size = GetStaticBufferSize(varDecl);
+	return SUCCESS_RESULT;
+}
+
+static bool CrossesBlock(uint64_t address, uint64_t size)
+{
+	return address / BLOCK_SIZE != (address + size - 1) / BLOCK_SIZE;
+}
+
+static uint64_t RoundUpToBlock(uint64_t address)
+{
+	return (address + BLOCK_SIZE - 1) / BLOCK_SIZE * BLOCK_SIZE;
+}
+
+// buffers go in the first place they fit, which can be space that was skipped to align another buffer
+static uint64_t Allocate(uint64_t size, bool aligned, bool keepInBlock)
+{
+	for (size_t i = 0; i < gaps.length; ++i)
+	{
+		Gap* gap = gaps.array[i];
+		if (gap->end - gap->start < size ||
+			(aligned && gap->start % BLOCK_SIZE != 0) ||
+			(keepInBlock && CrossesBlock(gap->start, size)))
+			continue;
+
+		uint64_t address = gap->start;
+		gap->start += size;
+		if (gap->start == gap->end)
+			ArrayRemove(&gaps, i);
+		return address;
+	}
+
+	uint64_t address = top;
+	if (aligned || (keepInBlock && CrossesBlock(top, size)))
+		address = RoundUpToBlock(top);
+	if (address != top)
+		ArrayAdd(&gaps, &(Gap){.start = top, .end = address});
+	top = address + size;
+	return address;
+}
+
+static bool IsReservedModule(const ModuleNode* module)
+{
+	for (size_t i = 0; i < sizeof(reservedModules) / sizeof(reservedModules[0]); ++i)
+	{
+		if (strcmp(module->moduleName, reservedModules[i]) == 0)
+			return true;
+	}
+	return false;
+}
+
+static Result PlaceBuffer(VarDeclStmt* varDecl, const ModuleNode* module)
+{
+	uint64_t size;
+	PROPAGATE_ERROR(GetBufferSize(varDecl, module->path, &size));
+
+	if (IsReservedModule(module))
+	{
+		ASSERT(size <= reservedStart);
+		reservedStart -= size;
+		varDecl->staticAddress = reservedStart;
+		ArrayAdd(&entries,
+			&(MapEntry){
+				.name = varDecl->name,
+				.moduleName = module->moduleName,
+				.address = varDecl->staticAddress,
+				.size = size,
+			});
+		return SUCCESS_RESULT;
+	}
+
+	// buffers that fill a whole block start at the beginning of one, and smaller buffers stay inside of one
+	bool aligned = varDecl->staticAlign == PropertyBoolean_True ||
+				   (varDecl->staticAlign == PropertyBoolean_NotSet && size >= BLOCK_SIZE);
+	bool keepInBlock = varDecl->staticAlign == PropertyBoolean_NotSet && size < BLOCK_SIZE;
+	varDecl->staticAddress = Allocate(size, aligned, keepInBlock);
+	if (top > MAX_MEMORY_LIMIT)
+		return ERROR_RESULT(
+			AllocateString2Int("Static buffers need %" PRId64 " memory slots, but effects can only have %" PRId64, (int64_t)top, MAX_MEMORY_LIMIT),
+			varDecl->lineNumber, module->path);
+
+	ArrayAdd(&entries,
+		&(MapEntry){
+			.name = varDecl->name,
+			.moduleName = module->moduleName,
+			.address = varDecl->staticAddress,
+			.size = size,
+		});
+	return SUCCESS_RESULT;
+}
+
+static ModuleNode* FindModule(const AST* ast, const char* moduleName)
+{
+	for (size_t i = 0; i < ast->nodes.length; ++i)
+	{
+		ModuleNode* module = ((NodePtr*)ast->nodes.array[i])->ptr;
+		if (strcmp(module->moduleName, moduleName) == 0)
+			return module;
+	}
+	return NULL;
+}
+
+static NodePtr* FindDeclaration(const ModuleNode* module, NodeType type, const char* name)
+{
+	for (size_t i = 0; i < module->statements.length; ++i)
+	{
+		NodePtr* node = module->statements.array[i];
+		if (node->type != type)
+			continue;
+
+		if (type == Node_VariableDeclaration && strcmp(((VarDeclStmt*)node->ptr)->name, name) == 0)
+			return node;
+		if (type == Node_FunctionDeclaration && strcmp(((FuncDeclStmt*)node->ptr)->name, name) == 0)
+			return node;
+	}
+	return NULL;
+}
+
+static NodePtr AllocCallStatement(FuncDeclStmt* funcDecl, Array arguments, int lineNumber)
+{
+	NodePtr funcCall = AllocASTNode(
+		&(FuncCallExpr){
+			.lineNumber = lineNumber,
+			.arguments = arguments,
+			.baseExpr = AllocASTNode(
+				&(MemberAccessExpr){
+					.lineNumber = lineNumber,
+					.identifiers.array = NULL,
+					.start = NULL_NODE,
+					.funcReference = funcDecl,
+					.typeReference = NULL,
+					.varReference = NULL,
+				},
+				sizeof(MemberAccessExpr), Node_MemberAccess),
+		},
+		sizeof(FuncCallExpr), Node_FunctionCall);
+	return AllocASTNode(
+		&(ExpressionStmt){
+			.lineNumber = lineNumber,
+			.expr = funcCall,
+		},
+		sizeof(ExpressionStmt), Node_ExpressionStatement);
+}
+
+// file scope statements run at the start of @init, in the same order as they are in the file
+static size_t InsertAfter(ModuleNode* module, const NodePtr* statement, size_t index, NodePtr newStatement)
+{
+	while (module->statements.array[index] != (const void*)statement)
+		++index;
+	ArrayInsert(&module->statements, &newStatement, index + 1);
+	return index + 1;
+}
+
+static bool HasSerializeSection(const AST* ast)
+{
+	for (size_t i = 0; i < ast->nodes.length; ++i)
+	{
+		const ModuleNode* module = ((NodePtr*)ast->nodes.array[i])->ptr;
+		for (size_t j = 0; j < module->statements.length; ++j)
+		{
+			const NodePtr* statement = module->statements.array[j];
+			if (statement->type == Node_Section && ((SectionStmt*)statement->ptr)->sectionType == Section_Serialize)
+				return true;
+		}
+	}
+	return false;
+}
+
+// mem.static_end is set to the first slot after the buffers, and memory above it is freed when @init starts
+static void AddStaticEnd(const AST* ast, bool hasReservedBuffers)
+{
+	ModuleNode* module = FindModule(ast, "mem");
+	ASSERT(module);
+	NodePtr* staticEndNode = FindDeclaration(module, Node_VariableDeclaration, "static_end");
+	NodePtr* freeNode = FindDeclaration(module, Node_FunctionDeclaration, "freembuf");
+	ASSERT(staticEndNode && freeNode);
+
+	VarDeclStmt* staticEnd = staticEndNode->ptr;
+	ASSERT(!staticEnd->initializer.ptr);
+	staticEnd->initializer = AllocUInt64Integer(top, staticEnd->lineNumber);
+	++staticEnd->useCount;
+
+	// freembuf() would also free the reserved buffers at the end of memory
+	if (hasReservedBuffers)
+		return;
+
+	// @init also runs when a project is loaded, after @serialize has read its state into the runtime memory
+	if (HasSerializeSection(ast))
+		return;
+
+	Array arguments = AllocateArray(sizeof(NodePtr));
+	NodePtr argument = AllocIdentifier(staticEnd, staticEnd->lineNumber);
+	ArrayAdd(&arguments, &argument);
+	InsertAfter(module, staticEndNode, 0, AllocCallStatement(freeNode->ptr, arguments, staticEnd->lineNumber));
+}
+
+// adds the values of one element to the array, in the same order as they are in memory
+static Result FlattenValue(NodePtr node, StructDeclStmt* structType, PrimitiveType primitiveType, int lineNumber, Array* values, const char* path)
+{
+	if (structType)
+	{
+		if (node.type != Node_InitializerList)
+			return ERROR_RESULT(AllocateString1Str("Expected an initializer list for struct \"%s\"", structType->name), lineNumber, path);
+
+		const InitializerListNode* list = node.ptr;
+		if (list->values.length != structType->members.length)
+			return ERROR_RESULT(
+				AllocateString1Str1Int("Initializer lists for struct \"%s\" need %" PRId64 " values", structType->name, (int64_t)structType->members.length),
+				list->lineNumber, path);
+
+		for (size_t i = 0; i < list->values.length; ++i)
+		{
+			const NodePtr* member = structType->members.array[i];
+			ASSERT(member->type == Node_VariableDeclaration);
+			const Type memberType = ((VarDeclStmt*)member->ptr)->type;
+			StructDeclStmt* memberStruct = GetStructTypeInfoFromType(memberType).effectiveType;
+			PROPAGATE_ERROR(FlattenValue(
+				*(NodePtr*)list->values.array[i],
+				memberStruct,
+				memberStruct ? Primitive_Any : GetPrimitiveTypeInfoFromType(memberType).effectiveType,
+				list->lineNumber, values, path));
+		}
+		return SUCCESS_RESULT;
+	}
+
+	if (node.type == Node_InitializerList)
+		return ERROR_RESULT("Expected a value instead of an initializer list", ((InitializerListNode*)node.ptr)->lineNumber, path);
+
+	double value;
+	if (node.type == Node_Literal && ((LiteralExpr*)node.ptr)->type == Literal_Boolean)
+		value = ((LiteralExpr*)node.ptr)->boolean;
+	else if (!EvaluateConstant(node, NULL, &value) || !isfinite(value))
+		return ERROR_RESULT("Initializer lists can only contain constant values", lineNumber, path);
+
+	if (primitiveType == Primitive_Int)
+		value = trunc(value);
+	else if (primitiveType == Primitive_Bool)
+		value = fabs(value) >= JSFX_EPSILON;
+
+	NodePtr number = AllocDouble(value, lineNumber);
+	ArrayAdd(values, &number);
+	return SUCCESS_RESULT;
+}
+
+static void AddSetValuesCalls(ModuleNode* module, const NodePtr** statement, FuncDeclStmt* setValues, const NodePtr* values, uint64_t address, uint64_t count, int lineNumber)
+{
+	size_t index = 0;
+	for (uint64_t start = 0; start < count; start += VALUES_PER_CALL)
+	{
+		Array arguments = AllocateArray(sizeof(NodePtr));
+		NodePtr argument = AllocUInt64Integer(address + start, lineNumber);
+		ArrayAdd(&arguments, &argument);
+		for (uint64_t i = start; i < count && i < start + VALUES_PER_CALL; ++i)
+			ArrayAdd(&arguments, &values[i]);
+
+		index = InsertAfter(module, *statement, index, AllocCallStatement(setValues, arguments, lineNumber));
+		*statement = module->statements.array[index];
+	}
+}
+
+// the values of a buffer with an initializer list are written with a few mem_set_values() calls,
+// instead of one assignment for every element and member
+static Result AddInitializerList(const AST* ast, ModuleNode* module, const NodePtr* statement)
+{
+	VarDeclStmt* varDecl = statement->ptr;
+	ASSERT(varDecl->initializerList.type == Node_InitializerList);
+	const InitializerListNode* list = varDecl->initializerList.ptr;
+
+	const Type ptrType = GetPtrMember(GetStructTypeInfoFromType(varDecl->type).effectiveType)->type;
+	StructDeclStmt* elementType = GetStructTypeInfoFromType(ptrType).pointerType;
+	const PrimitiveType primitiveType = GetPrimitiveTypeInfoFromType(ptrType).pointerType;
+
+	Array values = AllocateArray(sizeof(NodePtr));
+	for (size_t i = 0; i < list->values.length; ++i)
+		PROPAGATE_ERROR(FlattenValue(*(NodePtr*)list->values.array[i], elementType, primitiveType, list->lineNumber, &values, module->path));
+
+	NodePtr* setValuesNode = FindDeclaration(FindModule(ast, "mem"), Node_FunctionDeclaration, "set_values");
+	ASSERT(setValuesNode);
+
+	const size_t elementCount = list->values.length;
+	const uint64_t slotCount = elementCount == 0 ? 0 : values.length / elementCount;
+	NodePtr* flatValues = malloc(sizeof(NodePtr) * (values.length + 1));
+	if (elementType && elementType->layout == StructLayout_StructOfArrays)
+	{
+		// each member has its own array, so the values are written one member at a time
+		for (uint64_t member = 0; member < slotCount; ++member)
+		{
+			for (size_t i = 0; i < elementCount; ++i)
+				flatValues[i] = *(NodePtr*)values.array[i * slotCount + member];
+			AddSetValuesCalls(module, &statement, setValuesNode->ptr, flatValues,
+				varDecl->staticAddress + member * elementType->capacity, elementCount, list->lineNumber);
+		}
+	}
+	else
+	{
+		for (size_t i = 0; i < values.length; ++i)
+			flatValues[i] = *(NodePtr*)values.array[i];
+		AddSetValuesCalls(module, &statement, setValuesNode->ptr, flatValues, varDecl->staticAddress, values.length, list->lineNumber);
+	}
+	free(flatValues);
+
+	FreeArray(&values);
+	FreeASTNode(varDecl->initializerList);
+	varDecl->initializerList = NULL_NODE;
+	return SUCCESS_RESULT;
+}
+
+static DescStmt* FindDesc(const AST* ast, ModuleNode** descModule)
+{
+	for (size_t i = 0; i < ast->nodes.length; ++i)
+	{
+		ModuleNode* module = ((NodePtr*)ast->nodes.array[i])->ptr;
+		for (size_t j = 0; j < module->statements.length; ++j)
+		{
+			NodePtr* node = module->statements.array[j];
+			if (node->type == Node_Desc)
+			{
+				*descModule = module;
+				return node->ptr;
+			}
+		}
+	}
+	return NULL;
+}
+
+static uint64_t GetMemoryEnd(const AST* ast)
+{
+	ModuleNode* descModule = NULL;
+	const DescStmt* desc = FindDesc(ast, &descModule);
+	if (desc && desc->maxMemory)
+		return (uint64_t)strtod(desc->maxMemory, NULL);
+	return DEFAULT_MAX_MEMORY;
+}
+
+// effects that need more than the default amount of memory have to ask for it
+static Result SetMaxMemory(const AST* ast, ModuleNode* mainModule)
+{
+	ModuleNode* descModule = mainModule;
+	DescStmt* desc = FindDesc(ast, &descModule);
+	if (desc && desc->maxMemory)
+	{
+		double maxMemory = strtod(desc->maxMemory, NULL);
+		if (maxMemory < (double)top)
+			return ERROR_RESULT(
+				AllocateString2Int("Static buffers need %" PRId64 " memory slots, but max_memory is %" PRId64, (int64_t)top, (int64_t)maxMemory),
+				desc->lineNumber, descModule->path);
+		return SUCCESS_RESULT;
+	}
+
+	if (top <= DEFAULT_MAX_MEMORY)
+		return SUCCESS_RESULT;
+
+	if (!desc)
+	{
+		NodePtr node = AllocASTNode(
+			&(DescStmt){
+				.lineNumber = -1,
+				.propertyList = NULL_NODE,
+				.allKeyboard = PropertyBoolean_NotSet,
+				.noMeter = PropertyBoolean_NotSet,
+				.idleMode = IdleMode_NotSet,
+			},
+			sizeof(DescStmt), Node_Desc);
+		ArrayAdd(&mainModule->statements, &node);
+		desc = node.ptr;
+	}
+	desc->maxMemory = AllocUInt64ToString(RoundUpToBlock(top));
+	return SUCCESS_RESULT;
+}
+
+static int CompareEntries(const void* a, const void* b)
+{
+	const MapEntry* entryA = *(const MapEntry* const*)a;
+	const MapEntry* entryB = *(const MapEntry* const*)b;
+	return (entryA->address > entryB->address) - (entryA->address < entryB->address);
+}
+
+static void PrintMemoryMap(void)
+{
+	for (size_t i = 0; i < gaps.length; ++i)
+	{
+		const Gap* gap = gaps.array[i];
+		ArrayAdd(&entries, &(MapEntry){.address = gap->start, .size = gap->end - gap->start});
+	}
+	qsort(entries.array, entries.length, sizeof(*entries.array), CompareEntries);
+
+	printf("Static memory map (%" PRIu64 " slots)\n", top);
+	printf("  %10s %10s  %s\n", "address", "slots", "buffer");
+	for (size_t i = 0; i < entries.length; ++i)
+	{
+		const MapEntry* entry = entries.array[i];
+		if (entry->name)
+			printf("  %10" PRIu64 " %10" PRIu64 "  %s.%s\n", entry->address, entry->size, entry->moduleName, entry->name);
+		else
+			printf("  %10" PRIu64 " %10" PRIu64 "  (unused)\n", entry->address, entry->size);
+	}
+}
+
+// gives every static buffer (an array at file scope with a length property or an initializer list) its own place in memory
+Result StaticMemoryPass(const AST* ast, bool printMemoryMap)
+{
+	entries = AllocateArray(sizeof(MapEntry));
+	gaps = AllocateArray(sizeof(Gap));
+	top = 0;
+	const uint64_t memoryEnd = GetMemoryEnd(ast);
+	reservedStart = memoryEnd;
+
+	ModuleNode* mainModule = NULL;
+	for (size_t i = 0; i < ast->nodes.length; ++i)
+	{
+		const NodePtr* node = ast->nodes.array[i];
+		ASSERT(node->type == Node_Module);
+		ModuleNode* module = node->ptr;
+		for (size_t j = 0; j < module->statements.length; ++j)
+		{
+			NodePtr* statement = module->statements.array[j];
+			if (statement->type != Node_VariableDeclaration || ((VarDeclStmt*)statement->ptr)->staticLength == 0)
+				continue;
+
+			PROPAGATE_ERROR(PlaceBuffer(statement->ptr, module));
+			if (((VarDeclStmt*)statement->ptr)->initializerList.ptr)
+				PROPAGATE_ERROR(AddInitializerList(ast, module, statement));
+			mainModule = module;
+		}
+	}
+
+	if (top > reservedStart)
+		return ERROR_RESULT(
+			AllocateString2Int("Static buffers need %" PRId64 " memory slots, but only %" PRId64 " are left before the buffers of the debug build", (int64_t)top, (int64_t)reservedStart),
+			-1, NULL);
+
+	if (mainModule)
+	{
+		AddStaticEnd(ast, reservedStart != memoryEnd);
+		PROPAGATE_ERROR(SetMaxMemory(ast, mainModule));
+		if (printMemoryMap)
+			PrintMemoryMap();
+	}
+
+	FreeArray(&entries);
+	FreeArray(&gaps);
+	return SUCCESS_RESULT;
+}
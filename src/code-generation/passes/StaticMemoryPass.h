@@ -0,0 +1,7 @@
+#pragma once
+
+#include "Result.h"
+#include "SyntaxTree.h"
+
+Result StaticMemoryPass(const AST* ast, bool printMemoryMap);
+uint64_t GetStaticBufferSize(const VarDeclStmt* varDecl);
@@ -0,0 +1,477 @@
+#include "StructReferencePass.h"
+
+#include "Common.h"
+
+// struct arguments are passed as one parameter per member, so every member of a struct that is
+// already in memory gets loaded at the call even if the function only uses a couple of them.
+// if every call to a function passes a big struct parameter straight from memory, the parameter is
+// made a pointer to it instead. the function copies its parameters into local variables first
+// thing, so it still gets its own copy, and the loads of the members that it doesn't use are
+// removed as dead code
+
+typedef enum
+{
+	Visit_Collect,
+	Visit_Check,
+	Visit_Rewrite,
+} VisitMode;
+
+typedef struct
+{
+	FuncDeclStmt* function;
+	VarDeclStmt* parameter;
+	size_t index;
+	bool rejected;
+} Candidate;
+
+typedef struct
+{
+	FuncDeclStmt* function;
+	bool storeFree;
+} StoreFreeFunction;
+
+static Array candidates;
+static Array storeFreeFunctions;
+static int memberThreshold;
+static VisitMode mode;
+
+static void VisitStatement(NodePtr* node);
+static void VisitExpression(NodePtr* node);
+static bool HasStores(NodePtr node);
+
+static size_t CountMembers(StructDeclStmt* type)
+{
+	size_t count = 0;
+	for (size_t i = 0; i < type->members.length; ++i)
+	{
+		const NodePtr* node = type->members.array[i];
+		ASSERT(node->type == Node_VariableDeclaration);
+		StructDeclStmt* memberType = GetStructTypeInfoFromType(((VarDeclStmt*)node->ptr)->type).effectiveType;
+		count += memberType ? CountMembers(memberType) : 1;
+	}
+	return count;
+}
+
+static FuncDeclStmt* GetCalledFunction(const FuncCallExpr* funcCall)
+{
+	ASSERT(funcCall->baseExpr.type == Node_MemberAccess);
+	FuncDeclStmt* funcDecl = ((MemberAccessExpr*)funcCall->baseExpr.ptr)->funcReference;
+	ASSERT(funcDecl != NULL);
+	return funcDecl;
+}
+
+static bool IsMemoryTarget(NodePtr node)
+{
+	if (node.type == Node_Subscript)
+		return true;
+	if (node.type == Node_MemberAccess)
+		return ((MemberAccessExpr*)node.ptr)->start.ptr != NULL;
+	return false;
+}
+
+// functions that call each other are treated as writing to memory,
+// there is no way to know yet if the other one does
+static bool IsStoreFree(FuncDeclStmt* funcDecl)
+{
+	if (funcDecl->modifiers.externalValue)
+		return funcDecl->pure == PropertyBoolean_True;
+
+	for (size_t i = 0; i < storeFreeFunctions.length; ++i)
+	{
+		const StoreFreeFunction* function = storeFreeFunctions.array[i];
+		if (function->function == funcDecl)
+			return function->storeFree;
+	}
+
+	size_t index = storeFreeFunctions.length;
+	ArrayAdd(&storeFreeFunctions, &(StoreFreeFunction){.function = funcDecl, .storeFree = false});
+	bool storeFree = !HasStores(funcDecl->block);
+	((StoreFreeFunction*)storeFreeFunctions.array[index])->storeFree = storeFree;
+	return storeFree;
+}
+
+static bool HasStores(NodePtr node)
+{
+	switch (node.type)
+	{
+	case Node_Null:
+	case Node_Literal:
+	case Node_SizeOf:
+	case Node_LoopControl:
+	// they only run when they are called
+	case Node_FunctionDeclaration:
+		return false;
+	case Node_MemberAccess:
+	{
+		MemberAccessExpr* memberAccess = node.ptr;
+		return HasStores(memberAccess->start);
+	}
+	case Node_Binary:
+	{
+		BinaryExpr* binary = node.ptr;
+		if (binary->operatorType >= Binary_Assignment && IsMemoryTarget(binary->left))
+			return true;
+		return HasStores(binary->left) || HasStores(binary->right);
+	}
+	case Node_Unary:
+	{
+		UnaryExpr* unary = node.ptr;
+		if ((unary->operatorType == Unary_Increment || unary->operatorType == Unary_Decrement) &&
+			IsMemoryTarget(unary->expression))
+			return true;
+		return HasStores(unary->expression);
+	}
+	case Node_FunctionCall:
+	{
+		FuncCallExpr* funcCall = node.ptr;
+		if (!IsStoreFree(GetCalledFunction(funcCall)))
+			return true;
+		for (size_t i = 0; i < funcCall->arguments.length; ++i)
+			if (HasStores(*(NodePtr*)funcCall->arguments.array[i]))
+				return true;
+		return false;
+	}
+	case Node_Subscript:
+	{
+		SubscriptExpr* subscript = node.ptr;
+		return HasStores(subscript->baseExpr) || HasStores(subscript->indexExpr);
+	}
+	case Node_BlockExpression:
+	{
+		BlockExpr* blockExpr = node.ptr;
+		return HasStores(blockExpr->block);
+	}
+	case Node_ExpressionStatement:
+	{
+		ExpressionStmt* exprStmt = node.ptr;
+		return HasStores(exprStmt->expr);
+	}
+	case Node_VariableDeclaration:
+	{
+		VarDeclStmt* varDecl = node.ptr;
+		return HasStores(varDecl->initializer);
+	}
+	case Node_Return:
+	{
+		ReturnStmt* returnStmt = node.ptr;
+		return HasStores(returnStmt->expr);
+	}
+	case Node_BlockStatement:
+	{
+		BlockStmt* block = node.ptr;
+		for (size_t i = 0; i < block->statements.length; ++i)
+			if (HasStores(*(NodePtr*)block->statements.array[i]))
+				return true;
+		return false;
+	}
+	case Node_If:
+	{
+		IfStmt* ifStmt = node.ptr;
+		return HasStores(ifStmt->expr) || HasStores(ifStmt->trueStmt) || HasStores(ifStmt->falseStmt);
+	}
+	case Node_While:
+	{
+		WhileStmt* whileStmt = node.ptr;
+		return HasStores(whileStmt->expr) || HasStores(whileStmt->stmt);
+	}
+	default: INVALID_VALUE(node.type);
+	}
+}
+
+static Candidate* FindCandidate(const VarDeclStmt* parameter)
+{
+	for (size_t i = 0; i < candidates.length; ++i)
+	{
+		Candidate* candidate = candidates.array[i];
+		if (candidate->parameter == parameter)
+			return candidate;
+	}
+	return NULL;
+}
+
+static void AddCandidates(FuncDeclStmt* funcDecl)
+{
+	if (funcDecl->modifiers.externalValue ||
+		funcDecl->variadic ||
+		funcDecl->isBlockExpression ||
+		funcDecl->block.ptr == NULL)
+		return;
+
+	for (size_t i = 0; i < funcDecl->parameters.length; ++i)
+	{
+		const NodePtr* node = funcDecl->parameters.array[i];
+		ASSERT(node->type == Node_VariableDeclaration);
+		VarDeclStmt* parameter = node->ptr;
+
+		StructDeclStmt* type = GetStructTypeInfoFromType(parameter->type).effectiveType;
+		if (type == NULL ||
+			type->isArrayType ||
+			CountMembers(type) < (size_t)memberThreshold)
+			continue;
+
+		ArrayAdd(&candidates, &(Candidate){
+								  .function = funcDecl,
+								  .parameter = parameter,
+								  .index = i,
+								  .rejected = false,
+							  });
+	}
+}
+
+// the argument has to already be in memory, and the arguments after it can't write to memory
+// because the members are only loaded once the function has been called
+static bool CanPassAddress(const FuncCallExpr* funcCall, size_t index, StructDeclStmt* type)
+{
+	NodePtr argument = *(NodePtr*)funcCall->arguments.array[index];
+	if (argument.type != Node_Subscript || GetStructTypeInfoFromExpr(argument).effectiveType != type)
+		return false;
+
+	for (size_t i = index + 1; i < funcCall->arguments.length; ++i)
+		if (HasStores(*(NodePtr*)funcCall->arguments.array[i]))
+			return false;
+	return true;
+}
+
+// adding to a struct pointer already skips whole elements
+static NodePtr AllocAddressOf(SubscriptExpr* subscript)
+{
+	NodePtr address = AllocASTNode(
+		&(BinaryExpr){
+			.lineNumber = subscript->lineNumber,
+			.operatorType = Binary_Add,
+			.left = subscript->baseExpr,
+			.right = AllocIntConversion(subscript->indexExpr, subscript->lineNumber),
+		},
+		sizeof(BinaryExpr), Node_Binary);
+
+	subscript->baseExpr = NULL_NODE;
+	subscript->indexExpr = NULL_NODE;
+	return address;
+}
+
+static void VisitFunctionCall(FuncCallExpr* funcCall)
+{
+	for (size_t i = 0; i < funcCall->arguments.length; ++i)
+		VisitExpression(funcCall->arguments.array[i]);
+
+	if (mode == Visit_Collect)
+		return;
+
+	FuncDeclStmt* funcDecl = GetCalledFunction(funcCall);
+	for (size_t i = 0; i < candidates.length; ++i)
+	{
+		Candidate* candidate = candidates.array[i];
+		if (candidate->function != funcDecl || candidate->rejected)
+			continue;
+
+		ASSERT(candidate->index < funcCall->arguments.length);
+		if (mode == Visit_Check)
+		{
+			StructDeclStmt* type = GetStructTypeInfoFromType(candidate->parameter->type).effectiveType;
+			if (!CanPassAddress(funcCall, candidate->index, type))
+				candidate->rejected = true;
+			continue;
+		}
+
+		NodePtr* argument = funcCall->arguments.array[candidate->index];
+		ASSERT(argument->type == Node_Subscript);
+		NodePtr address = AllocAddressOf(argument->ptr);
+		FreeASTNode(*argument);
+		*argument = address;
+	}
+}
+
+static void VisitMemberAccess(NodePtr* node)
+{
+	ASSERT(node->type == Node_MemberAccess);
+	MemberAccessExpr* memberAccess = node->ptr;
+	VisitExpression(&memberAccess->start);
+
+	// the only thing that uses the parameter is the local variable that it is copied into
+	if (mode != Visit_Rewrite || memberAccess->start.ptr || memberAccess->varParentReference)
+		return;
+
+	Candidate* candidate = FindCandidate(memberAccess->varReference);
+	if (!candidate || candidate->rejected)
+		return;
+
+	NodePtr dereference = AllocASTNode(
+		&(SubscriptExpr){
+			.lineNumber = memberAccess->lineNumber,
+			.baseExpr = AllocIdentifier(candidate->parameter, memberAccess->lineNumber),
+			.indexExpr = AllocUInt64Integer(0, memberAccess->lineNumber),
+		},
+		sizeof(SubscriptExpr), Node_Subscript);
+	FreeASTNode(*node);
+	*node = dereference;
+}
+
+static void VisitExpression(NodePtr* node)
+{
+	switch (node->type)
+	{
+	case Node_Literal:
+	case Node_Null:
+		break;
+	case Node_MemberAccess:
+	{
+		VisitMemberAccess(node);
+		break;
+	}
+	case Node_Binary:
+	{
+		BinaryExpr* binary = node->ptr;
+		VisitExpression(&binary->left);
+		VisitExpression(&binary->right);
+		break;
+	}
+	case Node_Unary:
+	{
+		UnaryExpr* unary = node->ptr;
+		VisitExpression(&unary->expression);
+		break;
+	}
+	case Node_FunctionCall:
+	{
+		VisitFunctionCall(node->ptr);
+		break;
+	}
+	case Node_Subscript:
+	{
+		SubscriptExpr* subscript = node->ptr;
+		VisitExpression(&subscript->baseExpr);
+		VisitExpression(&subscript->indexExpr);
+		break;
+	}
+	case Node_SizeOf:
+	{
+		SizeOfExpr* sizeOf = node->ptr;
+		VisitExpression(&sizeOf->expr);
+		break;
+	}
+	case Node_BlockExpression:
+	{
+		BlockExpr* block = node->ptr;
+		VisitStatement(&block->block);
+		break;
+	}
+	default: INVALID_VALUE(node->type);
+	}
+}
+
+static void VisitStatement(NodePtr* node)
+{
+	switch (node->type)
+	{
+	case Node_StructDeclaration:
+	case Node_LoopControl:
+	case Node_Import:
+	case Node_Input:
+	case Node_Desc:
+	case Node_Null:
+		break;
+	case Node_VariableDeclaration:
+	{
+		VarDeclStmt* varDecl = node->ptr;
+		VisitExpression(&varDecl->initializer);
+		break;
+	}
+	case Node_ExpressionStatement:
+	{
+		ExpressionStmt* exprStmt = node->ptr;
+		VisitExpression(&exprStmt->expr);
+		break;
+	}
+	case Node_FunctionDeclaration:
+	{
+		FuncDeclStmt* funcDecl = node->ptr;
+		if (mode == Visit_Collect)
+			AddCandidates(funcDecl);
+		VisitStatement(&funcDecl->block);
+		break;
+	}
+	case Node_BlockStatement:
+	{
+		const BlockStmt* block = node->ptr;
+		for (size_t i = 0; i < block->statements.length; ++i)
+			VisitStatement(block->statements.array[i]);
+		break;
+	}
+	case Node_If:
+	{
+		IfStmt* ifStmt = node->ptr;
+		VisitStatement(&ifStmt->trueStmt);
+		VisitStatement(&ifStmt->falseStmt);
+		VisitExpression(&ifStmt->expr);
+		break;
+	}
+	case Node_Return:
+	{
+		ReturnStmt* returnStmt = node->ptr;
+		VisitExpression(&returnStmt->expr);
+		break;
+	}
+	case Node_Section:
+	{
+		SectionStmt* section = node->ptr;
+		VisitStatement(&section->block);
+		break;
+	}
+	case Node_While:
+	{
+		WhileStmt* whileStmt = node->ptr;
+		VisitExpression(&whileStmt->expr);
+		VisitStatement(&whileStmt->stmt);
+		break;
+	}
+	default: INVALID_VALUE(node->type);
+	}
+}
+
+static void VisitModules(const AST* ast, VisitMode visitMode)
+{
+	mode = visitMode;
+	for (size_t i = 0; i < ast->nodes.length; ++i)
+	{
+		const NodePtr* node = ast->nodes.array[i];
+
+		ASSERT(node->type == Node_Module);
+		const ModuleNode* module = node->ptr;
+
+		for (size_t i = 0; i < module->statements.length; ++i)
+			VisitStatement(module->statements.array[i]);
+	}
+}
+
+int StructReferencePass(const AST* ast, int threshold)
+{
+	if (threshold <= 0)
+		return 0;
+
+	int changeCount = 0;
+	memberThreshold = threshold;
+	candidates = AllocateArray(sizeof(Candidate));
+	storeFreeFunctions = AllocateArray(sizeof(StoreFreeFunction));
+
+	// the calls can come before the function, so all of the candidates are found first
+	VisitModules(ast, Visit_Collect);
+	if (candidates.length != 0)
+	{
+		VisitModules(ast, Visit_Check);
+		VisitModules(ast, Visit_Rewrite);
+
+		for (size_t i = 0; i < candidates.length; ++i)
+		{
+			Candidate* candidate = candidates.array[i];
+			if (!candidate->rejected)
+			{
+				candidate->parameter->type.modifier = TypeModifier_Pointer;
+				++changeCount;
+			}
+		}
+	}
+
+	FreeArray(&storeFreeFunctions);
+	FreeArray(&candidates);
+	return changeCount;
+}
@@ -0,0 +1,5 @@
+#pragma once
+
+#include "SyntaxTree.h"
+
+int StructReferencePass(const AST* ast, int threshold);
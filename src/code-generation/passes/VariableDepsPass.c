@@ -113,11 +113,16 @@ static void EnvSetDep(Env* env, const VarDeclStmt* var, NodePtr dep, bool add)
 	}
 }
 
-static Array* EnvGetDeps(Env* env, const VarDeclStmt* var)
+static Array* EnvFindDeps(Env* env, const VarDeclStmt* var)
 {
 	char key[64];
 	snprintf(key, sizeof(key), "%p", (const void*)var);
-	Array* deps = MapGet(env, key);
+	return MapGet(env, key);
+}
+
+static Array* EnvGetDeps(Env* env, const VarDeclStmt* var)
+{
+	Array* deps = EnvFindDeps(env, var);
 	ASSERT(deps);
 	ASSERT(deps->length > 0);
 	return deps;
@@ -247,8 +252,9 @@ static Env VisitStatement(NodePtr node, Env* env)
 			if (!memberAccess->varReference->inputStmt)
 			{
 				bool lastDepIsInDifferentSection = false;
-				Array* deps = EnvGetDeps(env, memberAccess->varReference);
-				for (size_t i = 0; i < deps->length; ++i)
+				// the declaration might have already been removed if this pass is running again
+				Array* deps = EnvFindDeps(env, memberAccess->varReference);
+				for (size_t i = 0; deps && i < deps->length; ++i)
 				{
 					NodePtr* dep = deps->array[i];
 					SectionStmt* section = NULL;
@@ -329,8 +335,131 @@ static Env VisitStatement(NodePtr node, Env* env)
 	return *env;
 }
 
+// clears everything from the last time this pass ran, so that it can be run again after the tree has changed
+static void ResetDeps(NodePtr node)
+{
+	switch (node.type)
+	{
+	case Node_MemberAccess:
+	{
+		MemberAccessExpr* memberAccess = node.ptr;
+		if (memberAccess->deps.array)
+			ArrayClear(&memberAccess->deps);
+		ResetDeps(memberAccess->start);
+		break;
+	}
+	case Node_Binary:
+	{
+		BinaryExpr* binary = node.ptr;
+		ResetDeps(binary->left);
+		ResetDeps(binary->right);
+		break;
+	}
+	case Node_Unary:
+	{
+		UnaryExpr* unary = node.ptr;
+		ResetDeps(unary->expression);
+		break;
+	}
+	case Node_FunctionCall:
+	{
+		FuncCallExpr* funcCall = node.ptr;
+		ResetDeps(funcCall->baseExpr);
+		for (size_t i = 0; i < funcCall->arguments.length; ++i)
+			ResetDeps(*(NodePtr*)funcCall->arguments.array[i]);
+		break;
+	}
+	case Node_Subscript:
+	{
+		SubscriptExpr* subscript = node.ptr;
+		ResetDeps(subscript->baseExpr);
+		ResetDeps(subscript->indexExpr);
+		break;
+	}
+	case Node_BlockExpression:
+	{
+		BlockExpr* blockExpr = node.ptr;
+		ResetDeps(blockExpr->block);
+		break;
+	}
+	case Node_ExpressionStatement:
+	{
+		ExpressionStmt* exprStmt = node.ptr;
+		exprStmt->useCount = 0;
+		exprStmt->unused = false;
+		exprStmt->keepRight = false;
+		ResetDeps(exprStmt->expr);
+		break;
+	}
+	case Node_VariableDeclaration:
+	{
+		VarDeclStmt* varDecl = node.ptr;
+		varDecl->useCount = 0;
+		varDecl->unused = false;
+		varDecl->keepRight = false;
+		ResetDeps(varDecl->initializer);
+		break;
+	}
+	case Node_Input:
+	{
+		InputStmt* input = node.ptr;
+		ResetDeps(input->varDecl);
+		break;
+	}
+	case Node_FunctionDeclaration:
+	{
+		FuncDeclStmt* funcDecl = node.ptr;
+		for (size_t i = 0; i < funcDecl->parameters.length; ++i)
+			ResetDeps(*(NodePtr*)funcDecl->parameters.array[i]);
+		ResetDeps(funcDecl->block);
+		break;
+	}
+	case Node_BlockStatement:
+	{
+		BlockStmt* block = node.ptr;
+		for (size_t i = 0; i < block->statements.length; ++i)
+			ResetDeps(*(NodePtr*)block->statements.array[i]);
+		break;
+	}
+	case Node_If:
+	{
+		IfStmt* ifStmt = node.ptr;
+		ResetDeps(ifStmt->expr);
+		ResetDeps(ifStmt->trueStmt);
+		ResetDeps(ifStmt->falseStmt);
+		break;
+	}
+	case Node_While:
+	{
+		WhileStmt* whileStmt = node.ptr;
+		ResetDeps(whileStmt->expr);
+		ResetDeps(whileStmt->stmt);
+		break;
+	}
+	case Node_Section:
+	{
+		SectionStmt* section = node.ptr;
+		ResetDeps(section->block);
+		break;
+	}
+	default:
+		break;
+	}
+}
+
 void VariableDepsPass(const AST* ast)
 {
+	for (size_t i = 0; i < ast->nodes.length; ++i)
+	{
+		const NodePtr* node = ast->nodes.array[i];
+
+		ASSERT(node->type == Node_Module);
+		const ModuleNode* module = node->ptr;
+
+		for (size_t i = 0; i < module->statements.length; ++i)
+			ResetDeps(*(NodePtr*)module->statements.array[i]);
+	}
+
 	Env env = EnvAlloc();
 	for (size_t i = 0; i < ast->nodes.length; ++i)
 	{
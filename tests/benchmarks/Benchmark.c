@@ -0,0 +1,184 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+
+#define MAX_PATH_LENGTH 4096
+#define MAX_COMMAND_LENGTH (MAX_PATH_LENGTH * 4)
+#define SAMPLE_RATE 48000
+
+static const char* const levels[] = {"O0", "O1", "O2", "Os"};
+
+#define LEVEL_COUNT (sizeof(levels) / sizeof(levels[0]))
+
+typedef struct
+{
+	long size;
+	double opsPerSample;
+	double nsPerSample;
+	double gfxOpsPerFrame;
+	char hash[17];
+} Result;
+
+static const char* scythePath;
+static const char* evaluatorPath;
+static const char* outputDirectory;
+static unsigned long long samples;
+
+// the examples are all called Main.scy, so those are named after their directory
+static void GetName(const char* path, char* name, size_t size)
+{
+	const char* fileName = strrchr(path, '/');
+	fileName = fileName ? fileName + 1 : path;
+
+	const char* start = fileName;
+	size_t length = strcspn(fileName, ".");
+	if (strncmp(fileName, "Main.", 5) == 0 && fileName != path)
+	{
+		const char* end = fileName - 1;
+		start = end;
+		while (start > path && start[-1] != '/')
+			--start;
+		length = (size_t)(end - start);
+	}
+
+	if (length >= size)
+		length = size - 1;
+	memcpy(name, start, length);
+	name[length] = '\0';
+}
+
+static char* ReadFile(const char* path)
+{
+	FILE* file = fopen(path, "rb");
+	if (!file)
+		return NULL;
+
+	fseek(file, 0, SEEK_END);
+	long length = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	char* buffer = malloc((size_t)length + 1);
+	size_t read = fread(buffer, 1, (size_t)length, file);
+	buffer[read] = '\0';
+	fclose(file);
+	return buffer;
+}
+
+static long FileSize(const char* path)
+{
+	FILE* file = fopen(path, "rb");
+	if (!file)
+		return -1;
+
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fclose(file);
+	return size;
+}
+
+// the report is written by the evaluator, so only the fields that are needed are looked for
+static double ReadNumber(const char* json, const char* key)
+{
+	const char* found = strstr(json, key);
+	return found ? strtod(found + strlen(key), NULL) : 0;
+}
+
+static bool Run(const char* path, const char* name, const char* level, Result* result)
+{
+	char output[MAX_PATH_LENGTH];
+	char report[MAX_PATH_LENGTH];
+	char command[MAX_COMMAND_LENGTH];
+	snprintf(output, sizeof(output), "%s/%s_%s.jsfx", outputDirectory, name, level);
+	snprintf(report, sizeof(report), "%s/%s_%s.json", outputDirectory, name, level);
+
+	snprintf(command, sizeof(command), "\"%s\" \"%s\" \"%s\" -%s > \"%s.log\" 2>&1", scythePath, path, output, level, output);
+	if (system(command) != 0)
+	{
+		fprintf(stderr, "Could not compile \"%s\" with -%s, see %s.log\n", path, level, output);
+		return false;
+	}
+
+	snprintf(command, sizeof(command), "\"%s\" \"%s\" --samples %llu --json > \"%s\"", evaluatorPath, output, samples, report);
+	if (system(command) != 0)
+	{
+		fprintf(stderr, "Could not run \"%s\", see %s\n", output, report);
+		return false;
+	}
+
+	char* json = ReadFile(report);
+	if (!json)
+	{
+		fprintf(stderr, "Could not read \"%s\"\n", report);
+		return false;
+	}
+
+	result->size = FileSize(output);
+	result->opsPerSample = ReadNumber(json, "\"ops_per_sample\": ");
+	result->nsPerSample = ReadNumber(json, "\"ns_per_sample\": ");
+
+	// @gfx runs once, so the renderer still gets a number
+	double gfxRuns = ReadNumber(json, "\"gfx\": {\"runs\": ");
+	const char* gfx = strstr(json, "\"gfx\": {");
+	double gfxOps = gfx ? ReadNumber(gfx, "\"ops\": ") : 0;
+	result->gfxOpsPerFrame = gfxRuns ? gfxOps / gfxRuns : 0;
+
+	const char* hash = strstr(json, "\"hash\": \"");
+	snprintf(result->hash, sizeof(result->hash), "%.16s", hash ? hash + strlen("\"hash\": \"") : "");
+
+	free(json);
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 6)
+	{
+		fprintf(stderr, "Usage: %s <scythe> <evaluator> <output_directory> <seconds> <file.scy>...\n", argv[0]);
+		return 1;
+	}
+
+	scythePath = argv[1];
+	evaluatorPath = argv[2];
+	outputDirectory = argv[3];
+	samples = (unsigned long long)(strtod(argv[4], NULL) * SAMPLE_RATE);
+
+	char csvPath[MAX_PATH_LENGTH];
+	snprintf(csvPath, sizeof(csvPath), "%s/bench_runtime.csv", outputDirectory);
+	FILE* csv = fopen(csvPath, "w");
+	if (!csv)
+	{
+		fprintf(stderr, "Could not open \"%s\" for writing\n", csvPath);
+		return 1;
+	}
+
+	// ops/sample, size and hash only change when the compiler does, ns/sample depends on the machine
+	fprintf(csv, "benchmark,level,size,ops_per_sample,ns_per_sample,gfx_ops_per_frame,hash\n");
+	printf("%-20s %-6s %10s %14s %12s %16s  %s\n", "benchmark", "level", "size", "ops/sample", "ns/sample", "gfx ops/frame", "hash");
+
+	int failed = 0;
+	for (int i = 5; i < argc; ++i)
+	{
+		char name[256];
+		GetName(argv[i], name, sizeof(name));
+
+		for (size_t j = 0; j < LEVEL_COUNT; ++j)
+		{
+			Result result;
+			if (!Run(argv[i], name, levels[j], &result))
+			{
+				++failed;
+				continue;
+			}
+
+			printf("%-20s %-6s %10ld %14.3f %12.1f %16.0f  %s\n",
+				name, levels[j], result.size, result.opsPerSample, result.nsPerSample, result.gfxOpsPerFrame, result.hash);
+			fprintf(csv, "%s,%s,%ld,%.3f,%.1f,%.0f,%s\n",
+				name, levels[j], result.size, result.opsPerSample, result.nsPerSample, result.gfxOpsPerFrame, result.hash);
+		}
+	}
+
+	fclose(csv);
+	printf("\nResults written to %s\n", csvPath);
+	return failed ? 1 : 0;
+}
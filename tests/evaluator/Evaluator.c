@@ -0,0 +1,2707 @@
+#include <ctype.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// headless evaluator for the subset of JSFX/EEL2 that the compiler emits.
+// it is not a replacement for REAPER, but it is close enough to check that
+// optimizations do not change the behaviour of a program, and to count how much work
+// each section does.
+
+#define ASSERT(x)                                          \
+	do                                                     \
+	{                                                      \
+		if (!(x))                                          \
+		{                                                  \
+			fprintf(stderr, "Assertion failed: %s\n", #x); \
+			abort();                                       \
+		}                                                  \
+	}                                                      \
+	while (0)
+
+#define CLOSE_FACTOR 0.00001
+#define MAX_LOOP_ITERATIONS 1048576
+
+#define MEMORY_BLOCK_SIZE 65536
+#define MEMORY_BLOCKS 128
+#define GMEM_SIZE (1 << 20)
+
+#define STRING_SLOTS 1024
+#define STRING_LITERAL_START 10000
+
+#define MAX_CHANNELS 64
+#define MAX_SLIDERS 256
+#define STACK_SIZE 4096
+
+typedef enum
+{
+	Section_Init,
+	Section_Slider,
+	Section_Block,
+	Section_Sample,
+	Section_Serialize,
+	Section_GFX,
+	Section_Count,
+} SectionType;
+
+static const char* sectionNames[] = {
+	[Section_Init] = "init",
+	[Section_Slider] = "slider",
+	[Section_Block] = "block",
+	[Section_Sample] = "sample",
+	[Section_Serialize] = "serialize",
+	[Section_GFX] = "gfx",
+};
+
+typedef enum
+{
+	Op_None,
+	Op_Assign,
+	Op_AddAssign,
+	Op_SubAssign,
+	Op_MulAssign,
+	Op_DivAssign,
+	Op_ModAssign,
+	Op_PowAssign,
+	Op_OrAssign,
+	Op_AndAssign,
+	Op_XorAssign,
+	Op_BoolOr,
+	Op_BoolAnd,
+	Op_Equal,
+	Op_NotEqual,
+	Op_Less,
+	Op_Greater,
+	Op_LessEqual,
+	Op_GreaterEqual,
+	Op_XOR,
+	Op_BitAnd,
+	Op_BitOr,
+	Op_Add,
+	Op_Sub,
+	Op_Mul,
+	Op_Div,
+	Op_LeftShift,
+	Op_RightShift,
+	Op_Mod,
+	Op_Pow,
+	Op_Not,
+	Op_Negate,
+	Op_Plus,
+} Operator;
+
+// the levels of eel2's grammar, written out from eel2 rather than the compiler so that the
+// brackets the writer leaves out are checked
+static const int binaryPrecedence[] = {
+	[Op_Pow] = 10,
+	[Op_Mod] = 9,
+	[Op_LeftShift] = 9,
+	[Op_RightShift] = 9,
+	[Op_Div] = 8,
+	[Op_Mul] = 7,
+	[Op_Sub] = 6,
+	[Op_Add] = 5,
+	[Op_BitOr] = 4,
+	[Op_BitAnd] = 4,
+	[Op_XOR] = 4,
+	[Op_Equal] = 3,
+	[Op_NotEqual] = 3,
+	[Op_Less] = 3,
+	[Op_Greater] = 3,
+	[Op_LessEqual] = 3,
+	[Op_GreaterEqual] = 3,
+	[Op_BoolOr] = 2,
+	[Op_BoolAnd] = 2,
+};
+
+typedef enum
+{
+	Expr_Number,
+	Expr_Variable,
+	Expr_Subscript,
+	Expr_GMem,
+	Expr_Unary,
+	Expr_Binary,
+	Expr_Assignment,
+	Expr_Conditional,
+	Expr_Sequence,
+	Expr_Call,
+	Expr_While,
+	Expr_DoWhile,
+	Expr_Loop,
+} ExprType;
+
+typedef struct Expr Expr;
+typedef struct Function Function;
+typedef struct Evaluator Evaluator;
+
+typedef double (*BuiltinFunction)(Expr** args, size_t argCount);
+
+typedef struct
+{
+	const char* name;
+	BuiltinFunction function;
+	int minArgs;
+	int maxArgs;
+} Builtin;
+
+struct Expr
+{
+	ExprType type;
+	Operator operator;
+	int lineNumber;
+
+	double number;
+	double* variable;
+
+	Expr* left;
+	Expr* right;
+	Expr* third;
+
+	Expr** args;
+	size_t argCount;
+
+	char* callName;
+	Function* function;
+	const Builtin* builtin;
+	size_t sourcePosition;
+};
+
+typedef struct
+{
+	char* name;
+	double* value;
+} Variable;
+
+struct Function
+{
+	char* name;
+	char** parameterNames;
+	double** parameters;
+	size_t parameterCount;
+	Expr* body;
+	size_t sourcePosition;
+	uint64_t callCount;
+	uint64_t opCount;
+};
+
+typedef struct
+{
+	char* data;
+	size_t length;
+} String;
+
+typedef struct
+{
+	uint64_t ops;
+	uint64_t calls;
+	uint64_t memoryReads;
+	uint64_t memoryWrites;
+	uint64_t loopIterations;
+	uint64_t runs;
+} Counters;
+
+typedef struct
+{
+	char* source;
+	size_t sourceLength;
+	size_t sourcePosition;
+	Expr* code;
+	Counters counters;
+} Section;
+
+// ---------- global state ----------
+
+static const char* currentPath;
+
+static Variable* variables;
+static size_t variableCount;
+static size_t variableCapacity;
+
+static Function** functions;
+static size_t functionCount;
+
+static double* memoryBlocks[MEMORY_BLOCKS];
+static double* gmem;
+
+static String strings[STRING_SLOTS];
+static String* literalStrings;
+static size_t literalStringCount;
+
+static double stack[STACK_SIZE];
+static size_t stackPointer;
+
+static Section sections[Section_Count];
+static Counters* counters;
+static Counters scratchCounters;
+static Function* currentFunction;
+
+static uint64_t randomState = 0x2545F4914F6CDD1DULL;
+
+static double* splVariables[MAX_CHANNELS];
+static double* sliderVariables[MAX_SLIDERS + 1];
+static double sliderDefaults[MAX_SLIDERS + 1];
+static bool sliderExists[MAX_SLIDERS + 1];
+
+static bool hadRuntimeError;
+
+static void Fatal(int lineNumber, const char* format, ...)
+{
+	fflush(stdout);
+	va_list args;
+	va_start(args, format);
+	fprintf(stderr, "%s", currentPath ? currentPath : "evaluator");
+	if (lineNumber > 0) fprintf(stderr, ":%d", lineNumber);
+	fprintf(stderr, ": ");
+	vfprintf(stderr, format, args);
+	fprintf(stderr, "\n");
+	va_end(args);
+	exit(EXIT_FAILURE);
+}
+
+static void RuntimeError(const char* format, ...)
+{
+	if (hadRuntimeError)
+		return;
+	hadRuntimeError = true;
+
+	fflush(stdout);
+	va_list args;
+	va_start(args, format);
+	fprintf(stderr, "runtime error: ");
+	vfprintf(stderr, format, args);
+	fprintf(stderr, "\n");
+	va_end(args);
+}
+
+static void* AllocZeroed(size_t size)
+{
+	void* ptr = calloc(1, size);
+	if (!ptr)
+		Fatal(0, "out of memory");
+	return ptr;
+}
+
+static char* CopyString(const char* string, size_t length)
+{
+	char* new = AllocZeroed(length + 1);
+	memcpy(new, string, length);
+	new[length] = '\0';
+	return new;
+}
+
+static bool NameEquals(const char* a, const char* b)
+{
+	for (; *a && *b; ++a, ++b)
+		if (tolower((unsigned char)*a) != tolower((unsigned char)*b))
+			return false;
+	return *a == *b;
+}
+
+// ---------- variables ----------
+
+static double* GetVariable(const char* name)
+{
+	for (size_t i = 0; i < variableCount; ++i)
+		if (NameEquals(variables[i].name, name))
+			return variables[i].value;
+
+	if (variableCount == variableCapacity)
+	{
+		variableCapacity = variableCapacity ? variableCapacity * 2 : 256;
+		variables = realloc(variables, variableCapacity * sizeof(Variable));
+		if (!variables)
+			Fatal(0, "out of memory");
+	}
+
+	Variable* variable = &variables[variableCount++];
+	variable->name = CopyString(name, strlen(name));
+	variable->value = AllocZeroed(sizeof(double));
+	return variable->value;
+}
+
+static double* FindVariable(const char* name)
+{
+	for (size_t i = 0; i < variableCount; ++i)
+		if (NameEquals(variables[i].name, name))
+			return variables[i].value;
+	return NULL;
+}
+
+// ---------- memory ----------
+
+static int64_t ToIndex(double value)
+{
+	return (int64_t)floor(value + CLOSE_FACTOR);
+}
+
+static double* GetMemory(double address, bool write)
+{
+	int64_t index = ToIndex(address);
+	if (index < 0 || index >= (int64_t)MEMORY_BLOCK_SIZE * MEMORY_BLOCKS)
+		return NULL;
+
+	size_t block = (size_t)index / MEMORY_BLOCK_SIZE;
+	if (!memoryBlocks[block])
+	{
+		if (!write)
+			return NULL;
+		memoryBlocks[block] = AllocZeroed(MEMORY_BLOCK_SIZE * sizeof(double));
+	}
+	return &memoryBlocks[block][(size_t)index % MEMORY_BLOCK_SIZE];
+}
+
+static double ReadMemory(double address)
+{
+	counters->memoryReads++;
+	double* ptr = GetMemory(address, false);
+	return ptr ? *ptr : 0;
+}
+
+static void WriteMemory(double address, double value)
+{
+	counters->memoryWrites++;
+	double* ptr = GetMemory(address, true);
+	if (ptr)
+		*ptr = value;
+}
+
+// ---------- strings ----------
+
+static String* GetString(double value)
+{
+	int64_t index = ToIndex(value);
+	if (index >= 0 && index < STRING_SLOTS)
+		return &strings[index];
+	if (index >= STRING_LITERAL_START && (size_t)(index - STRING_LITERAL_START) < literalStringCount)
+		return &literalStrings[index - STRING_LITERAL_START];
+	return NULL;
+}
+
+static void SetString(String* string, const char* data, size_t length)
+{
+	char* new = CopyString(data, length);
+	free(string->data);
+	string->data = new;
+	string->length = length;
+}
+
+static double AddLiteralString(const char* data, size_t length)
+{
+	for (size_t i = 0; i < literalStringCount; ++i)
+		if (literalStrings[i].length == length && memcmp(literalStrings[i].data, data, length) == 0)
+			return (double)(STRING_LITERAL_START + i);
+
+	literalStrings = realloc(literalStrings, (literalStringCount + 1) * sizeof(String));
+	if (!literalStrings)
+		Fatal(0, "out of memory");
+	literalStrings[literalStringCount] = (String){.data = CopyString(data, length), .length = length};
+	return (double)(STRING_LITERAL_START + literalStringCount++);
+}
+
+// ---------- scanner ----------
+
+typedef enum
+{
+	Token_End,
+	Token_Number,
+	Token_String,
+	Token_Char,
+	Token_Identifier,
+	Token_Punctuation,
+} TokenType;
+
+typedef struct
+{
+	TokenType type;
+	const char* start;
+	size_t length;
+	int lineNumber;
+	size_t position;
+} Token;
+
+typedef struct
+{
+	const char* source;
+	size_t length;
+	size_t position;
+	size_t basePosition;
+	int lineNumber;
+	Token current;
+	Function* function;
+} Parser;
+
+static const char* punctuations[] = {
+	"+=", "-=", "*=", "/=", "%=", "^=", "|=", "&=", "~=",
+	"==", "!=", "<=", ">=", "<<", ">>", "&&", "||",
+	"+", "-", "*", "/", "%", "^", "|", "&", "~", "!", "<", ">", "=",
+	"(", ")", "[", "]", ",", ";", "?", ":",
+};
+
+static void SkipWhitespace(Parser* parser)
+{
+	while (parser->position < parser->length)
+	{
+		char c = parser->source[parser->position];
+		if (c == '\n')
+		{
+			parser->lineNumber++;
+			parser->position++;
+		}
+		else if (isspace((unsigned char)c))
+			parser->position++;
+		else if (c == '/' && parser->position + 1 < parser->length && parser->source[parser->position + 1] == '/')
+		{
+			while (parser->position < parser->length && parser->source[parser->position] != '\n')
+				parser->position++;
+		}
+		else if (c == '/' && parser->position + 1 < parser->length && parser->source[parser->position + 1] == '*')
+		{
+			parser->position += 2;
+			while (parser->position + 1 < parser->length &&
+				   !(parser->source[parser->position] == '*' && parser->source[parser->position + 1] == '/'))
+			{
+				if (parser->source[parser->position] == '\n')
+					parser->lineNumber++;
+				parser->position++;
+			}
+			parser->position += 2;
+		}
+		else
+			break;
+	}
+}
+
+static void NextToken(Parser* parser)
+{
+	SkipWhitespace(parser);
+
+	Token token = {.start = parser->source + parser->position, .lineNumber = parser->lineNumber, .position = parser->basePosition + parser->position};
+	if (parser->position >= parser->length)
+	{
+		token.type = Token_End;
+		parser->current = token;
+		return;
+	}
+
+	const char* s = parser->source;
+	size_t p = parser->position;
+	char c = s[p];
+
+	if (isdigit((unsigned char)c) || (c == '.' && p + 1 < parser->length && isdigit((unsigned char)s[p + 1])) || c == '$')
+	{
+		token.type = Token_Number;
+		if (c == '$' && p + 1 < parser->length && s[p + 1] == '\'')
+		{
+			p += 2;
+			while (p < parser->length && s[p] != '\'') p++;
+			p++;
+		}
+		else if (c == '$')
+		{
+			p++;
+			while (p < parser->length && (isalnum((unsigned char)s[p]) || s[p] == '.')) p++;
+		}
+		else
+		{
+			while (p < parser->length && (isalnum((unsigned char)s[p]) || s[p] == '.')) p++;
+		}
+	}
+	else if (isalpha((unsigned char)c) || c == '_' || c == '#')
+	{
+		token.type = Token_Identifier;
+		p++;
+		while (p < parser->length && (isalnum((unsigned char)s[p]) || s[p] == '_' || s[p] == '.')) p++;
+	}
+	else if (c == '"' || c == '\'')
+	{
+		token.type = c == '"' ? Token_String : Token_Char;
+		p++;
+		while (p < parser->length && s[p] != c)
+		{
+			if (s[p] == '\\' && p + 1 < parser->length) p++;
+			if (s[p] == '\n') parser->lineNumber++;
+			p++;
+		}
+		if (p >= parser->length)
+			Fatal(token.lineNumber, "unterminated string");
+		p++;
+	}
+	else
+	{
+		token.type = Token_Punctuation;
+		size_t length = 0;
+		for (size_t i = 0; i < sizeof(punctuations) / sizeof(punctuations[0]); ++i)
+		{
+			size_t punctuationLength = strlen(punctuations[i]);
+			if (p + punctuationLength <= parser->length && memcmp(s + p, punctuations[i], punctuationLength) == 0)
+			{
+				length = punctuationLength;
+				break;
+			}
+		}
+		if (length == 0)
+			Fatal(token.lineNumber, "unexpected character '%c'", c);
+		p += length;
+	}
+
+	token.length = p - parser->position;
+	parser->position = p;
+	parser->current = token;
+}
+
+static bool IsPunctuation(const Parser* parser, const char* punctuation)
+{
+	return parser->current.type == Token_Punctuation &&
+		   parser->current.length == strlen(punctuation) &&
+		   memcmp(parser->current.start, punctuation, parser->current.length) == 0;
+}
+
+static bool IsIdentifier(const Parser* parser, const char* name)
+{
+	return parser->current.type == Token_Identifier &&
+		   parser->current.length == strlen(name) &&
+		   memcmp(parser->current.start, name, parser->current.length) == 0;
+}
+
+static void Expect(Parser* parser, const char* punctuation)
+{
+	if (!IsPunctuation(parser, punctuation))
+		Fatal(parser->current.lineNumber, "expected '%s' but got '%.*s'", punctuation, (int)parser->current.length, parser->current.start);
+	NextToken(parser);
+}
+
+// ---------- parser ----------
+
+static Expr* AllocExpr(ExprType type, int lineNumber)
+{
+	Expr* expr = AllocZeroed(sizeof(Expr));
+	expr->type = type;
+	expr->lineNumber = lineNumber;
+	return expr;
+}
+
+static Expr* ParseExpression(Parser* parser);
+static Expr* ParseSequence(Parser* parser, const char* terminator);
+
+static double ParseNumber(const Token* token)
+{
+	char* text = CopyString(token->start, token->length);
+	double value = 0;
+	if (text[0] == '$' && text[1] == '\'')
+	{
+		for (size_t i = 2; text[i] && text[i] != '\''; ++i)
+			value = value * 256 + (unsigned char)text[i];
+	}
+	else if (text[0] == '$' && (text[1] == 'x' || text[1] == 'X'))
+		value = (double)strtoull(text + 2, NULL, 16);
+	else if (strcmp(text, "$pi") == 0)
+		value = 3.14159265358979323846;
+	else if (strcmp(text, "$e") == 0)
+		value = 2.71828182845904523536;
+	else if (strcmp(text, "$phi") == 0)
+		value = 1.61803398874989484820;
+	else if (text[0] == '0' && (text[1] == 'x' || text[1] == 'X'))
+		value = (double)strtoull(text + 2, NULL, 16);
+	else if (text[0] == '0' && (text[1] == 'b' || text[1] == 'B'))
+		value = (double)strtoull(text + 2, NULL, 2);
+	else
+	{
+		char* end;
+		value = strtod(text, &end);
+		if (*end != '\0')
+			Fatal(token->lineNumber, "invalid number \"%s\"", text);
+	}
+	free(text);
+	return value;
+}
+
+static char* UnescapeString(const char* start, size_t length, size_t* outLength)
+{
+	char* new = AllocZeroed(length + 1);
+	size_t j = 0;
+	for (size_t i = 0; i < length; ++i)
+	{
+		char c = start[i];
+		if (c == '\\' && i + 1 < length)
+		{
+			++i;
+			switch (start[i])
+			{
+			case 'n': c = '\n'; break;
+			case 'r': c = '\r'; break;
+			case 't': c = '\t'; break;
+			case '0': c = '\0'; break;
+			default: c = start[i]; break;
+			}
+		}
+		new[j++] = c;
+	}
+	*outLength = j;
+	return new;
+}
+
+extern const Builtin builtins[];
+extern const size_t builtinCount;
+
+static const Builtin* FindBuiltin(const char* name)
+{
+	for (size_t i = 0; i < builtinCount; ++i)
+		if (NameEquals(builtins[i].name, name))
+			return &builtins[i];
+	return NULL;
+}
+
+static Expr* ParseCall(Parser* parser, char* name, int lineNumber, size_t position)
+{
+	Expr* expr = AllocExpr(Expr_Call, lineNumber);
+	expr->callName = name;
+	expr->sourcePosition = position;
+
+	Expect(parser, "(");
+	size_t capacity = 0;
+	while (!IsPunctuation(parser, ")"))
+	{
+		Expr* arg = ParseSequence(parser, NULL);
+		if (expr->argCount == capacity)
+		{
+			capacity = capacity ? capacity * 2 : 4;
+			expr->args = realloc(expr->args, capacity * sizeof(Expr*));
+			if (!expr->args)
+				Fatal(0, "out of memory");
+		}
+		expr->args[expr->argCount++] = arg;
+
+		if (!IsPunctuation(parser, ","))
+			break;
+		NextToken(parser);
+	}
+	Expect(parser, ")");
+
+	if (NameEquals(name, "while"))
+	{
+		if (expr->argCount != 1)
+			Fatal(lineNumber, "while expects one argument");
+		if (IsPunctuation(parser, "("))
+		{
+			NextToken(parser);
+			Expr* loop = AllocExpr(Expr_While, lineNumber);
+			loop->left = expr->args[0];
+			loop->right = ParseSequence(parser, ")");
+			Expect(parser, ")");
+			return loop;
+		}
+
+		Expr* loop = AllocExpr(Expr_DoWhile, lineNumber);
+		loop->left = expr->args[0];
+		return loop;
+	}
+	if (NameEquals(name, "loop"))
+	{
+		if (expr->argCount != 2)
+			Fatal(lineNumber, "loop expects two arguments");
+		Expr* loop = AllocExpr(Expr_Loop, lineNumber);
+		loop->left = expr->args[0];
+		loop->right = expr->args[1];
+		return loop;
+	}
+
+	return expr;
+}
+
+static Expr* ParsePrimary(Parser* parser)
+{
+	Token token = parser->current;
+	switch (token.type)
+	{
+	case Token_Number:
+	{
+		NextToken(parser);
+		Expr* expr = AllocExpr(Expr_Number, token.lineNumber);
+		expr->number = ParseNumber(&token);
+		return expr;
+	}
+	case Token_String:
+	{
+		NextToken(parser);
+		size_t length;
+		char* data = UnescapeString(token.start + 1, token.length - 2, &length);
+		Expr* expr = AllocExpr(Expr_Number, token.lineNumber);
+		expr->number = AddLiteralString(data, length);
+		free(data);
+		return expr;
+	}
+	case Token_Char:
+	{
+		NextToken(parser);
+		size_t length;
+		char* data = UnescapeString(token.start + 1, token.length - 2, &length);
+		Expr* expr = AllocExpr(Expr_Number, token.lineNumber);
+		for (size_t i = 0; i < length; ++i)
+			expr->number = expr->number * 256 + (unsigned char)data[i];
+		free(data);
+		return expr;
+	}
+	case Token_Identifier:
+	{
+		NextToken(parser);
+		char* name = CopyString(token.start, token.length);
+		if (IsPunctuation(parser, "("))
+			return ParseCall(parser, name, token.lineNumber, token.position);
+
+		if (NameEquals(name, "gmem"))
+		{
+			free(name);
+			return AllocExpr(Expr_GMem, token.lineNumber);
+		}
+
+		Expr* expr = AllocExpr(Expr_Variable, token.lineNumber);
+		if (parser->function)
+		{
+			for (size_t i = 0; i < parser->function->parameterCount; ++i)
+				if (NameEquals(parser->function->parameterNames[i], name))
+					expr->variable = parser->function->parameters[i];
+		}
+		if (!expr->variable)
+			expr->variable = GetVariable(name);
+		free(name);
+		return expr;
+	}
+	case Token_Punctuation:
+	{
+		if (IsPunctuation(parser, "("))
+		{
+			NextToken(parser);
+			Expr* expr = ParseSequence(parser, ")");
+			Expect(parser, ")");
+			return expr;
+		}
+		break;
+	}
+	default: break;
+	}
+
+	Fatal(token.lineNumber, "unexpected token '%.*s'", (int)token.length, token.start);
+	return NULL;
+}
+
+static Expr* ParsePostfix(Parser* parser)
+{
+	Expr* expr = ParsePrimary(parser);
+	while (IsPunctuation(parser, "["))
+	{
+		int lineNumber = parser->current.lineNumber;
+		NextToken(parser);
+		Expr* subscript = AllocExpr(expr->type == Expr_GMem ? Expr_GMem : Expr_Subscript, lineNumber);
+		if (expr->type == Expr_GMem)
+			free(expr);
+		else
+			subscript->left = expr;
+		if (IsPunctuation(parser, "]"))
+		{
+			subscript->right = AllocExpr(Expr_Number, lineNumber);
+		}
+		else
+			subscript->right = ParseSequence(parser, "]");
+		Expect(parser, "]");
+		expr = subscript;
+	}
+	return expr;
+}
+
+static Expr* ParseUnary(Parser* parser)
+{
+	Operator operator = Op_None;
+	if (IsPunctuation(parser, "!")) operator= Op_Not;
+	else if (IsPunctuation(parser, "-")) operator= Op_Negate;
+	else if (IsPunctuation(parser, "+")) operator= Op_Plus;
+
+	if (operator== Op_None)
+		return ParsePostfix(parser);
+
+	int lineNumber = parser->current.lineNumber;
+	NextToken(parser);
+	Expr* expr = AllocExpr(Expr_Unary, lineNumber);
+	expr->operator= operator;
+	expr->left = ParseUnary(parser);
+	return expr;
+}
+
+static Operator GetBinaryOperator(const Parser* parser)
+{
+	static const struct
+	{
+		const char* text;
+		Operator operator;
+	} operators[] = {
+		{"^", Op_Pow},
+		{"%", Op_Mod},
+		{"<<", Op_LeftShift},
+		{">>", Op_RightShift},
+		{"*", Op_Mul},
+		{"/", Op_Div},
+		{"+", Op_Add},
+		{"-", Op_Sub},
+		{"|", Op_BitOr},
+		{"&", Op_BitAnd},
+		{"~", Op_XOR},
+		{"==", Op_Equal},
+		{"!=", Op_NotEqual},
+		{"<", Op_Less},
+		{">", Op_Greater},
+		{"<=", Op_LessEqual},
+		{">=", Op_GreaterEqual},
+		{"||", Op_BoolOr},
+		{"&&", Op_BoolAnd},
+	};
+
+	for (size_t i = 0; i < sizeof(operators) / sizeof(operators[0]); ++i)
+		if (IsPunctuation(parser, operators[i].text))
+			return operators[i].operator;
+	return Op_None;
+}
+
+static Expr* ParseBinary(Parser* parser, int minPrecedence)
+{
+	Expr* left = ParseUnary(parser);
+	while (true)
+	{
+		Operator operator = GetBinaryOperator(parser);
+		if (operator== Op_None || binaryPrecedence[operator] < minPrecedence)
+			return left;
+
+		int lineNumber = parser->current.lineNumber;
+		NextToken(parser);
+		Expr* expr = AllocExpr(Expr_Binary, lineNumber);
+		expr->operator= operator;
+		expr->left = left;
+		expr->right = ParseBinary(parser, binaryPrecedence[operator] + 1);
+		left = expr;
+	}
+}
+
+static Operator GetAssignmentOperator(const Parser* parser)
+{
+	static const struct
+	{
+		const char* text;
+		Operator operator;
+	} operators[] = {
+		{"=", Op_Assign},
+		{"+=", Op_AddAssign},
+		{"-=", Op_SubAssign},
+		{"*=", Op_MulAssign},
+		{"/=", Op_DivAssign},
+		{"%=", Op_ModAssign},
+		{"^=", Op_PowAssign},
+		{"|=", Op_OrAssign},
+		{"&=", Op_AndAssign},
+		{"~=", Op_XorAssign},
+	};
+
+	for (size_t i = 0; i < sizeof(operators) / sizeof(operators[0]); ++i)
+		if (IsPunctuation(parser, operators[i].text))
+			return operators[i].operator;
+	return Op_None;
+}
+
+static Expr* ParseExpression(Parser* parser)
+{
+	Expr* left = ParseBinary(parser, 0);
+
+	Operator operator = GetAssignmentOperator(parser);
+	if (operator!= Op_None)
+	{
+		if (left->type != Expr_Variable && left->type != Expr_Subscript && left->type != Expr_GMem &&
+			!(left->type == Expr_Call && (NameEquals(left->callName, "spl") || NameEquals(left->callName, "slider"))))
+			Fatal(parser->current.lineNumber, "cannot assign to this expression");
+
+		int lineNumber = parser->current.lineNumber;
+		NextToken(parser);
+		Expr* expr = AllocExpr(Expr_Assignment, lineNumber);
+		expr->operator= operator;
+		expr->left = left;
+		expr->right = ParseExpression(parser);
+		return expr;
+	}
+
+	if (IsPunctuation(parser, "?"))
+	{
+		int lineNumber = parser->current.lineNumber;
+		NextToken(parser);
+		Expr* expr = AllocExpr(Expr_Conditional, lineNumber);
+		expr->left = left;
+		expr->right = ParseExpression(parser);
+		if (IsPunctuation(parser, ":"))
+		{
+			NextToken(parser);
+			expr->third = ParseExpression(parser);
+		}
+		return expr;
+	}
+
+	return left;
+}
+
+static Expr* ParseFunction(Parser* parser)
+{
+	int lineNumber = parser->current.lineNumber;
+	size_t position = parser->current.position;
+	NextToken(parser);
+
+	if (parser->current.type != Token_Identifier)
+		Fatal(lineNumber, "expected function name");
+
+	Function* function = AllocZeroed(sizeof(Function));
+	function->name = CopyString(parser->current.start, parser->current.length);
+	function->sourcePosition = position;
+	NextToken(parser);
+
+	for (size_t i = 0; i < functionCount; ++i)
+		if (NameEquals(functions[i]->name, function->name))
+			Fatal(lineNumber, "function \"%s\" is defined more than once", function->name);
+
+	Expect(parser, "(");
+	while (!IsPunctuation(parser, ")"))
+	{
+		if (parser->current.type != Token_Identifier)
+			Fatal(parser->current.lineNumber, "expected parameter name");
+
+		function->parameterNames = realloc(function->parameterNames, (function->parameterCount + 1) * sizeof(char*));
+		function->parameters = realloc(function->parameters, (function->parameterCount + 1) * sizeof(double*));
+		if (!function->parameterNames || !function->parameters)
+			Fatal(0, "out of memory");
+		function->parameterNames[function->parameterCount] = CopyString(parser->current.start, parser->current.length);
+		function->parameters[function->parameterCount] = AllocZeroed(sizeof(double));
+		function->parameterCount++;
+		NextToken(parser);
+
+		if (!IsPunctuation(parser, ","))
+			break;
+		NextToken(parser);
+	}
+	Expect(parser, ")");
+
+	if (parser->function)
+		Fatal(lineNumber, "nested function definitions are not supported");
+
+	parser->function = function;
+	Expect(parser, "(");
+	function->body = ParseSequence(parser, ")");
+	Expect(parser, ")");
+	parser->function = NULL;
+
+	functions = realloc(functions, (functionCount + 1) * sizeof(Function*));
+	if (!functions)
+		Fatal(0, "out of memory");
+	functions[functionCount++] = function;
+
+	return NULL;
+}
+
+static Expr* ParseSequence(Parser* parser, const char* terminator)
+{
+	Expr* sequence = AllocExpr(Expr_Sequence, parser->current.lineNumber);
+	size_t capacity = 0;
+	while (parser->current.type != Token_End)
+	{
+		if (terminator && IsPunctuation(parser, terminator))
+			break;
+		if (!terminator && (IsPunctuation(parser, ",") || IsPunctuation(parser, ")")))
+			break;
+
+		if (IsPunctuation(parser, ";"))
+		{
+			NextToken(parser);
+			continue;
+		}
+
+		Expr* expr;
+		if (IsIdentifier(parser, "function"))
+			expr = ParseFunction(parser);
+		else
+			expr = ParseExpression(parser);
+
+		if (expr)
+		{
+			if (sequence->argCount == capacity)
+			{
+				capacity = capacity ? capacity * 2 : 8;
+				sequence->args = realloc(sequence->args, capacity * sizeof(Expr*));
+				if (!sequence->args)
+					Fatal(0, "out of memory");
+			}
+			sequence->args[sequence->argCount++] = expr;
+		}
+
+		if (IsPunctuation(parser, ";"))
+			NextToken(parser);
+		else if (parser->current.type != Token_End &&
+				 !(terminator && IsPunctuation(parser, terminator)) &&
+				 !(!terminator && (IsPunctuation(parser, ",") || IsPunctuation(parser, ")"))))
+			Fatal(parser->current.lineNumber, "expected ';' but got '%.*s'", (int)parser->current.length, parser->current.start);
+	}
+
+	if (sequence->argCount == 1)
+	{
+		Expr* expr = sequence->args[0];
+		free(sequence->args);
+		free(sequence);
+		return expr;
+	}
+	return sequence;
+}
+
+// ---------- evaluation ----------
+
+static double Evaluate(Expr* expr);
+
+static bool IsTrue(double value)
+{
+	return fabs(value) >= CLOSE_FACTOR;
+}
+
+static int64_t ToInteger(double value)
+{
+	if (isnan(value))
+		return 0;
+	if (value >= 9.2e18)
+		return INT64_MAX;
+	if (value <= -9.2e18)
+		return INT64_MIN;
+	return (int64_t)value;
+}
+
+static int32_t ToInteger32(double value)
+{
+	return (int32_t)(uint32_t)(uint64_t)ToInteger(value);
+}
+
+static double ApplyBinary(Operator operator, double a, double b)
+{
+	switch (operator)
+	{
+	case Op_Add: return a + b;
+	case Op_Sub: return a - b;
+	case Op_Mul: return a * b;
+	case Op_Div: return a / b;
+	case Op_Pow: return pow(a, b);
+	case Op_Mod:
+	{
+		int64_t divisor = ToInteger(fabs(b));
+		if (divisor == 0)
+			return 0;
+		return (double)(ToInteger(fabs(a)) % divisor);
+	}
+	case Op_LeftShift: return (double)(int32_t)((uint32_t)ToInteger32(a) << (ToInteger32(b) & 31));
+	case Op_RightShift: return (double)(ToInteger32(a) >> (ToInteger32(b) & 31));
+	case Op_BitOr: return (double)(ToInteger(a) | ToInteger(b));
+	case Op_BitAnd: return (double)(ToInteger(a) & ToInteger(b));
+	case Op_XOR: return (double)(ToInteger(a) ^ ToInteger(b));
+	case Op_Equal: return fabs(a - b) < CLOSE_FACTOR;
+	case Op_NotEqual: return fabs(a - b) >= CLOSE_FACTOR;
+	case Op_Less: return a < b;
+	case Op_Greater: return a > b;
+	case Op_LessEqual: return a <= b;
+	case Op_GreaterEqual: return a >= b;
+	default: ASSERT(0); return 0;
+	}
+}
+
+static Operator CompoundToBinary(Operator operator)
+{
+	switch (operator)
+	{
+	case Op_AddAssign: return Op_Add;
+	case Op_SubAssign: return Op_Sub;
+	case Op_MulAssign: return Op_Mul;
+	case Op_DivAssign: return Op_Div;
+	case Op_ModAssign: return Op_Mod;
+	case Op_PowAssign: return Op_Pow;
+	case Op_OrAssign: return Op_BitOr;
+	case Op_AndAssign: return Op_BitAnd;
+	case Op_XorAssign: return Op_XOR;
+	default: ASSERT(0); return Op_None;
+	}
+}
+
+static double* GetLValue(Expr* expr)
+{
+	switch (expr->type)
+	{
+	case Expr_Variable: return expr->variable;
+	case Expr_Subscript:
+	{
+		double base = Evaluate(expr->left);
+		double index = Evaluate(expr->right);
+		counters->memoryWrites++;
+		static double dummy;
+		double* ptr = GetMemory(base + index, true);
+		return ptr ? ptr : &dummy;
+	}
+	case Expr_GMem:
+	{
+		int64_t index = ToIndex(Evaluate(expr->right));
+		static double dummy;
+		counters->memoryWrites++;
+		return index >= 0 && index < GMEM_SIZE ? &gmem[index] : &dummy;
+	}
+	case Expr_Call:
+	{
+		ASSERT(expr->argCount >= 1);
+		int64_t index = ToIndex(Evaluate(expr->args[0]));
+		static double dummy;
+		if (NameEquals(expr->callName, "spl"))
+			return index >= 0 && index < MAX_CHANNELS ? splVariables[index] : &dummy;
+		if (NameEquals(expr->callName, "slider"))
+			return index >= 1 && index <= MAX_SLIDERS ? sliderVariables[index] : &dummy;
+		break;
+	}
+	default: break;
+	}
+	Fatal(expr->lineNumber, "expression is not assignable");
+	return NULL;
+}
+
+// built-in functions that write through their arguments accept any expression,
+// values written to something that is not assignable are discarded
+static double* GetOutputArgument(Expr* expr)
+{
+	static double discarded;
+	if (expr->type == Expr_Variable || expr->type == Expr_Subscript || expr->type == Expr_GMem)
+		return GetLValue(expr);
+	Evaluate(expr);
+	return &discarded;
+}
+
+static double CallFunction(Expr* expr)
+{
+	Function* function = expr->function;
+	if (expr->argCount != function->parameterCount)
+		Fatal(expr->lineNumber, "function \"%s\" expects %zu arguments but got %zu", function->name, function->parameterCount, expr->argCount);
+
+	double argsBuffer[16];
+	double* args = expr->argCount <= 16 ? argsBuffer : AllocZeroed(expr->argCount * sizeof(double));
+	for (size_t i = 0; i < expr->argCount; ++i)
+		args[i] = Evaluate(expr->args[i]);
+	for (size_t i = 0; i < expr->argCount; ++i)
+		*function->parameters[i] = args[i];
+	if (args != argsBuffer)
+		free(args);
+
+	counters->calls++;
+	function->callCount++;
+
+	Function* previousFunction = currentFunction;
+	currentFunction = function;
+	uint64_t opsBefore = counters->ops;
+	double value = Evaluate(function->body);
+	function->opCount += counters->ops - opsBefore;
+	currentFunction = previousFunction;
+	return value;
+}
+
+static double Evaluate(Expr* expr)
+{
+	counters->ops++;
+	switch (expr->type)
+	{
+	case Expr_Number: return expr->number;
+	case Expr_Variable: return *expr->variable;
+	case Expr_Subscript: return ReadMemory(Evaluate(expr->left) + Evaluate(expr->right));
+	case Expr_GMem:
+	{
+		counters->memoryReads++;
+		int64_t index = ToIndex(Evaluate(expr->right));
+		return index >= 0 && index < GMEM_SIZE ? gmem[index] : 0;
+	}
+	case Expr_Unary:
+	{
+		double value = Evaluate(expr->left);
+		switch (expr->operator)
+		{
+		case Op_Not: return !IsTrue(value);
+		case Op_Negate: return -value;
+		case Op_Plus: return value;
+		default: ASSERT(0); return 0;
+		}
+	}
+	case Expr_Binary:
+	{
+		if (expr->operator== Op_BoolAnd)
+			return IsTrue(Evaluate(expr->left)) && IsTrue(Evaluate(expr->right));
+		if (expr->operator== Op_BoolOr)
+			return IsTrue(Evaluate(expr->left)) || IsTrue(Evaluate(expr->right));
+
+		double a = Evaluate(expr->left);
+		double b = Evaluate(expr->right);
+		return ApplyBinary(expr->operator, a, b);
+	}
+	case Expr_Assignment:
+	{
+		if (expr->operator== Op_Assign)
+		{
+			double value = Evaluate(expr->right);
+			double* destination = GetLValue(expr->left);
+			*destination = value;
+			return value;
+		}
+
+		double* destination = GetLValue(expr->left);
+		double value = Evaluate(expr->right);
+		*destination = ApplyBinary(CompoundToBinary(expr->operator), *destination, value);
+		return *destination;
+	}
+	case Expr_Conditional:
+	{
+		if (IsTrue(Evaluate(expr->left)))
+			return Evaluate(expr->right);
+		if (expr->third)
+			return Evaluate(expr->third);
+		return 0;
+	}
+	case Expr_Sequence:
+	{
+		double value = 0;
+		for (size_t i = 0; i < expr->argCount; ++i)
+			value = Evaluate(expr->args[i]);
+		return value;
+	}
+	case Expr_Call:
+	{
+		if (expr->function)
+			return CallFunction(expr);
+
+		ASSERT(expr->builtin);
+		counters->calls++;
+		return expr->builtin->function(expr->args, expr->argCount);
+	}
+	case Expr_While:
+	{
+		for (int i = 0;; ++i)
+		{
+			if (i >= MAX_LOOP_ITERATIONS)
+			{
+				RuntimeError("loop at line %d exceeded %d iterations", expr->lineNumber, MAX_LOOP_ITERATIONS);
+				break;
+			}
+			if (!IsTrue(Evaluate(expr->left)))
+				break;
+			counters->loopIterations++;
+			Evaluate(expr->right);
+		}
+		return 0;
+	}
+	case Expr_DoWhile:
+	{
+		for (int i = 0;; ++i)
+		{
+			if (i >= MAX_LOOP_ITERATIONS)
+			{
+				RuntimeError("loop at line %d exceeded %d iterations", expr->lineNumber, MAX_LOOP_ITERATIONS);
+				break;
+			}
+			counters->loopIterations++;
+			if (!IsTrue(Evaluate(expr->left)))
+				break;
+		}
+		return 0;
+	}
+	case Expr_Loop:
+	{
+		int64_t count = ToInteger(Evaluate(expr->left));
+		if (count > MAX_LOOP_ITERATIONS)
+			count = MAX_LOOP_ITERATIONS;
+		for (int64_t i = 0; i < count; ++i)
+		{
+			counters->loopIterations++;
+			Evaluate(expr->right);
+		}
+		return 0;
+	}
+	default: ASSERT(0); return 0;
+	}
+}
+
+// ---------- built-in functions ----------
+
+static uint64_t outputHash = 0xCBF29CE484222325ULL;
+
+static uint64_t HashDouble(uint64_t hash, double value)
+{
+	if (value == 0)
+		value = 0; // treat -0 as 0
+	uint64_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	hash ^= bits;
+	hash *= 0x100000001B3ULL;
+	return hash;
+}
+
+
+#define ARG(i) Evaluate(args[i])
+
+// host functions do nothing, but their arguments are part of the output hash
+static double Builtin_Stub(Expr** args, size_t argCount)
+{
+	for (size_t i = 0; i < argCount; ++i)
+		outputHash = HashDouble(outputHash, Evaluate(args[i]));
+	return 0;
+}
+
+static double Builtin_Sin(Expr** args, size_t argCount) { (void)argCount; return sin(ARG(0)); }
+static double Builtin_Cos(Expr** args, size_t argCount) { (void)argCount; return cos(ARG(0)); }
+static double Builtin_Tan(Expr** args, size_t argCount) { (void)argCount; return tan(ARG(0)); }
+static double Builtin_Asin(Expr** args, size_t argCount) { (void)argCount; return asin(ARG(0)); }
+static double Builtin_Acos(Expr** args, size_t argCount) { (void)argCount; return acos(ARG(0)); }
+static double Builtin_Atan(Expr** args, size_t argCount) { (void)argCount; return atan(ARG(0)); }
+static double Builtin_Sqrt(Expr** args, size_t argCount) { (void)argCount; return sqrt(fabs(ARG(0))); }
+static double Builtin_Exp(Expr** args, size_t argCount) { (void)argCount; return exp(ARG(0)); }
+static double Builtin_Log(Expr** args, size_t argCount) { (void)argCount; return log(ARG(0)); }
+static double Builtin_Log10(Expr** args, size_t argCount) { (void)argCount; return log10(ARG(0)); }
+static double Builtin_Abs(Expr** args, size_t argCount) { (void)argCount; return fabs(ARG(0)); }
+static double Builtin_Floor(Expr** args, size_t argCount) { (void)argCount; return floor(ARG(0)); }
+static double Builtin_Ceil(Expr** args, size_t argCount) { (void)argCount; return ceil(ARG(0)); }
+
+static double Builtin_Atan2(Expr** args, size_t argCount)
+{
+	(void)argCount;
+	double a = ARG(0);
+	return atan2(a, ARG(1));
+}
+
+static double Builtin_Sqr(Expr** args, size_t argCount)
+{
+	(void)argCount;
+	double value = ARG(0);
+	return value * value;
+}
+
+static double Builtin_Pow(Expr** args, size_t argCount)
+{
+	(void)argCount;
+	double a = ARG(0);
+	return pow(a, ARG(1));
+}
+
+static double Builtin_Min(Expr** args, size_t argCount)
+{
+	(void)argCount;
+	double a = ARG(0);
+	double b = ARG(1);
+	return a < b ? a : b;
+}
+
+static double Builtin_Max(Expr** args, size_t argCount)
+{
+	(void)argCount;
+	double a = ARG(0);
+	double b = ARG(1);
+	return a > b ? a : b;
+}
+
+static double Builtin_Sign(Expr** args, size_t argCount)
+{
+	(void)argCount;
+	double value = ARG(0);
+	return value > 0 ? 1 : value < 0 ? -1 : 0;
+}
+
+static double Builtin_Invsqrt(Expr** args, size_t argCount)
+{
+	(void)argCount;
+	return 1.0 / sqrt(fabs(ARG(0)));
+}
+
+static double Builtin_Rand(Expr** args, size_t argCount)
+{
+	double range = argCount > 0 ? ARG(0) : 1;
+	if (range < 1) range = 1;
+	randomState ^= randomState << 13;
+	randomState ^= randomState >> 7;
+	randomState ^= randomState << 17;
+	return (double)(randomState >> 11) / (double)(1ULL << 53) * range;
+}
+
+static double Builtin_Memcpy(Expr** args, size_t argCount)
+{
+	(void)argCount;
+	double destination = ARG(0);
+	double source = ARG(1);
+	int64_t length = ToIndex(ARG(2));
+	if (length <= 0)
+		return destination;
+
+	double* copy = AllocZeroed((size_t)length * sizeof(double));
+	for (int64_t i = 0; i < length; ++i)
+		copy[i] = ReadMemory(source + (double)i);
+	for (int64_t i = 0; i < length; ++i)
+		WriteMemory(destination + (double)i, copy[i]);
+	free(copy);
+	return destination;
+}
+
+static double Builtin_Memset(Expr** args, size_t argCount)
+{
+	(void)argCount;
+	double destination = ARG(0);
+	double value = ARG(1);
+	int64_t length = ToIndex(ARG(2));
+	for (int64_t i = 0; i < length; ++i)
+		WriteMemory(destination + (double)i, value);
+	return destination;
+}
+
+static double Builtin_MemMultiplySum(Expr** args, size_t argCount)
+{
+	(void)argCount;
+	double a = ARG(0);
+	double b = ARG(1);
+	int64_t length = ToIndex(ARG(2));
+	double sum = 0;
+	for (int64_t i = 0; i < length; ++i)
+	{
+		double x = ReadMemory(a + (double)i);
+		if (b == -1) sum += x * x;
+		else if (b == -2) sum += x;
+		else sum += x * ReadMemory(b + (double)i);
+	}
+	return sum;
+}
+
+static double Builtin_MemSetValues(Expr** args, size_t argCount)
+{
+	double buffer = ARG(0);
+	for (size_t i = 1; i < argCount; ++i)
+		WriteMemory(buffer + (double)(i - 1), ARG(i));
+	return (double)(argCount - 1);
+}
+
+static double Builtin_MemGetValues(Expr** args, size_t argCount)
+{
+	double buffer = ARG(0);
+	for (size_t i = 1; i < argCount; ++i)
+		*GetOutputArgument(args[i]) = ReadMemory(buffer + (double)(i - 1));
+	return (double)(argCount - 1);
+}
+
+static double Builtin_MemInsertShuffle(Expr** args, size_t argCount)
+{
+	(void)argCount;
+	double buffer = ARG(0);
+	int64_t length = ToIndex(ARG(1));
+	double value = ARG(2);
+	if (length <= 0)
+		return 0;
+	double last = ReadMemory(buffer + (double)(length - 1));
+	for (int64_t i = length - 1; i > 0; --i)
+		WriteMemory(buffer + (double)i, ReadMemory(buffer + (double)(i - 1)));
+	WriteMemory(buffer, value);
+	return last;
+}
+
+static double Builtin_Freembuf(Expr** args, size_t argCount)
+{
+	(void)argCount;
+	return ARG(0);
+}
+
+static double Builtin_Memtop(Expr** args, size_t argCount)
+{
+	(void)args;
+	(void)argCount;
+	return (double)MEMORY_BLOCK_SIZE * MEMORY_BLOCKS;
+}
+
+static double Builtin_StackPush(Expr** args, size_t argCount)
+{
+	(void)argCount;
+	double value = ARG(0);
+	if (stackPointer >= STACK_SIZE)
+	{
+		RuntimeError("stack overflow");
+		return value;
+	}
+	stack[stackPointer++] = value;
+	return value;
+}
+
+static double Builtin_StackPop(Expr** args, size_t argCount)
+{
+	double value = 0;
+	if (stackPointer > 0)
+		value = stack[--stackPointer];
+	else
+		RuntimeError("stack underflow");
+
+	if (argCount > 0)
+		*GetOutputArgument(args[0]) = value;
+	return value;
+}
+
+static double Builtin_StackPeek(Expr** args, size_t argCount)
+{
+	(void)argCount;
+	int64_t index = ToIndex(ARG(0));
+	if (index < 0 || (size_t)index >= stackPointer)
+		return 0;
+	return stack[stackPointer - 1 - (size_t)index];
+}
+
+static double Builtin_StackExch(Expr** args, size_t argCount)
+{
+	(void)argCount;
+	double* value = GetOutputArgument(args[0]);
+	if (stackPointer == 0)
+		return *value;
+	double top = stack[stackPointer - 1];
+	stack[stackPointer - 1] = *value;
+	*value = top;
+	return top;
+}
+
+static double Builtin_Spl(Expr** args, size_t argCount)
+{
+	(void)argCount;
+	int64_t index = ToIndex(ARG(0));
+	return index >= 0 && index < MAX_CHANNELS ? *splVariables[index] : 0;
+}
+
+static double Builtin_Slider(Expr** args, size_t argCount)
+{
+	(void)argCount;
+	int64_t index = ToIndex(ARG(0));
+	return index >= 1 && index <= MAX_SLIDERS ? *sliderVariables[index] : 0;
+}
+
+static double Builtin_Time(Expr** args, size_t argCount)
+{
+	double value = 0;
+	if (argCount > 0)
+		*GetOutputArgument(args[0]) = value;
+	return value;
+}
+
+static double Builtin_TimePrecise(Expr** args, size_t argCount)
+{
+	static double fakeTime;
+	fakeTime += 0.000001;
+	if (argCount > 0)
+		*GetOutputArgument(args[0]) = fakeTime;
+	return fakeTime;
+}
+
+static String* ArgString(Expr** args, size_t index, int lineNumber)
+{
+	String* string = GetString(Evaluate(args[index]));
+	if (!string)
+	{
+		RuntimeError("invalid string argument (line %d)", lineNumber);
+		static String empty;
+		empty = (String){.data = "", .length = 0};
+		return &empty;
+	}
+	return string;
+}
+
+static double Builtin_Strlen(Expr** args, size_t argCount)
+{
+	(void)argCount;
+	return (double)ArgString(args, 0, args[0]->lineNumber)->length;
+}
+
+static double Builtin_Strcpy(Expr** args, size_t argCount)
+{
+	(void)argCount;
+	double destinationValue = ARG(0);
+	String* destination = GetString(destinationValue);
+	String* source = ArgString(args, 1, args[1]->lineNumber);
+	if (destination && destination != source)
+		SetString(destination, source->data ? source->data : "", source->length);
+	return destinationValue;
+}
+
+static double Builtin_Strncpy(Expr** args, size_t argCount)
+{
+	(void)argCount;
+	double destinationValue = ARG(0);
+	String* destination = GetString(destinationValue);
+	String* source = ArgString(args, 1, args[1]->lineNumber);
+	int64_t maxLength = ToInteger(ARG(2));
+	size_t length = source->length;
+	if (maxLength >= 0 && (size_t)maxLength < length)
+		length = (size_t)maxLength;
+	if (destination)
+		SetString(destination, source->data ? source->data : "", length);
+	return destinationValue;
+}
+
+static double ConcatStrings(double destinationValue, String* source, size_t length)
+{
+	String* destination = GetString(destinationValue);
+	if (!destination)
+		return destinationValue;
+
+	char* data = AllocZeroed(destination->length + length + 1);
+	if (destination->data) memcpy(data, destination->data, destination->length);
+	if (source->data) memcpy(data + destination->length, source->data, length);
+	SetString(destination, data, destination->length + length);
+	free(data);
+	return destinationValue;
+}
+
+static double Builtin_Strcat(Expr** args, size_t argCount)
+{
+	(void)argCount;
+	double destination = ARG(0);
+	String* source = ArgString(args, 1, args[1]->lineNumber);
+	return ConcatStrings(destination, source, source->length);
+}
+
+static double Builtin_Strncat(Expr** args, size_t argCount)
+{
+	(void)argCount;
+	double destination = ARG(0);
+	String* source = ArgString(args, 1, args[1]->lineNumber);
+	int64_t maxLength = ToInteger(ARG(2));
+	size_t length = source->length;
+	if (maxLength >= 0 && (size_t)maxLength < length)
+		length = (size_t)maxLength;
+	return ConcatStrings(destination, source, length);
+}
+
+static int CompareStrings(const String* a, const String* b, int64_t maxLength, bool ignoreCase)
+{
+	size_t length = a->length > b->length ? a->length : b->length;
+	if (maxLength >= 0 && (size_t)maxLength < length)
+		length = (size_t)maxLength;
+	for (size_t i = 0; i < length; ++i)
+	{
+		int ca = i < a->length ? (unsigned char)a->data[i] : 0;
+		int cb = i < b->length ? (unsigned char)b->data[i] : 0;
+		if (ignoreCase)
+		{
+			ca = tolower(ca);
+			cb = tolower(cb);
+		}
+		if (ca != cb)
+			return ca < cb ? -1 : 1;
+	}
+	return 0;
+}
+
+static double Builtin_Strcmp(Expr** args, size_t argCount)
+{
+	(void)argCount;
+	String* a = ArgString(args, 0, args[0]->lineNumber);
+	return CompareStrings(a, ArgString(args, 1, args[1]->lineNumber), -1, false);
+}
+
+static double Builtin_Stricmp(Expr** args, size_t argCount)
+{
+	(void)argCount;
+	String* a = ArgString(args, 0, args[0]->lineNumber);
+	return CompareStrings(a, ArgString(args, 1, args[1]->lineNumber), -1, true);
+}
+
+static double Builtin_Strncmp(Expr** args, size_t argCount)
+{
+	(void)argCount;
+	String* a = ArgString(args, 0, args[0]->lineNumber);
+	String* b = ArgString(args, 1, args[1]->lineNumber);
+	return CompareStrings(a, b, ToInteger(ARG(2)), false);
+}
+
+static double Builtin_Strnicmp(Expr** args, size_t argCount)
+{
+	(void)argCount;
+	String* a = ArgString(args, 0, args[0]->lineNumber);
+	String* b = ArgString(args, 1, args[1]->lineNumber);
+	return CompareStrings(a, b, ToInteger(ARG(2)), true);
+}
+
+static double Builtin_StrcpyFrom(Expr** args, size_t argCount)
+{
+	(void)argCount;
+	double destinationValue = ARG(0);
+	String* source = ArgString(args, 1, args[1]->lineNumber);
+	int64_t offset = ToInteger(ARG(2));
+	if (offset < 0) offset = 0;
+	if ((size_t)offset > source->length) offset = (int64_t)source->length;
+	String* destination = GetString(destinationValue);
+	if (destination)
+	{
+		char* copy = CopyString(source->data ? source->data + offset : "", source->length - (size_t)offset);
+		SetString(destination, copy, source->length - (size_t)offset);
+		free(copy);
+	}
+	return destinationValue;
+}
+
+static double Builtin_StrcpySubstr(Expr** args, size_t argCount)
+{
+	(void)argCount;
+	double destinationValue = ARG(0);
+	String* source = ArgString(args, 1, args[1]->lineNumber);
+	int64_t offset = ToInteger(ARG(2));
+	int64_t maxLength = ToInteger(ARG(3));
+	if (offset < 0) offset += (int64_t)source->length;
+	if (offset < 0) offset = 0;
+	if ((size_t)offset > source->length) offset = (int64_t)source->length;
+	size_t length = source->length - (size_t)offset;
+	if (maxLength < 0) maxLength += (int64_t)length;
+	if (maxLength < 0) maxLength = 0;
+	if ((size_t)maxLength < length) length = (size_t)maxLength;
+	String* destination = GetString(destinationValue);
+	if (destination)
+	{
+		char* copy = CopyString(source->data ? source->data + offset : "", length);
+		SetString(destination, copy, length);
+		free(copy);
+	}
+	return destinationValue;
+}
+
+static double Builtin_StrGetchar(Expr** args, size_t argCount)
+{
+	String* string = ArgString(args, 0, args[0]->lineNumber);
+	int64_t offset = ToInteger(ARG(1));
+	if (argCount > 2) ARG(2);
+	if (offset < 0) offset += (int64_t)string->length;
+	if (offset < 0 || (size_t)offset >= string->length)
+		return 0;
+	return (unsigned char)string->data[offset];
+}
+
+static double Builtin_StrSetchar(Expr** args, size_t argCount)
+{
+	double stringValue = ARG(0);
+	String* string = GetString(stringValue);
+	int64_t offset = ToInteger(ARG(1));
+	double value = ARG(2);
+	if (argCount > 3) ARG(3);
+	if (!string)
+		return stringValue;
+	if (offset < 0) offset += (int64_t)string->length;
+	if (offset < 0 || (size_t)offset > string->length)
+		return stringValue;
+	if ((size_t)offset == string->length)
+	{
+		char c = (char)ToInteger(value);
+		String single = {.data = &c, .length = 1};
+		return ConcatStrings(stringValue, &single, 1);
+	}
+	string->data[offset] = (char)ToInteger(value);
+	return stringValue;
+}
+
+static double Builtin_StrSetlen(Expr** args, size_t argCount)
+{
+	(void)argCount;
+	double stringValue = ARG(0);
+	String* string = GetString(stringValue);
+	int64_t length = ToInteger(ARG(1));
+	if (!string || length < 0)
+		return stringValue;
+	char* data = AllocZeroed((size_t)length + 1);
+	for (size_t i = 0; i < (size_t)length; ++i)
+		data[i] = i < string->length ? string->data[i] : ' ';
+	SetString(string, data, (size_t)length);
+	free(data);
+	return stringValue;
+}
+
+static double Builtin_StrInsert(Expr** args, size_t argCount)
+{
+	(void)argCount;
+	double stringValue = ARG(0);
+	String* string = GetString(stringValue);
+	String* source = ArgString(args, 1, args[1]->lineNumber);
+	int64_t position = ToInteger(ARG(2));
+	if (!string)
+		return stringValue;
+	if (position < 0) position = 0;
+	if ((size_t)position > string->length) position = (int64_t)string->length;
+	size_t length = string->length + source->length;
+	char* data = AllocZeroed(length + 1);
+	if (string->data) memcpy(data, string->data, (size_t)position);
+	if (source->data) memcpy(data + position, source->data, source->length);
+	if (string->data) memcpy(data + position + (int64_t)source->length, string->data + position, string->length - (size_t)position);
+	SetString(string, data, length);
+	free(data);
+	return stringValue;
+}
+
+static double Builtin_StrDelsub(Expr** args, size_t argCount)
+{
+	(void)argCount;
+	double stringValue = ARG(0);
+	String* string = GetString(stringValue);
+	int64_t position = ToInteger(ARG(1));
+	int64_t length = ToInteger(ARG(2));
+	if (!string || position < 0 || (size_t)position >= string->length || length <= 0)
+		return stringValue;
+	if ((size_t)(position + length) > string->length)
+		length = (int64_t)string->length - position;
+	memmove(string->data + position, string->data + position + length, string->length - (size_t)(position + length) + 1);
+	string->length -= (size_t)length;
+	return stringValue;
+}
+
+static double Builtin_Sprintf(Expr** args, size_t argCount)
+{
+	double destinationValue = ARG(0);
+	String* format = ArgString(args, 1, args[1]->lineNumber);
+
+	size_t capacity = 256;
+	size_t length = 0;
+	char* output = AllocZeroed(capacity);
+	size_t nextArg = 2;
+
+	for (size_t i = 0; i < format->length; ++i)
+	{
+		char buffer[512];
+		int written = 0;
+		char c = format->data[i];
+		if (c != '%')
+		{
+			buffer[0] = c;
+			written = 1;
+		}
+		else if (i + 1 < format->length && format->data[i + 1] == '%')
+		{
+			buffer[0] = '%';
+			written = 1;
+			++i;
+		}
+		else
+		{
+			size_t start = i++;
+			while (i < format->length && strchr("-+ #0123456789.", format->data[i]))
+				++i;
+			if (i >= format->length)
+				break;
+			char conversion = format->data[i];
+			char spec[64];
+			size_t specLength = i - start;
+			if (specLength > sizeof(spec) - 4)
+				specLength = sizeof(spec) - 4;
+			memcpy(spec, format->data + start, specLength);
+
+			double value = nextArg < argCount ? ARG(nextArg) : 0;
+			nextArg++;
+			switch (conversion)
+			{
+			case 'd':
+			case 'i':
+			case 'x':
+			case 'X':
+			case 'o':
+			case 'u':
+			case 'c':
+				spec[specLength] = 'l';
+				spec[specLength + 1] = 'l';
+				spec[specLength + 2] = conversion;
+				spec[specLength + 3] = '\0';
+				if (conversion == 'c')
+				{
+					spec[specLength] = 'c';
+					spec[specLength + 1] = '\0';
+					written = snprintf(buffer, sizeof(buffer), spec, (int)ToInteger(value));
+				}
+				else
+					written = snprintf(buffer, sizeof(buffer), spec, (long long)ToInteger(value));
+				break;
+			case 's':
+			{
+				String* string = GetString(value);
+				char* copy = string ? CopyString(string->data ? string->data : "", string->length) : CopyString("", 0);
+				spec[specLength] = 's';
+				spec[specLength + 1] = '\0';
+				written = snprintf(buffer, sizeof(buffer), spec, copy);
+				free(copy);
+				break;
+			}
+			default:
+				spec[specLength] = conversion;
+				spec[specLength + 1] = '\0';
+				written = snprintf(buffer, sizeof(buffer), spec, value);
+				break;
+			}
+		}
+
+		if (written < 0)
+			written = 0;
+		if ((size_t)written >= sizeof(buffer))
+			written = sizeof(buffer) - 1;
+		while (length + (size_t)written + 1 > capacity)
+		{
+			capacity *= 2;
+			output = realloc(output, capacity);
+			if (!output)
+				Fatal(0, "out of memory");
+		}
+		memcpy(output + length, buffer, (size_t)written);
+		length += (size_t)written;
+	}
+
+	for (; nextArg < argCount; ++nextArg)
+		ARG(nextArg);
+
+	String* destination = GetString(destinationValue);
+	if (destination)
+		SetString(destination, output, length);
+	free(output);
+	return destinationValue;
+}
+
+static bool WildcardMatch(const char* pattern, size_t patternLength, const char* string, size_t stringLength, bool ignoreCase)
+{
+	if (patternLength == 0)
+		return stringLength == 0;
+
+	char p = pattern[0];
+	if (p == '*')
+	{
+		for (size_t i = 0; i <= stringLength; ++i)
+			if (WildcardMatch(pattern + 1, patternLength - 1, string + i, stringLength - i, ignoreCase))
+				return true;
+		return false;
+	}
+	if (p == '%')
+	{
+		// format specifiers match any run of characters, values are not extracted
+		size_t i = 1;
+		while (i < patternLength && strchr("0123456789.", pattern[i])) ++i;
+		if (i < patternLength) ++i;
+		for (size_t j = 0; j <= stringLength; ++j)
+			if (WildcardMatch(pattern + i, patternLength - i, string + j, stringLength - j, ignoreCase))
+				return true;
+		return false;
+	}
+	if (stringLength == 0)
+		return false;
+	if (p == '?' ||
+		(ignoreCase ? tolower((unsigned char)p) == tolower((unsigned char)string[0]) : p == string[0]))
+		return WildcardMatch(pattern + 1, patternLength - 1, string + 1, stringLength - 1, ignoreCase);
+	return false;
+}
+
+static double Match(Expr** args, size_t argCount, bool ignoreCase)
+{
+	String* pattern = ArgString(args, 0, args[0]->lineNumber);
+	String* string = ArgString(args, 1, args[1]->lineNumber);
+	for (size_t i = 2; i < argCount; ++i)
+		GetOutputArgument(args[i]);
+	return WildcardMatch(pattern->data ? pattern->data : "", pattern->length, string->data ? string->data : "", string->length, ignoreCase);
+}
+
+static double Builtin_Match(Expr** args, size_t argCount) { return Match(args, argCount, false); }
+static double Builtin_Matchi(Expr** args, size_t argCount) { return Match(args, argCount, true); }
+
+static double Builtin_Midirecv(Expr** args, size_t argCount)
+{
+	for (size_t i = 0; i < argCount; ++i)
+		GetOutputArgument(args[i]);
+	return 0;
+}
+
+static double Builtin_GetHostPlacement(Expr** args, size_t argCount)
+{
+	for (size_t i = 0; i < argCount; ++i)
+		*GetOutputArgument(args[i]) = 0;
+	return 0;
+}
+
+static void FFT(double address, int64_t size, bool inverse)
+{
+	if (size < 2 || (size & (size - 1)) != 0)
+		return;
+
+	double* re = AllocZeroed((size_t)size * sizeof(double));
+	double* im = AllocZeroed((size_t)size * sizeof(double));
+	for (int64_t i = 0; i < size; ++i)
+	{
+		re[i] = ReadMemory(address + (double)(i * 2));
+		im[i] = ReadMemory(address + (double)(i * 2 + 1));
+	}
+
+	for (int64_t i = 1, j = 0; i < size; ++i)
+	{
+		int64_t bit = size >> 1;
+		for (; j & bit; bit >>= 1)
+			j ^= bit;
+		j ^= bit;
+		if (i < j)
+		{
+			double t = re[i];
+			re[i] = re[j];
+			re[j] = t;
+			t = im[i];
+			im[i] = im[j];
+			im[j] = t;
+		}
+	}
+
+	for (int64_t length = 2; length <= size; length <<= 1)
+	{
+		double angle = 2 * 3.14159265358979323846 / (double)length * (inverse ? 1 : -1);
+		for (int64_t i = 0; i < size; i += length)
+		{
+			for (int64_t j = 0; j < length / 2; ++j)
+			{
+				double wr = cos(angle * (double)j);
+				double wi = sin(angle * (double)j);
+				int64_t a = i + j;
+				int64_t b = i + j + length / 2;
+				double ur = re[a], ui = im[a];
+				double vr = re[b] * wr - im[b] * wi;
+				double vi = re[b] * wi + im[b] * wr;
+				re[a] = ur + vr;
+				im[a] = ui + vi;
+				re[b] = ur - vr;
+				im[b] = ui - vi;
+			}
+		}
+	}
+
+	for (int64_t i = 0; i < size; ++i)
+	{
+		WriteMemory(address + (double)(i * 2), re[i]);
+		WriteMemory(address + (double)(i * 2 + 1), im[i]);
+	}
+	free(re);
+	free(im);
+}
+
+static double Builtin_FFT(Expr** args, size_t argCount)
+{
+	(void)argCount;
+	double address = ARG(0);
+	FFT(address, ToInteger(ARG(1)), false);
+	return 0;
+}
+
+static double Builtin_IFFT(Expr** args, size_t argCount)
+{
+	(void)argCount;
+	double address = ARG(0);
+	FFT(address, ToInteger(ARG(1)), true);
+	return 0;
+}
+
+static double Builtin_ConvolveC(Expr** args, size_t argCount)
+{
+	(void)argCount;
+	double destination = ARG(0);
+	double source = ARG(1);
+	int64_t size = ToInteger(ARG(2));
+	for (int64_t i = 0; i < size; ++i)
+	{
+		double ar = ReadMemory(destination + (double)(i * 2));
+		double ai = ReadMemory(destination + (double)(i * 2 + 1));
+		double br = ReadMemory(source + (double)(i * 2));
+		double bi = ReadMemory(source + (double)(i * 2 + 1));
+		WriteMemory(destination + (double)(i * 2), ar * br - ai * bi);
+		WriteMemory(destination + (double)(i * 2 + 1), ar * bi + ai * br);
+	}
+	return 0;
+}
+
+const Builtin builtins[] = {
+	{"sin", Builtin_Sin, 1, 1},
+	{"cos", Builtin_Cos, 1, 1},
+	{"tan", Builtin_Tan, 1, 1},
+	{"asin", Builtin_Asin, 1, 1},
+	{"acos", Builtin_Acos, 1, 1},
+	{"atan", Builtin_Atan, 1, 1},
+	{"atan2", Builtin_Atan2, 2, 2},
+	{"sqr", Builtin_Sqr, 1, 1},
+	{"sqrt", Builtin_Sqrt, 1, 1},
+	{"pow", Builtin_Pow, 2, 2},
+	{"exp", Builtin_Exp, 1, 1},
+	{"log", Builtin_Log, 1, 1},
+	{"log10", Builtin_Log10, 1, 1},
+	{"abs", Builtin_Abs, 1, 1},
+	{"min", Builtin_Min, 2, 2},
+	{"max", Builtin_Max, 2, 2},
+	{"sign", Builtin_Sign, 1, 1},
+	{"rand", Builtin_Rand, 0, 1},
+	{"floor", Builtin_Floor, 1, 1},
+	{"ceil", Builtin_Ceil, 1, 1},
+	{"invsqrt", Builtin_Invsqrt, 1, 1},
+
+	{"fft", Builtin_FFT, 2, 2},
+	{"ifft", Builtin_IFFT, 2, 2},
+	{"fft_real", Builtin_FFT, 2, 2},
+	{"ifft_real", Builtin_IFFT, 2, 2},
+	{"fft_permute", Builtin_Stub, 2, 2},
+	{"fft_ipermute", Builtin_Stub, 2, 2},
+	{"mdct", Builtin_Stub, 2, 2},
+	{"imdct", Builtin_Stub, 2, 2},
+	{"convolve_c", Builtin_ConvolveC, 3, 3},
+
+	{"memcpy", Builtin_Memcpy, 3, 3},
+	{"memset", Builtin_Memset, 3, 3},
+	{"mem_multiply_sum", Builtin_MemMultiplySum, 3, 3},
+	{"mem_set_values", Builtin_MemSetValues, 1, 1024},
+	{"mem_get_values", Builtin_MemGetValues, 1, 1024},
+	{"mem_insert_shuffle", Builtin_MemInsertShuffle, 3, 3},
+	{"freembuf", Builtin_Freembuf, 1, 1},
+	{"__memtop", Builtin_Memtop, 0, 0},
+
+	{"stack_push", Builtin_StackPush, 1, 1},
+	{"stack_pop", Builtin_StackPop, 0, 1},
+	{"stack_peek", Builtin_StackPeek, 1, 1},
+	{"stack_exch", Builtin_StackExch, 1, 1},
+
+	{"spl", Builtin_Spl, 1, 1},
+	{"slider", Builtin_Slider, 1, 1},
+
+	{"time", Builtin_Time, 0, 1},
+	{"time_precise", Builtin_TimePrecise, 0, 1},
+
+	{"strlen", Builtin_Strlen, 1, 1},
+	{"strcpy", Builtin_Strcpy, 2, 2},
+	{"strncpy", Builtin_Strncpy, 3, 3},
+	{"strcat", Builtin_Strcat, 2, 2},
+	{"strncat", Builtin_Strncat, 3, 3},
+	{"strcmp", Builtin_Strcmp, 2, 2},
+	{"strncmp", Builtin_Strncmp, 3, 3},
+	{"stricmp", Builtin_Stricmp, 2, 2},
+	{"strnicmp", Builtin_Strnicmp, 3, 3},
+	{"strcpy_from", Builtin_StrcpyFrom, 3, 3},
+	{"strcpy_substr", Builtin_StrcpySubstr, 4, 4},
+	{"str_getchar", Builtin_StrGetchar, 2, 3},
+	{"str_setchar", Builtin_StrSetchar, 3, 4},
+	{"str_setlen", Builtin_StrSetlen, 2, 2},
+	{"str_insert", Builtin_StrInsert, 3, 3},
+	{"str_delsub", Builtin_StrDelsub, 3, 3},
+	{"sprintf", Builtin_Sprintf, 2, 1024},
+	{"match", Builtin_Match, 2, 1024},
+	{"matchi", Builtin_Matchi, 2, 1024},
+
+	{"midirecv", Builtin_Midirecv, 3, 4},
+	{"get_host_placement", Builtin_GetHostPlacement, 0, 2},
+};
+const size_t builtinCount = sizeof(builtins) / sizeof(builtins[0]);
+
+static const Builtin stubBuiltin = {"<host>", Builtin_Stub, 0, 1024};
+
+static bool IsHostFunction(const char* name)
+{
+	static const char* prefixes[] = {
+		"gfx_", "midi", "file_", "slider_", "sliderchange", "export_buffer_to_project", "get_host_", "set_host_",
+		"get_pin", "set_pin", "get_pinmapper", "set_pinmapper", "atomic_", "strcpy_fromslider", "printf",
+	};
+	for (size_t i = 0; i < sizeof(prefixes) / sizeof(prefixes[0]); ++i)
+		if (strncmp(name, prefixes[i], strlen(prefixes[i])) == 0)
+			return true;
+	return false;
+}
+
+// ---------- linking ----------
+
+static size_t SectionOrder(size_t position);
+
+static void ResolveCalls(Expr* expr, size_t sectionIndex)
+{
+	if (!expr)
+		return;
+
+	if (expr->type == Expr_Call && !expr->function && !expr->builtin)
+	{
+		for (size_t i = 0; i < functionCount; ++i)
+		{
+			if (NameEquals(functions[i]->name, expr->callName))
+			{
+				Function* function = functions[i];
+				size_t definitionOrder = SectionOrder(function->sourcePosition);
+				if (definitionOrder > sectionIndex ||
+					(definitionOrder == sectionIndex && function->sourcePosition > expr->sourcePosition))
+					Fatal(expr->lineNumber, "function \"%s\" is used before it is defined", function->name);
+				expr->function = function;
+				break;
+			}
+		}
+
+		if (!expr->function)
+		{
+			expr->builtin = FindBuiltin(expr->callName);
+			if (!expr->builtin && IsHostFunction(expr->callName))
+				expr->builtin = &stubBuiltin;
+			if (!expr->builtin)
+				Fatal(expr->lineNumber, "unknown function \"%s\"", expr->callName);
+			if ((int)expr->argCount < expr->builtin->minArgs || (int)expr->argCount > expr->builtin->maxArgs)
+				Fatal(expr->lineNumber, "wrong number of arguments to \"%s\"", expr->callName);
+		}
+	}
+
+	ResolveCalls(expr->left, sectionIndex);
+	ResolveCalls(expr->right, sectionIndex);
+	ResolveCalls(expr->third, sectionIndex);
+	for (size_t i = 0; i < expr->argCount; ++i)
+		ResolveCalls(expr->args[i], sectionIndex);
+}
+
+// ---------- file loading ----------
+
+typedef struct
+{
+	SectionType type;
+	size_t start;
+	size_t end;
+	int lineNumber;
+} SectionRange;
+
+static SectionRange* sectionRanges;
+static size_t sectionRangeCount;
+
+static size_t SectionOrder(size_t position)
+{
+	for (size_t i = 0; i < sectionRangeCount; ++i)
+		if (position >= sectionRanges[i].start && position < sectionRanges[i].end)
+			return sectionRanges[i].type;
+	return Section_Count;
+}
+
+static char* ReadFile(const char* path, size_t* outLength)
+{
+	errno = 0;
+	FILE* file = fopen(path, "rb");
+	if (!file)
+		Fatal(0, "could not open file: %s", strerror(errno));
+
+	size_t capacity = 4096;
+	size_t length = 0;
+	char* data = AllocZeroed(capacity);
+	size_t read;
+	while ((read = fread(data + length, 1, capacity - length - 1, file)) > 0)
+	{
+		length += read;
+		if (length + 1 >= capacity)
+		{
+			capacity *= 2;
+			data = realloc(data, capacity);
+			if (!data)
+				Fatal(0, "out of memory");
+		}
+	}
+	fclose(file);
+	data[length] = '\0';
+	*outLength = length;
+	return data;
+}
+
+static void ParseSliderLine(const char* line, size_t length)
+{
+	// sliderN:[name=]default<min,max,inc>description
+	char* copy = CopyString(line, length);
+	char* colon = strchr(copy, ':');
+	long number = strtol(copy + 6, NULL, 10);
+	if (!colon || number < 1 || number > MAX_SLIDERS)
+	{
+		free(copy);
+		return;
+	}
+
+	char* value = colon + 1;
+	char* equals = strchr(value, '=');
+	char* less = strchr(value, '<');
+	if (equals && (!less || equals < less))
+	{
+		*equals = '\0';
+		sliderVariables[number] = GetVariable(value);
+		value = equals + 1;
+	}
+	sliderDefaults[number] = strtod(value, NULL);
+	sliderExists[number] = true;
+	free(copy);
+}
+
+static void LoadFile(const char* path)
+{
+	currentPath = path;
+	size_t length;
+	char* source = ReadFile(path, &length);
+
+	for (int i = 0; i < MAX_CHANNELS; ++i)
+	{
+		char name[16];
+		snprintf(name, sizeof(name), "spl%d", i);
+		splVariables[i] = GetVariable(name);
+	}
+	for (int i = 1; i <= MAX_SLIDERS; ++i)
+	{
+		char name[16];
+		snprintf(name, sizeof(name), "slider%d", i);
+		sliderVariables[i] = GetVariable(name);
+	}
+
+	// split into sections
+	int lineNumber = 1;
+	for (size_t position = 0; position < length;)
+	{
+		size_t lineEnd = position;
+		while (lineEnd < length && source[lineEnd] != '\n')
+			lineEnd++;
+
+		const char* line = source + position;
+		size_t lineLength = lineEnd - position;
+
+		if (line[0] == '@')
+		{
+			if (sectionRangeCount > 0)
+				sectionRanges[sectionRangeCount - 1].end = position;
+
+			SectionType type = Section_Count;
+			for (int i = 0; i < Section_Count; ++i)
+			{
+				size_t nameLength = strlen(sectionNames[i]);
+				if (lineLength >= nameLength + 1 && strncmp(line + 1, sectionNames[i], nameLength) == 0 &&
+					(lineLength == nameLength + 1 || isspace((unsigned char)line[nameLength + 1])))
+					type = (SectionType)i;
+			}
+			if (type == Section_Count)
+				Fatal(lineNumber, "unknown section \"%.*s\"", (int)lineLength, line);
+
+			sectionRanges = realloc(sectionRanges, (sectionRangeCount + 1) * sizeof(SectionRange));
+			if (!sectionRanges)
+				Fatal(0, "out of memory");
+			sectionRanges[sectionRangeCount++] = (SectionRange){
+				.type = type,
+				.start = lineEnd,
+				.end = length,
+				.lineNumber = lineNumber,
+			};
+		}
+		else if (sectionRangeCount == 0 && strncmp(line, "slider", 6) == 0 && isdigit((unsigned char)line[6]))
+			ParseSliderLine(line, lineLength);
+
+		position = lineEnd + 1;
+		lineNumber++;
+	}
+
+	// sections of the same type are compiled as one, in this order
+	for (int type = 0; type < Section_Count; ++type)
+	{
+		Expr* sequence = AllocExpr(Expr_Sequence, 0);
+		for (size_t i = 0; i < sectionRangeCount; ++i)
+		{
+			if (sectionRanges[i].type != (SectionType)type)
+				continue;
+
+			Parser parser = {
+				.source = source + sectionRanges[i].start,
+				.length = sectionRanges[i].end - sectionRanges[i].start,
+				.basePosition = sectionRanges[i].start,
+				.lineNumber = sectionRanges[i].lineNumber,
+			};
+			NextToken(&parser);
+			Expr* code = ParseSequence(&parser, NULL);
+			if (parser.current.type != Token_End)
+				Fatal(parser.current.lineNumber, "unexpected '%.*s'", (int)parser.current.length, parser.current.start);
+
+			sequence->args = realloc(sequence->args, (sequence->argCount + 1) * sizeof(Expr*));
+			if (!sequence->args)
+				Fatal(0, "out of memory");
+			sequence->args[sequence->argCount++] = code;
+			sections[type].sourceLength += sectionRanges[i].end - sectionRanges[i].start;
+		}
+		sections[type].code = sequence;
+	}
+
+	for (int type = 0; type < Section_Count; ++type)
+		ResolveCalls(sections[type].code, (size_t)type);
+	for (size_t i = 0; i < functionCount; ++i)
+		ResolveCalls(functions[i]->body, SectionOrder(functions[i]->sourcePosition));
+
+	sections[Section_Init].source = source;
+}
+
+// ---------- running ----------
+
+static void RunSection(SectionType type)
+{
+	Section* section = &sections[type];
+	if (!section->code || section->code->argCount == 0)
+		return;
+
+	counters = &section->counters;
+	section->counters.runs++;
+	Evaluate(section->code);
+	counters = &scratchCounters;
+}
+
+static double TestSignal(uint64_t sample, int channel)
+{
+	// deterministic mix of a sine, a square wave and noise
+	double t = (double)sample;
+	double sine = sin(t * 0.0317 * (channel + 1));
+	double square = ((sample / 97) % 2) ? 0.25 : -0.25;
+	uint64_t hash = (sample + 1) * UINT64_C(0x9E3779B97F4A7C15) ^ (uint64_t)(channel + 1) * UINT64_C(0xBF58476D1CE4E5B9);
+	hash ^= hash >> 31;
+	double noise = (double)(hash >> 11) / (double)(1ULL << 53) - 0.5;
+	return 0.5 * sine + square + 0.1 * noise;
+}
+
+
+typedef struct
+{
+	const char* path;
+	uint64_t samples;
+	int blockSize;
+	int channels;
+	double sampleRate;
+	const char* checkPrefix;
+	const char** printNames;
+	size_t printCount;
+	double dumpAddress;
+	int64_t dumpLength;
+	int gfxFrames;
+	bool report;
+	bool json;
+	bool quiet;
+} Options;
+
+static void Usage(const char* program)
+{
+	fprintf(stderr,
+		"Usage: %s <file.jsfx> [options]\n"
+		"  --samples <n>       number of samples to process (default 0)\n"
+		"  --block-size <n>    samples per @block (default 64)\n"
+		"  --channels <n>      number of channels (default 2)\n"
+		"  --srate <n>         sample rate (default 48000)\n"
+		"  --gfx-frames <n>    number of times @gfx is run (default 1)\n"
+		"  --check <prefix>    fail unless every variable starting with prefix is true\n"
+		"  --print <name>      print the final value of a variable\n"
+		"  --dump <addr> <n>   print n memory slots starting at addr, one per line\n"
+		"  --report            print operation counts per section and function\n"
+		"  --json              print the report as JSON\n"
+		"  --quiet             do not print the output hash\n",
+		program);
+	exit(EXIT_FAILURE);
+}
+
+static Options ParseOptions(int argc, char** argv)
+{
+	Options options = {
+		.blockSize = 64,
+		.channels = 2,
+		.sampleRate = 48000,
+		.gfxFrames = 1,
+	};
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const char* arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (strcmp(arg, "--samples") == 0 && hasValue)
+			options.samples = strtoull(argv[++i], NULL, 10);
+		else if (strcmp(arg, "--block-size") == 0 && hasValue)
+			options.blockSize = atoi(argv[++i]);
+		else if (strcmp(arg, "--channels") == 0 && hasValue)
+			options.channels = atoi(argv[++i]);
+		else if (strcmp(arg, "--srate") == 0 && hasValue)
+			options.sampleRate = strtod(argv[++i], NULL);
+		else if (strcmp(arg, "--gfx-frames") == 0 && hasValue)
+			options.gfxFrames = atoi(argv[++i]);
+		else if (strcmp(arg, "--check") == 0 && hasValue)
+			options.checkPrefix = argv[++i];
+		else if (strcmp(arg, "--print") == 0 && hasValue)
+		{
+			options.printNames = realloc(options.printNames, (options.printCount + 1) * sizeof(char*));
+			if (!options.printNames)
+				Fatal(0, "out of memory");
+			options.printNames[options.printCount++] = argv[++i];
+		}
+		else if (strcmp(arg, "--dump") == 0 && i + 2 < argc)
+		{
+			options.dumpAddress = strtod(argv[++i], NULL);
+			options.dumpLength = strtoll(argv[++i], NULL, 10);
+		}
+		else if (strcmp(arg, "--report") == 0)
+			options.report = true;
+		else if (strcmp(arg, "--json") == 0)
+			options.json = options.report = true;
+		else if (strcmp(arg, "--quiet") == 0)
+			options.quiet = true;
+		else if (arg[0] != '-' && !options.path)
+			options.path = arg;
+		else
+			Usage(argv[0]);
+	}
+
+	if (!options.path)
+		Usage(argv[0]);
+	if (options.blockSize < 1)
+		options.blockSize = 1;
+	if (options.channels < 1 || options.channels > MAX_CHANNELS)
+		options.channels = 2;
+	return options;
+}
+
+static double Seconds(void)
+{
+	struct timespec now;
+	timespec_get(&now, TIME_UTC);
+	return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+static void PrintReport(const Options* options, uint64_t samples, double audioSeconds)
+{
+	uint64_t sampleOps = sections[Section_Sample].counters.ops + sections[Section_Block].counters.ops;
+	// the time of the interpreter, only useful to compare runs on the same machine
+	double nsPerSample = samples ? audioSeconds * 1e9 / (double)samples : 0.0;
+	if (options->json)
+	{
+		printf("{\n  \"file\": \"%s\",\n  \"samples\": %" PRIu64 ",\n  \"hash\": \"%016" PRIx64 "\",\n", options->path, samples, outputHash);
+		printf("  \"ops_per_sample\": %.3f,\n", samples ? (double)sampleOps / (double)samples : 0.0);
+		printf("  \"ns_per_sample\": %.3f,\n", nsPerSample);
+		printf("  \"sections\": {");
+		bool first = true;
+		for (int i = 0; i < Section_Count; ++i)
+		{
+			const Counters* c = &sections[i].counters;
+			if (!sections[i].code || sections[i].code->argCount == 0)
+				continue;
+			printf("%s\n    \"%s\": {\"runs\": %" PRIu64 ", \"ops\": %" PRIu64 ", \"calls\": %" PRIu64 ", \"memory_reads\": %" PRIu64 ", \"memory_writes\": %" PRIu64 ", \"loop_iterations\": %" PRIu64 "}",
+				first ? "" : ",", sectionNames[i], c->runs, c->ops, c->calls, c->memoryReads, c->memoryWrites, c->loopIterations);
+			first = false;
+		}
+		printf("\n  },\n  \"functions\": {");
+		first = true;
+		for (size_t i = 0; i < functionCount; ++i)
+		{
+			printf("%s\n    \"%s\": {\"calls\": %" PRIu64 ", \"ops\": %" PRIu64 "}",
+				first ? "" : ",", functions[i]->name, functions[i]->callCount, functions[i]->opCount);
+			first = false;
+		}
+		printf("\n  }\n}\n");
+		return;
+	}
+
+	printf("samples: %" PRIu64 "\n", samples);
+	if (samples)
+	{
+		printf("ops/sample: %.3f\n", (double)sampleOps / (double)samples);
+		printf("ns/sample: %.3f\n", nsPerSample);
+	}
+	printf("%-10s %10s %14s %12s %12s %12s %12s\n", "section", "runs", "ops", "calls", "mem reads", "mem writes", "loop iters");
+	for (int i = 0; i < Section_Count; ++i)
+	{
+		const Counters* c = &sections[i].counters;
+		if (!sections[i].code || sections[i].code->argCount == 0)
+			continue;
+		printf("@%-9s %10" PRIu64 " %14" PRIu64 " %12" PRIu64 " %12" PRIu64 " %12" PRIu64 " %12" PRIu64 "\n",
+			sectionNames[i], c->runs, c->ops, c->calls, c->memoryReads, c->memoryWrites, c->loopIterations);
+	}
+	if (functionCount)
+	{
+		printf("%-40s %12s %14s\n", "function", "calls", "ops");
+		for (size_t i = 0; i < functionCount; ++i)
+			printf("%-40s %12" PRIu64 " %14" PRIu64 "\n", functions[i]->name, functions[i]->callCount, functions[i]->opCount);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Options options = ParseOptions(argc, argv);
+
+	counters = &scratchCounters;
+	gmem = AllocZeroed(GMEM_SIZE * sizeof(double));
+
+	LoadFile(options.path);
+
+	*GetVariable("srate") = options.sampleRate;
+	*GetVariable("num_ch") = options.channels;
+	*GetVariable("samplesblock") = options.blockSize;
+	*GetVariable("tempo") = 120;
+	*GetVariable("ts_num") = 4;
+	*GetVariable("ts_denom") = 4;
+	*GetVariable("play_state") = 1;
+	for (int i = 1; i <= MAX_SLIDERS; ++i)
+		if (sliderExists[i])
+			*sliderVariables[i] = sliderDefaults[i];
+
+	RunSection(Section_Init);
+	RunSection(Section_Slider);
+
+	uint64_t processed = 0;
+	double audioStart = Seconds();
+	while (processed < options.samples)
+	{
+		uint64_t blockLength = (uint64_t)options.blockSize;
+		if (blockLength > options.samples - processed)
+			blockLength = options.samples - processed;
+		*GetVariable("samplesblock") = (double)blockLength;
+		*GetVariable("play_position") = (double)processed / options.sampleRate;
+		*GetVariable("beat_position") = (double)processed / options.sampleRate * 2;
+
+		RunSection(Section_Block);
+		for (uint64_t i = 0; i < blockLength; ++i)
+		{
+			for (int channel = 0; channel < MAX_CHANNELS; ++channel)
+				*splVariables[channel] = channel < options.channels ? TestSignal(processed + i, channel) : 0;
+
+			RunSection(Section_Sample);
+
+			for (int channel = 0; channel < options.channels; ++channel)
+				outputHash = HashDouble(outputHash, *splVariables[channel]);
+		}
+		processed += blockLength;
+	}
+	double audioSeconds = Seconds() - audioStart;
+
+	for (int i = 0; i < options.gfxFrames; ++i)
+		RunSection(Section_GFX);
+
+	int exitCode = EXIT_SUCCESS;
+	if (hadRuntimeError)
+		exitCode = EXIT_FAILURE;
+
+	if (options.checkPrefix)
+	{
+		size_t checked = 0;
+		size_t failed = 0;
+		size_t prefixLength = strlen(options.checkPrefix);
+		for (size_t i = 0; i < variableCount; ++i)
+		{
+			if (strncmp(variables[i].name, options.checkPrefix, prefixLength) != 0)
+				continue;
+			checked++;
+			if (!IsTrue(*variables[i].value))
+			{
+				printf("FAILED: %s = %.17g\n", variables[i].name, *variables[i].value);
+				failed++;
+			}
+		}
+		printf("%zu/%zu checks passed\n", checked - failed, checked);
+		if (failed || !checked)
+			exitCode = EXIT_FAILURE;
+	}
+
+	for (size_t i = 0; i < options.printCount; ++i)
+	{
+		double* value = FindVariable(options.printNames[i]);
+		printf("%s = %.17g\n", options.printNames[i], value ? *value : 0.0);
+	}
+
+	// the output of --dump can be given to profile-report
+	for (int64_t i = 0; i < options.dumpLength; ++i)
+		printf("%.17g\n", ReadMemory(options.dumpAddress + (double)i));
+
+	if (!options.quiet && !options.json)
+		printf("hash: %016" PRIx64 "\n", outputHash);
+	if (options.report)
+		PrintReport(&options, processed, audioSeconds);
+
+	return exitCode;
+}
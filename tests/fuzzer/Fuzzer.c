@@ -0,0 +1,1346 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <math.h>
+
+#define MAX_PATH_LENGTH 4096
+#define MAX_COMMAND_LENGTH (MAX_PATH_LENGTH * 4)
+
+#define MAX_VARIABLES 512
+#define MAX_FUNCTIONS 64
+#define MAX_PARAMETERS 3
+#define MAX_EXPRESSION_DEPTH 3
+#define MAX_BLOCK_DEPTH 3
+#define MAX_LOOP_COUNT 8
+
+// the generated programs only use memory below this, so it's all compared
+#define MEMORY_SLOTS 128
+#define SAMPLES 64
+
+static const char* const levels[] = {"O1", "O2", "Os"};
+
+#define LEVEL_COUNT (sizeof(levels) / sizeof(levels[0]))
+
+// ---------- programs ----------
+
+// a program is a tree of text. statements can be taken out and expressions can be replaced with a literal,
+// which is all the minimizer needs to do
+typedef struct Node Node;
+struct Node
+{
+	char* text;
+	Node** children;
+	size_t childCount;
+	bool removable;
+	const char* literal;
+	bool removed;
+	bool replaced;
+};
+
+typedef struct
+{
+	char* data;
+	size_t length;
+	size_t capacity;
+} String;
+
+static Node* NewNode(void)
+{
+	return calloc(1, sizeof(Node));
+}
+
+static void AddChild(Node* parent, Node* child)
+{
+	parent->children = realloc(parent->children, (parent->childCount + 1) * sizeof(Node*));
+	parent->children[parent->childCount++] = child;
+}
+
+static Node* Text(const char* format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	int length = vsnprintf(NULL, 0, format, args);
+	va_end(args);
+
+	Node* node = NewNode();
+	node->text = malloc((size_t)length + 1);
+	va_start(args, format);
+	vsnprintf(node->text, (size_t)length + 1, format, args);
+	va_end(args);
+	return node;
+}
+
+// the list of children ends with NULL
+static Node* Sequence(Node* first, ...)
+{
+	Node* node = NewNode();
+	va_list args;
+	va_start(args, first);
+	for (Node* child = first; child; child = va_arg(args, Node*))
+		AddChild(node, child);
+	va_end(args);
+	return node;
+}
+
+static Node* Statement(Node* node)
+{
+	node->removable = true;
+	return node;
+}
+
+static void FreeNode(Node* node)
+{
+	for (size_t i = 0; i < node->childCount; ++i)
+		FreeNode(node->children[i]);
+	free(node->children);
+	free(node->text);
+	free(node);
+}
+
+static void AppendString(String* string, const char* text)
+{
+	size_t length = strlen(text);
+	if (string->length + length + 1 > string->capacity)
+	{
+		string->capacity = (string->length + length + 1) * 2;
+		string->data = realloc(string->data, string->capacity);
+	}
+	memcpy(string->data + string->length, text, length + 1);
+	string->length += length;
+}
+
+static void PrintNode(const Node* node, String* string)
+{
+	if (node->removed)
+		return;
+	if (node->replaced)
+	{
+		AppendString(string, node->literal);
+		return;
+	}
+
+	if (node->text)
+		AppendString(string, node->text);
+	for (size_t i = 0; i < node->childCount; ++i)
+		PrintNode(node->children[i], string);
+}
+
+// ---------- generator ----------
+
+typedef enum
+{
+	Type_Void,
+	Type_Float,
+	Type_Int,
+	Type_Bool,
+	Type_S0,
+	Type_S1,
+} Type;
+
+static const char* const typeNames[] = {"void", "float", "int", "bool", "S0", "S1"};
+
+typedef struct
+{
+	char name[16];
+	Type type;
+	bool assignable;
+	// loop counters can be used as an index into any of the arrays
+	bool counter;
+} Variable;
+
+typedef struct
+{
+	char name[16];
+	Type returnType;
+	Type parameters[MAX_PARAMETERS];
+	size_t parameterCount;
+	// a global that the function writes, -1 if there isn't one
+	int writtenGlobal;
+} Function;
+
+typedef struct
+{
+	Type returnType;
+	bool canReturn;
+	int loopDepth;
+	int blockDepth;
+	int indent;
+	bool sample;
+} Context;
+
+static uint64_t randomState;
+
+static Variable variables[MAX_VARIABLES];
+static size_t variableCount;
+static size_t globalCount;
+// nested functions can only see globals and their own variables
+static size_t visibleStart;
+
+static Function functions[MAX_FUNCTIONS];
+static size_t functionCount;
+
+static int nameCounter;
+
+static uint64_t NextRandom(void)
+{
+	// xorshift64*
+	randomState ^= randomState >> 12;
+	randomState ^= randomState << 25;
+	randomState ^= randomState >> 27;
+	return randomState * 0x2545F4914F6CDD1DULL;
+}
+
+static int Random(int count)
+{
+	return (int)(NextRandom() % (uint64_t)count);
+}
+
+static bool Chance(int percent)
+{
+	return Random(100) < percent;
+}
+
+static const char* Pick(const char* const* strings, size_t count)
+{
+	return strings[Random((int)count)];
+}
+
+#define PICK(strings) Pick(strings, sizeof(strings) / sizeof(strings[0]))
+
+static const char* Indent(int indent)
+{
+	static const char tabs[] = "\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t";
+	if (indent > (int)sizeof(tabs) - 1)
+		indent = (int)sizeof(tabs) - 1;
+	return tabs + sizeof(tabs) - 1 - indent;
+}
+
+static bool IsVisible(size_t index)
+{
+	return index < globalCount || index >= visibleStart;
+}
+
+static Variable* AddVariable(const char* prefix, Type type, bool assignable)
+{
+	if (variableCount >= MAX_VARIABLES)
+		return NULL;
+
+	Variable* variable = &variables[variableCount++];
+	snprintf(variable->name, sizeof(variable->name), "%s%d", prefix, nameCounter++);
+	variable->type = type;
+	variable->assignable = assignable;
+	variable->counter = false;
+	return variable;
+}
+
+static const Variable* FindVariable(Type type, bool assignable, bool counter)
+{
+	size_t matches = 0;
+	for (size_t i = 0; i < variableCount; ++i)
+		if (IsVisible(i) && variables[i].type == type &&
+			(!assignable || variables[i].assignable) && (!counter || variables[i].counter))
+			++matches;
+	if (matches == 0)
+		return NULL;
+
+	size_t chosen = (size_t)Random((int)matches);
+	for (size_t i = 0; i < variableCount; ++i)
+		if (IsVisible(i) && variables[i].type == type &&
+			(!assignable || variables[i].assignable) && (!counter || variables[i].counter) &&
+			chosen-- == 0)
+			return &variables[i];
+	return NULL;
+}
+
+static const Function* FindFunction(Type returnType)
+{
+	size_t matches = 0;
+	for (size_t i = 0; i < functionCount; ++i)
+		if (functions[i].returnType == returnType)
+			++matches;
+	if (matches == 0)
+		return NULL;
+
+	size_t chosen = (size_t)Random((int)matches);
+	for (size_t i = 0; i < functionCount; ++i)
+		if (functions[i].returnType == returnType && chosen-- == 0)
+			return &functions[i];
+	return NULL;
+}
+
+static bool IsNumber(Type type)
+{
+	return type == Type_Float || type == Type_Int;
+}
+
+// ints can be passed as floats
+static bool CanPass(Type type, Type parameterType)
+{
+	return type == parameterType || (parameterType == Type_Float && type == Type_Int);
+}
+
+// functions that write a global and return something that can be passed as the parameter type
+static const Function* FindGlobalWriter(Type parameterType)
+{
+	size_t matches = 0;
+	for (size_t i = 0; i < functionCount; ++i)
+		if (functions[i].writtenGlobal >= 0 && CanPass(functions[i].returnType, parameterType))
+			++matches;
+	if (matches == 0)
+		return NULL;
+
+	size_t chosen = (size_t)Random((int)matches);
+	for (size_t i = 0; i < functionCount; ++i)
+		if (functions[i].writtenGlobal >= 0 &&
+			CanPass(functions[i].returnType, parameterType) &&
+			chosen-- == 0)
+			return &functions[i];
+	return NULL;
+}
+
+static Node* GenerateExpression(Type type, int depth, const Context* context);
+static Node* GenerateStatement(const Context* context);
+static Node* GenerateBlock(const Context* context, int statementCount);
+
+static Node* Expression(Type type, Node* node)
+{
+	static const char* const literals[] = {"", "0", "0", "false", NULL, NULL};
+	node->literal = literals[type];
+	return node;
+}
+
+static Node* GenerateIndex(int length, const Context* context)
+{
+	const Variable* counter = FindVariable(Type_Int, false, true);
+	if (counter && Chance(50))
+		return Text("%s", counter->name);
+
+	if (Chance(50))
+		return Text("%d", Random(length));
+
+	return Sequence(
+		Text("int{math.abs("),
+		GenerateExpression(Type_Float, MAX_EXPRESSION_DEPTH - 1, context),
+		Text(")} %% %d", length),
+		NULL);
+}
+
+static Node* GenerateStructMember(const char* base, Type structType, Type type)
+{
+	if (type == Type_S0)
+		return Text(structType == Type_S1 ? "%s.inner" : "%s", base);
+	if (structType == Type_S0)
+		return Text(type == Type_Float ? "%s.a" : "%s.b", base);
+	if (type == Type_Float)
+		return Text(Chance(50) ? "%s.x" : "%s.inner.a", base);
+	return Text(Chance(50) ? "%s.n" : "%s.inner.b", base);
+}
+
+// something that can be assigned to, NULL if there is nothing of that type
+static Node* GenerateLValue(Type type, const Context* context)
+{
+	if (type == Type_Bool)
+	{
+		const Variable* variable = FindVariable(Type_Bool, true, false);
+		return variable ? Text("%s", variable->name) : NULL;
+	}
+
+	for (int attempt = 0; attempt < 8; ++attempt)
+	{
+		switch (Random(6))
+		{
+		case 0:
+		{
+			const Variable* variable = FindVariable(type, true, false);
+			if (variable)
+				return Text("%s", variable->name);
+			break;
+		}
+		case 1:
+		{
+			Type structType = Chance(50) ? Type_S0 : Type_S1;
+			const Variable* variable = FindVariable(structType, true, false);
+			if (variable)
+				return GenerateStructMember(variable->name, structType, type);
+			break;
+		}
+		case 2:
+			return GenerateStructMember("gs", Type_S1, type);
+		case 3:
+			if (type == Type_S0)
+				return Sequence(Text("sa["), GenerateIndex(8, context), Text("]"), NULL);
+			return Sequence(
+				Text(type == Type_Float ? "fa[" : "ia["),
+				GenerateIndex(16, context),
+				Text("]"),
+				NULL);
+		case 4:
+			return Sequence(
+				Text("sa["),
+				GenerateIndex(8, context),
+				Text(type == Type_Float ? "].a" : type == Type_Int ? "].b" : "]"),
+				NULL);
+		case 5:
+			if (type == Type_S0)
+				return Text("sp->inner");
+			if (type == Type_Float)
+				return Text(Chance(50) ? "sp->x" : "sp->inner.a");
+			return Text(Chance(50) ? "sp->n" : "sp->inner.b");
+		}
+	}
+
+	const Variable* variable = FindVariable(type, true, false);
+	return variable ? Text("%s", variable->name) : NULL;
+}
+
+// an assignment or increment used as a value, so that the order the operands run in matters
+static Node* GenerateSideEffect(Type type, Node* lvalue, int depth, const Context* context)
+{
+	static const char* const compound[] = {" += ", " -= ", " *= "};
+	switch (Random(3))
+	{
+	case 0:
+		return Sequence(Text("("), lvalue, Text(" = "), GenerateExpression(type, depth + 1, context), Text(")"), NULL);
+	case 1:
+		return Sequence(Text("("), lvalue, Text("%s", PICK(compound)), GenerateExpression(type, depth + 1, context), Text(")"), NULL);
+	default:
+		return Sequence(Text("("), lvalue, Text(Chance(50) ? "++)" : "--)"), NULL);
+	}
+}
+
+static Node* GenerateCall(const Function* function, const Context* context)
+{
+	// sometimes one argument reads a variable and another one changes it, with a side effect or a call
+	// that writes the global, so the arguments have to run in order. the call that writes it doesn't do this again
+	static bool pairing;
+	size_t readArgument = MAX_PARAMETERS;
+	size_t writeArgument = MAX_PARAMETERS;
+	Node* read = NULL;
+	Node* write = NULL;
+	size_t numbers[MAX_PARAMETERS];
+	size_t numberCount = 0;
+	for (size_t i = 0; i < function->parameterCount; ++i)
+		if (IsNumber(function->parameters[i]))
+			numbers[numberCount++] = i;
+
+	if (!pairing && function->parameterCount >= 2 && numberCount > 0 && Chance(50))
+	{
+		readArgument = numbers[Random((int)numberCount)];
+		writeArgument = (readArgument + 1 + (size_t)Random((int)function->parameterCount - 1)) % function->parameterCount;
+		Type readType = function->parameters[readArgument];
+		Type writeType = function->parameters[writeArgument];
+
+		const Function* writer = FindGlobalWriter(writeType);
+		if (writer && Chance(50) && CanPass(variables[writer->writtenGlobal].type, readType))
+		{
+			read = Text("%s", variables[writer->writtenGlobal].name);
+			pairing = true;
+			write = GenerateCall(writer, context);
+			pairing = false;
+		}
+		else if (IsNumber(readType) && IsNumber(writeType))
+		{
+			Type type = readType == Type_Float && writeType == Type_Float && Chance(70) ? Type_Float : Type_Int;
+			const Variable* variable = FindVariable(type, true, false);
+			if (variable)
+			{
+				read = Text("%s", variable->name);
+				write = GenerateSideEffect(type, Text("%s", variable->name), MAX_EXPRESSION_DEPTH - 1, context);
+			}
+		}
+	}
+
+	Node* node = Sequence(Text("%s(", function->name), NULL);
+	for (size_t i = 0; i < function->parameterCount; ++i)
+	{
+		if (i > 0)
+			AddChild(node, Text(", "));
+
+		if (read && i == readArgument)
+			AddChild(node, Expression(function->parameters[i], read));
+		else if (write && i == writeArgument)
+			AddChild(node, Expression(function->parameters[i], write));
+		else
+			AddChild(node, GenerateExpression(function->parameters[i], MAX_EXPRESSION_DEPTH - 1, context));
+	}
+	AddChild(node, Text(")"));
+	return node;
+}
+
+static Node* GenerateBlockExpression(Type type, const Context* context)
+{
+	Context inner = {
+		.returnType = type,
+		.canReturn = true,
+		.indent = context->indent + 1,
+		.blockDepth = MAX_BLOCK_DEPTH,
+		.sample = context->sample,
+	};
+
+	size_t savedVariableCount = variableCount;
+	Node* node = Sequence(Text("%s {\n", typeNames[type]), NULL);
+	if (Chance(50))
+		AddChild(node, GenerateStatement(&inner));
+	AddChild(node, Statement(Sequence(
+		Text("%sif (", Indent(inner.indent)),
+		GenerateExpression(Type_Bool, 1, &inner),
+		Text(") return "),
+		GenerateExpression(type, 1, &inner),
+		Text(";\n"),
+		NULL)));
+	AddChild(node, Sequence(
+		Text("%sreturn ", Indent(inner.indent)),
+		GenerateExpression(type, 1, &inner),
+		Text(";\n%s}", Indent(context->indent)),
+		NULL));
+	variableCount = savedVariableCount;
+	return node;
+}
+
+static Node* GenerateFloat(int depth, const Context* context)
+{
+	static const char* const literals[] = {"0", "1", "2", "0.5", "-1.5", "3.25", "10", "-7", "0.125"};
+	static const char* const operators[] = {" + ", " - ", " * "};
+	static const char* const divisors[] = {"2", "4", "0.5", "-3", "10"};
+	static const char* const functions1[] = {"math.sin", "math.abs", "math.floor"};
+	static const char* const functions2[] = {"math.min", "math.max"};
+
+	bool leaf = depth >= MAX_EXPRESSION_DEPTH;
+	switch (leaf ? Random(3) : Random(12))
+	{
+	case 0: return Text("%s", PICK(literals));
+	case 1:
+	{
+		const Variable* variable = FindVariable(Chance(70) ? Type_Float : Type_Int, false, false);
+		if (variable)
+			return Text("%s", variable->name);
+		return Text("%s", PICK(literals));
+	}
+	case 2:
+	{
+		Node* lvalue = GenerateLValue(Chance(70) ? Type_Float : Type_Int, context);
+		return lvalue ? lvalue : Text("%s", PICK(literals));
+	}
+	case 3:
+	case 4:
+		return Sequence(
+			Text("("),
+			GenerateExpression(Type_Float, depth + 1, context),
+			Text("%s", PICK(operators)),
+			GenerateExpression(Type_Float, depth + 1, context),
+			Text(")"),
+			NULL);
+	case 5:
+		return Sequence(
+			Text("("),
+			GenerateExpression(Type_Float, depth + 1, context),
+			Text(" / %s)", PICK(divisors)),
+			NULL);
+	case 6:
+		return Sequence(Text("-("), GenerateExpression(Type_Float, depth + 1, context), Text(")"), NULL);
+	case 7:
+		return Sequence(
+			Text("%s(", PICK(functions1)),
+			GenerateExpression(Type_Float, depth + 1, context),
+			Text(")"),
+			NULL);
+	case 8:
+		return Sequence(
+			Text("%s(", PICK(functions2)),
+			GenerateExpression(Type_Float, depth + 1, context),
+			Text(", "),
+			GenerateExpression(Type_Float, depth + 1, context),
+			Text(")"),
+			NULL);
+	case 9:
+	{
+		const Function* function = FindFunction(Chance(70) ? Type_Float : Type_Int);
+		if (function)
+			return GenerateCall(function, context);
+		if (context->sample)
+			return Text(Chance(50) ? "jsfx.spl0" : "jsfx.spl1");
+		return Text("%s", PICK(literals));
+	}
+	case 10:
+		if (depth > 1 || !Chance(40))
+			return GenerateFloat(depth + 1, context);
+		return GenerateBlockExpression(Type_Float, context);
+	case 11:
+	{
+		// only inside operands and arguments, statements already assign
+		Type type = Chance(70) ? Type_Float : Type_Int;
+		Node* lvalue = depth > 0 ? GenerateLValue(type, context) : NULL;
+		return lvalue ? GenerateSideEffect(type, lvalue, depth, context) : Text("%s", PICK(literals));
+	}
+	default: return NULL;
+	}
+}
+
+static Node* GenerateInt(int depth, const Context* context)
+{
+	static const char* const literals[] = {"0", "1", "2", "3", "-4", "7", "12"};
+	static const char* const divisors[] = {"3", "5", "8"};
+	static const char* const operators[] = {" & ", " | "};
+
+	bool leaf = depth >= MAX_EXPRESSION_DEPTH;
+	switch (leaf ? Random(3) : Random(9))
+	{
+	case 0: return Text("%s", PICK(literals));
+	case 1:
+	{
+		const Variable* variable = FindVariable(Type_Int, false, false);
+		return variable ? Text("%s", variable->name) : Text("%s", PICK(literals));
+	}
+	case 2:
+	{
+		Node* lvalue = GenerateLValue(Type_Int, context);
+		return lvalue ? lvalue : Text("%s", PICK(literals));
+	}
+	case 3:
+	case 4:
+		return Sequence(Text("int{"), GenerateExpression(Type_Float, depth + 1, context), Text("}"), NULL);
+	case 5:
+		return Sequence(
+			Text("("),
+			GenerateExpression(Type_Int, depth + 1, context),
+			Text(" %% %s)", PICK(divisors)),
+			NULL);
+	case 6:
+		return Sequence(
+			Text("("),
+			GenerateExpression(Type_Int, depth + 1, context),
+			Text("%s", PICK(operators)),
+			GenerateExpression(Type_Int, depth + 1, context),
+			Text(")"),
+			NULL);
+	case 7:
+	{
+		const Function* function = FindFunction(Type_Int);
+		return function ? GenerateCall(function, context) : Text("%s", PICK(literals));
+	}
+	case 8:
+	{
+		Node* lvalue = depth > 0 ? GenerateLValue(Type_Int, context) : NULL;
+		return lvalue ? GenerateSideEffect(Type_Int, lvalue, depth, context) : Text("%s", PICK(literals));
+	}
+	default: return NULL;
+	}
+}
+
+static Node* GenerateBool(int depth, const Context* context)
+{
+	static const char* const comparisons[] = {" < ", " > ", " <= ", " >= "};
+	static const char* const equality[] = {" == ", " != "};
+	static const char* const logical[] = {" && ", " || "};
+
+	bool leaf = depth >= MAX_EXPRESSION_DEPTH;
+	switch (leaf ? Random(2) : Random(6))
+	{
+	case 0: return Text(Chance(50) ? "true" : "false");
+	case 1:
+	{
+		const Variable* variable = FindVariable(Type_Bool, false, false);
+		return variable ? Text("%s", variable->name) : Text("true");
+	}
+	case 2:
+		return Sequence(
+			Text("("),
+			GenerateExpression(Type_Float, depth + 1, context),
+			Text("%s", PICK(comparisons)),
+			GenerateExpression(Type_Float, depth + 1, context),
+			Text(")"),
+			NULL);
+	case 3:
+		return Sequence(
+			Text("("),
+			GenerateExpression(Type_Int, depth + 1, context),
+			Text("%s", PICK(equality)),
+			GenerateExpression(Type_Int, depth + 1, context),
+			Text(")"),
+			NULL);
+	case 4:
+		return Sequence(
+			Text("("),
+			GenerateExpression(Type_Bool, depth + 1, context),
+			Text("%s", PICK(logical)),
+			GenerateExpression(Type_Bool, depth + 1, context),
+			Text(")"),
+			NULL);
+	case 5:
+		return Sequence(Text("!"), GenerateExpression(Type_Bool, MAX_EXPRESSION_DEPTH, context), NULL);
+	default: return NULL;
+	}
+}
+
+static Node* GenerateS0(int depth, const Context* context)
+{
+	switch (Random(4))
+	{
+	case 0:
+		return Sequence(
+			Text("S0 {.a = "),
+			GenerateExpression(Type_Float, depth + 1, context),
+			Text(", .b = "),
+			GenerateExpression(Type_Int, depth + 1, context),
+			Text("}"),
+			NULL);
+	case 1:
+	{
+		Node* lvalue = GenerateLValue(Type_S0, context);
+		if (lvalue)
+			return lvalue;
+		break;
+	}
+	case 2:
+	{
+		const Variable* variable = FindVariable(Type_S0, false, false);
+		if (variable)
+			return Text("%s", variable->name);
+		break;
+	}
+	case 3:
+	{
+		const Function* function = FindFunction(Type_S0);
+		if (function)
+			return GenerateCall(function, context);
+		break;
+	}
+	}
+	return Text("S0 {.a = 1, .b = 2}");
+}
+
+static Node* GenerateExpression(Type type, int depth, const Context* context)
+{
+	switch (type)
+	{
+	case Type_Float: return Expression(type, GenerateFloat(depth, context));
+	case Type_Int: return Expression(type, GenerateInt(depth, context));
+	case Type_Bool: return Expression(type, GenerateBool(depth, context));
+	case Type_S0: return GenerateS0(depth, context);
+	default: return Text("0");
+	}
+}
+
+static Node* GenerateDeclaration(const Context* context)
+{
+	static const Type types[] = {Type_Float, Type_Float, Type_Int, Type_Int, Type_Bool, Type_S0};
+	Type type = types[Random(sizeof(types) / sizeof(types[0]))];
+
+	// the initializer can't use the variable, so it's generated before the variable exists
+	Node* initializer = GenerateExpression(type, 0, context);
+	const Variable* variable = AddVariable("l", type, true);
+	if (!variable)
+	{
+		FreeNode(initializer);
+		return Text("");
+	}
+
+	return Statement(Sequence(
+		Text("%s%s %s = ", Indent(context->indent), typeNames[type], variable->name),
+		initializer,
+		Text(";\n"),
+		NULL));
+}
+
+static Node* GenerateAssignment(const Context* context)
+{
+	static const Type types[] = {Type_Float, Type_Float, Type_Int, Type_Int, Type_Bool, Type_S0};
+	static const char* const compound[] = {" += ", " -= ", " *= "};
+
+	Type type = types[Random(sizeof(types) / sizeof(types[0]))];
+	Node* lvalue = GenerateLValue(type, context);
+	if (!lvalue)
+		return Text("");
+
+	if ((type == Type_Float || type == Type_Int) && Chance(20))
+		return Statement(Sequence(Text("%s", Indent(context->indent)), lvalue, Text(Chance(50) ? "++;\n" : "--;\n"), NULL));
+
+	const char* assignment = " = ";
+	if ((type == Type_Float || type == Type_Int) && Chance(30))
+		assignment = PICK(compound);
+
+	return Statement(Sequence(
+		Text("%s", Indent(context->indent)),
+		lvalue,
+		Text("%s", assignment),
+		GenerateExpression(type, 0, context),
+		Text(";\n"),
+		NULL));
+}
+
+static Node* GenerateIf(const Context* context)
+{
+	Context inner = *context;
+	inner.indent++;
+	inner.blockDepth++;
+
+	Node* node = Statement(Sequence(
+		Text("%sif (", Indent(context->indent)),
+		GenerateExpression(Type_Bool, 0, context),
+		Text(")\n"),
+		GenerateBlock(&inner, 1 + Random(3)),
+		NULL));
+
+	if (Chance(40))
+	{
+		AddChild(node, Text("%selse\n", Indent(context->indent)));
+		AddChild(node, GenerateBlock(&inner, 1 + Random(3)));
+	}
+	return node;
+}
+
+static Node* GenerateLoop(const Context* context)
+{
+	Context inner = *context;
+	inner.indent++;
+	inner.blockDepth++;
+	inner.loopDepth++;
+
+	int count = 1 + Random(MAX_LOOP_COUNT);
+	size_t savedVariableCount = variableCount;
+	Variable* counter = AddVariable(Chance(60) ? "i" : "w", Type_Int, false);
+	if (!counter)
+		return Text("");
+	counter->counter = true;
+
+	Node* node;
+	if (counter->name[0] == 'i')
+	{
+		node = Statement(Sequence(
+			Text("%sfor (int %s = 0; %s < %d; %s++)\n", Indent(context->indent), counter->name, counter->name, count, counter->name),
+			GenerateBlock(&inner, 1 + Random(4)),
+			NULL));
+	}
+	else
+	{
+		// the counter is incremented first, so continue can't skip it
+		node = Statement(Sequence(
+			Text("%s{\n", Indent(context->indent)),
+			Text("%sint %s = 0;\n", Indent(inner.indent), counter->name),
+			Text("%swhile (%s < %d)\n", Indent(inner.indent), counter->name, count),
+			Text("%s{\n", Indent(inner.indent)),
+			Text("%s%s++;\n", Indent(inner.indent + 1), counter->name),
+			NULL));
+
+		inner.indent++;
+		for (int i = 1 + Random(4); i > 0; --i)
+			AddChild(node, GenerateStatement(&inner));
+		AddChild(node, Text("%s}\n%s}\n", Indent(context->indent + 1), Indent(context->indent)));
+	}
+
+	variableCount = savedVariableCount;
+	return node;
+}
+
+static Node* GenerateJump(const Context* context)
+{
+	const char* jump;
+	Node* value = NULL;
+	if (context->loopDepth > 0 && (!context->canReturn || Chance(60)))
+		jump = Chance(50) ? "break" : "continue";
+	else
+	{
+		jump = "return";
+		if (context->returnType != Type_Void)
+			value = GenerateExpression(context->returnType, 0, context);
+	}
+
+	Node* node = Statement(Sequence(
+		Text("%sif (", Indent(context->indent)),
+		GenerateExpression(Type_Bool, 1, context),
+		Text(") %s", jump),
+		NULL));
+	if (value)
+	{
+		AddChild(node, Text(" "));
+		AddChild(node, value);
+	}
+	AddChild(node, Text(";\n"));
+	return node;
+}
+
+static Node* GenerateFunction(int indent, bool nested)
+{
+	static const Type returnTypes[] = {Type_Void, Type_Float, Type_Float, Type_Int, Type_S0};
+	static const Type parameterTypes[] = {Type_Float, Type_Float, Type_Int, Type_S0};
+
+	if (functionCount >= MAX_FUNCTIONS)
+		return Text("");
+
+	Function function = {
+		.returnType = returnTypes[Random(sizeof(returnTypes) / sizeof(returnTypes[0]))],
+		.writtenGlobal = -1,
+	};
+	snprintf(function.name, sizeof(function.name), "%s%d", nested ? "n" : "f", nameCounter++);
+
+	size_t savedVariableCount = variableCount;
+	size_t savedVisibleStart = visibleStart;
+	size_t savedFunctionCount = functionCount;
+	visibleStart = variableCount;
+
+	Node* node = Statement(Text("%s%s %s(", Indent(indent), typeNames[function.returnType], function.name));
+	function.parameterCount = (size_t)Random(MAX_PARAMETERS + 1);
+	for (size_t i = 0; i < function.parameterCount; ++i)
+	{
+		function.parameters[i] = parameterTypes[Random(sizeof(parameterTypes) / sizeof(parameterTypes[0]))];
+		const Variable* parameter = AddVariable("p", function.parameters[i], true);
+		if (!parameter)
+		{
+			function.parameterCount = i;
+			break;
+		}
+		AddChild(node, Text("%s%s %s", i > 0 ? ", " : "", typeNames[function.parameters[i]], parameter->name));
+	}
+	AddChild(node, Text(")\n%s{\n", Indent(indent)));
+
+	Context context = {
+		.returnType = function.returnType,
+		.canReturn = true,
+		.indent = indent + 1,
+	};
+	if (!nested && Chance(40))
+		AddChild(node, GenerateFunction(indent + 1, true));
+
+	// calls can pass this global in another argument
+	if (Chance(50))
+	{
+		int global = Random((int)globalCount);
+		Type type = variables[global].type;
+		if (IsNumber(type))
+		{
+			function.writtenGlobal = global;
+			AddChild(node, Sequence(
+				Text("%s%s = ", Indent(indent + 1), variables[global].name),
+				GenerateExpression(type, 0, &context),
+				Text(";\n"),
+				NULL));
+		}
+	}
+	// functions that only return a value are inlined the most
+	for (int i = Chance(25) ? 0 : 2 + Random(5); i > 0; --i)
+		AddChild(node, GenerateStatement(&context));
+
+	if (function.returnType != Type_Void)
+		AddChild(node, Sequence(
+			Text("%sreturn ", Indent(indent + 1)),
+			GenerateExpression(function.returnType, 0, &context),
+			Text(";\n"),
+			NULL));
+	AddChild(node, Text("%s}\n", Indent(indent)));
+
+	variableCount = savedVariableCount;
+	visibleStart = savedVisibleStart;
+	functionCount = savedFunctionCount;
+
+	// it's only callable after its body, so nothing is recursive
+	functions[functionCount++] = function;
+	return node;
+}
+
+static Node* GenerateStatement(const Context* context)
+{
+	bool canNest = context->blockDepth < MAX_BLOCK_DEPTH;
+	for (;;)
+	{
+		switch (Random(12))
+		{
+		case 0:
+		case 1: return GenerateDeclaration(context);
+		case 2:
+		case 3:
+		case 4: return GenerateAssignment(context);
+		case 5:
+			if (canNest)
+				return GenerateIf(context);
+			break;
+		case 6:
+			if (canNest)
+				return GenerateLoop(context);
+			break;
+		case 7:
+			if (context->loopDepth > 0 || context->canReturn)
+				return GenerateJump(context);
+			break;
+		case 8:
+		{
+			const Function* function = FindFunction((Type)Random(Type_S0 + 1));
+			if (function)
+				return Statement(Sequence(Text("%s", Indent(context->indent)), GenerateCall(function, context), Text(";\n"), NULL));
+			break;
+		}
+		case 9:
+			if (context->sample)
+				return Statement(Sequence(
+					Text("%sjsfx.spl%d = ", Indent(context->indent), Random(2)),
+					GenerateExpression(Type_Float, 0, context),
+					Text(";\n"),
+					NULL));
+			break;
+		case 10:
+		case 11:
+			if (canNest)
+			{
+				Context inner = *context;
+				inner.indent++;
+				inner.blockDepth++;
+				return Statement(GenerateBlock(&inner, 1 + Random(3)));
+			}
+			break;
+		}
+	}
+}
+
+static Node* GenerateBlock(const Context* context, int statementCount)
+{
+	size_t savedVariableCount = variableCount;
+	Node* node = Sequence(Text("%s{\n", Indent(context->indent - 1)), NULL);
+	for (int i = 0; i < statementCount; ++i)
+		AddChild(node, GenerateStatement(context));
+	AddChild(node, Text("%s}\n", Indent(context->indent - 1)));
+	variableCount = savedVariableCount;
+	return node;
+}
+
+static Node* GenerateProgram(uint64_t seed)
+{
+	randomState = seed * 0x9E3779B97F4A7C15ULL + 1;
+	variableCount = 0;
+	visibleStart = 0;
+	functionCount = 0;
+	nameCounter = 0;
+
+	Node* program = Sequence(
+		Text("// generated by the fuzzer from seed %llu\n\n", (unsigned long long)seed),
+		Text("struct S0\n{\n\tfloat a;\n\tint b;\n}\n\n"),
+		Text("struct S1\n{\n\tfloat x;\n\tS0 inner;\n\tint n;\n}\n\n"),
+		Text("float[] fa = float[] {.ptr = 0, .length = 16};\n"),
+		Text("int[] ia = int[] {.ptr = 16, .length = 16};\n"),
+		Text("S0[] sa = S0[] {.ptr = 32, .length = 8};\n"),
+		Text("S1* sp = 48;\n"),
+		Text("any[] observed = any[] {.ptr = 64, .length = %d};\n", MEMORY_SLOTS - 64),
+		Text("S1 gs;\n"),
+		NULL);
+
+	// the first global is a bool, so there is always a bool to assign to
+	static const Type globalTypes[] = {Type_Float, Type_Float, Type_Int, Type_Bool};
+	int globals = 3 + Random(4);
+	for (int i = 0; i < globals; ++i)
+	{
+		Type type = i == 0 ? Type_Bool : globalTypes[Random(sizeof(globalTypes) / sizeof(globalTypes[0]))];
+		const Variable* variable = AddVariable("g", type, true);
+		AddChild(program, Text("%s %s = %s;\n", typeNames[type], variable->name, type == Type_Bool ? "true" : type == Type_Int ? "3" : "0.5"));
+	}
+	globalCount = variableCount;
+	visibleStart = variableCount;
+	AddChild(program, Text("\n"));
+
+	for (int i = 2 + Random(5); i > 0; --i)
+	{
+		AddChild(program, GenerateFunction(0, false));
+		AddChild(program, Text("\n"));
+	}
+
+	// everything that the program can change ends up in memory, where it's compared
+	Node* observe = Sequence(Text("void Observe()\n{\n"), NULL);
+	int slot = 0;
+	for (size_t i = 0; i < globalCount; ++i)
+		AddChild(observe, Statement(Text("\tobserved[%d] = %s;\n", slot++, variables[i].name)));
+	static const char* const members[] = {"x", "inner.a", "inner.b", "n"};
+	for (size_t i = 0; i < sizeof(members) / sizeof(members[0]); ++i)
+		AddChild(observe, Statement(Text("\tobserved[%d] = gs.%s;\n", slot++, members[i])));
+	AddChild(observe, Text("}\n\n"));
+	AddChild(program, observe);
+
+	static const char* const sections[] = {"init", "sample"};
+	for (size_t i = 0; i < sizeof(sections) / sizeof(sections[0]); ++i)
+	{
+		Context context = {.returnType = Type_Void, .indent = 1, .sample = i == 1};
+		Node* section = Sequence(Text("@%s\n{\n", sections[i]), NULL);
+		for (int j = 3 + Random(5); j > 0; --j)
+			AddChild(section, GenerateStatement(&context));
+		AddChild(section, Text("\tObserve();\n}\n\n"));
+		AddChild(program, section);
+		variableCount = globalCount;
+	}
+
+	return program;
+}
+
+// ---------- harness ----------
+
+typedef enum
+{
+	Outcome_Same,
+	// the unoptimized build doesn't compile or run, so there is nothing to compare against
+	Outcome_Invalid,
+	Outcome_Crash,
+	Outcome_CompileError,
+	Outcome_RuntimeError,
+	Outcome_Mismatch,
+} Outcome;
+
+static const char* const outcomeNames[] = {"same", "invalid", "compiler crash", "compile error", "runtime error", "different output"};
+
+static const char* scythePath;
+static const char* evaluatorPath;
+static const char* outputDirectory;
+
+static bool WriteText(const char* path, const char* text)
+{
+	FILE* file = fopen(path, "wb");
+	if (!file)
+		return false;
+	fputs(text, file);
+	fclose(file);
+	return true;
+}
+
+static char* ReadText(const char* path)
+{
+	FILE* file = fopen(path, "rb");
+	if (!file)
+		return NULL;
+
+	fseek(file, 0, SEEK_END);
+	long length = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	char* buffer = malloc((size_t)length + 1);
+	size_t read = fread(buffer, 1, (size_t)length, file);
+	buffer[read] = '\0';
+	fclose(file);
+	return buffer;
+}
+
+static Outcome Compile(const char* level)
+{
+	char output[MAX_PATH_LENGTH];
+	char command[MAX_COMMAND_LENGTH];
+	snprintf(output, sizeof(output), "%s/fuzz_%s.jsfx", outputDirectory, level);
+	snprintf(command, sizeof(command), "\"%s\" \"%s/fuzz.scy\" \"%s\" -%s > \"%s.log\" 2>&1",
+		scythePath, outputDirectory, output, level, output);
+	if (system(command) == 0)
+		return Outcome_Same;
+
+	// errors in the program are reported, anything else is the compiler crashing
+	strcat(output, ".log");
+	char* log = ReadText(output);
+	bool reported = log && strstr(log, "Compilation failed.");
+	free(log);
+	return reported ? Outcome_CompileError : Outcome_Crash;
+}
+
+// the memory dump and the hash of the output samples
+static char* Run(const char* level)
+{
+	char output[MAX_PATH_LENGTH];
+	char command[MAX_COMMAND_LENGTH];
+	snprintf(output, sizeof(output), "%s/fuzz_%s", outputDirectory, level);
+	snprintf(command, sizeof(command), "\"%s\" \"%s.jsfx\" --samples %d --dump 0 %d > \"%s.txt\" 2>&1",
+		evaluatorPath, output, SAMPLES, MEMORY_SLOTS, output);
+	if (system(command) != 0)
+		return NULL;
+
+	strcat(output, ".txt");
+	return ReadText(output);
+}
+
+static bool SameNumber(const char* a, const char* b)
+{
+	double x = strtod(a, NULL);
+	double y = strtod(b, NULL);
+	// optimizations are allowed to change the sign of nan
+	return x == y || (isnan(x) && isnan(y));
+}
+
+static bool SameOutput(const char* a, const char* b)
+{
+	while (*a && *b)
+	{
+		size_t lengthA = strcspn(a, "\n");
+		size_t lengthB = strcspn(b, "\n");
+		if ((lengthA != lengthB || strncmp(a, b, lengthA) != 0) && !SameNumber(a, b))
+			return false;
+
+		a += lengthA + (a[lengthA] == '\n');
+		b += lengthB + (b[lengthB] == '\n');
+	}
+	return *a == *b;
+}
+
+// the output of the program at -O0, NULL if it doesn't compile or run
+static char* RunReference(const Node* program, Outcome* outcome)
+{
+	String source = {0};
+	PrintNode(program, &source);
+
+	char path[MAX_PATH_LENGTH];
+	snprintf(path, sizeof(path), "%s/fuzz.scy", outputDirectory);
+	bool written = WriteText(path, source.data);
+	free(source.data);
+
+	*outcome = written ? Compile("O0") : Outcome_Invalid;
+	if (*outcome == Outcome_CompileError)
+		*outcome = Outcome_Invalid;
+	if (*outcome != Outcome_Same)
+		return NULL;
+
+	char* output = Run("O0");
+	if (!output)
+		*outcome = Outcome_Invalid;
+	return output;
+}
+
+static Outcome Compare(const char* expected, const char* level)
+{
+	Outcome outcome = Compile(level);
+	if (outcome != Outcome_Same)
+		return outcome;
+
+	char* actual = Run(level);
+	if (!actual)
+		return Outcome_RuntimeError;
+
+	outcome = SameOutput(expected, actual) ? Outcome_Same : Outcome_Mismatch;
+	free(actual);
+	return outcome;
+}
+
+static Outcome Check(const Node* program, const char* level)
+{
+	Outcome outcome;
+	char* expected = RunReference(program, &outcome);
+	if (!expected)
+		return outcome;
+
+	if (strcmp(level, "O0") != 0)
+		outcome = Compare(expected, level);
+	free(expected);
+	return outcome;
+}
+
+static void CollectNodes(Node* node, Node*** nodes, size_t* count)
+{
+	if (node->removable || node->literal)
+	{
+		*nodes = realloc(*nodes, (*count + 1) * sizeof(Node*));
+		(*nodes)[(*count)++] = node;
+	}
+	for (size_t i = 0; i < node->childCount; ++i)
+		CollectNodes(node->children[i], nodes, count);
+}
+
+// takes out statements and replaces expressions with literals for as long as the program still fails the same way
+static void Minimize(Node* program, const char* level, Outcome outcome)
+{
+	Node** nodes = NULL;
+	size_t count = 0;
+	CollectNodes(program, &nodes, &count);
+
+	bool changed = true;
+	while (changed)
+	{
+		changed = false;
+		for (size_t i = 0; i < count; ++i)
+		{
+			Node* node = nodes[i];
+			if (node->removed || node->replaced)
+				continue;
+
+			bool* change = node->removable ? &node->removed : &node->replaced;
+			*change = true;
+			if (Check(program, level) == outcome)
+				changed = true;
+			else
+				*change = false;
+		}
+	}
+	free(nodes);
+}
+
+static void SaveProgram(const Node* program, uint64_t seed, const char* suffix, char* path, size_t pathSize)
+{
+	String source = {0};
+	PrintNode(program, &source);
+	snprintf(path, pathSize, "%s/seed_%llu%s.scy", outputDirectory, (unsigned long long)seed, suffix);
+	WriteText(path, source.data);
+	free(source.data);
+}
+
+static void ReportFailure(Node* program, uint64_t seed, const char* level, Outcome outcome)
+{
+	char path[MAX_PATH_LENGTH];
+	char minimizedPath[MAX_PATH_LENGTH];
+	SaveProgram(program, seed, "", path, sizeof(path));
+	Minimize(program, level, outcome);
+	SaveProgram(program, seed, "_min", minimizedPath, sizeof(minimizedPath));
+
+	printf("seed %llu: %s with -%s, see %s and %s\n",
+		(unsigned long long)seed, outcomeNames[outcome], level, path, minimizedPath);
+	fflush(stdout);
+}
+
+int main(int argc, char** argv)
+{
+	if (argc != 6)
+	{
+		fprintf(stderr, "Usage: %s <scythe> <evaluator> <output_directory> <first_seed> <count>\n", argv[0]);
+		fprintf(stderr, "  a count of 0 keeps going until it's stopped\n");
+		return 1;
+	}
+
+	scythePath = argv[1];
+	evaluatorPath = argv[2];
+	outputDirectory = argv[3];
+	uint64_t firstSeed = strtoull(argv[4], NULL, 10);
+	uint64_t count = strtoull(argv[5], NULL, 10);
+
+	uint64_t checked = 0;
+	uint64_t failures = 0;
+	uint64_t invalid = 0;
+	for (uint64_t seed = firstSeed; count == 0 || seed < firstSeed + count; ++seed)
+	{
+		Node* program = GenerateProgram(seed);
+		Outcome outcome;
+		char* expected = RunReference(program, &outcome);
+		if (outcome == Outcome_Invalid)
+		{
+			// that's a bug in the generator, not the compiler
+			char path[MAX_PATH_LENGTH];
+			SaveProgram(program, seed, "_invalid", path, sizeof(path));
+			fprintf(stderr, "seed %llu: the program doesn't work at -O0, see %s\n", (unsigned long long)seed, path);
+			++invalid;
+		}
+		else if (outcome != Outcome_Same)
+		{
+			++failures;
+			ReportFailure(program, seed, "O0", outcome);
+		}
+
+		for (size_t i = 0; expected && i < LEVEL_COUNT; ++i)
+		{
+			outcome = Compare(expected, levels[i]);
+			if (outcome != Outcome_Same)
+			{
+				++failures;
+				ReportFailure(program, seed, levels[i], outcome);
+				break;
+			}
+		}
+		free(expected);
+		FreeNode(program);
+
+		if (++checked % 100 == 0)
+		{
+			printf("%llu programs, %llu failed\n", (unsigned long long)checked, (unsigned long long)failures);
+			fflush(stdout);
+		}
+	}
+
+	printf("%llu programs, %llu failed, %llu invalid\n",
+		(unsigned long long)checked, (unsigned long long)failures, (unsigned long long)invalid);
+	return failures || invalid ? 1 : 0;
+}
@@ -0,0 +1,133 @@
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// each test file has these comments at the start of a line:
+//<options> the compiler options, only the first one is used
+//<expect> text that has to be in the output
+//<reject> text that can't be in the output
+#define OPTIONS_TOKEN "//<options>"
+#define EXPECT_TOKEN "//<expect>"
+#define REJECT_TOKEN "//<reject>"
+
+static int numTestsPassed;
+
+static char* ReadFile(const char* path)
+{
+	errno = 0;
+	FILE* file = fopen(path, "rb");
+	if (!file)
+	{
+		fprintf(stderr, "Failed to open file: %s (%s)\n", strerror(errno), path);
+		exit(EXIT_FAILURE);
+	}
+
+	size_t capacity = 4096;
+	size_t length = 0;
+	char* string = malloc(capacity);
+	int c;
+	while ((c = fgetc(file)) != EOF)
+	{
+		if (length + 1 >= capacity)
+		{
+			capacity *= 2;
+			string = realloc(string, capacity);
+		}
+		string[length++] = (char)c;
+	}
+	string[length] = '\0';
+	fclose(file);
+	return string;
+}
+
+// returns the rest of the line after the token, without the leading space
+static bool GetDirective(const char* line, size_t lineLength, const char* token, char* out, size_t size)
+{
+	size_t tokenLength = strlen(token);
+	if (lineLength < tokenLength || strncmp(line, token, tokenLength) != 0)
+		return false;
+
+	size_t start = tokenLength;
+	if (start < lineLength && line[start] == ' ')
+		++start;
+
+	size_t length = lineLength - start;
+	if (length > 0 && line[lineLength - 1] == '\r')
+		--length;
+	if (length >= size)
+		length = size - 1;
+	memcpy(out, line + start, length);
+	out[length] = '\0';
+	return true;
+}
+
+static void TestFile(const char* executable, const char* outputPath, const char* path)
+{
+	char* source = ReadFile(path);
+
+	char options[256] = "";
+	for (const char* line = source; *line;)
+	{
+		const char* end = strchr(line, '\n');
+		size_t lineLength = end ? (size_t)(end - line) : strlen(line);
+		if (GetDirective(line, lineLength, OPTIONS_TOKEN, options, sizeof(options)))
+			break;
+		line += end ? lineLength + 1 : lineLength;
+	}
+
+	char command[4096];
+	snprintf(command, sizeof(command), "\"%s\" \"%s\" \"%s\" %s > /dev/null 2>&1", executable, path, outputPath, options);
+	if (system(command) != 0)
+	{
+		fprintf(stderr, "[x] Failed to compile %s %s\n", path, options);
+		exit(EXIT_FAILURE);
+	}
+	char* output = ReadFile(outputPath);
+
+	size_t lineNumber = 1;
+	for (const char* line = source; *line; ++lineNumber)
+	{
+		const char* end = strchr(line, '\n');
+		size_t lineLength = end ? (size_t)(end - line) : strlen(line);
+
+		char text[1024];
+		bool expect = GetDirective(line, lineLength, EXPECT_TOKEN, text, sizeof(text));
+		bool reject = !expect && GetDirective(line, lineLength, REJECT_TOKEN, text, sizeof(text));
+		if (expect || reject)
+		{
+			bool found = strstr(output, text) != NULL;
+			if (found != expect)
+			{
+				fprintf(stderr, "[x] Failed test in %s:%zu\n", path, lineNumber);
+				fprintf(stderr, "%s: %s\n", expect ? "Expected" : "Didn't expect", text);
+				fprintf(stderr, "Got:\n%s\n", output);
+				exit(EXIT_FAILURE);
+			}
+
+			printf("[✓] %s %s (%s:%zu)\n", expect ? "has" : "doesn't have", text, path, lineNumber);
+			++numTestsPassed;
+		}
+
+		line += end ? lineLength + 1 : lineLength;
+	}
+
+	free(output);
+	free(source);
+}
+
+int main(int argc, const char** argv)
+{
+	if (argc <= 3)
+	{
+		fprintf(stderr, "Usage: %s <scythe> <output_file> <test_files...>\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	for (int i = 3; i < argc; ++i)
+		TestFile(argv[1], argv[2], argv[i]);
+
+	printf("%d tests passed\n", numTestsPassed);
+	return EXIT_SUCCESS;
+}
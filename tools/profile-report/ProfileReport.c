@@ -0,0 +1,164 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+
+// each counter is a profile.Counter struct in memory: the count, the total time and the time the section started
+#define SLOTS_PER_COUNTER 3
+#define MAX_LINE_LENGTH 4096
+
+typedef struct
+{
+	char* name;
+	char* path;
+	int lineNumber;
+	double count;
+	double time;
+} Counter;
+
+static Counter* counters;
+static size_t counterCount;
+
+static char* AllocateString(const char* string)
+{
+	size_t length = strlen(string);
+	char* new = malloc(length + 1);
+	memcpy(new, string, length + 1);
+	return new;
+}
+
+static bool ReadMap(const char* path)
+{
+	FILE* file = fopen(path, "r");
+	if (!file)
+	{
+		fprintf(stderr, "Could not open profile map \"%s\"\n", path);
+		return false;
+	}
+
+	char line[MAX_LINE_LENGTH];
+	unsigned long long address;
+	if (!fgets(line, sizeof(line), file) || sscanf(line, "counters %llu %zu", &address, &counterCount) != 2)
+	{
+		fprintf(stderr, "\"%s\" is not a profile map\n", path);
+		fclose(file);
+		return false;
+	}
+
+	counters = calloc(counterCount, sizeof(Counter));
+	for (size_t i = 0; i < counterCount; ++i)
+	{
+		// index, name, path and line, separated by tabs
+		char* fields[4];
+		if (!fgets(line, sizeof(line), file))
+			goto error;
+
+		line[strcspn(line, "\r\n")] = '\0';
+		fields[0] = strtok(line, "\t");
+		for (int j = 1; j < 4; ++j)
+			fields[j] = strtok(NULL, "\t");
+		if (!fields[3] || strtoul(fields[0], NULL, 10) != i)
+			goto error;
+
+		counters[i].name = AllocateString(fields[1]);
+		counters[i].path = AllocateString(fields[2]);
+		counters[i].lineNumber = atoi(fields[3]);
+	}
+
+	fclose(file);
+	return true;
+
+error:
+	fprintf(stderr, "The profile map \"%s\" is incomplete\n", path);
+	fclose(file);
+	return false;
+}
+
+static bool ReadDump(const char* path)
+{
+	FILE* file = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+	if (!file)
+	{
+		fprintf(stderr, "Could not open dump \"%s\"\n", path);
+		return false;
+	}
+
+	// the dump is the memory of the counters, as numbers separated by whitespace or commas
+	size_t slot = 0;
+	char word[128];
+	while (slot < counterCount * SLOTS_PER_COUNTER && fscanf(file, " %127[^ \t\r\n,]%*[ \t\r\n,]", word) == 1)
+	{
+		double value = strtod(word, NULL);
+		Counter* counter = &counters[slot / SLOTS_PER_COUNTER];
+		if (slot % SLOTS_PER_COUNTER == 0)
+			counter->count = value;
+		else if (slot % SLOTS_PER_COUNTER == 1)
+			counter->time = value;
+		++slot;
+	}
+
+	if (file != stdin)
+		fclose(file);
+
+	if (slot < counterCount * SLOTS_PER_COUNTER)
+	{
+		fprintf(stderr, "The dump has %zu values, but %zu counters need %zu\n", slot, counterCount, counterCount * SLOTS_PER_COUNTER);
+		return false;
+	}
+	return true;
+}
+
+static int CompareCounters(const void* a, const void* b)
+{
+	const Counter* counterA = a;
+	const Counter* counterB = b;
+	if (counterA->time != counterB->time)
+		return counterA->time < counterB->time ? 1 : -1;
+	if (counterA->count != counterB->count)
+		return counterA->count < counterB->count ? 1 : -1;
+	return strcmp(counterA->name, counterB->name);
+}
+
+static void PrintCounters(bool sections)
+{
+	printf("%12s %12s %12s  %s\n", "count", "total ms", "average us", sections ? "section" : "function");
+	for (size_t i = 0; i < counterCount; ++i)
+	{
+		const Counter* counter = &counters[i];
+		// sections don't have a line, they are counted as a whole
+		if ((counter->lineNumber < 0) != sections || counter->count == 0)
+			continue;
+
+		if (sections)
+			printf("%12.0f %12.3f %12.3f  %s\n", counter->count, counter->time * 1000, counter->time * 1000000 / counter->count, counter->name);
+		else
+			printf("%12.0f %12s %12s  %s  %s:%d\n", counter->count, "", "", counter->name, counter->path, counter->lineNumber);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc != 3)
+	{
+		fprintf(stderr, "Usage: %s <profile_map> <dump>\n", argv[0]);
+		fprintf(stderr, "  <profile_map> is the .profile file that scythe writes next to the output with --profile\n");
+		fprintf(stderr, "  <dump> has the values of profile.counters in memory, or - to read them from stdin\n");
+		return 1;
+	}
+
+	if (!ReadMap(argv[1]) || !ReadDump(argv[2]))
+		return 1;
+
+	qsort(counters, counterCount, sizeof(Counter), CompareCounters);
+	PrintCounters(true);
+	printf("\n");
+	PrintCounters(false);
+
+	for (size_t i = 0; i < counterCount; ++i)
+	{
+		free(counters[i].name);
+		free(counters[i].path);
+	}
+	free(counters);
+	return 0;
+}